@@ -0,0 +1,361 @@
+#include "AmbientOcclusion.h"
+
+#include "FrameContext.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t OCCLUSION_GROUP_SIZE = 8;		// local_size of ssao.comp and ssao_temporal.comp
+	const uint32_t OCCLUSION_SAMPLES = 8;			// SAMPLE_COUNT in ssao.comp, only for the report
+
+	uint32_t groupCount(uint32_t size, uint32_t groupSize)
+	{
+		return (size + groupSize - 1) / groupSize;
+	}
+
+	VkDescriptorSetLayout createSetLayout(VkDevice device, const std::vector<VkDescriptorType>& types)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = types[i];
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutCreateInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &layout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+		}
+
+		return layout;
+	}
+
+	VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout, uint32_t pushConstantSize)
+	{
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
+		VkPipelineLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.setLayoutCount = 1;
+		layoutCreateInfo.pSetLayouts = &setLayout;
+		layoutCreateInfo.pushConstantRangeCount = 1;
+		layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout layout;
+		VkResult result = vkCreatePipelineLayout(device, &layoutCreateInfo, nullptr, &layout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Pipeline Layout!");
+		}
+
+		return layout;
+	}
+
+	VkWriteDescriptorSet imageWrite(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo* imageInfo)
+	{
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.descriptorType = type;
+		write.descriptorCount = 1;
+		write.pImageInfo = imageInfo;
+		return write;
+	}
+}
+
+AmbientOcclusion::AmbientOcclusion()
+{
+}
+
+RenderGraphResource AmbientOcclusion::addPasses(RenderGraph& newGraph, RenderGraphResource depth)
+{
+	graph = &newGraph;
+	depthResource = depth;
+
+	// -- RESOURCES --
+	// Occlusion in r, linear depth in g. Four channels, two channel storage images aren't supported everywhere
+	RenderGraphImageDesc rawDesc;
+	rawDesc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	rawDesc.scale = 0.5f;
+	rawResource = graph->createImage("SSAO raw", rawDesc);
+
+	// Accumulated over frames, read by the lighting at the end of every frame. Shared by both queue
+	// families, so the temporal pass can read the history on the compute queue
+	historyResource = graph->importImage("SSAO history", VK_FORMAT_R16G16B16A16_SFLOAT, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT, true);
+	outputResource = graph->importImage("SSAO output", VK_FORMAT_R16G16B16A16_SFLOAT, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT, true);
+	graph->exportResource(outputResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+
+	// -- PASSES --
+	// On the compute queue. The scene's fragments wait for the occlusion, the graphics work that doesn't
+	// need it (the particle emission, the scene's vertices) runs beside it
+	graph->addPass("SSAO", RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+		.read(depthResource, RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+		.write(rawResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordOcclusion(commandBuffer); });
+
+	graph->addPass("SSAO temporal", RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+		.read(rawResource, RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+		.read(historyResource, RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+		.write(outputResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordTemporal(commandBuffer); });
+
+	return outputResource;
+}
+
+void AmbientOcclusion::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue queue, VkCommandPool commandPool)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	createLayouts();
+	createAccumulation(queue, commandPool);
+
+	// Only read with texelFetch, the filtering is done in the shaders with depth aware weights
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.maxLod = 0.0f;
+
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Sampler!");
+	}
+
+	printf("Ambient occlusion: %ux%u, %u samples per pixel, temporal accumulation\n",
+		accumulationExtent.width, accumulationExtent.height, OCCLUSION_SAMPLES);
+}
+
+void AmbientOcclusion::createLayouts()
+{
+	occlusionSetLayout = createSetLayout(device, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE });
+	temporalSetLayout = createSetLayout(device, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		VK_DESCRIPTOR_TYPE_STORAGE_IMAGE });
+
+	occlusionPipelineLayout = createPipelineLayout(device, occlusionSetLayout, sizeof(PushOcclusion));
+	temporalPipelineLayout = createPipelineLayout(device, temporalSetLayout, sizeof(PushTemporal));
+}
+
+void AmbientOcclusion::createAccumulation(VkQueue queue, VkCommandPool commandPool)
+{
+	// Same size as the raw occlusion, half the output
+	accumulationExtent = graph->getImageExtent(rawResource);
+
+	for (uint32_t i = 0; i < accumulationImages.size(); i++)
+	{
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.extent = { accumulationExtent.width, accumulationExtent.height, 1 };
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		graph->setConcurrentSharing(imageCreateInfo);		// Imported as concurrent
+
+		VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &accumulationImages[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create an Image!");
+		}
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(device, accumulationImages[i], &memoryRequirements);
+
+		VkMemoryAllocateInfo memoryAllocInfo = {};
+		memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocInfo.allocationSize = memoryRequirements.size;
+		memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, &accumulationMemory[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate memory for image!");
+		}
+		vkBindImageMemory(device, accumulationImages[i], accumulationMemory[i], 0);
+
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = accumulationImages[i];
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCreateInfo.subresourceRange.baseMipLevel = 0;
+		viewCreateInfo.subresourceRange.levelCount = 1;
+		viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+		viewCreateInfo.subresourceRange.layerCount = 1;
+
+		result = vkCreateImageView(device, &viewCreateInfo, nullptr, &accumulationViews[i]);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create an Image View!");
+		}
+
+		// Every frame starts with both shader readable (the state the graph leaves them in)
+		transitionImageLayout(device, queue, commandPool, accumulationImages[i], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	historyValid = false;
+}
+
+void AmbientOcclusion::destroyAccumulation()
+{
+	for (uint32_t i = 0; i < accumulationImages.size(); i++)
+	{
+		vkDestroyImageView(device, accumulationViews[i], nullptr);
+		vkDestroyImage(device, accumulationImages[i], nullptr);
+		vkFreeMemory(device, accumulationMemory[i], nullptr);
+		accumulationViews[i] = VK_NULL_HANDLE;
+		accumulationImages[i] = VK_NULL_HANDLE;
+		accumulationMemory[i] = VK_NULL_HANDLE;
+	}
+}
+
+void AmbientOcclusion::resize(VkQueue queue, VkCommandPool commandPool)
+{
+	destroyAccumulation();
+	createAccumulation(queue, commandPool);
+}
+
+void AmbientOcclusion::appendPipelineDescs(std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles)
+{
+	computeDescs.push_back({ "SSAO", "Shaders/ssaoComp.spv", occlusionPipelineLayout });
+	computeHandles.push_back(&occlusionPipeline);
+	computeDescs.push_back({ "SSAO temporal", "Shaders/ssaoTemporalComp.spv", temporalPipelineLayout });
+	computeHandles.push_back(&temporalPipeline);
+}
+
+void AmbientOcclusion::prepareFrame(FrameContext& frame, const glm::mat4& projection, const glm::mat4& view,
+	const glm::mat4& previousViewProjection, VkExtent2D renderExtent)
+{
+	// The output of the last frame becomes the history
+	outputIndex ^= 1;
+	graph->setImportedImage(historyResource, accumulationImages[outputIndex ^ 1], accumulationViews[outputIndex ^ 1], accumulationExtent, VK_NULL_HANDLE);
+	graph->setImportedImage(outputResource, accumulationImages[outputIndex], accumulationViews[outputIndex], accumulationExtent, VK_NULL_HANDLE);
+
+	// Every other pixel of the rendered area, in both directions
+	glm::uvec2 halfSize(std::min((renderExtent.width + 1) / 2, accumulationExtent.width),
+		std::min((renderExtent.height + 1) / 2, accumulationExtent.height));
+	glm::vec2 renderSize(static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height));
+
+	// NDC and linear depth to view space, the jitter is in P[2][0] and P[2][1]
+	glm::vec4 projectionInfo(1.0f / projection[0][0], 1.0f / projection[1][1], projection[2][0], projection[2][1]);
+
+	pushOcclusion.projectionInfo = projectionInfo;
+	pushOcclusion.depthParams = glm::vec2(projection[2][2], projection[3][2]);
+	pushOcclusion.renderSize = renderSize;
+	pushOcclusion.halfSize = halfSize;
+	pushOcclusion.radius = settings.radius;
+	pushOcclusion.projectedScale = 0.5f * renderSize.y * std::abs(projection[1][1]);
+	pushOcclusion.intensity = settings.intensity;
+	pushOcclusion.frameIndex = frameIndex++;
+
+	pushTemporal.viewToPreviousClip = previousViewProjection * glm::inverse(view);
+	pushTemporal.projectionInfo = projectionInfo;
+	pushTemporal.renderSize = renderSize;
+	pushTemporal.halfSize = halfSize;
+	pushTemporal.previousRenderSize = glm::vec2(static_cast<float>(previousRenderExtent.width), static_cast<float>(previousRenderExtent.height));
+	pushTemporal.blend = settings.temporalBlend;
+	pushTemporal.historyValid = historyValid ? 1 : 0;
+
+	historyValid = true;
+	previousRenderExtent = renderExtent;
+
+	// The graph's views change with a resize, the sets are written every frame
+	VkDescriptorImageInfo depthInfo = { sampler, graph->getImageView(depthResource), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo rawStorageInfo = { VK_NULL_HANDLE, graph->getImageView(rawResource), VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorImageInfo rawSampledInfo = { sampler, graph->getImageView(rawResource), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo historyInfo = { sampler, accumulationViews[outputIndex ^ 1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo outputInfo = { VK_NULL_HANDLE, accumulationViews[outputIndex], VK_IMAGE_LAYOUT_GENERAL };
+
+	occlusionSet = frame.allocateDescriptorSet(occlusionSetLayout);
+	temporalSet = frame.allocateDescriptorSet(temporalSetLayout);
+
+	std::array<VkWriteDescriptorSet, 5> writes = {
+		imageWrite(occlusionSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &depthInfo),
+		imageWrite(occlusionSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &rawStorageInfo),
+		imageWrite(temporalSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &rawSampledInfo),
+		imageWrite(temporalSet, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &historyInfo),
+		imageWrite(temporalSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &outputInfo)
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+VkImageView AmbientOcclusion::getOutputView() const
+{
+	return accumulationViews[outputIndex];
+}
+
+AmbientOcclusionSettings& AmbientOcclusion::getSettings()
+{
+	return settings;
+}
+
+void AmbientOcclusion::recordOcclusion(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionPipelineLayout, 0, 1, &occlusionSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, occlusionPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushOcclusion), &pushOcclusion);
+	vkCmdDispatch(commandBuffer, groupCount(pushOcclusion.halfSize.x, OCCLUSION_GROUP_SIZE), groupCount(pushOcclusion.halfSize.y, OCCLUSION_GROUP_SIZE), 1);
+}
+
+void AmbientOcclusion::recordTemporal(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, temporalPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, temporalPipelineLayout, 0, 1, &temporalSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, temporalPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushTemporal), &pushTemporal);
+	vkCmdDispatch(commandBuffer, groupCount(pushTemporal.halfSize.x, OCCLUSION_GROUP_SIZE), groupCount(pushTemporal.halfSize.y, OCCLUSION_GROUP_SIZE), 1);
+}
+
+void AmbientOcclusion::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyPipeline(device, occlusionPipeline, nullptr);
+	vkDestroyPipeline(device, temporalPipeline, nullptr);
+
+	vkDestroyPipelineLayout(device, occlusionPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, temporalPipelineLayout, nullptr);
+
+	vkDestroyDescriptorSetLayout(device, occlusionSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, temporalSetLayout, nullptr);
+
+	vkDestroySampler(device, sampler, nullptr);
+
+	destroyAccumulation();
+
+	device = VK_NULL_HANDLE;
+}
+
+AmbientOcclusion::~AmbientOcclusion()
+{
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "RenderGraph.h"
+#include "PipelineManager.h"
+
+class FrameContext;
+
+/**
+ * @struct AmbientOcclusionSettings
+ * @brief Tunables of the ambient occlusion.
+ */
+struct AmbientOcclusionSettings
+{
+	float radius = 1.0f;					///< View space radius the occluders are searched in.
+	float intensity = 1.0f;					///< Scales the obscurance before it is subtracted from 1.
+	float temporalBlend = 0.1f;				///< Weight of the current frame in the accumulation.
+	float strength = 1.0f;					///< Share of the environment lighting the occlusion removes, 0 turns it off.
+};
+
+/**
+ * @class AmbientOcclusion
+ * @brief Screen space ambient occlusion at half resolution, accumulated over frames.
+ *
+ * A compute pass estimates the obscurance of every other pixel of the depth buffer with a few
+ * samples on a spiral, rotated per pixel and per frame. A second pass blurs it with depth aware
+ * weights and blends it into the previous frame's result, reprojected and rejected where the
+ * depth no longer matches. The result keeps the linear depth next to the occlusion, the lighting
+ * shaders use it to upsample with weights that don't bleed across depth edges. Both passes are
+ * in the render graph, the GPU profiler times each.
+ */
+class AmbientOcclusion
+{
+public:
+	AmbientOcclusion();
+
+	/**
+	 * @brief Declares the occlusion and accumulation passes.
+	 *
+	 * @param newGraph Graph the passes are added to, before it is compiled.
+	 * @param depth Single sampled depth of the scene, written by an earlier pass.
+	 * @return The accumulated occlusion, to be read by the lighting (SAMPLED_FRAGMENT).
+	 */
+	RenderGraphResource addPasses(RenderGraph& newGraph, RenderGraphResource depth);
+
+	/**
+	 * @brief Creates the layouts, the sampler and the accumulation images, after the graph is compiled.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param queue Queue the initial layout transitions are submitted to.
+	 * @param commandPool Pool of the transitions' command buffers.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue queue, VkCommandPool commandPool);
+
+	/**
+	 * @brief Recreates the accumulation images at the graph's new size, after it was resized.
+	 *
+	 * @throws std::runtime_error if an image can't be created.
+	 */
+	void resize(VkQueue queue, VkCommandPool commandPool);
+
+	/**
+	 * @brief Appends the compute pipelines and the members holding them, the caller creates them.
+	 */
+	void appendPipelineDescs(std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles);
+
+	/**
+	 * @brief Imports this frame's accumulation images and writes the descriptor sets of the passes.
+	 *
+	 * @param frame The frame context being recorded.
+	 * @param projection Projection of the frame, jittered like the depth buffer.
+	 * @param view View matrix of the frame.
+	 * @param previousViewProjection Unjittered view-projection of the previous frame.
+	 * @param renderExtent Area of the depth buffer rendered this frame, from its top left corner.
+	 */
+	void prepareFrame(FrameContext& frame, const glm::mat4& projection, const glm::mat4& view,
+		const glm::mat4& previousViewProjection, VkExtent2D renderExtent);
+
+	// Accumulated occlusion of the frame being recorded, occlusion in r and linear depth in g
+	VkImageView getOutputView() const;
+
+	AmbientOcclusionSettings& getSettings();
+
+	void destroy();
+
+	~AmbientOcclusion();
+
+private:
+	// Push constants, laid out as in the shaders
+	struct PushOcclusion
+	{
+		glm::vec4 projectionInfo;			// 1 / P[0][0], 1 / P[1][1], P[2][0], P[2][1]
+		glm::vec2 depthParams;				// P[2][2], P[3][2]
+		glm::vec2 renderSize;
+		glm::uvec2 halfSize;
+		float radius;
+		float projectedScale;
+		float intensity;
+		uint32_t frameIndex;
+	};
+
+	struct PushTemporal
+	{
+		glm::mat4 viewToPreviousClip;
+		glm::vec4 projectionInfo;
+		glm::vec2 renderSize;
+		glm::uvec2 halfSize;
+		glm::vec2 previousRenderSize;
+		float blend;
+		uint32_t historyValid;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	RenderGraph* graph = nullptr;
+	AmbientOcclusionSettings settings;
+
+	// -- GRAPH --
+	RenderGraphResource depthResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource rawResource = RENDER_GRAPH_INVALID;				// This frame's noisy occlusion
+	RenderGraphResource historyResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource outputResource = RENDER_GRAPH_INVALID;
+
+	// -- ACCUMULATION --
+	// Owned here, the graph's transient memory doesn't survive the frame. Read from the previous
+	// frame's, written to the other, swapped every frame
+	std::array<VkImage, 2> accumulationImages = {};
+	std::array<VkDeviceMemory, 2> accumulationMemory = {};
+	std::array<VkImageView, 2> accumulationViews = {};
+	VkExtent2D accumulationExtent = {};
+	uint32_t outputIndex = 0;
+	bool historyValid = false;				// False until a frame was accumulated at the current size
+	VkExtent2D previousRenderExtent = {};
+	uint32_t frameIndex = 0;
+
+	// -- PIPELINES --
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout occlusionSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout temporalSetLayout = VK_NULL_HANDLE;
+
+	VkPipelineLayout occlusionPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout temporalPipelineLayout = VK_NULL_HANDLE;
+
+	VkPipeline occlusionPipeline = VK_NULL_HANDLE;
+	VkPipeline temporalPipeline = VK_NULL_HANDLE;
+
+	// -- FRAME --
+	VkDescriptorSet occlusionSet = VK_NULL_HANDLE;
+	VkDescriptorSet temporalSet = VK_NULL_HANDLE;
+	PushOcclusion pushOcclusion = {};
+	PushTemporal pushTemporal = {};
+
+	void createLayouts();
+	void createAccumulation(VkQueue queue, VkCommandPool commandPool);
+	void destroyAccumulation();
+
+	void recordOcclusion(VkCommandBuffer commandBuffer);
+	void recordTemporal(VkCommandBuffer commandBuffer);
+};
@@ -0,0 +1,290 @@
+#include "AnimationSystem.h"
+
+#include "CpuProfiler.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace
+{
+	// Looping playback position in [0, duration)
+	float wrapTime(float time, float duration)
+	{
+		if (duration <= 0.0f)
+		{
+			return 0.0f;
+		}
+
+		time = std::fmod(time, duration);
+		return time < 0.0f ? time + duration : time;
+	}
+
+	// Normalised blend of two rotations along the shorter arc, close enough to a slerp between keyframes
+	glm::quat nlerp(const glm::quat& a, const glm::quat& b, float t)
+	{
+		float sign = glm::dot(a, b) < 0.0f ? -1.0f : 1.0f;
+		return glm::normalize(a * (1.0f - t) + b * (t * sign));
+	}
+}
+
+void playAnimation(AnimationComponent& animation, uint32_t clip, float fadeDuration)
+{
+	if (animation.clip == clip && animation.fade >= 1.0f)
+	{
+		return;
+	}
+
+	animation.previousClip = animation.clip;
+	animation.previousTime = animation.time;
+	animation.clip = clip;
+	animation.time = 0.0f;
+	animation.fadeDuration = fadeDuration;
+	animation.fade = fadeDuration > 0.0f ? 0.0f : 1.0f;
+}
+
+AnimationSystem::AnimationSystem()
+{
+}
+
+void AnimationSystem::create(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		workerCount = std::min(std::max(1u, std::thread::hardware_concurrency()) - 1, MAX_ANIMATION_WORKERS);
+	}
+
+	stopping = false;
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(&AnimationSystem::workerLoop, this, i);
+	}
+	printf("Animation: %u worker thread(s)\n", workerCount);
+}
+
+void AnimationSystem::update(EntityRegistry& registry, std::vector<MeshModel>& models, float deltaTime)
+{
+	PROFILE_FUNCTION();
+
+	// -- PLAYBACK --
+	// Times move on here, the palette ranges are handed out in the same pass
+	jobs.clear();
+	uint32_t paletteSize = 0;
+	registry.forEachChunk(ANIMATION_BIT | RENDER_MESH_BIT, [&](ArchetypeChunk& chunk)
+		{
+			AnimationComponent* animations = chunk.get<AnimationComponent>();
+			RenderMeshComponent* renderMeshes = chunk.get<RenderMeshComponent>();
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				AnimationComponent& animation = animations[i];
+				MeshModel& model = models[renderMeshes[i].modelIndex];
+				const std::vector<AnimationClip>& clips = model.getClips();
+				if (!model.isSkinned() || animation.clip >= clips.size())
+				{
+					animation.paletteOffset = 0xFFFFFFFF;
+					continue;
+				}
+
+				animation.time = wrapTime(animation.time + deltaTime * animation.speed, clips[animation.clip].duration);
+				if (animation.fade < 1.0f && animation.previousClip < clips.size())
+				{
+					animation.previousTime = wrapTime(animation.previousTime + deltaTime * animation.speed, clips[animation.previousClip].duration);
+					animation.fade = animation.fadeDuration > 0.0f ? std::min(1.0f, animation.fade + deltaTime / animation.fadeDuration) : 1.0f;
+				}
+				else
+				{
+					animation.fade = 1.0f;
+				}
+
+				animation.paletteOffset = paletteSize;
+				paletteSize += static_cast<uint32_t>(model.getSkinBones().size());
+				jobs.push_back({ &model, animation });
+			}
+		});
+
+	palette.resize(paletteSize);
+
+	// -- POSING --
+	nextJob = 0;
+	if (jobs.size() > 1 && !workers.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			batch++;
+			busyWorkers = static_cast<uint32_t>(workers.size());
+		}
+		wake.notify_all();
+
+		// The caller takes jobs too, then waits for the ones still being posed
+		runJobs(callerScratch);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return busyWorkers == 0; });
+	}
+	else
+	{
+		runJobs(callerScratch);
+	}
+}
+
+const std::vector<glm::mat4>& AnimationSystem::getPalette() const
+{
+	return palette;
+}
+
+void AnimationSystem::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+AnimationSystem::~AnimationSystem()
+{
+}
+
+void AnimationSystem::workerLoop(uint32_t index)
+{
+	CpuProfiler::setThreadName("Animation worker " + std::to_string(index));
+
+	Scratch scratch;
+	uint64_t seenBatch = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return stopping || batch != seenBatch; });
+			if (stopping)
+			{
+				return;
+			}
+			seenBatch = batch;
+		}
+
+		runJobs(scratch);
+
+		// Every worker checks in once per batch, so none is still reading the jobs when the next one starts
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0)
+		{
+			done.notify_one();
+		}
+	}
+}
+
+void AnimationSystem::runJobs(Scratch& scratch)
+{
+	PROFILE_SCOPE("Pose skeletons");
+
+	for (size_t i = nextJob++; i < jobs.size(); i = nextJob++)
+	{
+		evaluate(jobs[i], scratch);
+	}
+}
+
+void AnimationSystem::evaluate(const Job& job, Scratch& scratch)
+{
+	const AnimationComponent& animation = job.animation;
+	const Skeleton& skeleton = job.model->getSkeleton();
+	const std::vector<AnimationClip>& clips = job.model->getClips();
+
+	// -- LOCAL POSE --
+	samplePose(clips[animation.clip], animation.time, scratch.pose);
+	if (animation.fade < 1.0f && animation.previousClip < clips.size())
+	{
+		samplePose(clips[animation.previousClip], animation.previousTime, scratch.fadePose);
+		blendPose(scratch.pose, scratch.fadePose, 1.0f - animation.fade);
+	}
+
+	// -- HIERARCHY --
+	// Parents come first, their global transform is ready when a child needs it
+	uint32_t jointCount = skeleton.getJointCount();
+	scratch.globals.resize(jointCount);
+	for (uint32_t j = 0; j < jointCount; j++)
+	{
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(scratch.pose.translations[j]))
+			* glm::mat4_cast(scratch.pose.rotations[j])
+			* glm::scale(glm::mat4(1.0f), glm::vec3(scratch.pose.scales[j]));
+		int32_t parent = skeleton.parents[j];
+		scratch.globals[j] = parent < 0 ? local : scratch.globals[parent] * local;
+	}
+
+	// -- PALETTE --
+	// Bone space back to the mesh's space, identity in the bind pose, so a skinned mesh sits where the static one would
+	const std::vector<SkinBone>& bones = job.model->getSkinBones();
+	glm::mat4* joints = &palette[animation.paletteOffset];
+	uint32_t invertedJoint = 0xFFFFFFFF;
+	glm::mat4 jointToMesh(1.0f);
+	for (size_t b = 0; b < bones.size(); b++)
+	{
+		if (bones[b].meshJoint != invertedJoint)
+		{
+			jointToMesh = glm::inverse(scratch.globals[bones[b].meshJoint]);
+			invertedJoint = bones[b].meshJoint;
+		}
+		joints[b] = jointToMesh * scratch.globals[bones[b].joint] * bones[b].offset;
+	}
+}
+
+void AnimationSystem::samplePose(const AnimationClip& clip, float time, Pose& pose)
+{
+	uint32_t jointCount = clip.jointCount;
+	pose.translations.resize(jointCount);
+	pose.rotations.resize(jointCount);
+	pose.scales.resize(jointCount);
+
+	// The keyframe pair around the time, both are contiguous runs of every joint
+	float position = time * clip.sampleRate;
+	uint32_t frame = std::min(static_cast<uint32_t>(position), clip.frameCount - 1);
+	uint32_t nextFrame = std::min(frame + 1, clip.frameCount - 1);
+	float t = std::min(std::max(position - static_cast<float>(frame), 0.0f), 1.0f);
+
+	const glm::vec4* translations0 = &clip.translations[static_cast<size_t>(frame) * jointCount];
+	const glm::vec4* translations1 = &clip.translations[static_cast<size_t>(nextFrame) * jointCount];
+	const glm::quat* rotations0 = &clip.rotations[static_cast<size_t>(frame) * jointCount];
+	const glm::quat* rotations1 = &clip.rotations[static_cast<size_t>(nextFrame) * jointCount];
+	const glm::vec4* scales0 = &clip.scales[static_cast<size_t>(frame) * jointCount];
+	const glm::vec4* scales1 = &clip.scales[static_cast<size_t>(nextFrame) * jointCount];
+
+	// One loop per track, each a branch free run of four wide lanes
+	for (uint32_t j = 0; j < jointCount; j++)
+	{
+		pose.translations[j] = glm::mix(translations0[j], translations1[j], t);
+	}
+	for (uint32_t j = 0; j < jointCount; j++)
+	{
+		pose.rotations[j] = nlerp(rotations0[j], rotations1[j], t);
+	}
+	for (uint32_t j = 0; j < jointCount; j++)
+	{
+		pose.scales[j] = glm::mix(scales0[j], scales1[j], t);
+	}
+}
+
+void AnimationSystem::blendPose(Pose& pose, const Pose& other, float otherWeight)
+{
+	size_t jointCount = pose.translations.size();
+	for (size_t j = 0; j < jointCount; j++)
+	{
+		pose.translations[j] = glm::mix(pose.translations[j], other.translations[j], otherWeight);
+	}
+	for (size_t j = 0; j < jointCount; j++)
+	{
+		pose.rotations[j] = nlerp(pose.rotations[j], other.rotations[j], otherWeight);
+	}
+	for (size_t j = 0; j < jointCount; j++)
+	{
+		pose.scales[j] = glm::mix(pose.scales[j], other.scales[j], otherWeight);
+	}
+}
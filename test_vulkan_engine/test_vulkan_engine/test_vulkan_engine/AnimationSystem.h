@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "EntityRegistry.h"
+#include "MeshModel.h"
+
+// Upper limit of the worker threads, posing is cheap next to the rest of the frame
+const uint32_t MAX_ANIMATION_WORKERS = 4;
+
+/**
+ * @brief Starts a clip on an entity, crossfading from the one that was playing.
+ *
+ * @param animation The entity's playback state.
+ * @param clip Index of the clip in the model's clip list.
+ * @param fadeDuration Length of the crossfade in seconds, 0 switches at once.
+ */
+void playAnimation(AnimationComponent& animation, uint32_t clip, float fadeDuration);
+
+/**
+ * @class AnimationSystem
+ * @brief Poses the skinned entities every frame on a few persistent worker threads.
+ *
+ * The playback times are advanced on the calling thread, then the pose of every animated entity is
+ * a job: its clips are sampled (a straight blend of two keyframe runs), crossfaded, multiplied down
+ * the joint hierarchy and turned into the joint matrices of the model's skin bones. Each job writes
+ * its own range of the palette, which the skinning pass uploads and reads.
+ */
+class AnimationSystem
+{
+public:
+	AnimationSystem();
+
+	/**
+	 * @brief Starts the worker threads.
+	 *
+	 * @param workerCount Threads besides the caller, 0 picks one less than the hardware threads (at most MAX_ANIMATION_WORKERS).
+	 */
+	void create(uint32_t workerCount = 0);
+
+	/**
+	 * @brief Advances the clips and computes the joint palettes, returns once every entity is posed.
+	 *
+	 * @param registry The entity storage, the entities owning an AnimationComponent and a RenderMeshComponent are posed.
+	 * @param models The loaded models, indexed by RenderMeshComponent::modelIndex.
+	 * @param deltaTime The time elapsed since the last frame.
+	 */
+	void update(EntityRegistry& registry, std::vector<MeshModel>& models, float deltaTime);
+
+	// Joint matrices of every posed entity, each starts at its AnimationComponent::paletteOffset
+	const std::vector<glm::mat4>& getPalette() const;
+
+	void destroy();
+
+	~AnimationSystem();
+
+private:
+	struct Job
+	{
+		MeshModel* model;
+		AnimationComponent animation;
+	};
+
+	// Local transforms of the joints, laid out like the clips
+	struct Pose
+	{
+		std::vector<glm::vec4> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec4> scales;
+	};
+
+	// Per thread working memory, kept between frames
+	struct Scratch
+	{
+		Pose pose;
+		Pose fadePose;
+		std::vector<glm::mat4> globals;
+	};
+
+	std::vector<Job> jobs;
+	std::vector<glm::mat4> palette;
+	std::atomic<size_t> nextJob{ 0 };
+	Scratch callerScratch;
+
+	// -- WORKERS --
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;			// Workers wait for the next batch
+	std::condition_variable done;			// The caller waits for the workers to finish it
+	uint64_t batch = 0;
+	uint32_t busyWorkers = 0;
+	bool stopping = false;
+
+	void workerLoop(uint32_t index);
+	void runJobs(Scratch& scratch);
+	void evaluate(const Job& job, Scratch& scratch);
+
+	static void samplePose(const AnimationClip& clip, float time, Pose& pose);
+	static void blendPose(Pose& pose, const Pose& other, float otherWeight);
+};
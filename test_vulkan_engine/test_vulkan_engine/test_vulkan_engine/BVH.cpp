@@ -0,0 +1,454 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	// Relative cost of visiting a node compared to testing a primitive
+	const float SAH_TRAVERSAL_COST = 1.0f;
+
+	// Initial capacity of the traversal stack (SAH trees are not balanced, so it can still grow)
+	const size_t BVH_STACK_RESERVE = 64;
+
+	bool sameBounds(const AABB& a, const AABB& b)
+	{
+		return a.min == b.min && a.max == b.max;
+	}
+}
+
+BVH::BVH()
+{
+}
+
+void BVH::build(const std::vector<AABB>& bounds, const std::vector<Entity>& entities)
+{
+	if (bounds.size() != entities.size())
+	{
+		throw std::runtime_error("Failed to build BVH, bounds and entities differ in size!");
+	}
+
+	clear();
+	if (bounds.empty())
+	{
+		return;
+	}
+
+	primitiveBounds = bounds;
+	primitiveEntities = entities;
+	primitiveLeaf.resize(bounds.size(), 0);
+
+	primitiveOrder.resize(bounds.size());
+	std::vector<glm::vec3> centroids(bounds.size());
+	for (uint32_t i = 0; i < bounds.size(); i++)
+	{
+		primitiveOrder[i] = i;
+		centroids[i] = bounds[i].getCenter();
+	}
+
+	// A binary tree with n leaves has at most 2n - 1 nodes
+	nodes.reserve(bounds.size() * 2);
+
+	BVHNode root;
+	root.firstPrimitive = 0;
+	root.primitiveCount = static_cast<uint32_t>(bounds.size());
+	nodes.push_back(root);
+
+	buildNode(0, centroids);
+}
+
+void BVH::updatePrimitive(uint32_t primitive, const AABB& bounds)
+{
+	if (primitive >= primitiveBounds.size())
+	{
+		return;
+	}
+
+	primitiveBounds[primitive] = bounds;
+
+	// Walk up to the root, stop as soon as a node doesn't change
+	int32_t nodeIndex = static_cast<int32_t>(primitiveLeaf[primitive]);
+	while (nodeIndex >= 0)
+	{
+		BVHNode& node = nodes[nodeIndex];
+
+		AABB newBounds;
+		if (node.left < 0)
+		{
+			newBounds = computeRangeBounds(node.firstPrimitive, node.primitiveCount);
+		}
+		else
+		{
+			newBounds = nodes[node.left].bounds;
+			newBounds.expand(nodes[node.left + 1].bounds);
+		}
+
+		if (sameBounds(newBounds, node.bounds))
+		{
+			break;
+		}
+
+		node.bounds = newBounds;
+		nodeIndex = node.parent;
+	}
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<Entity>& outEntities) const
+{
+	outEntities.clear();
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	std::vector<int32_t> stack;
+	stack.reserve(BVH_STACK_RESERVE);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		const BVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		FrustumTestResult result = testFrustumAABB(frustum, node.bounds);
+		if (result == FRUSTUM_OUTSIDE)
+		{
+			continue;
+		}
+
+		// Everything below a fully visible node is visible, leaves are accepted as they are
+		if (result == FRUSTUM_INSIDE || node.left < 0)
+		{
+			for (uint32_t i = 0; i < node.primitiveCount; i++)
+			{
+				uint32_t primitive = primitiveOrder[node.firstPrimitive + i];
+				if (node.primitiveCount == 1 || result == FRUSTUM_INSIDE ||
+					testFrustumAABB(frustum, primitiveBounds[primitive]) != FRUSTUM_OUTSIDE)
+				{
+					outEntities.push_back(primitiveEntities[primitive]);
+				}
+			}
+			continue;
+		}
+
+		stack.push_back(node.left);
+		stack.push_back(node.left + 1);
+	}
+}
+
+bool BVH::raycast(const Ray& ray, float maxDistance, Entity ignore, BVHRayHit* outHit) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	glm::vec3 invDirection = 1.0f / ray.direction;
+	float closest = maxDistance;
+	Entity closestEntity = INVALID_ENTITY;
+
+	float rootDistance;
+	if (!intersectRayAABB(ray, invDirection, nodes[0].bounds, closest, &rootDistance))
+	{
+		return false;
+	}
+
+	std::vector<int32_t> stack;
+	stack.reserve(BVH_STACK_RESERVE);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		const BVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (node.left < 0)
+		{
+			for (uint32_t i = 0; i < node.primitiveCount; i++)
+			{
+				uint32_t primitive = primitiveOrder[node.firstPrimitive + i];
+				float distance;
+				if (primitiveEntities[primitive] != ignore &&
+					intersectRayAABB(ray, invDirection, primitiveBounds[primitive], closest, &distance) &&
+					(closestEntity == INVALID_ENTITY || distance < closest))
+				{
+					closest = distance;
+					closestEntity = primitiveEntities[primitive];
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so the far one can be culled by the closest hit. Once there
+		// is a hit, a child entered only at the same distance can't improve it (stacked duplicates)
+		float leftDistance, rightDistance;
+		bool hitLeft = intersectRayAABB(ray, invDirection, nodes[node.left].bounds, closest, &leftDistance) &&
+			(closestEntity == INVALID_ENTITY || leftDistance < closest);
+		bool hitRight = intersectRayAABB(ray, invDirection, nodes[node.left + 1].bounds, closest, &rightDistance) &&
+			(closestEntity == INVALID_ENTITY || rightDistance < closest);
+
+		if (hitLeft && hitRight)
+		{
+			bool leftFirst = leftDistance <= rightDistance;
+			stack.push_back(leftFirst ? node.left + 1 : node.left);
+			stack.push_back(leftFirst ? node.left : node.left + 1);
+		}
+		else if (hitLeft)
+		{
+			stack.push_back(node.left);
+		}
+		else if (hitRight)
+		{
+			stack.push_back(node.left + 1);
+		}
+	}
+
+	if (closestEntity == INVALID_ENTITY)
+	{
+		return false;
+	}
+
+	outHit->entity = closestEntity;
+	outHit->distance = closest;
+	return true;
+}
+
+Entity BVH::findNearest(const glm::vec3& point, float maxDistance, Entity ignore, float* outDistance,
+	const std::function<bool(Entity)>& accept) const
+{
+	if (nodes.empty())
+	{
+		return INVALID_ENTITY;
+	}
+
+	float closestSq = maxDistance * maxDistance;
+	Entity closestEntity = INVALID_ENTITY;
+
+	std::vector<int32_t> stack;
+	stack.reserve(BVH_STACK_RESERVE);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		const BVHNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		// Skip subtrees that can't contain anything closer than the best so far (or only ties of it)
+		float nodeDistanceSq = distanceSquaredPointAABB(point, node.bounds);
+		if (nodeDistanceSq > closestSq || (closestEntity != INVALID_ENTITY && nodeDistanceSq >= closestSq))
+		{
+			continue;
+		}
+
+		if (node.left < 0)
+		{
+			for (uint32_t i = 0; i < node.primitiveCount; i++)
+			{
+				uint32_t primitive = primitiveOrder[node.firstPrimitive + i];
+				float distanceSq = distanceSquaredPointAABB(point, primitiveBounds[primitive]);
+				if (primitiveEntities[primitive] != ignore &&
+					(distanceSq < closestSq || (closestEntity == INVALID_ENTITY && distanceSq == closestSq)) &&
+					(!accept || accept(primitiveEntities[primitive])))
+				{
+					closestSq = distanceSq;
+					closestEntity = primitiveEntities[primitive];
+				}
+			}
+			continue;
+		}
+
+		// Push the closer child last so it is visited first
+		float leftSq = distanceSquaredPointAABB(point, nodes[node.left].bounds);
+		float rightSq = distanceSquaredPointAABB(point, nodes[node.left + 1].bounds);
+		bool leftFirst = leftSq <= rightSq;
+		stack.push_back(leftFirst ? node.left + 1 : node.left);
+		stack.push_back(leftFirst ? node.left : node.left + 1);
+	}
+
+	if (outDistance != nullptr && closestEntity != INVALID_ENTITY)
+	{
+		*outDistance = glm::sqrt(closestSq);
+	}
+
+	return closestEntity;
+}
+
+size_t BVH::getPrimitiveCount() const
+{
+	return primitiveBounds.size();
+}
+
+size_t BVH::getNodeCount() const
+{
+	return nodes.size();
+}
+
+void BVH::clear()
+{
+	nodes.clear();
+	primitiveBounds.clear();
+	primitiveEntities.clear();
+	primitiveOrder.clear();
+	primitiveLeaf.clear();
+}
+
+BVH::~BVH()
+{
+}
+
+void BVH::buildNode(uint32_t nodeIndex, std::vector<glm::vec3>& centroids)
+{
+	// Note: nodes can reallocate while children are added, so the node is always accessed by index
+	nodes[nodeIndex].bounds = computeRangeBounds(nodes[nodeIndex].firstPrimitive, nodes[nodeIndex].primitiveCount);
+
+	uint32_t first = nodes[nodeIndex].firstPrimitive;
+	uint32_t count = nodes[nodeIndex].primitiveCount;
+
+	int axis;
+	float split;
+	bool foundSplit = count > BVH_MAX_LEAF_PRIMITIVES && findSAHSplit(nodes[nodeIndex], centroids, &axis, &split);
+	if (!foundSplit && count <= BVH_FORCED_SPLIT_PRIMITIVES)
+	{
+		// Make a leaf
+		for (uint32_t i = 0; i < count; i++)
+		{
+			primitiveLeaf[primitiveOrder[first + i]] = nodeIndex;
+		}
+		return;
+	}
+
+	uint32_t* begin = primitiveOrder.data() + first;
+	uint32_t leftCount = 0;
+	if (foundSplit)
+	{
+		// Partition the range on the chosen plane
+		uint32_t* middle = std::partition(begin, begin + count,
+			[&](uint32_t primitive) { return centroids[primitive][axis] < split; });
+		leftCount = static_cast<uint32_t>(middle - begin);
+	}
+	else
+	{
+		// No cheaper plane (or coinciding centroids) on a large range: split along the longest
+		// axis anyway, so duplicated instances don't end up as one leaf scanned linearly
+		glm::vec3 extent = nodes[nodeIndex].bounds.getExtent();
+		axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	}
+
+	// Degenerate or forced split, fall back to the median
+	if (leftCount == 0 || leftCount == count)
+	{
+		leftCount = count / 2;
+		std::nth_element(begin, begin + leftCount, begin + count,
+			[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+	}
+
+	// Children are allocated next to each other
+	int32_t leftIndex = static_cast<int32_t>(nodes.size());
+
+	BVHNode leftNode;
+	leftNode.parent = static_cast<int32_t>(nodeIndex);
+	leftNode.firstPrimitive = first;
+	leftNode.primitiveCount = leftCount;
+
+	BVHNode rightNode;
+	rightNode.parent = static_cast<int32_t>(nodeIndex);
+	rightNode.firstPrimitive = first + leftCount;
+	rightNode.primitiveCount = count - leftCount;
+
+	nodes.push_back(leftNode);
+	nodes.push_back(rightNode);
+	nodes[nodeIndex].left = leftIndex;
+
+	buildNode(leftIndex, centroids);
+	buildNode(leftIndex + 1, centroids);
+}
+
+bool BVH::findSAHSplit(const BVHNode& node, const std::vector<glm::vec3>& centroids, int* outAxis, float* outSplit) const
+{
+	// Bin the centroids instead of the boxes, their bounds decide the bin layout
+	AABB centroidBounds;
+	for (uint32_t i = 0; i < node.primitiveCount; i++)
+	{
+		centroidBounds.expand(centroids[primitiveOrder[node.firstPrimitive + i]]);
+	}
+
+	// Flat nodes have no area, any positive value keeps the child costs comparable
+	float parentArea = node.bounds.getSurfaceArea();
+	if (parentArea <= 0.0f)
+	{
+		parentArea = 1.0f;
+	}
+	float bestCost = static_cast<float>(node.primitiveCount);		// Cost of keeping the node as a leaf
+	bool found = false;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float axisMin = centroidBounds.min[axis];
+		float axisExtent = centroidBounds.max[axis] - axisMin;
+		if (axisExtent <= 0.0f)
+		{
+			continue;
+		}
+
+		AABB binBounds[BVH_SAH_BIN_COUNT];
+		uint32_t binCounts[BVH_SAH_BIN_COUNT] = {};
+		float binScale = BVH_SAH_BIN_COUNT / axisExtent;
+
+		for (uint32_t i = 0; i < node.primitiveCount; i++)
+		{
+			uint32_t primitive = primitiveOrder[node.firstPrimitive + i];
+			uint32_t bin = std::min(BVH_SAH_BIN_COUNT - 1, static_cast<uint32_t>((centroids[primitive][axis] - axisMin) * binScale));
+			binCounts[bin]++;
+			binBounds[bin].expand(primitiveBounds[primitive]);
+		}
+
+		// Sweep from the right to get the cost of the right side of every plane
+		float rightAreas[BVH_SAH_BIN_COUNT];
+		uint32_t rightCounts[BVH_SAH_BIN_COUNT];
+		AABB rightBox;
+		uint32_t rightCount = 0;
+		for (uint32_t bin = BVH_SAH_BIN_COUNT - 1; bin > 0; bin--)
+		{
+			rightBox.expand(binBounds[bin]);
+			rightCount += binCounts[bin];
+			rightAreas[bin] = rightBox.getSurfaceArea();
+			rightCounts[bin] = rightCount;
+		}
+
+		// Sweep from the left and evaluate the plane between bin - 1 and bin
+		AABB leftBox;
+		uint32_t leftCount = 0;
+		for (uint32_t bin = 1; bin < BVH_SAH_BIN_COUNT; bin++)
+		{
+			leftBox.expand(binBounds[bin - 1]);
+			leftCount += binCounts[bin - 1];
+			if (leftCount == 0 || rightCounts[bin] == 0)
+			{
+				continue;
+			}
+
+			float cost = SAH_TRAVERSAL_COST +
+				(leftBox.getSurfaceArea() * leftCount + rightAreas[bin] * rightCounts[bin]) / parentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				*outAxis = axis;
+				*outSplit = axisMin + bin / binScale;
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+AABB BVH::computeRangeBounds(uint32_t first, uint32_t count) const
+{
+	AABB bounds;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		bounds.expand(primitiveBounds[primitiveOrder[first + i]]);
+	}
+
+	return bounds;
+}
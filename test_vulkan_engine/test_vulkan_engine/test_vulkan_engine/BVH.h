@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Components.h"
+
+const uint32_t BVH_MAX_LEAF_PRIMITIVES = 2;		// Leaves are not split below this
+const uint32_t BVH_FORCED_SPLIT_PRIMITIVES = 8;	// Above this a leaf is split at the median even when the SAH finds no cheaper plane
+const uint32_t BVH_SAH_BIN_COUNT = 12;			// Number of buckets the SAH evaluates per axis
+const uint32_t BVH_INVALID_PRIMITIVE = 0xFFFFFFFF;
+
+/**
+ * @struct BVHNode
+ * @brief Node of the hierarchy.
+ *
+ * The primitives below a node are always a contiguous range of the primitive order,
+ * inner nodes store it as well so fully visible subtrees can be emitted without traversal.
+ */
+struct BVHNode
+{
+	AABB bounds;					///< Union of every primitive below the node.
+	int32_t left = -1;				///< Index of the left child (right is left + 1), -1 for leaves.
+	int32_t parent = -1;			///< Index of the parent, -1 for the root.
+	uint32_t firstPrimitive = 0;	///< First entry of the node's range in the primitive order.
+	uint32_t primitiveCount = 0;	///< Number of primitives below the node.
+};
+
+/**
+ * @struct BVHRayHit
+ * @brief Closest primitive hit by a ray.
+ */
+struct BVHRayHit
+{
+	Entity entity = INVALID_ENTITY;		///< The hit entity.
+	float distance = 0.0f;				///< Distance along the ray to the entry point of its bounds.
+};
+
+/**
+ * @class BVH
+ * @brief Bounding volume hierarchy over world space boxes of scene entities.
+ *
+ * Built top-down with a binned surface area heuristic. Moving primitives only refit
+ * the nodes on their path to the root, the tree is rebuilt when primitives are added
+ * or removed. Used for frustum culling, ray picking and nearest object queries.
+ */
+class BVH
+{
+public:
+	BVH();
+
+	/**
+	 * @brief Builds the hierarchy from scratch.
+	 *
+	 * @param bounds World space box of every primitive.
+	 * @param entities Entity of every primitive (same size as bounds).
+	 */
+	void build(const std::vector<AABB>& bounds, const std::vector<Entity>& entities);
+
+	/**
+	 * @brief Changes the box of a primitive and refits the nodes above it.
+	 *
+	 * @param primitive Index of the primitive (its position in the array passed to build).
+	 * @param bounds The new world space box.
+	 */
+	void updatePrimitive(uint32_t primitive, const AABB& bounds);
+
+	/**
+	 * @brief Collects every entity whose box is (at least partially) inside the frustum.
+	 *
+	 * @param frustum The view frustum.
+	 * @param outEntities Receives the visible entities (it is cleared first).
+	 */
+	void queryFrustum(const Frustum& frustum, std::vector<Entity>& outEntities) const;
+
+	/**
+	 * @brief Finds the closest entity box hit by a ray.
+	 *
+	 * @param ray The ray to cast.
+	 * @param maxDistance Hits further than this are ignored.
+	 * @param ignore Entity skipped by the query (e.g. the one casting the ray).
+	 * @param outHit Receives the closest hit.
+	 * @return True if something was hit.
+	 */
+	bool raycast(const Ray& ray, float maxDistance, Entity ignore, BVHRayHit* outHit) const;
+
+	/**
+	 * @brief Finds the entity whose box is closest to a point.
+	 *
+	 * @param point The query point.
+	 * @param maxDistance Entities further than this are ignored.
+	 * @param ignore Entity skipped by the query.
+	 * @param outDistance Receives the distance to the closest box (can be nullptr).
+	 * @param accept Only the entities it returns true for are considered (every entity if empty).
+	 * @return The closest entity, or INVALID_ENTITY if none is in range.
+	 */
+	Entity findNearest(const glm::vec3& point, float maxDistance, Entity ignore, float* outDistance,
+		const std::function<bool(Entity)>& accept = nullptr) const;
+
+	size_t getPrimitiveCount() const;
+	size_t getNodeCount() const;
+
+	void clear();
+
+	~BVH();
+
+private:
+	std::vector<BVHNode> nodes;
+	std::vector<AABB> primitiveBounds;			// Indexed by primitive
+	std::vector<Entity> primitiveEntities;		// Indexed by primitive
+	std::vector<uint32_t> primitiveOrder;		// Primitive indices, every node covers a contiguous range
+	std::vector<uint32_t> primitiveLeaf;		// Leaf node holding each primitive
+
+	void buildNode(uint32_t nodeIndex, std::vector<glm::vec3>& centroids);
+	bool findSAHSplit(const BVHNode& node, const std::vector<glm::vec3>& centroids, int* outAxis, float* outSplit) const;
+	AABB computeRangeBounds(uint32_t first, uint32_t count) const;
+};
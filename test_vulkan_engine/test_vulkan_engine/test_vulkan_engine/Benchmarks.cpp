@@ -0,0 +1,447 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "EntityRegistry.h"
+#include "SceneSystems.h"
+#include "BVH.h"
+#include "FrustumCuller.h"
+#include "CpuProfiler.h"
+
+namespace
+{
+	typedef std::chrono::steady_clock BenchClock;
+
+	double elapsedMs(BenchClock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+	}
+
+	// Stand-in for a Mesh: the draw loop only needs its buffers and index count
+	struct BenchMesh
+	{
+		uint64_t vertexBuffer;
+		uint64_t indexBuffer;
+		int indexCount;
+		int texId;
+	};
+
+	// Replica of the old MeshModel layout: meshes, matrix and controller state in one object
+	struct LegacyModel
+	{
+		std::vector<BenchMesh> meshList;
+		glm::mat4 model;
+		glm::vec3 position;
+		bool controlable;
+		float angleY;
+		float angleX;
+	};
+
+	// Same logic as the old MeshModel::keyControl
+	void legacyKeyControl(LegacyModel& model, bool* keys, float deltaTime, float moveSpeed, float angleSpeed)
+	{
+		if (!model.controlable)
+		{
+			return;
+		}
+
+		glm::vec3 forward = glm::normalize(glm::vec3(model.model[2]));
+		glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::vec3 up = glm::normalize(glm::cross(right, forward));
+
+		if (keys[GLFW_KEY_UP]) { model.position += forward * moveSpeed * deltaTime; }
+		if (keys[GLFW_KEY_DOWN]) { model.position -= forward * moveSpeed * deltaTime; }
+
+		bool isCtrlPressed = keys[GLFW_KEY_RIGHT_CONTROL] || keys[GLFW_KEY_LEFT_CONTROL];
+		if (isCtrlPressed)
+		{
+			if (keys[GLFW_KEY_UP]) { model.position += up * moveSpeed * deltaTime; }
+			if (keys[GLFW_KEY_DOWN]) { model.position -= up * moveSpeed * deltaTime; }
+		}
+
+		if (keys[GLFW_KEY_KP_8]) { model.angleX -= angleSpeed * deltaTime; }
+		if (keys[GLFW_KEY_KP_2]) { model.angleX += angleSpeed * deltaTime; }
+		if (keys[GLFW_KEY_KP_4]) { model.angleY += angleSpeed * deltaTime; }
+		if (keys[GLFW_KEY_KP_6]) { model.angleY -= angleSpeed * deltaTime; }
+
+		// Same matrix code as the ECS path, so the comparison is only about the storage layout
+		model.model = composeTransformMatrix(model.position, model.angleX, model.angleY);
+	}
+}
+
+void runBenchmarks()
+{
+	printf("=== Entity storage ===\n");
+	runEntityStorageBenchmark(10000, 200);
+	runEntityStorageBenchmark(50000, 50);
+	runEntityStorageBenchmark(100000, 25);
+
+	printf("=== Scene BVH ===\n");
+	runBVHBenchmark(10000, 1000);
+	runBVHBenchmark(100000, 1000);
+
+	printf("=== Frustum culling ===\n");
+	runFrustumCullingBenchmark(10000, 200);
+	runFrustumCullingBenchmark(100000, 50);
+	runFrustumCullingBenchmark(1000000, 10);
+
+	printf("=== CPU profiler ===\n");
+	runCpuProfilerBenchmark(1000000);
+}
+
+void runEntityStorageBenchmark(size_t entityCount, int iterations)
+{
+	const size_t meshesPerModel = 3;
+	const size_t controllableStride = 4;		// Every 4th entity is controllable
+	const float deltaTime = 1.0f / 60.0f;
+
+	bool keys[1024] = {};
+	keys[GLFW_KEY_UP] = true;
+	keys[GLFW_KEY_KP_4] = true;
+
+	// Shared mesh assets, referenced by index from the render mesh component
+	std::vector<std::vector<BenchMesh>> assets(16, std::vector<BenchMesh>(meshesPerModel, BenchMesh{ 1, 2, 36, 0 }));
+
+	// -- LEGACY LAYOUT --
+	std::vector<LegacyModel> legacyModels(entityCount);
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		legacyModels[i].meshList = assets[i % assets.size()];
+		legacyModels[i].position = glm::vec3(static_cast<float>(i), 0.0f, 0.0f);
+		legacyModels[i].model = glm::translate(glm::mat4(1.0f), legacyModels[i].position);
+		legacyModels[i].controlable = (i % controllableStride) == 0;
+		legacyModels[i].angleX = 0.0f;
+		legacyModels[i].angleY = 0.0f;
+	}
+
+	// -- ARCHETYPE STORAGE --
+	EntityRegistry registry;
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		ComponentMask mask = TRANSFORM_BIT | RENDER_MESH_BIT;
+		if ((i % controllableStride) == 0)
+		{
+			mask |= CONTROLLER_BIT;
+		}
+
+		Entity entity = registry.createEntity(mask);
+		TransformComponent* transform = registry.getComponent<TransformComponent>(entity);
+		transform->position = glm::vec3(static_cast<float>(i), 0.0f, 0.0f);
+		transform->model = glm::translate(glm::mat4(1.0f), transform->position);
+		registry.getComponent<RenderMeshComponent>(entity)->modelIndex = static_cast<uint32_t>(i % assets.size());
+	}
+
+	// Draw data gathered by both paths (what recordMainPass pushes and binds)
+	std::vector<glm::mat4> pushConstants;
+	pushConstants.reserve(entityCount);
+	uint64_t drawChecksum = 0;
+
+	// Controller update. Alternating rounds, the fastest of each counts, so neither layout is
+	// measured only cold or only after the other warmed the caches and the clock
+	const int controlRounds = 5;
+	double legacyControlMs = DBL_MAX;
+	double ecsControlMs = DBL_MAX;
+	for (int round = 0; round < controlRounds; round++)
+	{
+		for (int pass = 0; pass < 2; pass++)
+		{
+			bool legacy = (pass == 0) == (round % 2 == 0);
+			BenchClock::time_point start = BenchClock::now();
+			for (int it = 0; it < iterations; it++)
+			{
+				if (legacy)
+				{
+					for (auto& model : legacyModels)
+					{
+						legacyKeyControl(model, keys, deltaTime, DEFAULT_CONTROLLER_MOVE_SPEED, DEFAULT_CONTROLLER_ANGLE_SPEED);
+					}
+				}
+				else
+				{
+					updateControllerSystem(registry, keys, deltaTime);
+				}
+			}
+			double roundMs = elapsedMs(start) / iterations;
+			double& bestMs = legacy ? legacyControlMs : ecsControlMs;
+			bestMs = std::min(bestMs, roundMs);
+		}
+	}
+
+	// Draw data gathering
+	BenchClock::time_point start = BenchClock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		pushConstants.clear();
+		for (auto& model : legacyModels)
+		{
+			pushConstants.push_back(model.model);
+			for (auto& mesh : model.meshList)
+			{
+				drawChecksum += mesh.indexBuffer + mesh.indexCount;
+			}
+		}
+	}
+	double legacyGatherMs = elapsedMs(start) / iterations;
+
+	start = BenchClock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		pushConstants.clear();
+		registry.forEachChunk(TRANSFORM_BIT | RENDER_MESH_BIT, [&](ArchetypeChunk& chunk)
+			{
+				TransformComponent* transforms = chunk.get<TransformComponent>();
+				RenderMeshComponent* renderMeshes = chunk.get<RenderMeshComponent>();
+				for (uint32_t i = 0; i < chunk.count; i++)
+				{
+					pushConstants.push_back(transforms[i].model);
+					for (auto& mesh : assets[renderMeshes[i].modelIndex])
+					{
+						drawChecksum += mesh.indexBuffer + mesh.indexCount;
+					}
+				}
+			});
+	}
+	double ecsGatherMs = elapsedMs(start) / iterations;
+
+	printf("%7zu entities | controller: legacy %8.3f ms, archetype %8.3f ms (x%.2f) | draw gather: legacy %8.3f ms, archetype %8.3f ms (x%.2f) [%llu]\n",
+		entityCount,
+		legacyControlMs, ecsControlMs, legacyControlMs / ecsControlMs,
+		legacyGatherMs, ecsGatherMs, legacyGatherMs / ecsGatherMs,
+		static_cast<unsigned long long>(drawChecksum & 0xFF));
+}
+
+void runBVHBenchmark(size_t primitiveCount, int queryCount)
+{
+	const float worldSize = 2000.0f;
+
+	// Random boxes scattered in a cube around the origin
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+	std::uniform_real_distribution<float> size(0.5f, 8.0f);
+
+	std::vector<AABB> bounds(primitiveCount);
+	std::vector<Entity> entities(primitiveCount);
+	for (size_t i = 0; i < primitiveCount; i++)
+	{
+		glm::vec3 center = glm::vec3(position(random), position(random), position(random));
+		glm::vec3 extent = glm::vec3(size(random), size(random), size(random));
+		bounds[i].min = center - extent;
+		bounds[i].max = center + extent;
+		entities[i] = static_cast<Entity>(i);
+	}
+
+	BVH bvh;
+	BenchClock::time_point start = BenchClock::now();
+	bvh.build(bounds, entities);
+	double buildMs = elapsedMs(start);
+
+	// Same projection as VulkanRenderer::updateView, camera at the origin
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = extractFrustum(projection * view);
+
+	// Frustum culling
+	std::vector<Entity> visible;
+	visible.reserve(primitiveCount);
+	start = BenchClock::now();
+	for (int it = 0; it < 20; it++)
+	{
+		visible.clear();
+		for (size_t i = 0; i < primitiveCount; i++)
+		{
+			if (testFrustumAABB(frustum, bounds[i]) != FRUSTUM_OUTSIDE) visible.push_back(entities[i]);
+		}
+	}
+	double linearFrustumMs = elapsedMs(start) / 20;
+	size_t linearVisible = visible.size();
+
+	start = BenchClock::now();
+	for (int it = 0; it < 20; it++)
+	{
+		bvh.queryFrustum(frustum, visible);
+	}
+	double bvhFrustumMs = elapsedMs(start) / 20;
+
+	// Query inputs
+	std::vector<Ray> rays(queryCount);
+	std::vector<glm::vec3> points(queryCount);
+	for (int i = 0; i < queryCount; i++)
+	{
+		glm::vec3 target = glm::vec3(position(random), position(random), position(random));
+		rays[i].origin = glm::vec3(position(random), position(random), position(random));
+		rays[i].direction = glm::normalize(target - rays[i].origin);
+		points[i] = glm::vec3(position(random), position(random), position(random));
+	}
+
+	// Ray picking
+	uint64_t checksum = 0;
+	start = BenchClock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		glm::vec3 invDirection = 1.0f / rays[q].direction;
+		float closest = FLT_MAX;
+		Entity hit = INVALID_ENTITY;
+		for (size_t i = 0; i < primitiveCount; i++)
+		{
+			float distance;
+			if (intersectRayAABB(rays[q], invDirection, bounds[i], closest, &distance)) { closest = distance; hit = entities[i]; }
+		}
+		checksum += hit;
+	}
+	double linearRayMs = elapsedMs(start);
+
+	start = BenchClock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		BVHRayHit hit;
+		if (bvh.raycast(rays[q], FLT_MAX, INVALID_ENTITY, &hit)) { checksum -= hit.entity; }
+		else { checksum -= INVALID_ENTITY; }
+	}
+	double bvhRayMs = elapsedMs(start);
+
+	// Nearest object
+	start = BenchClock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		float closest = FLT_MAX;
+		Entity nearest = INVALID_ENTITY;
+		for (size_t i = 0; i < primitiveCount; i++)
+		{
+			float distanceSq = distanceSquaredPointAABB(points[q], bounds[i]);
+			if (distanceSq < closest) { closest = distanceSq; nearest = entities[i]; }
+		}
+		checksum += nearest;
+	}
+	double linearNearestMs = elapsedMs(start);
+
+	start = BenchClock::now();
+	for (int q = 0; q < queryCount; q++)
+	{
+		checksum -= bvh.findNearest(points[q], FLT_MAX, INVALID_ENTITY, nullptr);
+	}
+	double bvhNearestMs = elapsedMs(start);
+
+	// Refit after moving every 10th box a little
+	start = BenchClock::now();
+	for (size_t i = 0; i < primitiveCount; i += 10)
+	{
+		AABB moved = bounds[i];
+		moved.min += glm::vec3(1.0f);
+		moved.max += glm::vec3(1.0f);
+		bvh.updatePrimitive(static_cast<uint32_t>(i), moved);
+	}
+	double refitMs = elapsedMs(start);
+
+	printf("%7zu boxes | build %.2f ms, refit 10%% %.3f ms | frustum: linear %.3f ms, bvh %.3f ms (%zu/%zu visible) | "
+		"%d rays: linear %.2f ms, bvh %.2f ms | %d nearest: linear %.2f ms, bvh %.2f ms%s\n",
+		primitiveCount, buildMs, refitMs,
+		linearFrustumMs, bvhFrustumMs, visible.size(), linearVisible,
+		queryCount, linearRayMs, bvhRayMs,
+		queryCount, linearNearestMs, bvhNearestMs,
+		checksum == 0 ? "" : " (MISMATCH)");
+}
+
+void runFrustumCullingBenchmark(size_t sphereCount, int iterations)
+{
+	const float worldSize = 2000.0f;
+
+	std::mt19937 random(4321);
+	std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+	std::uniform_real_distribution<float> size(0.5f, 8.0f);
+
+	FrustumCuller culler;
+	for (size_t i = 0; i < sphereCount; i++)
+	{
+		culler.addSphere(static_cast<Entity>(i), glm::vec3(position(random), position(random), position(random)), size(random));
+	}
+
+	// Same projection as VulkanRenderer::updateView, camera at the origin
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = extractFrustum(projection * view);
+
+	std::vector<Entity> scalarVisible;
+	std::vector<Entity> visible;
+	scalarVisible.reserve(sphereCount);
+	visible.reserve(sphereCount);
+
+	BenchClock::time_point start = BenchClock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		culler.cullScalar(frustum, scalarVisible);
+	}
+	double scalarMs = elapsedMs(start) / iterations;
+
+	start = BenchClock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		culler.cullSSE(frustum, visible);
+	}
+	double sseMs = elapsedMs(start) / iterations;
+	bool sseMatches = visible == scalarVisible;
+
+	double avxMs = 0.0;
+	bool avxMatches = true;
+	if (FrustumCuller::getPath() == CULL_PATH_AVX2)
+	{
+		start = BenchClock::now();
+		for (int it = 0; it < iterations; it++)
+		{
+			culler.cullAVX2(frustum, visible);
+		}
+		avxMs = elapsedMs(start) / iterations;
+		avxMatches = visible == scalarVisible;
+	}
+
+	printf("%8zu spheres | scalar %8.3f ms | SSE %8.3f ms (x%.2f) | AVX2 %8.3f ms (x%.2f) | %zu visible%s\n",
+		sphereCount, scalarMs,
+		sseMs, scalarMs / sseMs,
+		avxMs, avxMs > 0.0 ? scalarMs / avxMs : 0.0,
+		scalarVisible.size(),
+		sseMatches && avxMatches ? "" : " (MISMATCH)");
+}
+
+void runCpuProfilerBenchmark(size_t zoneCount)
+{
+	volatile uint64_t sink = 0;
+
+	// Empty loop as the baseline
+	BenchClock::time_point start = BenchClock::now();
+	for (size_t i = 0; i < zoneCount; i++)
+	{
+		sink = sink + i;
+	}
+	double baselineMs = elapsedMs(start);
+
+	start = BenchClock::now();
+	for (size_t i = 0; i < zoneCount; i++)
+	{
+		PROFILE_SCOPE("Benchmark zone");
+		sink = sink + i;
+	}
+	double zonesMs = elapsedMs(start);
+
+	// Written to the temp directory, a capture is never left in the working tree
+	std::error_code error;
+	std::filesystem::path traceFile = std::filesystem::temp_directory_path(error) / "bench_cpu_trace.json";
+
+	start = BenchClock::now();
+	bool exported = CpuProfiler::exportChromeTrace(traceFile.string());
+	double exportMs = elapsedMs(start);
+
+	printf("%zu zones | %.1f ns per zone | export of the last %u zones to %s %.2f ms%s\n",
+		zoneCount, (zonesMs - baselineMs) * 1000000.0 / zoneCount,
+		CPU_PROFILER_RING_SIZE, traceFile.string().c_str(), exportMs, exported ? "" : " (FAILED)");
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Runs every CPU benchmark and prints the results to the console.
+ *
+ * Started with the `--bench` command line argument, no window or Vulkan device is created.
+ */
+void runBenchmarks();
+
+/**
+ * @brief Compares the per-frame systems on the archetype storage against the old per-object layout.
+ *
+ * Both the controller update and the gathering of draw data are measured.
+ *
+ * @param entityCount Number of entities to create.
+ * @param iterations Number of simulated frames.
+ */
+void runEntityStorageBenchmark(size_t entityCount, int iterations);
+
+/**
+ * @brief Compares the BVH queries (frustum, ray, nearest) against a linear scan of the boxes.
+ *
+ * Build and refit times are reported as well.
+ *
+ * @param primitiveCount Number of random boxes in the scene.
+ * @param queryCount Number of ray and nearest queries.
+ */
+void runBVHBenchmark(size_t primitiveCount, int queryCount);
+
+/**
+ * @brief Compares the scalar, SSE and AVX2 paths of the FrustumCuller.
+ *
+ * @param sphereCount Number of random bounding spheres.
+ * @param iterations Number of culled frames.
+ */
+void runFrustumCullingBenchmark(size_t sphereCount, int iterations);
+
+/**
+ * @brief Measures the cost of a profiler zone and of the trace export.
+ *
+ * @param zoneCount Number of zones recorded.
+ */
+void runCpuProfilerBenchmark(size_t zoneCount);
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct AABB
+{
+	glm::vec3 min = glm::vec3(FLT_MAX);		// Smallest corner (empty box by default)
+	glm::vec3 max = glm::vec3(-FLT_MAX);	// Largest corner
+
+	bool isValid() const
+	{
+		return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+	}
+
+	glm::vec3 getCenter() const
+	{
+		return (min + max) * 0.5f;
+	}
+
+	glm::vec3 getExtent() const
+	{
+		return (max - min) * 0.5f;
+	}
+
+	// Grow the box to contain a point
+	void expand(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	// Grow the box to contain another box
+	void expand(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	// Surface area, the cost metric of the SAH
+	float getSurfaceArea() const
+	{
+		if (!isValid()) return 0.0f;
+
+		glm::vec3 size = max - min;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	bool contains(const AABB& other) const
+	{
+		return other.min.x >= min.x && other.min.y >= min.y && other.min.z >= min.z &&
+			other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+	}
+};
+
+// Six planes (xyz = normal pointing inside, w = distance) of a view frustum
+struct Frustum
+{
+	glm::vec4 planes[6];	// Left, right, bottom, top, near, far
+};
+
+// Half line used for picking
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;	// Normalised
+};
+
+/**
+ * @brief Transforms a local space box and returns the world space box enclosing it.
+ *
+ * Uses the absolute value of the rotation part (Arvo's method), so no corners have to be transformed.
+ *
+ * @param bounds The local space box.
+ * @param transform The model matrix.
+ * @return The enclosing world space box.
+ */
+inline AABB transformAABB(const AABB& bounds, const glm::mat4& transform)
+{
+	if (!bounds.isValid()) return bounds;
+
+	glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.getCenter(), 1.0f));
+	glm::vec3 extent = bounds.getExtent();
+
+	glm::mat3 absRotation = glm::mat3(transform);
+	for (int i = 0; i < 3; i++)
+	{
+		absRotation[i] = glm::abs(absRotation[i]);
+	}
+	glm::vec3 newExtent = absRotation * extent;
+
+	AABB result;
+	result.min = center - newExtent;
+	result.max = center + newExtent;
+	return result;
+}
+
+/**
+ * @brief Extracts the frustum planes of a view-projection matrix (Gribb/Hartmann).
+ *
+ * The near plane uses w + z >= 0 which is exact for OpenGL style depth and slightly
+ * conservative for Vulkan style depth, so it works with either projection.
+ *
+ * @param viewProjection Projection * view.
+ * @return The normalised frustum planes.
+ */
+inline Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+	// Rows of the matrix (GLM is column major)
+	glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	Frustum frustum;
+	frustum.planes[0] = row3 + row0;
+	frustum.planes[1] = row3 - row0;
+	frustum.planes[2] = row3 + row1;
+	frustum.planes[3] = row3 - row1;
+	frustum.planes[4] = row3 + row2;
+	frustum.planes[5] = row3 - row2;
+
+	for (int i = 0; i < 6; i++)
+	{
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+	}
+
+	return frustum;
+}
+
+// Result of a box against frustum test
+enum FrustumTestResult
+{
+	FRUSTUM_OUTSIDE,
+	FRUSTUM_INTERSECT,
+	FRUSTUM_INSIDE
+};
+
+/**
+ * @brief Classifies a box against a frustum.
+ *
+ * @param frustum The frustum to test against.
+ * @param bounds The box to test.
+ * @return Whether the box is fully outside, fully inside or crossing the frustum.
+ */
+inline FrustumTestResult testFrustumAABB(const Frustum& frustum, const AABB& bounds)
+{
+	glm::vec3 center = bounds.getCenter();
+	glm::vec3 extent = bounds.getExtent();
+
+	FrustumTestResult result = FRUSTUM_INSIDE;
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec3 normal = glm::vec3(frustum.planes[i]);
+		float distance = glm::dot(normal, center) + frustum.planes[i].w;
+		float radius = glm::dot(glm::abs(normal), extent);
+
+		if (distance < -radius) return FRUSTUM_OUTSIDE;
+		if (distance < radius) result = FRUSTUM_INTERSECT;
+	}
+
+	return result;
+}
+
+/**
+ * @brief Intersects a ray with a box (slab test).
+ *
+ * @param ray The ray, its direction doesn't have to be axis aligned.
+ * @param invDirection 1 / ray.direction, computed once per ray.
+ * @param bounds The box to test.
+ * @param maxDistance Hits further than this are ignored.
+ * @param outDistance Receives the entry distance (0 if the origin is inside the box).
+ * @return True if the ray hits the box.
+ */
+inline bool intersectRayAABB(const Ray& ray, const glm::vec3& invDirection, const AABB& bounds, float maxDistance, float* outDistance)
+{
+	glm::vec3 t0 = (bounds.min - ray.origin) * invDirection;
+	glm::vec3 t1 = (bounds.max - ray.origin) * invDirection;
+
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+
+	float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+
+	if (enter > exit) return false;
+
+	*outDistance = enter;
+	return true;
+}
+
+/**
+ * @brief Squared distance from a point to a box (0 if the point is inside).
+ */
+inline float distanceSquaredPointAABB(const glm::vec3& point, const AABB& bounds)
+{
+	glm::vec3 closest = glm::clamp(point, bounds.min, bounds.max);
+	glm::vec3 delta = point - closest;
+	return glm::dot(delta, delta);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+/**
+ * @brief Identifier of an entity stored in the EntityRegistry.
+ *
+ * The lower 24 bits hold the slot index, the upper 8 bits a generation counter
+ * that is bumped when the slot is reused, so stale handles can be detected.
+ */
+typedef uint32_t Entity;
+
+/**
+ * @brief Bit mask describing which components an entity (or archetype) owns.
+ */
+typedef uint32_t ComponentMask;
+
+const Entity INVALID_ENTITY = 0xFFFFFFFF;
+
+/**
+ * @enum ComponentType
+ * @brief Index of every component type known by the registry.
+ *
+ * The index is used both as a bit position in a ComponentMask and as the index
+ * of the component array inside an archetype chunk.
+ */
+enum ComponentType
+{
+	COMPONENT_TRANSFORM = 0,	///< World transform of the entity.
+	COMPONENT_RENDER_MESH,		///< Reference to the mesh data used to draw the entity.
+	COMPONENT_CONTROLLER,		///< Keyboard controller parameters.
+	COMPONENT_LIGHT,			///< Spotlight parameters, the entity acts as a light source.
+	COMPONENT_BOUNDS,			///< Local and world space bounding box, the entity is part of the scene BVH.
+	COMPONENT_ANIMATION,		///< Playback state of the skeletal animation of a skinned model.
+	COMPONENT_TYPE_COUNT
+};
+
+const ComponentMask TRANSFORM_BIT = 1u << COMPONENT_TRANSFORM;
+const ComponentMask RENDER_MESH_BIT = 1u << COMPONENT_RENDER_MESH;
+const ComponentMask CONTROLLER_BIT = 1u << COMPONENT_CONTROLLER;
+const ComponentMask LIGHT_BIT = 1u << COMPONENT_LIGHT;
+const ComponentMask BOUNDS_BIT = 1u << COMPONENT_BOUNDS;
+const ComponentMask ANIMATION_BIT = 1u << COMPONENT_ANIMATION;
+
+// Default speeds of a controllable entity (units / second and degrees / second)
+const float DEFAULT_CONTROLLER_MOVE_SPEED = 8.0f;
+const float DEFAULT_CONTROLLER_ANGLE_SPEED = 10.0f;
+
+/**
+ * @struct TransformComponent
+ * @brief Position, orientation and the resulting model matrix of an entity.
+ */
+struct TransformComponent
+{
+	glm::mat4 model;		///< Model matrix pushed to the vertex shader.
+	glm::mat4 previousModel;	///< Model matrix of the last rendered frame, for the motion vectors.
+	glm::vec3 position;		///< Position in world space.
+	float angleX;			///< Rotation around the X axis (degrees).
+	float angleY;			///< Rotation around the Y axis (degrees).
+};
+
+/**
+ * @struct RenderMeshComponent
+ * @brief Links an entity to a loaded MeshModel in the renderer's model list.
+ */
+struct RenderMeshComponent
+{
+	uint32_t modelIndex;	///< Index of the MeshModel holding the GPU buffers.
+};
+
+/**
+ * @struct ControllerComponent
+ * @brief Marks an entity as controllable from the keyboard.
+ */
+struct ControllerComponent
+{
+	float moveSpeed;		///< Translation speed.
+	float angleSpeed;		///< Rotation speed.
+};
+
+/**
+ * @struct LightComponent
+ * @brief Spotlight parameters of an entity that acts as a light source.
+ *
+ * The position and direction of the light come from the TransformComponent.
+ */
+struct LightComponent
+{
+	glm::vec3 color;		///< Colour of the light.
+	float intensity;		///< Brightness multiplier of the colour.
+	float innerCutOff;		///< Cosine of the inner cutoff angle.
+	float outerCutOff;		///< Cosine of the outer cutoff angle.
+};
+
+/**
+ * @struct BoundsComponent
+ * @brief Bounding box of an entity and its slot in the scene BVH.
+ */
+struct BoundsComponent
+{
+	AABB localBounds;		///< Box of the mesh in model space.
+	AABB worldBounds;		///< Box after applying the model matrix (last value pushed to the BVH).
+	uint32_t bvhPrimitive;	///< Primitive index in the scene BVH, 0xFFFFFFFF until the next rebuild.
+};
+
+/**
+ * @struct AnimationComponent
+ * @brief Clip playback of an entity drawing a skinned model.
+ *
+ * While fade is below 1 the pose is blended from the previous clip into the current one.
+ */
+struct AnimationComponent
+{
+	uint32_t clip;			///< Index of the playing clip in the model's clip list.
+	float time;				///< Playback position in seconds, loops over the clip's duration.
+	float speed;			///< Playback rate, 1 is the authored speed.
+	uint32_t previousClip;	///< Clip faded out, 0xFFFFFFFF if none.
+	float previousTime;		///< Playback position of the faded out clip.
+	float fade;				///< Weight of the current clip, rises from 0 to 1.
+	float fadeDuration;		///< Length of the crossfade in seconds.
+	uint32_t paletteOffset;	///< First joint matrix of the entity in the frame's palette, 0xFFFFFFFF if not posed.
+};
+
+/**
+ * @brief Maps a component struct to its ComponentType.
+ */
+template<typename T> struct ComponentTraits;
+
+template<> struct ComponentTraits<TransformComponent> { static const ComponentType type = COMPONENT_TRANSFORM; };
+template<> struct ComponentTraits<RenderMeshComponent> { static const ComponentType type = COMPONENT_RENDER_MESH; };
+template<> struct ComponentTraits<ControllerComponent> { static const ComponentType type = COMPONENT_CONTROLLER; };
+template<> struct ComponentTraits<LightComponent> { static const ComponentType type = COMPONENT_LIGHT; };
+template<> struct ComponentTraits<BoundsComponent> { static const ComponentType type = COMPONENT_BOUNDS; };
+template<> struct ComponentTraits<AnimationComponent> { static const ComponentType type = COMPONENT_ANIMATION; };
@@ -0,0 +1,191 @@
+#include "CpuProfiler.h"
+
+#include "Utilities.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	typedef std::chrono::steady_clock ProfilerClock;
+
+	const uint64_t RING_MASK = CPU_PROFILER_RING_SIZE - 1;
+
+	// Single producer (the owning thread), any number of readers
+	struct ThreadRing
+	{
+		std::atomic<uint64_t> head{ 0 };		// Number of zones ever written
+		std::unique_ptr<CpuZoneEvent[]> events;
+		uint32_t threadId = 0;
+		std::string name;						// Guarded by the registry mutex
+	};
+
+	// Function local statics, so zones recorded during static initialisation are safe
+	ProfilerClock::time_point getStartTime()
+	{
+		static const ProfilerClock::time_point startTime = ProfilerClock::now();
+		return startTime;
+	}
+
+	std::mutex& getRegistryMutex()
+	{
+		static std::mutex registryMutex;
+		return registryMutex;
+	}
+
+	std::vector<std::unique_ptr<ThreadRing>>& getRings()
+	{
+		static std::vector<std::unique_ptr<ThreadRing>> rings;
+		return rings;
+	}
+
+	// Frame markers, written by the thread running the main loop
+	std::atomic<uint64_t> frameHead{ 0 };
+	uint64_t frameStarts[CPU_PROFILER_FRAME_RING_SIZE];
+
+	ThreadRing* getThreadRing()
+	{
+		thread_local ThreadRing* ring = nullptr;
+		if (ring == nullptr)
+		{
+			// First zone of this thread, the only time the shared list is locked by a writer
+			std::unique_ptr<ThreadRing> newRing(new ThreadRing());
+			newRing->events.reset(new CpuZoneEvent[CPU_PROFILER_RING_SIZE]);
+
+			std::lock_guard<std::mutex> lock(getRegistryMutex());
+			newRing->threadId = static_cast<uint32_t>(getRings().size()) + 1;
+			newRing->name = "Thread " + std::to_string(newRing->threadId);
+			ring = newRing.get();
+			getRings().push_back(std::move(newRing));
+		}
+
+		return ring;
+	}
+
+	// Copies the entries of a ring that are still intact at the end of the copy
+	template<typename T>
+	void copyRing(const std::atomic<uint64_t>& head, const T* ring, uint64_t ringSize, std::vector<T>& outEntries, uint64_t* outFirstIndex)
+	{
+		uint64_t end = head.load(std::memory_order_acquire);
+		uint64_t begin = end > ringSize ? end - ringSize : 0;
+
+		std::vector<T> copy;
+		copy.reserve(static_cast<size_t>(end - begin));
+		for (uint64_t i = begin; i < end; i++)
+		{
+			copy.push_back(ring[i % ringSize]);
+		}
+
+		// The writer may have overwritten the oldest entries (and be writing the next one) meanwhile
+		uint64_t newEnd = head.load(std::memory_order_acquire);
+		uint64_t firstValid = newEnd >= ringSize ? newEnd - ringSize + 1 : 0;
+		uint64_t skip = firstValid > begin ? std::min<uint64_t>(firstValid - begin, copy.size()) : 0;
+
+		outEntries.assign(copy.begin() + static_cast<size_t>(skip), copy.end());
+		*outFirstIndex = begin + skip;
+	}
+
+	// Trace timestamps are microseconds, keep the nanoseconds as decimals
+	void writeMicroseconds(std::ofstream& file, uint64_t ns)
+	{
+		file << (ns / 1000) << '.' << std::setw(3) << std::setfill('0') << (ns % 1000);
+	}
+}
+
+namespace CpuProfiler
+{
+	uint64_t now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(ProfilerClock::now() - getStartTime()).count());
+	}
+
+	void recordZone(const char* name, uint64_t startNs, uint64_t endNs, uint32_t depth)
+	{
+		ThreadRing* ring = getThreadRing();
+
+		uint64_t head = ring->head.load(std::memory_order_relaxed);
+		CpuZoneEvent& event = ring->events[head & RING_MASK];
+		event.name = name;
+		event.startNs = startNs;
+		event.endNs = endNs;
+		event.depth = depth;
+
+		// Publish the entry
+		ring->head.store(head + 1, std::memory_order_release);
+	}
+
+	uint32_t& threadDepth()
+	{
+		thread_local uint32_t depth = 0;
+		return depth;
+	}
+
+	void setThreadName(const std::string& name)
+	{
+		ThreadRing* ring = getThreadRing();
+
+		std::lock_guard<std::mutex> lock(getRegistryMutex());
+		ring->name = name;
+	}
+
+	void markFrame()
+	{
+		uint64_t head = frameHead.load(std::memory_order_relaxed);
+		frameStarts[head % CPU_PROFILER_FRAME_RING_SIZE] = now();
+		frameHead.store(head + 1, std::memory_order_release);
+	}
+
+	bool exportChromeTrace(const std::string& fileName)
+	{
+		std::ofstream file(fileName);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "{\"traceEvents\":[\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Frames\"}}";
+
+		// Frames as consecutive spans on their own track
+		std::vector<uint64_t> frames;
+		uint64_t firstFrame;
+		copyRing(frameHead, frameStarts, CPU_PROFILER_FRAME_RING_SIZE, frames, &firstFrame);
+		for (size_t i = 0; i + 1 < frames.size(); i++)
+		{
+			file << ",\n{\"name\":\"Frame " << (firstFrame + i) << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":";
+			writeMicroseconds(file, frames[i]);
+			file << ",\"dur\":";
+			writeMicroseconds(file, frames[i + 1] - frames[i]);
+			file << "}";
+		}
+
+		// Only blocks threads recording their very first zone
+		std::lock_guard<std::mutex> lock(getRegistryMutex());
+		for (const auto& ring : getRings())
+		{
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->threadId
+				<< ",\"args\":{\"name\":\"" << escapeJson(ring->name) << "\"}}";
+
+			std::vector<CpuZoneEvent> events;
+			uint64_t firstEvent;
+			copyRing(ring->head, ring->events.get(), CPU_PROFILER_RING_SIZE, events, &firstEvent);
+
+			for (const auto& event : events)
+			{
+				file << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->threadId << ",\"ts\":";
+				writeMicroseconds(file, event.startNs);
+				file << ",\"dur\":";
+				writeMicroseconds(file, event.endNs - event.startNs);
+				file << "}";
+			}
+		}
+
+		file << "\n]}\n";
+		return file.good();
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+const uint32_t CPU_PROFILER_RING_SIZE = 1 << 16;		// Zones kept per thread (power of two)
+const uint32_t CPU_PROFILER_FRAME_RING_SIZE = 1024;		// Frame markers kept
+
+/**
+ * @struct CpuZoneEvent
+ * @brief One finished zone.
+ */
+struct CpuZoneEvent
+{
+	const char* name;		///< Zone name, must have static storage (string literal).
+	uint64_t startNs;		///< Start, nanoseconds since the profiler started.
+	uint64_t endNs;			///< End, nanoseconds since the profiler started.
+	uint32_t depth;			///< Nesting level inside the thread.
+};
+
+/**
+ * @namespace CpuProfiler
+ * @brief Low overhead instrumentation of CPU zones.
+ *
+ * Every thread writes its zones into its own ring buffer, the only shared state is the list
+ * of rings which is touched once per thread. Writing a zone is two clock reads and a store,
+ * reading the rings (for the export) never blocks the writers: old entries that were
+ * overwritten during the copy are detected and dropped.
+ */
+namespace CpuProfiler
+{
+	// Nanoseconds since the profiler started
+	uint64_t now();
+
+	// Records a finished zone on the calling thread
+	void recordZone(const char* name, uint64_t startNs, uint64_t endNs, uint32_t depth);
+
+	// Nesting level of the calling thread (used by CpuProfileZone)
+	uint32_t& threadDepth();
+
+	/**
+	 * @brief Names the calling thread in the exported trace.
+	 *
+	 * @param name Name of the thread.
+	 */
+	void setThreadName(const std::string& name);
+
+	/**
+	 * @brief Marks the start of a new frame, frames are shown as their own track in the trace.
+	 */
+	void markFrame();
+
+	/**
+	 * @brief Writes every recorded zone as a Chrome trace (chrome://tracing, Perfetto).
+	 *
+	 * @param fileName Path of the JSON file.
+	 * @return True on success.
+	 */
+	bool exportChromeTrace(const std::string& fileName);
+}
+
+/**
+ * @class CpuProfileZone
+ * @brief Measures the lifetime of the object as a zone (use the PROFILE_SCOPE macros).
+ */
+class CpuProfileZone
+{
+public:
+	explicit CpuProfileZone(const char* zoneName) : name(zoneName), startNs(CpuProfiler::now()), depth(CpuProfiler::threadDepth()++)
+	{
+	}
+
+	~CpuProfileZone()
+	{
+		CpuProfiler::threadDepth()--;
+		CpuProfiler::recordZone(name, startNs, CpuProfiler::now(), depth);
+	}
+
+	CpuProfileZone(const CpuProfileZone&) = delete;
+	CpuProfileZone& operator=(const CpuProfileZone&) = delete;
+
+private:
+	const char* name;
+	uint64_t startNs;
+	uint32_t depth;
+};
+
+// Define DISABLE_CPU_PROFILER to compile the zones out
+#if defined(DISABLE_CPU_PROFILER)
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#else
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) CpuProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#endif
@@ -0,0 +1,88 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Largest change of the scale per adjustment, downwards and upwards
+	const float MAX_STEP_DOWN = 0.25f;
+	const float MAX_STEP_UP = 0.0625f;
+
+	// Weight of the newest sample in the smoothed frame time
+	const double SMOOTHING = 0.25;
+}
+
+DynamicResolution::DynamicResolution()
+{
+}
+
+void DynamicResolution::create(double targetFramesPerSecond, uint32_t newLatencyFrames)
+{
+	enabled = targetFramesPerSecond > 0.0;
+	targetFrameTimeMs = enabled ? 1000.0 / targetFramesPerSecond : 0.0;
+	latencyFrames = newLatencyFrames;
+
+	scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+	smoothedFrameTimeMs = 0.0;
+	framesSinceChange = 0;
+}
+
+float DynamicResolution::update(double gpuFrameTimeMs)
+{
+	// Without timestamp queries there is nothing to control with
+	if (!enabled || gpuFrameTimeMs <= 0.0)
+	{
+		return scale;
+	}
+
+	smoothedFrameTimeMs = smoothedFrameTimeMs > 0.0 ? smoothedFrameTimeMs + (gpuFrameTimeMs - smoothedFrameTimeMs) * SMOOTHING : gpuFrameTimeMs;
+
+	// The measurements still include frames of the previous scale
+	if (++framesSinceChange <= latencyFrames)
+	{
+		return scale;
+	}
+
+	bool overBudget = gpuFrameTimeMs > targetFrameTimeMs || smoothedFrameTimeMs > targetFrameTimeMs;
+	bool hasHeadroom = smoothedFrameTimeMs < targetFrameTimeMs * DYNAMIC_RESOLUTION_HEADROOM;
+	if (!overBudget && !hasHeadroom)
+	{
+		return scale;
+	}
+
+	// Aim at the middle of the band, a spike is reacted to by its own size
+	double frameTimeMs = overBudget ? std::max(gpuFrameTimeMs, smoothedFrameTimeMs) : smoothedFrameTimeMs;
+	double goalMs = targetFrameTimeMs * (1.0 + DYNAMIC_RESOLUTION_HEADROOM) * 0.5;
+	float desired = scale * static_cast<float>(std::sqrt(goalMs / frameTimeMs));
+	desired = std::max(scale - MAX_STEP_DOWN, std::min(desired, scale + MAX_STEP_UP));
+	desired = std::round(desired / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP;
+	desired = std::max(DYNAMIC_RESOLUTION_MIN_SCALE, std::min(desired, DYNAMIC_RESOLUTION_MAX_SCALE));
+
+	if (desired != scale)
+	{
+		scale = desired;
+		framesSinceChange = 0;
+		smoothedFrameTimeMs = 0.0;
+	}
+
+	return scale;
+}
+
+float DynamicResolution::getScale() const
+{
+	return scale;
+}
+
+bool DynamicResolution::isEnabled() const
+{
+	return enabled;
+}
+
+VkExtent2D DynamicResolution::getRenderExtent(VkExtent2D outputExtent) const
+{
+	VkExtent2D renderExtent;
+	renderExtent.width = std::max(1u, static_cast<uint32_t>(outputExtent.width * scale + 0.5f));
+	renderExtent.height = std::max(1u, static_cast<uint32_t>(outputExtent.height * scale + 0.5f));
+	return renderExtent;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;			// Lowest render scale per axis (a quarter of the pixels)
+const float DYNAMIC_RESOLUTION_MAX_SCALE = 1.0f;
+const float DYNAMIC_RESOLUTION_STEP = 1.0f / 32.0f;			// Scales are quantised, small timing noise doesn't change the resolution
+const double DYNAMIC_RESOLUTION_HEADROOM = 0.85;			// Below this share of the budget the resolution is raised
+
+/**
+ * @class DynamicResolution
+ * @brief Picks the render scale of the scene from the measured GPU frame time.
+ *
+ * The cost of the scene passes grows with the pixel count, the square of the scale, so the
+ * new scale is the old one times the square root of budget / frame time. The timings arrive
+ * a few frames late (the profiler reads a slot back when it is reused), after a change the
+ * controller waits until the frames rendered at the new scale are measured. Over budget it
+ * scales down in one go, with headroom it scales up in small steps, so a spike drops frames
+ * for at most a couple of frames and the resolution doesn't oscillate.
+ */
+class DynamicResolution
+{
+public:
+	DynamicResolution();
+
+	/**
+	 * @brief Sets the budget and resets the scale to the maximum.
+	 *
+	 * @param targetFramesPerSecond Frame rate to hold, 0 keeps the native resolution.
+	 * @param newLatencyFrames Frames between recording a frame and reading its GPU time back.
+	 */
+	void create(double targetFramesPerSecond, uint32_t newLatencyFrames);
+
+	/**
+	 * @brief Feeds the latest GPU frame time, adjusts the scale if it is out of the budget.
+	 *
+	 * @param gpuFrameTimeMs GPU time of the latest measured frame, 0 if there is no measurement.
+	 * @return The render scale of the next frame.
+	 */
+	float update(double gpuFrameTimeMs);
+
+	float getScale() const;
+	bool isEnabled() const;
+
+	// Render target area of the scene at the current scale, at least 1x1
+	VkExtent2D getRenderExtent(VkExtent2D outputExtent) const;
+
+private:
+	bool enabled = false;
+	double targetFrameTimeMs = 0.0;
+	uint32_t latencyFrames = 2;
+
+	float scale = DYNAMIC_RESOLUTION_MAX_SCALE;
+	double smoothedFrameTimeMs = 0.0;
+	uint32_t framesSinceChange = 0;
+};
@@ -0,0 +1,320 @@
+#include "EntityRegistry.h"
+
+#include <cstring>
+
+namespace
+{
+	// Component arrays inside a chunk start on a 16 byte boundary
+	const size_t COMPONENT_ALIGNMENT = 16;
+
+	size_t alignOffset(size_t offset)
+	{
+		return (offset + COMPONENT_ALIGNMENT - 1) & ~(COMPONENT_ALIGNMENT - 1);
+	}
+
+	// Values new components are initialised with
+	const TransformComponent defaultTransform = { glm::mat4(1.0f), glm::mat4(1.0f), glm::vec3(0.0f), 0.0f, 0.0f };
+	const RenderMeshComponent defaultRenderMesh = { 0 };
+	const ControllerComponent defaultController = { DEFAULT_CONTROLLER_MOVE_SPEED, DEFAULT_CONTROLLER_ANGLE_SPEED };
+	const LightComponent defaultLight = { glm::vec3(0.5f, 0.5f, 0.5f), 2.5f, 0.9659f, 0.9063f };
+	const BoundsComponent defaultBounds = { AABB(), AABB(), 0xFFFFFFFF };
+	const AnimationComponent defaultAnimation = { 0, 0.0f, 1.0f, 0xFFFFFFFF, 0.0f, 1.0f, 0.0f, 0xFFFFFFFF };
+}
+
+EntityRegistry::EntityRegistry()
+{
+}
+
+Entity EntityRegistry::createEntity(ComponentMask mask)
+{
+	// Reuse a free slot if possible, otherwise append a new record
+	uint32_t index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		if (records.size() > ENTITY_INDEX_MASK)
+		{
+			throw std::runtime_error("Too many entities in the Entity Registry!");
+		}
+
+		index = static_cast<uint32_t>(records.size());
+		records.push_back(EntityRecord());
+	}
+
+	EntityRecord& record = records[index];
+	record.alive = true;
+
+	Entity entity = index | (record.generation << ENTITY_GENERATION_SHIFT);
+	allocateRow(entity, findOrCreateArchetype(mask));
+
+	entityCount++;
+	return entity;
+}
+
+void EntityRegistry::destroyEntity(Entity entity)
+{
+	if (!isAlive(entity))
+	{
+		return;
+	}
+
+	uint32_t index = entity & ENTITY_INDEX_MASK;
+	releaseRow(records[index]);
+
+	// Invalidate existing handles by bumping the generation
+	records[index].alive = false;
+	records[index].generation = (records[index].generation + 1) & 0xFF;
+	freeSlots.push_back(index);
+
+	entityCount--;
+}
+
+void EntityRegistry::addComponents(Entity entity, ComponentMask mask)
+{
+	if (!isAlive(entity))
+	{
+		return;
+	}
+
+	ComponentMask current = getMask(entity);
+	if ((current | mask) != current)
+	{
+		moveEntity(entity, current | mask);
+	}
+}
+
+void EntityRegistry::removeComponents(Entity entity, ComponentMask mask)
+{
+	if (!isAlive(entity))
+	{
+		return;
+	}
+
+	ComponentMask current = getMask(entity);
+	if ((current & ~mask) != current)
+	{
+		moveEntity(entity, current & ~mask);
+	}
+}
+
+bool EntityRegistry::isAlive(Entity entity) const
+{
+	uint32_t index = entity & ENTITY_INDEX_MASK;
+	if (entity == INVALID_ENTITY || index >= records.size())
+	{
+		return false;
+	}
+
+	const EntityRecord& record = records[index];
+	return record.alive && record.generation == (entity >> ENTITY_GENERATION_SHIFT);
+}
+
+ComponentMask EntityRegistry::getMask(Entity entity) const
+{
+	if (!isAlive(entity))
+	{
+		return 0;
+	}
+
+	return archetypes[records[entity & ENTITY_INDEX_MASK].archetype].mask;
+}
+
+size_t EntityRegistry::getEntityCount() const
+{
+	return entityCount;
+}
+
+void EntityRegistry::clear()
+{
+	archetypes.clear();
+	records.clear();
+	freeSlots.clear();
+	entityCount = 0;
+}
+
+EntityRegistry::~EntityRegistry()
+{
+}
+
+uint32_t EntityRegistry::findOrCreateArchetype(ComponentMask mask)
+{
+	for (size_t i = 0; i < archetypes.size(); i++)
+	{
+		if (archetypes[i].mask == mask)
+		{
+			return static_cast<uint32_t>(i);
+		}
+	}
+
+	Archetype archetype;
+	archetype.mask = mask;
+	archetypes.push_back(std::move(archetype));
+
+	return static_cast<uint32_t>(archetypes.size() - 1);
+}
+
+ArchetypeChunk* EntityRegistry::createChunk(ComponentMask mask)
+{
+	// Bytes needed by a single row (entity handle + every owned component)
+	size_t rowSize = sizeof(Entity);
+	size_t arrayCount = 1;
+	for (uint32_t type = 0; type < COMPONENT_TYPE_COUNT; type++)
+	{
+		if (mask & (1u << type))
+		{
+			rowSize += getComponentSize(static_cast<ComponentType>(type));
+			arrayCount++;
+		}
+	}
+
+	// Leave room for the alignment padding between arrays
+	size_t usable = ARCHETYPE_CHUNK_SIZE - arrayCount * COMPONENT_ALIGNMENT;
+
+	ArchetypeChunk* chunk = new ArchetypeChunk();
+	chunk->capacity = static_cast<uint32_t>(usable / rowSize);
+	chunk->memory.reset(new glm::vec4[ARCHETYPE_CHUNK_SIZE / sizeof(glm::vec4)]);
+
+	// Lay out the arrays one after another: entities first, then the components
+	size_t offset = 0;
+	chunk->entities = reinterpret_cast<Entity*>(chunk->memory.get());
+	offset = alignOffset(offset + sizeof(Entity) * chunk->capacity);
+
+	for (uint32_t type = 0; type < COMPONENT_TYPE_COUNT; type++)
+	{
+		if (mask & (1u << type))
+		{
+			chunk->offsets[type] = offset;
+			offset = alignOffset(offset + getComponentSize(static_cast<ComponentType>(type)) * chunk->capacity);
+		}
+	}
+
+	return chunk;
+}
+
+void EntityRegistry::allocateRow(Entity entity, uint32_t archetypeIndex)
+{
+	Archetype& archetype = archetypes[archetypeIndex];
+
+	// Chunks are kept packed, so only the last one can have free rows
+	if (archetype.chunks.empty() || archetype.chunks.back()->count == archetype.chunks.back()->capacity)
+	{
+		archetype.chunks.emplace_back(createChunk(archetype.mask));
+	}
+
+	uint32_t chunkIndex = static_cast<uint32_t>(archetype.chunks.size() - 1);
+	ArchetypeChunk& chunk = *archetype.chunks[chunkIndex];
+	uint32_t row = chunk.count++;
+
+	// Default initialise the owned components
+	chunk.entities[row] = entity;
+	unsigned char* base = reinterpret_cast<unsigned char*>(chunk.memory.get());
+	for (uint32_t type = 0; type < COMPONENT_TYPE_COUNT; type++)
+	{
+		if (archetype.mask & (1u << type))
+		{
+			size_t size = getComponentSize(static_cast<ComponentType>(type));
+			memcpy(base + chunk.offsets[type] + size * row, getComponentDefault(static_cast<ComponentType>(type)), size);
+		}
+	}
+
+	EntityRecord& record = records[entity & ENTITY_INDEX_MASK];
+	record.archetype = archetypeIndex;
+	record.chunk = chunkIndex;
+	record.row = row;
+}
+
+void EntityRegistry::releaseRow(const EntityRecord& record)
+{
+	Archetype& archetype = archetypes[record.archetype];
+	ArchetypeChunk& chunk = *archetype.chunks[record.chunk];
+	ArchetypeChunk& lastChunk = *archetype.chunks.back();
+	uint32_t lastRow = lastChunk.count - 1;
+
+	// Move the very last row of the archetype into the hole to keep chunks packed
+	if (&chunk != &lastChunk || record.row != lastRow)
+	{
+		unsigned char* dst = reinterpret_cast<unsigned char*>(chunk.memory.get());
+		unsigned char* src = reinterpret_cast<unsigned char*>(lastChunk.memory.get());
+		for (uint32_t type = 0; type < COMPONENT_TYPE_COUNT; type++)
+		{
+			if (archetype.mask & (1u << type))
+			{
+				size_t size = getComponentSize(static_cast<ComponentType>(type));
+				memcpy(dst + chunk.offsets[type] + size * record.row, src + lastChunk.offsets[type] + size * lastRow, size);
+			}
+		}
+
+		Entity moved = lastChunk.entities[lastRow];
+		chunk.entities[record.row] = moved;
+
+		EntityRecord& movedRecord = records[moved & ENTITY_INDEX_MASK];
+		movedRecord.chunk = record.chunk;
+		movedRecord.row = record.row;
+	}
+
+	lastChunk.count--;
+
+	// Release the last chunk once it is empty
+	if (lastChunk.count == 0)
+	{
+		archetype.chunks.pop_back();
+	}
+}
+
+void EntityRegistry::moveEntity(Entity entity, ComponentMask newMask)
+{
+	// Look up the target first, creating it can reallocate the archetype list
+	uint32_t newArchetype = findOrCreateArchetype(newMask);
+
+	EntityRecord oldRecord = records[entity & ENTITY_INDEX_MASK];
+	allocateRow(entity, newArchetype);
+	EntityRecord newRecord = records[entity & ENTITY_INDEX_MASK];
+
+	// Copy the components both archetypes share
+	ComponentMask shared = archetypes[oldRecord.archetype].mask & newMask;
+	ArchetypeChunk& src = *archetypes[oldRecord.archetype].chunks[oldRecord.chunk];
+	ArchetypeChunk& dst = *archetypes[newRecord.archetype].chunks[newRecord.chunk];
+	for (uint32_t type = 0; type < COMPONENT_TYPE_COUNT; type++)
+	{
+		if (shared & (1u << type))
+		{
+			size_t size = getComponentSize(static_cast<ComponentType>(type));
+			memcpy(reinterpret_cast<unsigned char*>(dst.memory.get()) + dst.offsets[type] + size * newRecord.row,
+				reinterpret_cast<unsigned char*>(src.memory.get()) + src.offsets[type] + size * oldRecord.row, size);
+		}
+	}
+
+	releaseRow(oldRecord);
+}
+
+size_t EntityRegistry::getComponentSize(ComponentType type)
+{
+	switch (type)
+	{
+	case COMPONENT_TRANSFORM:	return sizeof(TransformComponent);
+	case COMPONENT_RENDER_MESH:	return sizeof(RenderMeshComponent);
+	case COMPONENT_CONTROLLER:	return sizeof(ControllerComponent);
+	case COMPONENT_LIGHT:		return sizeof(LightComponent);
+	case COMPONENT_BOUNDS:		return sizeof(BoundsComponent);
+	case COMPONENT_ANIMATION:	return sizeof(AnimationComponent);
+	default:					return 0;
+	}
+}
+
+const void* EntityRegistry::getComponentDefault(ComponentType type)
+{
+	switch (type)
+	{
+	case COMPONENT_TRANSFORM:	return &defaultTransform;
+	case COMPONENT_RENDER_MESH:	return &defaultRenderMesh;
+	case COMPONENT_CONTROLLER:	return &defaultController;
+	case COMPONENT_LIGHT:		return &defaultLight;
+	case COMPONENT_BOUNDS:		return &defaultBounds;
+	case COMPONENT_ANIMATION:	return &defaultAnimation;
+	default:					return nullptr;
+	}
+}
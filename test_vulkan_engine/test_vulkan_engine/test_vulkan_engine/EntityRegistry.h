@@ -0,0 +1,196 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "Components.h"
+
+// Size of one archetype chunk in bytes
+const size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+
+/**
+ * @struct ArchetypeChunk
+ * @brief Fixed size block of memory holding the components of up to `capacity` entities.
+ *
+ * Every component type present in the archetype is stored as its own contiguous array
+ * (structure of arrays), so systems only touch the component arrays they need.
+ */
+struct ArchetypeChunk
+{
+	std::unique_ptr<glm::vec4[]> memory;			///< Backing storage (vec4 keeps the arrays 16 byte aligned).
+	size_t offsets[COMPONENT_TYPE_COUNT] = {};		///< Byte offset of each component array inside memory.
+	Entity* entities = nullptr;						///< Entity owning each row.
+	uint32_t count = 0;								///< Number of used rows.
+	uint32_t capacity = 0;							///< Number of rows that fit in the chunk.
+
+	/**
+	 * @brief Returns the component array of type T in this chunk.
+	 *
+	 * The caller must make sure the archetype owns the component.
+	 */
+	template<typename T>
+	T* get()
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(memory.get()) + offsets[ComponentTraits<T>::type]);
+	}
+};
+
+/**
+ * @struct Archetype
+ * @brief All entities sharing the same set of components.
+ */
+struct Archetype
+{
+	ComponentMask mask = 0;										///< Components owned by every entity of the archetype.
+	std::vector<std::unique_ptr<ArchetypeChunk>> chunks;		///< Chunks holding the component data.
+};
+
+/**
+ * @class EntityRegistry
+ * @brief Data oriented entity storage grouped by archetype.
+ *
+ * Entities with the same component mask are stored in the same archetype, inside
+ * fixed size chunks where every component type lives in its own contiguous array.
+ * Per-frame systems iterate the chunks matching a component mask and only read
+ * the arrays they need, instead of walking through fat per-object structures.
+ */
+class EntityRegistry
+{
+public:
+	EntityRegistry();
+
+	/**
+	 * @brief Creates a new entity with the given components (default initialised).
+	 *
+	 * @param mask Components the entity owns.
+	 * @return Handle of the new entity.
+	 */
+	Entity createEntity(ComponentMask mask);
+
+	/**
+	 * @brief Destroys an entity and releases its row in its chunk.
+	 *
+	 * @param entity The entity to destroy.
+	 */
+	void destroyEntity(Entity entity);
+
+	/**
+	 * @brief Adds components to an existing entity, moving it to the matching archetype.
+	 *
+	 * Components already owned keep their value, new ones are default initialised.
+	 *
+	 * @param entity The entity to extend.
+	 * @param mask Components to add.
+	 */
+	void addComponents(Entity entity, ComponentMask mask);
+
+	/**
+	 * @brief Removes components from an existing entity, moving it to the matching archetype.
+	 *
+	 * @param entity The entity to shrink.
+	 * @param mask Components to remove.
+	 */
+	void removeComponents(Entity entity, ComponentMask mask);
+
+	/**
+	 * @brief Checks if the handle refers to a living entity.
+	 */
+	bool isAlive(Entity entity) const;
+
+	/**
+	 * @brief Returns the component mask of a living entity.
+	 */
+	ComponentMask getMask(Entity entity) const;
+
+	/**
+	 * @brief Returns a component of an entity, or nullptr if the entity doesn't own it.
+	 *
+	 * The pointer is only valid until the next structural change (create, destroy, add, remove).
+	 */
+	template<typename T>
+	T* getComponent(Entity entity)
+	{
+		if (!isAlive(entity))
+		{
+			return nullptr;
+		}
+
+		const EntityRecord& record = records[entity & ENTITY_INDEX_MASK];
+		Archetype& archetype = archetypes[record.archetype];
+		if (!(archetype.mask & (1u << ComponentTraits<T>::type)))
+		{
+			return nullptr;
+		}
+
+		return &archetype.chunks[record.chunk]->get<T>()[record.row];
+	}
+
+	/**
+	 * @brief Calls func(ArchetypeChunk&) for every non-empty chunk owning all required components.
+	 *
+	 * @param required Components the chunk must own.
+	 * @param func Callback receiving the chunk.
+	 */
+	template<typename Func>
+	void forEachChunk(ComponentMask required, Func func)
+	{
+		for (auto& archetype : archetypes)
+		{
+			if ((archetype.mask & required) != required)
+			{
+				continue;
+			}
+
+			for (auto& chunk : archetype.chunks)
+			{
+				if (chunk->count > 0)
+				{
+					func(*chunk);
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Returns the number of living entities.
+	 */
+	size_t getEntityCount() const;
+
+	/**
+	 * @brief Destroys every entity and releases all chunks.
+	 */
+	void clear();
+
+	~EntityRegistry();
+
+private:
+	static const uint32_t ENTITY_INDEX_MASK = 0x00FFFFFF;
+	static const uint32_t ENTITY_GENERATION_SHIFT = 24;
+
+	// Location of an entity inside the archetype storage
+	struct EntityRecord
+	{
+		uint32_t archetype = 0;
+		uint32_t chunk = 0;
+		uint32_t row = 0;
+		uint32_t generation = 0;
+		bool alive = false;
+	};
+
+	std::vector<Archetype> archetypes;
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeSlots;
+	size_t entityCount = 0;
+
+	uint32_t findOrCreateArchetype(ComponentMask mask);
+	ArchetypeChunk* createChunk(ComponentMask mask);
+	void allocateRow(Entity entity, uint32_t archetypeIndex);
+	void releaseRow(const EntityRecord& record);
+	void moveEntity(Entity entity, ComponentMask newMask);
+
+	static size_t getComponentSize(ComponentType type);
+	static const void* getComponentDefault(ComponentType type);
+};
@@ -0,0 +1,893 @@
+#include "EnvironmentLighting.h"
+
+#include "Utilities.h"
+#include "stb_image.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t CACHE_FILE_MAGIC = 0x42494B56;		// "VKIB"
+	const uint32_t CACHE_FILE_VERSION = 1;				// Bumped when the precomputation changes
+
+	// Written in front of the SH coefficients and the prefiltered levels
+	struct CacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t faceSize;
+		uint32_t mipLevels;
+		uint64_t sourceChecksum;		// Of the HDR file the data was computed from
+		uint64_t dataSize;
+		uint64_t checksum;
+	};
+
+	const VkFormat ENVIRONMENT_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+	const VkDeviceSize ENVIRONMENT_TEXEL_SIZE = 4 * sizeof(uint16_t);
+	const VkDeviceSize IRRADIANCE_SIZE = SH_COEFFICIENT_COUNT * sizeof(glm::vec4);
+
+	// The irradiance is projected from the level with 32x32 faces, finer levels change nothing in nine coefficients
+	const uint32_t IRRADIANCE_SOURCE_SIZE = 32;
+
+	// FNV-1a, same as the pipeline cache's
+	uint64_t computeChecksum(const char* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint32_t mipSize(uint32_t size, uint32_t mipLevel)
+	{
+		return std::max(1u, size >> mipLevel);
+	}
+
+	uint32_t mipLevelCount(uint32_t size)
+	{
+		uint32_t levels = 1;
+		while (size > 1)
+		{
+			size /= 2;
+			levels++;
+		}
+		return levels;
+	}
+
+	// Copy regions of every level of the prefiltered cubemap, packed level after level, the six faces of a level together
+	std::vector<VkBufferImageCopy> prefilteredRegions(VkDeviceSize baseOffset, VkDeviceSize* outSize)
+	{
+		std::vector<VkBufferImageCopy> regions(PREFILTERED_MIP_LEVELS);
+		VkDeviceSize offset = baseOffset;
+		for (uint32_t level = 0; level < PREFILTERED_MIP_LEVELS; level++)
+		{
+			uint32_t size = mipSize(PREFILTERED_CUBE_SIZE, level);
+
+			regions[level] = {};
+			regions[level].bufferOffset = offset;
+			regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[level].imageSubresource.mipLevel = level;
+			regions[level].imageSubresource.baseArrayLayer = 0;
+			regions[level].imageSubresource.layerCount = 6;
+			regions[level].imageExtent = { size, size, 1 };
+
+			offset += VkDeviceSize(size) * size * 6 * ENVIRONMENT_TEXEL_SIZE;
+		}
+
+		*outSize = offset - baseOffset;
+		return regions;
+	}
+
+	void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseMipLevel, uint32_t levelCount,
+		VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+		VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = baseMipLevel;
+		barrier.subresourceRange.levelCount = levelCount;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+		VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+	{
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	VkDescriptorSetLayout createComputeSetLayout(VkDevice device, VkDescriptorType outputType)
+	{
+		// Binding 0: the source, binding 1: the result
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = outputType;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutCreateInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout setLayout;
+		VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+		}
+		return setLayout;
+	}
+
+	VkPipelineLayout createComputePipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout, uint32_t pushConstantSize)
+	{
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutCreateInfo.setLayoutCount = 1;
+		pipelineLayoutCreateInfo.pSetLayouts = &setLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+		pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantSize > 0 ? &pushConstantRange : nullptr;
+
+		VkPipelineLayout pipelineLayout;
+		VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Pipeline Layout!");
+		}
+		return pipelineLayout;
+	}
+}
+
+EnvironmentLighting::EnvironmentLighting()
+{
+}
+
+void EnvironmentLighting::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	// -- SAMPLER --
+	// Trilinear over every level: the shaders pick the level from the roughness
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Environment Sampler!");
+	}
+
+	// -- SET LAYOUT --
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// -- DESCRIPTOR POOL --
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = 1;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+}
+
+void EnvironmentLighting::load(const std::string& environmentFile, VkQueue queue, VkCommandPool commandPool, PipelineManager& pipelineManager)
+{
+	createResults();
+
+	if (environmentFile.empty())
+	{
+		// A single white texel runs through the same precomputation, not worth a cache file
+		std::vector<float> white = { 1.0f, 1.0f, 1.0f, 1.0f };
+		precompute(white, 1, 1, queue, commandPool, pipelineManager);
+		printf("Environment lighting: no environment, uniform white\n");
+	}
+	else
+	{
+		std::string sourceFile = "Textures/" + environmentFile;
+		std::ifstream file(sourceFile, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open an Environment file! (" + environmentFile + ")");
+		}
+
+		std::vector<char> source(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(source.data(), source.size());
+
+		// The cache belongs to these exact bytes, an edited environment is precomputed again
+		uint64_t sourceChecksum = computeChecksum(source.data(), source.size());
+		std::string cacheFile = sourceFile + ".ibl";
+
+		if (!loadCache(cacheFile, sourceChecksum, queue, commandPool))
+		{
+			int width, height, channels;
+			float* pixels = stbi_loadf_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), static_cast<int>(source.size()),
+				&width, &height, &channels, STBI_rgb_alpha);
+			if (!pixels)
+			{
+				throw std::runtime_error("Failed to load an Environment file! (" + environmentFile + ")");
+			}
+
+			std::vector<float> pixelData(pixels, pixels + size_t(width) * height * 4);
+			stbi_image_free(pixels);
+
+			auto start = std::chrono::steady_clock::now();
+			precompute(pixelData, width, height, queue, commandPool, pipelineManager);
+			double precomputeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			printf("Environment lighting: precomputed %s in %.2f ms\n", environmentFile.c_str(), precomputeMs);
+
+			saveCache(cacheFile, sourceChecksum, queue, commandPool);
+		}
+	}
+
+	writeDescriptorSet();
+}
+
+bool EnvironmentLighting::loadCache(const std::string& cacheFile, uint64_t sourceChecksum, VkQueue queue, VkCommandPool commandPool)
+{
+	std::ifstream file(cacheFile, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		printf("Environment lighting: no cache file, precomputing\n");
+		return false;
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+
+	CacheFileHeader header;
+	if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		printf("Environment lighting: %s is truncated, precomputing\n", cacheFile.c_str());
+		return false;
+	}
+
+	if (header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION ||
+		header.faceSize != PREFILTERED_CUBE_SIZE || header.mipLevels != PREFILTERED_MIP_LEVELS)
+	{
+		printf("Environment lighting: %s has an unknown format, precomputing\n", cacheFile.c_str());
+		return false;
+	}
+
+	if (header.sourceChecksum != sourceChecksum)
+	{
+		printf("Environment lighting: %s was computed from another environment, precomputing\n", cacheFile.c_str());
+		return false;
+	}
+
+	VkDeviceSize prefilteredSize;
+	std::vector<VkBufferImageCopy> regions = prefilteredRegions(IRRADIANCE_SIZE, &prefilteredSize);
+	VkDeviceSize dataSize = IRRADIANCE_SIZE + prefilteredSize;
+	if (header.dataSize != dataSize || header.dataSize != fileSize - sizeof(header))
+	{
+		printf("Environment lighting: %s has a wrong size, precomputing\n", cacheFile.c_str());
+		return false;
+	}
+
+	std::vector<char> data(static_cast<size_t>(dataSize));
+	if (!file.read(data.data(), data.size()) || computeChecksum(data.data(), data.size()) != header.checksum)
+	{
+		printf("Environment lighting: %s is damaged, precomputing\n", cacheFile.c_str());
+		return false;
+	}
+
+	// -- UPLOAD --
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* mapped;
+	vkMapMemory(device, stagingBufferMemory, 0, dataSize, 0, &mapped);
+	memcpy(mapped, data.data(), data.size());
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+
+	VkBufferCopy irradianceRegion = {};
+	irradianceRegion.size = IRRADIANCE_SIZE;
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, irradianceBuffer, 1, &irradianceRegion);
+
+	imageBarrier(commandBuffer, prefiltered.image, 0, PREFILTERED_MIP_LEVELS, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, prefiltered.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+	imageBarrier(commandBuffer, prefiltered.image, 0, PREFILTERED_MIP_LEVELS, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	bufferBarrier(commandBuffer, irradianceBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	endAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	printf("Environment lighting: loaded %zu bytes from %s\n", data.size(), cacheFile.c_str());
+	return true;
+}
+
+void EnvironmentLighting::saveCache(const std::string& cacheFile, uint64_t sourceChecksum, VkQueue queue, VkCommandPool commandPool)
+{
+	VkDeviceSize prefilteredSize;
+	std::vector<VkBufferImageCopy> regions = prefilteredRegions(IRRADIANCE_SIZE, &prefilteredSize);
+	VkDeviceSize dataSize = IRRADIANCE_SIZE + prefilteredSize;
+
+	// -- READBACK --
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, dataSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+
+	VkBufferCopy irradianceRegion = {};
+	irradianceRegion.size = IRRADIANCE_SIZE;
+	vkCmdCopyBuffer(commandBuffer, irradianceBuffer, stagingBuffer, 1, &irradianceRegion);
+
+	imageBarrier(commandBuffer, prefiltered.image, 0, PREFILTERED_MIP_LEVELS, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyImageToBuffer(commandBuffer, prefiltered.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer,
+		static_cast<uint32_t>(regions.size()), regions.data());
+	imageBarrier(commandBuffer, prefiltered.image, 0, PREFILTERED_MIP_LEVELS, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	bufferBarrier(commandBuffer, stagingBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+
+	endAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
+
+	std::vector<char> data(static_cast<size_t>(dataSize));
+	void* mapped;
+	vkMapMemory(device, stagingBufferMemory, 0, dataSize, 0, &mapped);
+	memcpy(data.data(), mapped, data.size());
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	// -- FILE --
+	CacheFileHeader header = {};
+	header.magic = CACHE_FILE_MAGIC;
+	header.version = CACHE_FILE_VERSION;
+	header.faceSize = PREFILTERED_CUBE_SIZE;
+	header.mipLevels = PREFILTERED_MIP_LEVELS;
+	header.sourceChecksum = sourceChecksum;
+	header.dataSize = data.size();
+	header.checksum = computeChecksum(data.data(), data.size());
+
+	// Temporary file first, like the pipeline cache: a crash mid write never leaves a damaged cache behind
+	std::string tempFile = cacheFile + ".tmp";
+	{
+		std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			printf("Environment lighting: can't write %s, precomputing again next time\n", cacheFile.c_str());
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		if (!file.good())
+		{
+			printf("Environment lighting: can't write %s, precomputing again next time\n", cacheFile.c_str());
+			return;
+		}
+	}
+
+	std::remove(cacheFile.c_str());
+	if (std::rename(tempFile.c_str(), cacheFile.c_str()) == 0)
+	{
+		printf("Environment lighting: cached %zu bytes in %s\n", data.size(), cacheFile.c_str());
+	}
+}
+
+void EnvironmentLighting::precompute(const std::vector<float>& pixels, int width, int height, VkQueue queue, VkCommandPool commandPool, PipelineManager& pipelineManager)
+{
+	// -- SOURCE --
+	// Half floats: linear filtering of 32 bit floats is optional, of 16 bit ones it is not
+	std::vector<uint16_t> halfPixels(pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		halfPixels[i] = static_cast<uint16_t>(glm::packHalf1x16(pixels[i]));
+	}
+	VkDeviceSize sourceSize = halfPixels.size() * sizeof(uint16_t);
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, sourceSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* mapped;
+	vkMapMemory(device, stagingBufferMemory, 0, sourceSize, 0, &mapped);
+	memcpy(mapped, halfPixels.data(), static_cast<size_t>(sourceSize));
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	EnvironmentImage equirect = createEnvironmentImage(static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1, false,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	// The cubemap everything is computed from, its mips keep the sample count of the filters low
+	EnvironmentImage environment = createEnvironmentImage(ENVIRONMENT_CUBE_SIZE, ENVIRONMENT_CUBE_SIZE, mipLevelCount(ENVIRONMENT_CUBE_SIZE), true,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+	// Storage views see the six faces as an array
+	VkImageView environmentFaceView = createFaceView(environment.image, 0);
+	std::array<VkImageView, PREFILTERED_MIP_LEVELS> prefilteredFaceViews;
+	for (uint32_t level = 0; level < PREFILTERED_MIP_LEVELS; level++)
+	{
+		prefilteredFaceViews[level] = createFaceView(prefiltered.image, level);
+	}
+
+	// -- PIPELINES --
+	// Only needed once, destroyed at the end
+	VkDescriptorSetLayout imageSetLayout = createComputeSetLayout(device, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+	VkDescriptorSetLayout irradianceSetLayout = createComputeSetLayout(device, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+
+	VkPipelineLayout equirectToCubeLayout = createComputePipelineLayout(device, imageSetLayout, 0);
+	VkPipelineLayout irradianceLayout = createComputePipelineLayout(device, irradianceSetLayout, sizeof(PushIrradiance));
+	VkPipelineLayout prefilterLayout = createComputePipelineLayout(device, imageSetLayout, sizeof(PushPrefilter));
+
+	std::vector<ComputePipelineDesc> pipelineDescs(3);
+	pipelineDescs[0] = { "Equirect to cube", "Shaders/equirectToCubeComp.spv", equirectToCubeLayout };
+	pipelineDescs[1] = { "SH irradiance", "Shaders/shIrradianceComp.spv", irradianceLayout };
+	pipelineDescs[2] = { "Prefilter environment", "Shaders/prefilterEnvironmentComp.spv", prefilterLayout };
+	std::vector<VkPipeline> pipelines = pipelineManager.createComputePipelines(pipelineDescs);
+
+	// -- DESCRIPTOR SETS --
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = 2 + PREFILTERED_MIP_LEVELS;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = 1 + PREFILTERED_MIP_LEVELS;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = 2 + PREFILTERED_MIP_LEVELS;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	VkDescriptorPool computePool;
+	VkResult result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &computePool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+
+	// Set 0 resamples the equirect, set 1 projects the irradiance, the others prefilter a level each
+	std::vector<VkDescriptorSetLayout> setLayouts(2 + PREFILTERED_MIP_LEVELS, imageSetLayout);
+	setLayouts[1] = irradianceSetLayout;
+
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = computePool;
+	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+	setAllocInfo.pSetLayouts = setLayouts.data();
+
+	std::vector<VkDescriptorSet> computeSets(setLayouts.size());
+	result = vkAllocateDescriptorSets(device, &setAllocInfo, computeSets.data());
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Environment Descriptor Sets!");
+	}
+
+	auto writeComputeSet = [&](VkDescriptorSet set, VkImageView sourceView, VkImageView outputView, VkBuffer outputBuffer)
+	{
+		VkDescriptorImageInfo sourceInfo = {};
+		sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		sourceInfo.imageView = sourceView;
+		sourceInfo.sampler = sampler;
+
+		VkDescriptorImageInfo outputImageInfo = {};
+		outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		outputImageInfo.imageView = outputView;
+
+		VkDescriptorBufferInfo outputBufferInfo = {};
+		outputBufferInfo.buffer = outputBuffer;
+		outputBufferInfo.offset = 0;
+		outputBufferInfo.range = IRRADIANCE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 2> setWrites = {};
+		setWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		setWrites[0].dstSet = set;
+		setWrites[0].dstBinding = 0;
+		setWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		setWrites[0].descriptorCount = 1;
+		setWrites[0].pImageInfo = &sourceInfo;
+
+		setWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		setWrites[1].dstSet = set;
+		setWrites[1].dstBinding = 1;
+		setWrites[1].descriptorCount = 1;
+		if (outputBuffer != VK_NULL_HANDLE)
+		{
+			setWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			setWrites[1].pBufferInfo = &outputBufferInfo;
+		}
+		else
+		{
+			setWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			setWrites[1].pImageInfo = &outputImageInfo;
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+	};
+
+	writeComputeSet(computeSets[0], equirect.view, environmentFaceView, VK_NULL_HANDLE);
+	writeComputeSet(computeSets[1], environment.view, VK_NULL_HANDLE, irradianceBuffer);
+	for (uint32_t level = 0; level < PREFILTERED_MIP_LEVELS; level++)
+	{
+		writeComputeSet(computeSets[2 + level], environment.view, prefilteredFaceViews[level], VK_NULL_HANDLE);
+	}
+
+	// -- COMMANDS --
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+
+	// Upload the equirectangular image
+	imageBarrier(commandBuffer, equirect.image, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy sourceRegion = {};
+	sourceRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	sourceRegion.imageSubresource.mipLevel = 0;
+	sourceRegion.imageSubresource.baseArrayLayer = 0;
+	sourceRegion.imageSubresource.layerCount = 1;
+	sourceRegion.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, equirect.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &sourceRegion);
+
+	imageBarrier(commandBuffer, equirect.image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	// Resample it into the top level of the cubemap
+	imageBarrier(commandBuffer, environment.image, 0, environment.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[0]);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, equirectToCubeLayout, 0, 1, &computeSets[0], 0, nullptr);
+	vkCmdDispatch(commandBuffer, ENVIRONMENT_CUBE_SIZE / 8, ENVIRONMENT_CUBE_SIZE / 8, 6);
+
+	// Mip chain, every level blitted from the one above
+	imageBarrier(commandBuffer, environment.image, 0, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	for (uint32_t level = 1; level < environment.mipLevels; level++)
+	{
+		imageBarrier(commandBuffer, environment.image, level, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		int32_t sourceSize = static_cast<int32_t>(mipSize(ENVIRONMENT_CUBE_SIZE, level - 1));
+		int32_t targetSize = static_cast<int32_t>(mipSize(ENVIRONMENT_CUBE_SIZE, level));
+
+		VkImageBlit blit = {};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 6 };
+		blit.srcOffsets[1] = { sourceSize, sourceSize, 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 6 };
+		blit.dstOffsets[1] = { targetSize, targetSize, 1 };
+		vkCmdBlitImage(commandBuffer, environment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			environment.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		imageBarrier(commandBuffer, environment.image, level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	}
+
+	imageBarrier(commandBuffer, environment.image, 0, environment.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	// Diffuse: one workgroup projects a whole coarse level onto the SH basis
+	PushIrradiance pushIrradiance = {};
+	pushIrradiance.faceSize = IRRADIANCE_SOURCE_SIZE;
+	pushIrradiance.sourceLod = static_cast<float>(mipLevelCount(ENVIRONMENT_CUBE_SIZE) - mipLevelCount(IRRADIANCE_SOURCE_SIZE));
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[1]);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, irradianceLayout, 0, 1, &computeSets[1], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, irradianceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushIrradiance), &pushIrradiance);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+	// Specular: each level of the result is filtered with the GGX lobe of its roughness
+	imageBarrier(commandBuffer, prefiltered.image, 0, PREFILTERED_MIP_LEVELS, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[2]);
+	for (uint32_t level = 0; level < PREFILTERED_MIP_LEVELS; level++)
+	{
+		PushPrefilter pushPrefilter = {};
+		pushPrefilter.roughness = static_cast<float>(level) / (PREFILTERED_MIP_LEVELS - 1);
+		pushPrefilter.environmentSize = static_cast<float>(ENVIRONMENT_CUBE_SIZE);
+
+		uint32_t size = mipSize(PREFILTERED_CUBE_SIZE, level);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, prefilterLayout, 0, 1, &computeSets[2 + level], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, prefilterLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushPrefilter), &pushPrefilter);
+		vkCmdDispatch(commandBuffer, (size + 7) / 8, (size + 7) / 8, 6);
+	}
+
+	imageBarrier(commandBuffer, prefiltered.image, 0, PREFILTERED_MIP_LEVELS, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	bufferBarrier(commandBuffer, irradianceBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	endAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
+
+	// -- CLEANUP --
+	for (auto pipeline : pipelines)
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+	vkDestroyPipelineLayout(device, equirectToCubeLayout, nullptr);
+	vkDestroyPipelineLayout(device, irradianceLayout, nullptr);
+	vkDestroyPipelineLayout(device, prefilterLayout, nullptr);
+	vkDestroyDescriptorPool(device, computePool, nullptr);
+	vkDestroyDescriptorSetLayout(device, imageSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, irradianceSetLayout, nullptr);
+
+	for (auto view : prefilteredFaceViews)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+	vkDestroyImageView(device, environmentFaceView, nullptr);
+	destroyEnvironmentImage(environment);
+	destroyEnvironmentImage(equirect);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
+void EnvironmentLighting::createResults()
+{
+	prefiltered = createEnvironmentImage(PREFILTERED_CUBE_SIZE, PREFILTERED_CUBE_SIZE, PREFILTERED_MIP_LEVELS, true,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+	// Written by the projection or from the cache, read as a uniform buffer by every pixel
+	createBuffer(physicalDevice, device, IRRADIANCE_SIZE,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &irradianceBuffer, &irradianceMemory);
+}
+
+void EnvironmentLighting::writeDescriptorSet()
+{
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &setLayout;
+
+	VkResult result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate an Environment Descriptor Set!");
+	}
+
+	VkDescriptorBufferInfo irradianceInfo = {};
+	irradianceInfo.buffer = irradianceBuffer;
+	irradianceInfo.offset = 0;
+	irradianceInfo.range = IRRADIANCE_SIZE;
+
+	VkDescriptorImageInfo prefilteredInfo = {};
+	prefilteredInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	prefilteredInfo.imageView = prefiltered.view;
+	prefilteredInfo.sampler = sampler;
+
+	std::array<VkWriteDescriptorSet, 2> setWrites = {};
+	setWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[0].dstSet = descriptorSet;
+	setWrites[0].dstBinding = 0;
+	setWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	setWrites[0].descriptorCount = 1;
+	setWrites[0].pBufferInfo = &irradianceInfo;
+
+	setWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[1].dstSet = descriptorSet;
+	setWrites[1].dstBinding = 1;
+	setWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	setWrites[1].descriptorCount = 1;
+	setWrites[1].pImageInfo = &prefilteredInfo;
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+}
+
+EnvironmentLighting::EnvironmentImage EnvironmentLighting::createEnvironmentImage(uint32_t width, uint32_t height, uint32_t mipLevels, bool cube, VkImageUsageFlags usage)
+{
+	EnvironmentImage environmentImage;
+	environmentImage.mipLevels = mipLevels;
+
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.flags = cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = cube ? 6 : 1;
+	imageCreateInfo.format = ENVIRONMENT_FORMAT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = usage;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &environmentImage.image);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Environment Image!");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, environmentImage.image, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, &environmentImage.memory);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate memory for an Environment Image!");
+	}
+	vkBindImageMemory(device, environmentImage.image, environmentImage.memory, 0);
+
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = environmentImage.image;
+	viewCreateInfo.viewType = cube ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = ENVIRONMENT_FORMAT;
+	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = 0;
+	viewCreateInfo.subresourceRange.levelCount = mipLevels;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = imageCreateInfo.arrayLayers;
+
+	result = vkCreateImageView(device, &viewCreateInfo, nullptr, &environmentImage.view);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Environment Image View!");
+	}
+
+	return environmentImage;
+}
+
+VkImageView EnvironmentLighting::createFaceView(VkImage image, uint32_t mipLevel)
+{
+	// Storage images can't be cubes, the compute shaders write the faces as array layers
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = image;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewCreateInfo.format = ENVIRONMENT_FORMAT;
+	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = mipLevel;
+	viewCreateInfo.subresourceRange.levelCount = 1;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 6;
+
+	VkImageView view;
+	VkResult result = vkCreateImageView(device, &viewCreateInfo, nullptr, &view);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Environment Face View!");
+	}
+	return view;
+}
+
+void EnvironmentLighting::destroyEnvironmentImage(EnvironmentImage& environmentImage)
+{
+	vkDestroyImageView(device, environmentImage.view, nullptr);
+	vkDestroyImage(device, environmentImage.image, nullptr);
+	vkFreeMemory(device, environmentImage.memory, nullptr);
+	environmentImage = EnvironmentImage();
+}
+
+VkDescriptorSetLayout EnvironmentLighting::getSetLayout() const
+{
+	return setLayout;
+}
+
+VkDescriptorSet EnvironmentLighting::getDescriptorSet() const
+{
+	return descriptorSet;
+}
+
+void EnvironmentLighting::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// The set goes with the pool
+	destroyEnvironmentImage(prefiltered);
+	vkDestroyBuffer(device, irradianceBuffer, nullptr);
+	vkFreeMemory(device, irradianceMemory, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+
+	device = VK_NULL_HANDLE;
+}
+
+EnvironmentLighting::~EnvironmentLighting()
+{
+}
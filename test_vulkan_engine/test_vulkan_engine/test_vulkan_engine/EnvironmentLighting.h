@@ -0,0 +1,112 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PipelineManager.h"
+
+const uint32_t ENVIRONMENT_CUBE_SIZE = 256;				// Face size of the cubemap the environment is resampled into
+const uint32_t PREFILTERED_CUBE_SIZE = 128;				// Face size of the sharpest (roughness 0) prefiltered level
+const uint32_t PREFILTERED_MIP_LEVELS = 6;				// Roughness of level i is i / (levels - 1), the roughest level is 4x4
+const uint32_t SH_COEFFICIENT_COUNT = 9;				// Three bands of spherical harmonics, enough for a cosine convolved irradiance
+
+/**
+ * @class EnvironmentLighting
+ * @brief Image based lighting from an HDR environment: SH9 irradiance and a GGX prefiltered cubemap.
+ *
+ * The equirectangular HDR image is resampled into a mipmapped cubemap, from which compute shaders
+ * project the diffuse irradiance onto nine spherical harmonics (already convolved with the cosine
+ * lobe) and prefilter the specular reflections into a mip chain, a roughness per level. The
+ * results are written to a file next to the environment, keyed by a checksum of the HDR file,
+ * so the precomputation runs once per environment. Without an environment a uniform white one
+ * stands in, which lights like the old constant ambient term.
+ */
+class EnvironmentLighting
+{
+public:
+	EnvironmentLighting();
+
+	/**
+	 * @brief Creates the set layout the scene pipelines use, the sampler and the descriptor pool.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice);
+
+	/**
+	 * @brief Loads the precomputed lighting of an environment, computing and caching it if needed. Called once.
+	 *
+	 * @param environmentFile HDR file in the Textures folder, empty for the uniform white environment.
+	 * @param queue Queue the uploads and the precomputation are submitted to (graphics, it also computes).
+	 * @param commandPool Pool of their command buffers.
+	 * @param pipelineManager Compiles the precomputation's pipelines, destroyed once they ran.
+	 * @throws std::runtime_error if the file can't be loaded or a Vulkan object can't be created.
+	 */
+	void load(const std::string& environmentFile, VkQueue queue, VkCommandPool commandPool, PipelineManager& pipelineManager);
+
+	// Set of the scene pipelines: the SH coefficients (binding 0) and the prefiltered cubemap (binding 1)
+	VkDescriptorSetLayout getSetLayout() const;
+	VkDescriptorSet getDescriptorSet() const;
+
+	void destroy();
+
+	~EnvironmentLighting();
+
+private:
+	// Push constants, laid out as in the shaders
+	struct PushIrradiance
+	{
+		uint32_t faceSize;
+		float sourceLod;
+	};
+
+	struct PushPrefilter
+	{
+		float roughness;
+		float environmentSize;
+	};
+
+	// A cubemap, or an equirectangular 2D image, with its view
+	struct EnvironmentImage
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		uint32_t mipLevels = 1;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkSampler sampler = VK_NULL_HANDLE;					// Trilinear, clamp to edge, every mip
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+	// -- RESULTS --
+	EnvironmentImage prefiltered;
+	VkBuffer irradianceBuffer = VK_NULL_HANDLE;			// SH_COEFFICIENT_COUNT vec4, rgb used
+	VkDeviceMemory irradianceMemory = VK_NULL_HANDLE;
+
+	// Reads the cache file, false if it is missing or was written for another environment
+	bool loadCache(const std::string& cacheFile, uint64_t sourceChecksum, VkQueue queue, VkCommandPool commandPool);
+	void saveCache(const std::string& cacheFile, uint64_t sourceChecksum, VkQueue queue, VkCommandPool commandPool);
+
+	void precompute(const std::vector<float>& pixels, int width, int height, VkQueue queue, VkCommandPool commandPool, PipelineManager& pipelineManager);
+
+	void createResults();
+	void writeDescriptorSet();
+
+	EnvironmentImage createEnvironmentImage(uint32_t width, uint32_t height, uint32_t mipLevels, bool cube, VkImageUsageFlags usage);
+	VkImageView createFaceView(VkImage image, uint32_t mipLevel);
+	void destroyEnvironmentImage(EnvironmentImage& environmentImage);
+};
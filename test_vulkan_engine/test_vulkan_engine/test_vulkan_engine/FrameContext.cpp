@@ -0,0 +1,245 @@
+#include "FrameContext.h"
+
+#include "Utilities.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+void UniformRing::create(VkPhysicalDevice physicalDevice, VkDevice newDevice, VkDeviceSize newSize)
+{
+	device = newDevice;
+	size = newSize;
+	head = 0;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	alignment = std::max<VkDeviceSize>(1, std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment));
+
+	// Host coherent, so writes need no flush before the submit
+	createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &buffer, &memory);
+
+	void* data;
+	VkResult result = vkMapMemory(device, memory, 0, size, 0, &data);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to map a Uniform Buffer!");
+	}
+	mapped = static_cast<uint8_t*>(data);
+}
+
+VkDescriptorBufferInfo UniformRing::push(const void* data, VkDeviceSize dataSize)
+{
+	// Alignment is a power of two (required by the spec)
+	VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+	if (offset + dataSize > size)
+	{
+		throw std::runtime_error("Failed to allocate uniform data, the frame's uniform ring is full!");
+	}
+
+	memcpy(mapped + offset, data, static_cast<size_t>(dataSize));
+	head = offset + dataSize;
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = dataSize;
+	return bufferInfo;
+}
+
+void UniformRing::reset()
+{
+	head = 0;
+}
+
+VkDeviceSize UniformRing::getUsed() const
+{
+	return head;
+}
+
+void UniformRing::destroy()
+{
+	if (buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkUnmapMemory(device, memory);
+	vkDestroyBuffer(device, buffer, nullptr);
+	vkFreeMemory(device, memory, nullptr);
+
+	buffer = VK_NULL_HANDLE;
+	memory = VK_NULL_HANDLE;
+	mapped = nullptr;
+}
+
+void FrameContext::create(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t queueFamilyIndex, uint32_t computeQueueFamilyIndex)
+{
+	device = newDevice;
+
+	// -- COMMAND POOLS --
+	// Command buffers can only be submitted to the family of their pool
+	commandPool = createCommandPool(queueFamilyIndex);
+	computeCommandPool = computeQueueFamilyIndex != queueFamilyIndex ? createCommandPool(computeQueueFamilyIndex) : commandPool;
+
+	// -- DESCRIPTOR POOL --
+	std::array<VkDescriptorPoolSize, 5> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = FRAME_DESCRIPTOR_SETS * 2;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = FRAME_DESCRIPTOR_SETS;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;					// Compute passes (post processing)
+	poolSizes[2].descriptorCount = FRAME_DESCRIPTOR_SETS;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[3].descriptorCount = FRAME_DESCRIPTOR_SETS;
+	poolSizes[4].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;				// G-buffer of the deferred lighting
+	poolSizes[4].descriptorCount = FRAME_DESCRIPTOR_SETS;
+
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
+	descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolInfo.maxSets = FRAME_DESCRIPTOR_SETS;
+	descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	descriptorPoolInfo.pPoolSizes = poolSizes.data();
+
+	VkResult result = vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+
+	// -- UNIFORM RING --
+	uniforms.create(physicalDevice, device, FRAME_UNIFORM_RING_SIZE);
+
+	// -- SYNCHRONISATION --
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Signalled, so the first wait on a new context returns immediately
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &imageAvailable) != VK_SUCCESS ||
+		vkCreateFence(device, &fenceCreateInfo, nullptr, &inFlightFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Semaphore and/or Fence!");
+	}
+}
+
+void FrameContext::begin()
+{
+	vkResetFences(device, 1, &inFlightFence);
+	vkResetCommandPool(device, commandPool, 0);
+	if (computeCommandPool != commandPool)
+	{
+		vkResetCommandPool(device, computeCommandPool, 0);
+	}
+	vkResetDescriptorPool(device, descriptorPool, 0);
+	uniforms.reset();
+	usedCommandBuffers = 0;
+	usedComputeCommandBuffers = 0;
+}
+
+VkCommandBuffer FrameContext::acquireCommandBuffer()
+{
+	return acquireFromPool(commandPool, commandBuffers, usedCommandBuffers);
+}
+
+VkCommandBuffer FrameContext::acquireComputeCommandBuffer()
+{
+	// A shared family shares the buffers too
+	if (computeCommandPool == commandPool)
+	{
+		return acquireCommandBuffer();
+	}
+	return acquireFromPool(computeCommandPool, computeCommandBuffers, usedComputeCommandBuffers);
+}
+
+VkCommandPool FrameContext::createCommandPool(uint32_t queueFamilyIndex)
+{
+	// Transient: the pool is reset as a whole every frame
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	VkCommandPool pool;
+	VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &pool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Command Pool!");
+	}
+	return pool;
+}
+
+VkCommandBuffer FrameContext::acquireFromPool(VkCommandPool pool, std::vector<VkCommandBuffer>& buffers, size_t& used)
+{
+	// The pool reset in begin() reset every command buffer, the ones allocated before are reused
+	if (used == buffers.size())
+	{
+		VkCommandBufferAllocateInfo cbAllocInfo = {};
+		cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cbAllocInfo.commandPool = pool;
+		cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cbAllocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		VkResult result = vkAllocateCommandBuffers(device, &cbAllocInfo, &commandBuffer);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate Command Buffers!");
+		}
+		buffers.push_back(commandBuffer);
+	}
+
+	return buffers[used++];
+}
+
+VkDescriptorSet FrameContext::allocateDescriptorSet(VkDescriptorSetLayout layout)
+{
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Descriptor Sets!");
+	}
+
+	return descriptorSet;
+}
+
+void FrameContext::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	uniforms.destroy();
+	vkDestroySemaphore(device, imageAvailable, nullptr);
+	vkDestroyFence(device, inFlightFence, nullptr);
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	if (computeCommandPool != commandPool)
+	{
+		vkDestroyCommandPool(device, computeCommandPool, nullptr);
+	}
+	vkDestroyCommandPool(device, commandPool, nullptr);		// Frees the command buffers
+
+	commandPool = VK_NULL_HANDLE;
+	computeCommandPool = VK_NULL_HANDLE;
+	commandBuffers.clear();
+	computeCommandBuffers.clear();
+	usedCommandBuffers = 0;
+	usedComputeCommandBuffers = 0;
+	descriptorPool = VK_NULL_HANDLE;
+	inFlightFence = VK_NULL_HANDLE;
+	imageAvailable = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+}
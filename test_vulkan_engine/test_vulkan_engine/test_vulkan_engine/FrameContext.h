@@ -0,0 +1,115 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;						// Upper limit of the configurable frames in flight
+const VkDeviceSize FRAME_UNIFORM_RING_SIZE = 512 * 1024;		// Uniform and storage data one frame can write (the light list takes 32 KiB, the joint matrices 64 bytes a joint)
+const uint32_t FRAME_DESCRIPTOR_SETS = 64;						// Sets one frame can allocate
+
+/**
+ * @class UniformRing
+ * @brief Persistently mapped uniform / storage buffer, sub-allocated linearly during a frame.
+ *
+ * Allocations are aligned to both minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment,
+ * so any range can be bound as either. reset() hands the whole buffer
+ * back once the GPU finished the frame that used it.
+ */
+class UniformRing
+{
+public:
+	void create(VkPhysicalDevice physicalDevice, VkDevice newDevice, VkDeviceSize newSize);
+
+	/**
+	 * @brief Copies data into the ring.
+	 *
+	 * @param data The data to copy.
+	 * @param size Size of the data in bytes.
+	 * @return Buffer range to write into a descriptor.
+	 * @throws std::runtime_error if the frame ran out of uniform space.
+	 */
+	VkDescriptorBufferInfo push(const void* data, VkDeviceSize size);
+
+	void reset();
+
+	// Bytes used by the current frame
+	VkDeviceSize getUsed() const;
+
+	void destroy();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	uint8_t* mapped = nullptr;
+	VkDeviceSize size = 0;
+	VkDeviceSize alignment = 256;
+	VkDeviceSize head = 0;
+};
+
+/**
+ * @class FrameContext
+ * @brief Everything the CPU writes while recording one frame.
+ *
+ * A context is only reused after its fence signalled, so the command pool, descriptor pool
+ * and uniform ring can be reset wholesale at the start of the frame instead of tracking
+ * individual resources. The number of contexts is the number of frames in flight, which
+ * bounds how far the CPU can run ahead of the GPU.
+ */
+class FrameContext
+{
+public:
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandPool computeCommandPool = VK_NULL_HANDLE;		// Same as commandPool if compute shares the graphics family
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;		// Transient sets, reset every frame
+	VkFence inFlightFence = VK_NULL_HANDLE;					// Signalled when the frame's submission finished
+	VkSemaphore imageAvailable = VK_NULL_HANDLE;			// Signalled by the acquire of the frame's image
+	UniformRing uniforms;
+
+	/**
+	 * @brief Creates the pools, uniform ring and synchronisation objects.
+	 *
+	 * @param physicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param queueFamilyIndex Queue family the command buffers are submitted to.
+	 * @param computeQueueFamilyIndex Queue family of the async compute queue.
+	 */
+	void create(VkPhysicalDevice physicalDevice, VkDevice newDevice, uint32_t queueFamilyIndex, uint32_t computeQueueFamilyIndex);
+
+	/**
+	 * @brief Resets the fence, the command pool, the descriptor pool and the uniform ring.
+	 *
+	 * Only valid once inFlightFence signalled, right before the frame is recorded.
+	 */
+	void begin();
+
+	/**
+	 * @brief Allocates a descriptor set that lives until the context is begun again.
+	 */
+	VkDescriptorSet allocateDescriptorSet(VkDescriptorSetLayout layout);
+
+	/**
+	 * @brief Hands out a primary command buffer that is free until the context is begun again.
+	 *
+	 * A frame records one command buffer per submission, they are allocated on first use and kept.
+	 */
+	VkCommandBuffer acquireCommandBuffer();
+
+	// Same, for the async compute queue's family
+	VkCommandBuffer acquireComputeCommandBuffer();
+
+	void destroy();
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> commandBuffers;
+	size_t usedCommandBuffers = 0;
+	std::vector<VkCommandBuffer> computeCommandBuffers;
+	size_t usedComputeCommandBuffers = 0;
+
+	VkCommandPool createCommandPool(uint32_t queueFamilyIndex);
+	VkCommandBuffer acquireFromPool(VkCommandPool pool, std::vector<VkCommandBuffer>& buffers, size_t& used);
+};
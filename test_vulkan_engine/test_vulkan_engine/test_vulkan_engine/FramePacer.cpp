@@ -0,0 +1,331 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace
+{
+	// Sleeps can overshoot, the last part before a deadline is yielded away instead
+	const std::chrono::microseconds SLEEP_SLACK(500);
+
+	// Share of the expected fence wait that is slept before blocking in the driver
+	const double FENCE_SLEEP_SHARE = 0.75;
+
+	// Longest single sleep before the fence is checked again, a stale estimate can't add more latency than this
+	const double MAX_FENCE_SLEEP_MS = 4.0;
+
+	double toMs(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	// Percentile of sorted samples
+	double percentile(const std::vector<double>& sorted, double fraction)
+	{
+		size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	void preciseSleep(std::chrono::steady_clock::duration duration)
+	{
+#if defined(_WIN32)
+		// Sleep() has the granularity of the system timer (up to 15.6 ms), the high resolution
+		// waitable timer (Windows 10 1803+) doesn't
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+		static thread_local HANDLE timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (timer != nullptr)
+		{
+			LARGE_INTEGER dueTime;
+			dueTime.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 100);		// Relative, 100 ns units
+			if (SetWaitableTimer(timer, &dueTime, 0, nullptr, nullptr, FALSE))
+			{
+				WaitForSingleObject(timer, INFINITE);
+				return;
+			}
+		}
+#endif
+		std::this_thread::sleep_for(duration);
+	}
+}
+
+FramePacer::FramePacer()
+{
+}
+
+void FramePacer::create(uint32_t frameSlotCount, double refreshRateHz)
+{
+	frameSlots.assign(frameSlotCount, FrameSlot());
+	refreshPeriodMs = refreshRateHz > 0.0 ? 1000.0 / refreshRateHz : 1000.0 / 60.0;
+
+	frameTimes.clear();
+	latencies.clear();
+	frameTimeHead = 0;
+	latencyHead = 0;
+	firstFrame = true;
+}
+
+void FramePacer::setPresentMode(PresentMode mode)
+{
+	requestedMode = mode;
+}
+
+PresentMode FramePacer::getPresentMode() const
+{
+	return requestedMode;
+}
+
+const char* FramePacer::getPresentModeName(PresentMode mode)
+{
+	switch (mode)
+	{
+	case PRESENT_MODE_IMMEDIATE:		return "immediate";
+	case PRESENT_MODE_MAILBOX:			return "mailbox";
+	case PRESENT_MODE_FIFO:				return "fifo";
+	case PRESENT_MODE_FIFO_RELAXED:		return "fifo-relaxed";
+	default:							return "unknown";
+	}
+}
+
+VkPresentModeKHR FramePacer::choosePresentMode(const std::vector<VkPresentModeKHR>& presentationModes)
+{
+	// Fallbacks keep the intent: unthrottled modes fall back to each other, vsync modes to FIFO
+	std::vector<VkPresentModeKHR> preference;
+	switch (requestedMode)
+	{
+	case PRESENT_MODE_IMMEDIATE:		preference = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR }; break;
+	case PRESENT_MODE_MAILBOX:			preference = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR }; break;
+	case PRESENT_MODE_FIFO_RELAXED:		preference = { VK_PRESENT_MODE_FIFO_RELAXED_KHR }; break;
+	default:							break;
+	}
+
+	// FIFO is guaranteed to be supported
+	activeMode = VK_PRESENT_MODE_FIFO_KHR;
+	for (VkPresentModeKHR mode : preference)
+	{
+		if (std::find(presentationModes.begin(), presentationModes.end(), mode) != presentationModes.end())
+		{
+			activeMode = mode;
+			break;
+		}
+	}
+
+	const char* activeName =
+		activeMode == VK_PRESENT_MODE_IMMEDIATE_KHR ? "immediate" :
+		activeMode == VK_PRESENT_MODE_MAILBOX_KHR ? "mailbox" :
+		activeMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR ? "fifo-relaxed" : "fifo";
+	printf("Present mode: %s (requested %s)\n", activeName, getPresentModeName(requestedMode));
+
+	return activeMode;
+}
+
+void FramePacer::setFrameLimit(double framesPerSecond)
+{
+	frameLimitMs = framesPerSecond > 0.0 ? 1000.0 / framesPerSecond : 0.0;
+	nextDeadline = Clock::now();
+}
+
+void FramePacer::beginFrame()
+{
+	// -- FRAME LIMITER --
+	if (frameLimitMs > 0.0)
+	{
+		Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(frameLimitMs));
+		Clock::time_point now = Clock::now();
+
+		// After a long hitch start over, instead of rendering a burst of frames to catch up
+		if (now > nextDeadline + interval)
+		{
+			nextDeadline = now;
+		}
+
+		sleepUntil(nextDeadline);
+		nextDeadline += interval;
+	}
+
+	// -- FRAME TIME --
+	Clock::time_point now = Clock::now();
+	if (!firstFrame)
+	{
+		double frameTimeMs = toMs(now - lastFrameStart);
+		if (frameTimes.size() < FRAME_PACER_HISTORY)
+		{
+			frameTimes.push_back(frameTimeMs);
+		}
+		else
+		{
+			frameTimes[frameTimeHead] = frameTimeMs;
+		}
+		frameTimeHead = (frameTimeHead + 1) % FRAME_PACER_HISTORY;
+	}
+	firstFrame = false;
+	lastFrameStart = now;
+
+	// The input is polled right after this call
+	inputTime = now;
+}
+
+void FramePacer::waitForFence(VkDevice device, VkFence fence, uint32_t frameSlot)
+{
+	if (vkGetFenceStatus(device, fence) == VK_SUCCESS)
+	{
+		frameCompleted(frameSlot, Clock::now());
+		return;
+	}
+
+	// GPU bound (or throttled by vsync): sleep through most of the wait we expect, in slices that
+	// check the fence, so a GPU that got faster ends the sleep early
+	Clock::time_point waitStart = Clock::now();
+	Clock::time_point sleepEnd = waitStart + std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double, std::milli>(expectedFenceWaitMs * FENCE_SLEEP_SHARE));
+	Clock::duration maxSleep = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(MAX_FENCE_SLEEP_MS));
+	bool signalledWhileSleeping = false;
+	for (Clock::time_point now = waitStart; sleepEnd - now > std::chrono::milliseconds(1); now = Clock::now())
+	{
+		preciseSleep(std::min(sleepEnd - now, maxSleep));
+		if (vkGetFenceStatus(device, fence) == VK_SUCCESS)
+		{
+			signalledWhileSleeping = true;
+			break;
+		}
+	}
+
+	if (signalledWhileSleeping)
+	{
+		// The wait was shorter than the estimate, by an unknown amount. The estimate isn't fed its
+		// own sleep, it halves, and the next frames measure the real wait again
+		Clock::time_point waitEnd = Clock::now();
+		expectedFenceWaitMs *= 0.5;
+		frameCompleted(frameSlot, waitEnd);
+		return;
+	}
+
+	vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+	// The fence was still unsignalled when the sleep ended, so the whole span was a real wait on the GPU
+	Clock::time_point waitEnd = Clock::now();
+	expectedFenceWaitMs = expectedFenceWaitMs * 0.9 + toMs(waitEnd - waitStart) * 0.1;
+	frameCompleted(frameSlot, waitEnd);
+}
+
+void FramePacer::pollFence(VkDevice device, VkFence fence, uint32_t frameSlot)
+{
+	if (frameSlot < frameSlots.size() && frameSlots[frameSlot].pending && vkGetFenceStatus(device, fence) == VK_SUCCESS)
+	{
+		frameCompleted(frameSlot, Clock::now());
+	}
+}
+
+void FramePacer::frameSubmitted(uint32_t frameSlot)
+{
+	if (frameSlot < frameSlots.size())
+	{
+		frameSlots[frameSlot].pending = true;
+		frameSlots[frameSlot].inputTime = inputTime;
+	}
+}
+
+void FramePacer::frameCompleted(uint32_t frameSlot, Clock::time_point completionTime)
+{
+	if (frameSlot >= frameSlots.size() || !frameSlots[frameSlot].pending)
+	{
+		return;
+	}
+	frameSlots[frameSlot].pending = false;
+
+	// Vsync modes wait for the next vblank (half a refresh on average), then half a refresh of scan out
+	double displayDelayMs = refreshPeriodMs * 0.5;
+	if (activeMode != VK_PRESENT_MODE_IMMEDIATE_KHR)
+	{
+		displayDelayMs += refreshPeriodMs * 0.5;
+	}
+
+	double latencyMs = toMs(completionTime - frameSlots[frameSlot].inputTime) + displayDelayMs;
+	if (latencies.size() < FRAME_PACER_HISTORY)
+	{
+		latencies.push_back(latencyMs);
+	}
+	else
+	{
+		latencies[latencyHead] = latencyMs;
+	}
+	latencyHead = (latencyHead + 1) % FRAME_PACER_HISTORY;
+}
+
+FrameTimeStats FramePacer::getStats() const
+{
+	FrameTimeStats stats;
+
+	if (!frameTimes.empty())
+	{
+		std::vector<double> sorted = frameTimes;
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum = 0.0;
+		for (double frameTime : sorted) sum += frameTime;
+
+		stats.sampleCount = static_cast<uint32_t>(sorted.size());
+		stats.averageMs = sum / sorted.size();
+		stats.minMs = sorted.front();
+		stats.maxMs = sorted.back();
+		stats.p50Ms = percentile(sorted, 0.50);
+		stats.p90Ms = percentile(sorted, 0.90);
+		stats.p99Ms = percentile(sorted, 0.99);
+		stats.averageFps = stats.averageMs > 0.0 ? 1000.0 / stats.averageMs : 0.0;
+
+		double variance = 0.0;
+		for (double frameTime : sorted) variance += (frameTime - stats.averageMs) * (frameTime - stats.averageMs);
+		stats.stdDevMs = std::sqrt(variance / sorted.size());
+	}
+
+	if (!latencies.empty())
+	{
+		std::vector<double> sorted = latencies;
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum = 0.0;
+		for (double latency : sorted) sum += latency;
+
+		stats.latencySampleCount = static_cast<uint32_t>(sorted.size());
+		stats.latencyAverageMs = sum / sorted.size();
+		stats.latencyP99Ms = percentile(sorted, 0.99);
+	}
+
+	return stats;
+}
+
+void FramePacer::printStats() const
+{
+	FrameTimeStats stats = getStats();
+
+	printf("---- Frame pacing (%s, limit %s) ----\n", getPresentModeName(requestedMode),
+		frameLimitMs > 0.0 ? "on" : "off");
+	printf("Frame time over %u frames: avg %.2f ms (%.1f fps), min %.2f, p50 %.2f, p90 %.2f, p99 %.2f, max %.2f, stddev %.2f\n",
+		stats.sampleCount, stats.averageMs, stats.averageFps, stats.minMs, stats.p50Ms, stats.p90Ms, stats.p99Ms, stats.maxMs, stats.stdDevMs);
+	printf("Estimated input to photon latency: avg %.2f ms, p99 %.2f ms\n", stats.latencyAverageMs, stats.latencyP99Ms);
+}
+
+void FramePacer::sleepUntil(Clock::time_point deadline)
+{
+	// Sleep most of the way, yield the last bit so the deadline isn't overshot by the scheduler
+	Clock::time_point now = Clock::now();
+	if (deadline - now > SLEEP_SLACK)
+	{
+		preciseSleep(deadline - now - SLEEP_SLACK);
+	}
+
+	while (Clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+}
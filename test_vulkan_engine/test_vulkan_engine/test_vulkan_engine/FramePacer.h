@@ -0,0 +1,149 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+const uint32_t FRAME_PACER_HISTORY = 1024;		// Frame time and latency samples kept
+
+// Pacing modes, in the order they are cycled through
+enum PresentMode
+{
+	PRESENT_MODE_IMMEDIATE,			///< Unthrottled, tears. For benchmarking and lowest latency.
+	PRESENT_MODE_MAILBOX,			///< Unthrottled rendering, newest frame shown at vblank.
+	PRESENT_MODE_FIFO,				///< Vsync, lowest power.
+	PRESENT_MODE_FIFO_RELAXED,		///< Vsync, tears instead of stuttering when a frame is late.
+	PRESENT_MODE_COUNT
+};
+
+/**
+ * @struct FrameTimeStats
+ * @brief Distribution of the recent frame times and latency estimates.
+ */
+struct FrameTimeStats
+{
+	uint32_t sampleCount = 0;
+	double averageMs = 0.0;
+	double minMs = 0.0;
+	double maxMs = 0.0;
+	double p50Ms = 0.0;
+	double p90Ms = 0.0;
+	double p99Ms = 0.0;
+	double stdDevMs = 0.0;
+	double averageFps = 0.0;
+
+	uint32_t latencySampleCount = 0;
+	double latencyAverageMs = 0.0;		///< Estimated input to photon latency.
+	double latencyP99Ms = 0.0;
+};
+
+/**
+ * @class FramePacer
+ * @brief Present mode selection, frame limiting and frame time / latency measurement.
+ *
+ * Input to photon latency is estimated, Vulkan 1.0 can't tell when an image reached the screen:
+ * it is the time from sampling the input to the frame's fence signalling, plus the expected wait
+ * for the next vblank (not in immediate mode) and half a refresh for the scan out.
+ */
+class FramePacer
+{
+public:
+	FramePacer();
+
+	/**
+	 * @brief Sizes the per frame tracking.
+	 *
+	 * @param frameSlotCount Number of frame contexts.
+	 * @param refreshRateHz Refresh rate of the display, used by the latency estimate.
+	 */
+	void create(uint32_t frameSlotCount, double refreshRateHz);
+
+	// Requested mode, applied by the next swapchain (re)creation
+	void setPresentMode(PresentMode mode);
+	PresentMode getPresentMode() const;
+	static const char* getPresentModeName(PresentMode mode);
+
+	/**
+	 * @brief Picks the requested mode, or the closest supported one.
+	 *
+	 * @param presentationModes Modes supported by the surface (FIFO is always there).
+	 * @return The mode to create the swapchain with.
+	 */
+	VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& presentationModes);
+
+	/**
+	 * @brief Caps the frame rate, 0 turns the limiter off.
+	 */
+	void setFrameLimit(double framesPerSecond);
+
+	/**
+	 * @brief Call at the top of the main loop, before the input is polled.
+	 *
+	 * Sleeps until the frame limiter's next deadline, records the frame time and the time the
+	 * input of this frame is sampled.
+	 */
+	void beginFrame();
+
+	/**
+	 * @brief Waits for a frame context's fence, sleeping instead of spinning.
+	 *
+	 * Most of the expected wait is slept away, only the rest is left to vkWaitForFences
+	 * which busy waits on some drivers.
+	 *
+	 * @param device The logical device.
+	 * @param fence The frame context's fence.
+	 * @param frameSlot Index of the frame context.
+	 */
+	void waitForFence(VkDevice device, VkFence fence, uint32_t frameSlot);
+
+	/**
+	 * @brief Checks without blocking whether a frame context finished, for a tighter latency estimate.
+	 */
+	void pollFence(VkDevice device, VkFence fence, uint32_t frameSlot);
+
+	/**
+	 * @brief Records that the frame of the last beginFrame was submitted with this context.
+	 */
+	void frameSubmitted(uint32_t frameSlot);
+
+	FrameTimeStats getStats() const;
+
+	void printStats() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct FrameSlot
+	{
+		bool pending = false;
+		Clock::time_point inputTime;
+	};
+
+	PresentMode requestedMode = PRESENT_MODE_MAILBOX;
+	VkPresentModeKHR activeMode = VK_PRESENT_MODE_FIFO_KHR;
+	double refreshPeriodMs = 1000.0 / 60.0;
+
+	double frameLimitMs = 0.0;
+	Clock::time_point nextDeadline;
+
+	Clock::time_point lastFrameStart;
+	Clock::time_point inputTime;
+	bool firstFrame = true;
+
+	double expectedFenceWaitMs = 0.0;		// Moving average of the blocking fence waits
+
+	std::vector<FrameSlot> frameSlots;
+
+	// Ring buffers of the last FRAME_PACER_HISTORY samples
+	std::vector<double> frameTimes;
+	std::vector<double> latencies;
+	uint32_t frameTimeHead = 0;
+	uint32_t latencyHead = 0;
+
+	void frameCompleted(uint32_t frameSlot, Clock::time_point completionTime);
+
+	static void sleepUntil(Clock::time_point deadline);
+};
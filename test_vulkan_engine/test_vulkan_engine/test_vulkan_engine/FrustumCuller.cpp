@@ -0,0 +1,242 @@
+#include "FrustumCuller.h"
+
+#include <cfloat>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CULL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits AVX intrinsics without /arch, GCC and Clang need the target per function
+#if defined(CULL_X86) && !defined(_MSC_VER)
+#define CULL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CULL_TARGET_AVX2
+#endif
+
+namespace
+{
+	// Radius of the padding spheres, never passes a plane test
+	const float PADDING_RADIUS = -FLT_MAX;
+
+	uint32_t countTrailingZeros(uint32_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	// Appends the entities of the set bits of a visibility mask
+	void emitVisible(uint32_t mask, size_t base, const Entity* entities, std::vector<Entity>& outEntities)
+	{
+		while (mask != 0)
+		{
+			outEntities.push_back(entities[base + countTrailingZeros(mask)]);
+			mask &= mask - 1;
+		}
+	}
+
+	CullPath detectPath()
+	{
+#if defined(CULL_X86)
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] >= 7)
+		{
+			__cpuid(info, 1);
+			bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+			bool hasAvx = (info[2] & (1 << 28)) != 0;
+
+			__cpuidex(info, 7, 0);
+			bool hasAvx2 = (info[1] & (1 << 5)) != 0;
+
+			if (osSavesYmm && hasAvx && hasAvx2) return CULL_PATH_AVX2;
+		}
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return CULL_PATH_AVX2;
+#endif
+		// SSE2 is part of every x86-64 CPU
+		return CULL_PATH_SSE;
+#else
+		return CULL_PATH_SCALAR;
+#endif
+	}
+}
+
+FrustumCuller::FrustumCuller()
+{
+}
+
+void FrustumCuller::clear()
+{
+	sphereCount = 0;
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+	entities.clear();
+}
+
+void FrustumCuller::addSphere(Entity entity, const glm::vec3& center, float sphereRadius)
+{
+	// Start a new padded batch when the last one is full
+	if (sphereCount % CULL_BATCH_SIZE == 0)
+	{
+		centerX.resize(centerX.size() + CULL_BATCH_SIZE, 0.0f);
+		centerY.resize(centerY.size() + CULL_BATCH_SIZE, 0.0f);
+		centerZ.resize(centerZ.size() + CULL_BATCH_SIZE, 0.0f);
+		radius.resize(radius.size() + CULL_BATCH_SIZE, PADDING_RADIUS);
+		entities.resize(entities.size() + CULL_BATCH_SIZE, INVALID_ENTITY);
+	}
+
+	centerX[sphereCount] = center.x;
+	centerY[sphereCount] = center.y;
+	centerZ[sphereCount] = center.z;
+	radius[sphereCount] = sphereRadius;
+	entities[sphereCount] = entity;
+	sphereCount++;
+}
+
+void FrustumCuller::addBounds(Entity entity, const AABB& bounds)
+{
+	if (!bounds.isValid())
+	{
+		return;
+	}
+
+	addSphere(entity, bounds.getCenter(), glm::length(bounds.getExtent()));
+}
+
+void FrustumCuller::cull(const Frustum& frustum, std::vector<Entity>& outEntities) const
+{
+	switch (getPath())
+	{
+	case CULL_PATH_AVX2:	cullAVX2(frustum, outEntities); break;
+	case CULL_PATH_SSE:		cullSSE(frustum, outEntities); break;
+	default:				cullScalar(frustum, outEntities); break;
+	}
+}
+
+void FrustumCuller::cullScalar(const Frustum& frustum, std::vector<Entity>& outEntities) const
+{
+	outEntities.clear();
+
+	for (size_t i = 0; i < sphereCount; i++)
+	{
+		bool visible = true;
+		for (int p = 0; p < 6 && visible; p++)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = (plane.x * centerX[i] + plane.y * centerY[i]) + (plane.z * centerZ[i] + plane.w);
+			visible = distance >= -radius[i];
+		}
+
+		if (visible)
+		{
+			outEntities.push_back(entities[i]);
+		}
+	}
+}
+
+void FrustumCuller::cullSSE(const Frustum& frustum, std::vector<Entity>& outEntities) const
+{
+#if defined(CULL_X86)
+	outEntities.clear();
+
+	// Broadcast every plane component once
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	// The arrays are padded to 8, so whole groups of 4 can always be read
+	for (size_t i = 0; i < sphereCount; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&centerX[i]);
+		__m128 y = _mm_loadu_ps(&centerY[i]);
+		__m128 z = _mm_loadu_ps(&centerZ[i]);
+		__m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&radius[i]), signMask);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		emitVisible(static_cast<uint32_t>(_mm_movemask_ps(inside)), i, entities.data(), outEntities);
+	}
+#else
+	cullScalar(frustum, outEntities);
+#endif
+}
+
+CULL_TARGET_AVX2
+void FrustumCuller::cullAVX2(const Frustum& frustum, std::vector<Entity>& outEntities) const
+{
+#if defined(CULL_X86)
+	outEntities.clear();
+
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	for (size_t i = 0; i < sphereCount; i += CULL_BATCH_SIZE)
+	{
+		__m256 x = _mm256_loadu_ps(&centerX[i]);
+		__m256 y = _mm256_loadu_ps(&centerY[i]);
+		__m256 z = _mm256_loadu_ps(&centerZ[i]);
+		__m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(&radius[i]), signMask);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+
+		emitVisible(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, entities.data(), outEntities);
+	}
+#else
+	cullScalar(frustum, outEntities);
+#endif
+}
+
+size_t FrustumCuller::getSphereCount() const
+{
+	return sphereCount;
+}
+
+CullPath FrustumCuller::getPath()
+{
+	static const CullPath path = detectPath();
+	return path;
+}
+
+FrustumCuller::~FrustumCuller()
+{
+}
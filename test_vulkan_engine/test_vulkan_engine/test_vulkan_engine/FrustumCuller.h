@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Components.h"
+
+const uint32_t CULL_BATCH_SIZE = 8;		// Spheres tested by one AVX2 instruction, the arrays are padded to it
+
+// Instruction set used by FrustumCuller::cull
+enum CullPath
+{
+	CULL_PATH_SCALAR,
+	CULL_PATH_SSE,
+	CULL_PATH_AVX2
+};
+
+/**
+ * @class FrustumCuller
+ * @brief Flat, SIMD friendly frustum culling of bounding spheres.
+ *
+ * The spheres are stored as separate center x/y/z and radius arrays (structure of arrays),
+ * so 4 (SSE) or 8 (AVX2) objects are tested against a frustum plane with a single instruction.
+ * The result is a compact list of the visible entities.
+ */
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	/**
+	 * @brief Removes every sphere (the memory is kept for the next frame).
+	 */
+	void clear();
+
+	/**
+	 * @brief Adds a bounding sphere.
+	 *
+	 * @param entity The entity the sphere belongs to.
+	 * @param center Center of the sphere in world space.
+	 * @param radius Radius of the sphere.
+	 */
+	void addSphere(Entity entity, const glm::vec3& center, float radius);
+
+	/**
+	 * @brief Adds the bounding sphere of a world space box.
+	 */
+	void addBounds(Entity entity, const AABB& bounds);
+
+	/**
+	 * @brief Collects the entities whose sphere is (at least partially) inside the frustum.
+	 *
+	 * Uses the widest instruction set supported by the CPU (see getPath).
+	 *
+	 * @param frustum The view frustum.
+	 * @param outEntities Receives the visible entities in insertion order (it is cleared first).
+	 */
+	void cull(const Frustum& frustum, std::vector<Entity>& outEntities) const;
+
+	// Variants of cull with a fixed instruction set (the SIMD ones need CPU support)
+	void cullScalar(const Frustum& frustum, std::vector<Entity>& outEntities) const;
+	void cullSSE(const Frustum& frustum, std::vector<Entity>& outEntities) const;
+	void cullAVX2(const Frustum& frustum, std::vector<Entity>& outEntities) const;
+
+	size_t getSphereCount() const;
+
+	/**
+	 * @brief Returns the instruction set picked for this CPU.
+	 */
+	static CullPath getPath();
+
+	~FrustumCuller();
+
+private:
+	size_t sphereCount = 0;
+
+	// Padded to CULL_BATCH_SIZE, padding spheres have a huge negative radius so they are never visible
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	std::vector<Entity> entities;
+};
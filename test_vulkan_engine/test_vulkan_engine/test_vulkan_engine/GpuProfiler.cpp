@@ -0,0 +1,435 @@
+#include "GpuProfiler.h"
+
+#include "Utilities.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	const VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+	const char* STATISTIC_NAMES[GPU_STAT_COUNT] = {
+		"IA vertices", "IA primitives", "VS invocations", "Clip invocations", "Clip primitives", "FS invocations"
+	};
+
+	const char* QUEUE_NAMES[GPU_PROFILER_QUEUE_COUNT] = { "GPU graphics", "GPU async compute" };
+
+	// Scope handles carry the queue, endScope finds the pool without being told
+	uint32_t makeScopeHandle(GpuProfilerQueue queue, uint32_t index)
+	{
+		return queue * GPU_PROFILER_MAX_SCOPES + index;
+	}
+}
+
+GpuProfiler::GpuProfiler()
+{
+}
+
+void GpuProfiler::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, uint32_t graphicsFamily, uint32_t computeFamily,
+	uint32_t frameSlotCount, bool enableStatistics)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	// Timestamps are only usable on a queue whose family writes valid bits
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t families[GPU_PROFILER_QUEUE_COUNT] = { graphicsFamily, computeFamily };
+	timestampMask = ~0ull;
+	for (uint32_t q = 0; q < GPU_PROFILER_QUEUE_COUNT; q++)
+	{
+		uint32_t validBits = families[q] < queueFamilyCount ? queueFamilies[families[q]].timestampValidBits : 0;
+		queueSupported[q] = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+		if (queueSupported[q])
+		{
+			timestampMask &= validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+		}
+	}
+
+	supported = queueSupported[GPU_PROFILER_QUEUE_GRAPHICS];
+	if (!supported)
+	{
+		printf("GPU profiler disabled: the graphics queue family doesn't support timestamps\n");
+		return;
+	}
+	if (!queueSupported[GPU_PROFILER_QUEUE_COMPUTE])
+	{
+		printf("GPU profiler: the compute queue family doesn't support timestamps, async compute passes aren't timed\n");
+	}
+
+	timestampPeriod = properties.limits.timestampPeriod;
+	statisticsEnabled = enableStatistics;
+
+	// Every slot gets its own pools, so a slot can be reset while the others are in flight
+	frameSlots.resize(frameSlotCount);
+	for (auto& slot : frameSlots)
+	{
+		for (uint32_t q = 0; q < GPU_PROFILER_QUEUE_COUNT; q++)
+		{
+			if (!queueSupported[q])
+			{
+				continue;
+			}
+
+			VkQueryPoolCreateInfo timestampPoolInfo = {};
+			timestampPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			timestampPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			timestampPoolInfo.queryCount = GPU_PROFILER_MAX_SCOPES * 2;		// Begin and end of every scope
+
+			VkResult result = vkCreateQueryPool(device, &timestampPoolInfo, nullptr, &slot.queues[q].timestampPool);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a timestamp Query Pool!");
+			}
+		}
+
+		if (statisticsEnabled)
+		{
+			VkQueryPoolCreateInfo statisticsPoolInfo = {};
+			statisticsPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			statisticsPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			statisticsPoolInfo.queryCount = GPU_PROFILER_MAX_SCOPES;
+			statisticsPoolInfo.pipelineStatistics = STATISTIC_FLAGS;
+
+			VkResult result = vkCreateQueryPool(device, &statisticsPoolInfo, nullptr, &slot.statisticsPool);
+			if (result != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a pipeline statistics Query Pool!");
+			}
+		}
+	}
+}
+
+void GpuProfiler::beginFrame(uint32_t frameSlot)
+{
+	if (!supported || frameSlot >= frameSlots.size())
+	{
+		return;
+	}
+
+	currentSlot = frameSlot;
+	statisticsActive = false;
+	FrameSlot& slot = frameSlots[frameSlot];
+
+	// The slot's previous submission is finished by now, pick up its results
+	if (slot.recorded)
+	{
+		resolveSlot(slot);
+	}
+
+	for (uint32_t q = 0; q < GPU_PROFILER_QUEUE_COUNT; q++)
+	{
+		slot.queues[q].scopes.clear();
+		slot.queues[q].reset = false;
+		currentDepth[q] = 0;
+	}
+	slot.statisticsCount = 0;
+	slot.recorded = true;
+}
+
+void GpuProfiler::beginQueue(VkCommandBuffer commandBuffer, GpuProfilerQueue queue)
+{
+	if (!supported || !queueSupported[queue] || frameSlots.empty())
+	{
+		return;
+	}
+
+	// Resetting on the queue that writes the queries orders the reset before them without a semaphore
+	FrameSlot& slot = frameSlots[currentSlot];
+	vkCmdResetQueryPool(commandBuffer, slot.queues[queue].timestampPool, 0, GPU_PROFILER_MAX_SCOPES * 2);
+	if (statisticsEnabled && queue == GPU_PROFILER_QUEUE_GRAPHICS)
+	{
+		vkCmdResetQueryPool(commandBuffer, slot.statisticsPool, 0, GPU_PROFILER_MAX_SCOPES);
+	}
+	slot.queues[queue].reset = true;
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name, bool collectStatistics, GpuProfilerQueue queue)
+{
+	if (!supported || frameSlots.empty())
+	{
+		return GPU_PROFILER_INVALID_SCOPE;
+	}
+
+	FrameSlot& slot = frameSlots[currentSlot];
+	QueueQueries& queries = slot.queues[queue];
+	if (!queries.reset || queries.scopes.size() >= GPU_PROFILER_MAX_SCOPES)
+	{
+		return GPU_PROFILER_INVALID_SCOPE;
+	}
+
+	uint32_t index = static_cast<uint32_t>(queries.scopes.size());
+
+	PendingScope pending;
+	pending.name = name;
+	pending.depth = currentDepth[queue]++;
+	pending.statisticsQuery = GPU_PROFILER_INVALID_SCOPE;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries.timestampPool, index * 2);
+
+	// Only one statistics query can be active at a time, nested requests are ignored.
+	// The counters are graphics pipeline stages, a compute queue can't collect them.
+	if (collectStatistics && statisticsEnabled && !statisticsActive && queue == GPU_PROFILER_QUEUE_GRAPHICS)
+	{
+		statisticsActive = true;
+		pending.statisticsQuery = slot.statisticsCount++;
+		vkCmdBeginQuery(commandBuffer, slot.statisticsPool, pending.statisticsQuery, 0);
+	}
+
+	queries.scopes.push_back(pending);
+	return makeScopeHandle(queue, index);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	if (!supported || frameSlots.empty() || scope >= GPU_PROFILER_QUEUE_COUNT * GPU_PROFILER_MAX_SCOPES)
+	{
+		return;
+	}
+
+	GpuProfilerQueue queue = static_cast<GpuProfilerQueue>(scope / GPU_PROFILER_MAX_SCOPES);
+	uint32_t index = scope % GPU_PROFILER_MAX_SCOPES;
+
+	FrameSlot& slot = frameSlots[currentSlot];
+	QueueQueries& queries = slot.queues[queue];
+	if (index >= queries.scopes.size())
+	{
+		return;
+	}
+
+	if (queries.scopes[index].statisticsQuery != GPU_PROFILER_INVALID_SCOPE)
+	{
+		vkCmdEndQuery(commandBuffer, slot.statisticsPool, queries.scopes[index].statisticsQuery);
+		statisticsActive = false;
+	}
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries.timestampPool, index * 2 + 1);
+
+	if (currentDepth[queue] > 0)
+	{
+		currentDepth[queue]--;
+	}
+}
+
+const std::vector<GpuScopeResult>& GpuProfiler::getResults() const
+{
+	return results;
+}
+
+double GpuProfiler::getFrameTimeMs() const
+{
+	return frameTimeMs;
+}
+
+bool GpuProfiler::isSupported() const
+{
+	return supported;
+}
+
+bool GpuProfiler::exportChromeTrace(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	// One track per queue, overlapping async compute shows next to the graphics work
+	file << "{\"traceEvents\":[\n";
+	for (uint32_t q = 0; q < GPU_PROFILER_QUEUE_COUNT; q++)
+	{
+		file << (q > 0 ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << q
+			<< ",\"args\":{\"name\":\"" << QUEUE_NAMES[q] << "\"}}";
+	}
+
+	// Complete events ("X"), the viewer nests them by time
+	for (const auto& frame : traceFrames)
+	{
+		for (const auto& event : frame)
+		{
+			file << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.queue
+				<< ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs << "}";
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
+
+void GpuProfiler::printResults() const
+{
+	printf("GPU frame: %.3f ms\n", frameTimeMs);
+	bool computeHeader = false;
+	for (const auto& result : results)
+	{
+		// The graphics scopes come first, then the ones that ran on the async compute queue
+		if (result.queue == GPU_PROFILER_QUEUE_COMPUTE && !computeHeader)
+		{
+			printf("Async compute:\n");
+			computeHeader = true;
+		}
+
+		printf("%*s%-24s %8.3f ms\n", static_cast<int>(result.depth * 2), "", result.name.c_str(), result.durationMs);
+		if (result.hasStatistics)
+		{
+			for (int i = 0; i < GPU_STAT_COUNT; i++)
+			{
+				printf("%*s    %-18s %llu\n", static_cast<int>(result.depth * 2), "", STATISTIC_NAMES[i], static_cast<unsigned long long>(result.statistics[i]));
+			}
+		}
+	}
+}
+
+void GpuProfiler::destroy()
+{
+	for (auto& slot : frameSlots)
+	{
+		for (auto& queries : slot.queues)
+		{
+			if (queries.timestampPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, queries.timestampPool, nullptr);
+		}
+		if (slot.statisticsPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, slot.statisticsPool, nullptr);
+	}
+
+	frameSlots.clear();
+	results.clear();
+	traceFrames.clear();
+	supported = false;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+}
+
+void GpuProfiler::resolveSlot(FrameSlot& slot)
+{
+	// Without the WAIT flag this never blocks, unfinished queries give VK_NOT_READY and the frame is skipped
+	std::vector<uint64_t> timestamps[GPU_PROFILER_QUEUE_COUNT];
+	bool hasScopes = false;
+	for (uint32_t q = 0; q < GPU_PROFILER_QUEUE_COUNT; q++)
+	{
+		const QueueQueries& queries = slot.queues[q];
+		if (queries.scopes.empty())
+		{
+			continue;
+		}
+
+		uint32_t timestampCount = static_cast<uint32_t>(queries.scopes.size()) * 2;
+		timestamps[q].resize(timestampCount);
+		VkResult result = vkGetQueryPoolResults(device, queries.timestampPool, 0, timestampCount,
+			timestamps[q].size() * sizeof(uint64_t), timestamps[q].data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS)
+		{
+			return;
+		}
+		hasScopes = true;
+	}
+
+	if (!hasScopes)
+	{
+		return;
+	}
+
+	std::vector<uint64_t> statistics(slot.statisticsCount * GPU_STAT_COUNT);
+	bool hasStatistics = false;
+	if (slot.statisticsCount > 0)
+	{
+		VkResult result = vkGetQueryPoolResults(device, slot.statisticsPool, 0, slot.statisticsCount,
+			statistics.size() * sizeof(uint64_t), statistics.data(), GPU_STAT_COUNT * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		hasStatistics = result == VK_SUCCESS;
+	}
+
+	// Ticks to milliseconds
+	double tickMs = timestampPeriod / 1000000.0;
+
+	// The frame starts with the earliest first scope of the two queues (the compute queue may start first).
+	// A difference below half the range is taken as "later", which keeps the comparison correct across a wrap.
+	bool frameStartSet = false;
+	uint64_t frameStart = 0;
+	for (uint32_t q = 0; q < GPU_PROFILER_QUEUE_COUNT; q++)
+	{
+		if (timestamps[q].empty())
+		{
+			continue;
+		}
+
+		uint64_t first = timestamps[q][0] & timestampMask;
+		if (!frameStartSet || ((frameStart - first) & timestampMask) < timestampMask / 2)
+		{
+			frameStart = first;
+			frameStartSet = true;
+		}
+	}
+
+	if (!traceOriginSet)
+	{
+		traceOriginTicks = frameStart;
+		traceOriginSet = true;
+	}
+
+	results.clear();
+	std::vector<TraceEvent> traceEvents;
+	for (uint32_t q = 0; q < GPU_PROFILER_QUEUE_COUNT; q++)
+	{
+		const QueueQueries& queries = slot.queues[q];
+		for (size_t i = 0; i < timestamps[q].size() / 2; i++)
+		{
+			const PendingScope& pending = queries.scopes[i];
+			uint64_t begin = timestamps[q][i * 2] & timestampMask;
+			uint64_t end = timestamps[q][i * 2 + 1] & timestampMask;
+
+			GpuScopeResult scopeResult;
+			scopeResult.name = pending.name;
+			scopeResult.queue = static_cast<GpuProfilerQueue>(q);
+			scopeResult.depth = pending.depth;
+			scopeResult.startMs = ((begin - frameStart) & timestampMask) * tickMs;
+			scopeResult.durationMs = ((end - begin) & timestampMask) * tickMs;
+
+			if (hasStatistics && pending.statisticsQuery != GPU_PROFILER_INVALID_SCOPE)
+			{
+				scopeResult.hasStatistics = true;
+				for (int s = 0; s < GPU_STAT_COUNT; s++)
+				{
+					scopeResult.statistics[s] = statistics[pending.statisticsQuery * GPU_STAT_COUNT + s];
+				}
+			}
+
+			TraceEvent event;
+			event.name = pending.name;
+			event.queue = scopeResult.queue;
+			event.depth = pending.depth;
+			event.startUs = ((begin - traceOriginTicks) & timestampMask) * tickMs * 1000.0;
+			event.durationUs = scopeResult.durationMs * 1000.0;
+			traceEvents.push_back(event);
+
+			results.push_back(scopeResult);
+		}
+	}
+
+	// The outermost graphics scopes cover the whole frame, the last graphics submission waits for the compute work
+	frameTimeMs = 0.0;
+	for (const auto& scopeResult : results)
+	{
+		if (scopeResult.queue == GPU_PROFILER_QUEUE_GRAPHICS && scopeResult.depth == 0) frameTimeMs += scopeResult.durationMs;
+	}
+
+	traceFrames.push_back(traceEvents);
+	if (traceFrames.size() > GPU_PROFILER_TRACE_FRAMES)
+	{
+		traceFrames.pop_front();
+	}
+}
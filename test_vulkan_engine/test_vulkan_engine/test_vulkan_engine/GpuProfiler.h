@@ -0,0 +1,201 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdint>
+
+const uint32_t GPU_PROFILER_MAX_SCOPES = 64;				// Scopes per frame and queue
+const uint32_t GPU_PROFILER_TRACE_FRAMES = 600;				// Frames kept for the trace export
+const uint32_t GPU_PROFILER_INVALID_SCOPE = 0xFFFFFFFF;
+
+// Queues the profiled command buffers are submitted to, each has its own timestamp pools
+enum GpuProfilerQueue
+{
+	GPU_PROFILER_QUEUE_GRAPHICS,
+	GPU_PROFILER_QUEUE_COMPUTE,
+	GPU_PROFILER_QUEUE_COUNT
+};
+
+// Counters collected by the pipeline statistics queries (in VkQueryPipelineStatisticFlagBits order)
+enum GpuStatistic
+{
+	GPU_STAT_INPUT_VERTICES,
+	GPU_STAT_INPUT_PRIMITIVES,
+	GPU_STAT_VERTEX_INVOCATIONS,
+	GPU_STAT_CLIPPING_INVOCATIONS,
+	GPU_STAT_CLIPPING_PRIMITIVES,
+	GPU_STAT_FRAGMENT_INVOCATIONS,
+	GPU_STAT_COUNT
+};
+
+/**
+ * @struct GpuScopeResult
+ * @brief Measured GPU time (and optionally pipeline statistics) of one named scope.
+ */
+struct GpuScopeResult
+{
+	std::string name;							///< Name given to beginScope.
+	GpuProfilerQueue queue = GPU_PROFILER_QUEUE_GRAPHICS;	///< Queue the scope ran on.
+	uint32_t depth = 0;							///< Nesting level on its queue (0 = outermost).
+	double startMs = 0.0;						///< Start relative to the first scope of the frame, on any queue.
+	double durationMs = 0.0;					///< GPU time spent between begin and end.
+	bool hasStatistics = false;					///< True if the statistics below are valid.
+	uint64_t statistics[GPU_STAT_COUNT] = {};	///< Pipeline statistics (see GpuStatistic).
+};
+
+/**
+ * @class GpuProfiler
+ * @brief Measures GPU time of named scopes with timestamp and pipeline statistics queries.
+ *
+ * Every frame slot (one per command buffer) owns its own query pools. The results of a slot
+ * are read back when the slot is recorded again, after its previous submission finished,
+ * so reading them never stalls the CPU.
+ *
+ * The graphics and the async compute queue write into separate timestamp pools, each reset
+ * on its own queue, so passes on both queues are timed. Timestamps of one device share a
+ * clock, the scopes of both queues are placed on the same timeline.
+ */
+class GpuProfiler
+{
+public:
+	GpuProfiler();
+
+	/**
+	 * @brief Creates the query pools.
+	 *
+	 * A queue family without valid timestamp bits leaves its queue untimed. Without timestamps on the
+	 * graphics family the profiler is disabled.
+	 *
+	 * @param newPhysicalDevice The GPU, used to check timestamp support and the tick period.
+	 * @param newDevice The logical device.
+	 * @param graphicsFamily Queue family of the graphics queue.
+	 * @param computeFamily Queue family of the async compute queue (may be the graphics one).
+	 * @param frameSlotCount Number of command buffers recorded in rotation.
+	 * @param enableStatistics True if the pipelineStatisticsQuery feature was enabled on the device.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, uint32_t graphicsFamily, uint32_t computeFamily,
+		uint32_t frameSlotCount, bool enableStatistics);
+
+	/**
+	 * @brief Collects the results of the slot's previous use and starts a new frame in it.
+	 *
+	 * @param frameSlot Index of the slot (the command buffer index).
+	 */
+	void beginFrame(uint32_t frameSlot);
+
+	/**
+	 * @brief Resets the queries a queue uses in the current slot.
+	 *
+	 * Must be recorded on that queue, outside of a render pass, before its first scope of the frame.
+	 *
+	 * @param commandBuffer The command buffer being recorded, submitted to the queue.
+	 * @param queue The queue.
+	 */
+	void beginQueue(VkCommandBuffer commandBuffer, GpuProfilerQueue queue);
+
+	/**
+	 * @brief Writes the start timestamp of a named scope.
+	 *
+	 * Scopes can be nested. A scope with statistics can't be nested in another scope with statistics,
+	 * and has to start and end on the same side of a render pass boundary. Statistics are only collected
+	 * on the graphics queue.
+	 *
+	 * @param commandBuffer The command buffer being recorded.
+	 * @param name Name of the scope.
+	 * @param collectStatistics True to collect pipeline statistics as well.
+	 * @param queue Queue the command buffer is submitted to.
+	 * @return Handle passed to endScope.
+	 */
+	uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, bool collectStatistics = false,
+		GpuProfilerQueue queue = GPU_PROFILER_QUEUE_GRAPHICS);
+
+	/**
+	 * @brief Writes the end timestamp of a scope.
+	 */
+	void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+	// Latest resolved frame (a few frames behind the one being recorded)
+	const std::vector<GpuScopeResult>& getResults() const;
+	double getFrameTimeMs() const;
+
+	bool isSupported() const;
+
+	/**
+	 * @brief Writes the recorded frames as a Chrome trace (chrome://tracing, Perfetto).
+	 *
+	 * @param fileName Path of the JSON file.
+	 * @return True on success.
+	 */
+	bool exportChromeTrace(const std::string& fileName) const;
+
+	/**
+	 * @brief Prints the latest results to the console.
+	 */
+	void printResults() const;
+
+	void destroy();
+
+	~GpuProfiler();
+
+private:
+	// A scope recorded in a slot, waiting to be resolved
+	struct PendingScope
+	{
+		std::string name;
+		uint32_t depth;
+		uint32_t statisticsQuery;		// GPU_PROFILER_INVALID_SCOPE if none
+	};
+
+	// Timestamps written by one queue in a slot
+	struct QueueQueries
+	{
+		VkQueryPool timestampPool = VK_NULL_HANDLE;
+		std::vector<PendingScope> scopes;
+		bool reset = false;				// beginQueue recorded this frame
+	};
+
+	struct FrameSlot
+	{
+		QueueQueries queues[GPU_PROFILER_QUEUE_COUNT];
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+		uint32_t statisticsCount = 0;
+		bool recorded = false;
+	};
+
+	// One resolved scope of the trace history
+	struct TraceEvent
+	{
+		std::string name;
+		GpuProfilerQueue queue;
+		uint32_t depth;
+		double startUs;
+		double durationUs;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+
+	bool supported = false;
+	bool queueSupported[GPU_PROFILER_QUEUE_COUNT] = {};
+	bool statisticsEnabled = false;
+	float timestampPeriod = 1.0f;		// Nanoseconds per tick
+	uint64_t timestampMask = ~0ull;		// Bits valid on every timed queue
+
+	std::vector<FrameSlot> frameSlots;
+	uint32_t currentSlot = 0;
+	uint32_t currentDepth[GPU_PROFILER_QUEUE_COUNT] = {};
+	bool statisticsActive = false;
+
+	std::vector<GpuScopeResult> results;
+	double frameTimeMs = 0.0;
+
+	uint64_t traceOriginTicks = 0;
+	bool traceOriginSet = false;
+	std::deque<std::vector<TraceEvent>> traceFrames;
+
+	void resolveSlot(FrameSlot& slot);
+};
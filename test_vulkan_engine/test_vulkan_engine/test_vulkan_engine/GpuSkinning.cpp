@@ -0,0 +1,321 @@
+#include "GpuSkinning.h"
+
+#include "FrameContext.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t SKINNING_GROUP_SIZE = 64;				// local_size of skinning.comp
+	const VkDeviceSize INITIAL_OUTPUT_SIZE = 1024 * 1024;	// About 24k vertices, grows on demand
+
+	uint32_t groupCount(uint32_t size, uint32_t groupSize)
+	{
+		return (size + groupSize - 1) / groupSize;
+	}
+
+	VkDescriptorSetLayout createSetLayout(VkDevice device, uint32_t storageBufferCount)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(storageBufferCount);
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutCreateInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &layout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+		}
+
+		return layout;
+	}
+
+	VkWriteDescriptorSet bufferWrite(VkDescriptorSet set, uint32_t binding, const VkDescriptorBufferInfo* bufferInfo)
+	{
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo = bufferInfo;
+		return write;
+	}
+}
+
+GpuSkinning::GpuSkinning()
+{
+}
+
+RenderGraphResource GpuSkinning::addPass(RenderGraph& newGraph)
+{
+	graph = &newGraph;
+
+	// Owned here and rewritten every frame, the previous frame's draws read it until the pass starts
+	outputResource = graph->importBuffer("Skinned vertices", RENDER_GRAPH_ACCESS_VERTEX_BUFFER);
+	graph->exportResource(outputResource, RENDER_GRAPH_ACCESS_VERTEX_BUFFER);
+
+	graph->addPass("Skinning", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.write(outputResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { record(commandBuffer); });
+
+	return outputResource;
+}
+
+void GpuSkinning::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	// -- LAYOUTS --
+	frameSetLayout = createSetLayout(device, 2);
+	meshSetLayout = createSetLayout(device, 2);
+
+	std::array<VkDescriptorSetLayout, 2> setLayouts = { frameSetLayout, meshSetLayout };
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushSkinning);
+
+	VkPipelineLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	layoutCreateInfo.pSetLayouts = setLayouts.data();
+	layoutCreateInfo.pushConstantRangeCount = 1;
+	layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkResult result = vkCreatePipelineLayout(device, &layoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+
+	// -- MESH SETS --
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = MAX_SKINNED_MESHES * 2;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;		// Streamed models give theirs back
+	poolCreateInfo.maxSets = MAX_SKINNED_MESHES;
+	poolCreateInfo.poolSizeCount = 1;
+	poolCreateInfo.pPoolSizes = &poolSize;
+
+	result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &meshDescriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+
+	// Never empty, the graph's barriers need a buffer even when nothing is skinned
+	createOutputBuffer(INITIAL_OUTPUT_SIZE);
+}
+
+void GpuSkinning::createOutputBuffer(VkDeviceSize size)
+{
+	// Written by the compute shader, read as a vertex buffer by every pass drawing the scene
+	createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &outputBuffer, &outputMemory);
+	outputCapacity = size;
+}
+
+void GpuSkinning::destroyOutputBuffer()
+{
+	vkDestroyBuffer(device, outputBuffer, nullptr);
+	vkFreeMemory(device, outputMemory, nullptr);
+	outputBuffer = VK_NULL_HANDLE;
+	outputMemory = VK_NULL_HANDLE;
+	outputCapacity = 0;
+}
+
+void GpuSkinning::appendPipelineDescs(std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles)
+{
+	computeDescs.push_back({ "Skinning", "Shaders/skinningComp.spv", pipelineLayout });
+	computeHandles.push_back(&pipeline);
+}
+
+void GpuSkinning::prepareFrame(FrameContext& frame, EntityRegistry& registry, std::vector<MeshModel>& models,
+	const std::vector<Entity>& visibleEntities, const std::vector<glm::mat4>& palette)
+{
+	// -- LAYOUT --
+	// Only the visible entities are skinned, every mesh gets its own range of the output
+	dispatches.clear();
+	entityMeshes.clear();
+	meshOffsets.clear();
+	skinnedVertexCount = 0;
+	for (Entity entity : visibleEntities)
+	{
+		AnimationComponent* animation = registry.getComponent<AnimationComponent>(entity);
+		RenderMeshComponent* renderMesh = registry.getComponent<RenderMeshComponent>(entity);
+		if (animation == nullptr || renderMesh == nullptr || animation->paletteOffset == 0xFFFFFFFF)
+		{
+			continue;
+		}
+
+		MeshModel& model = models[renderMesh->modelIndex];
+		entityMeshes[entity] = meshOffsets.size();
+		for (size_t k = 0; k < model.getMeshCount(); k++)
+		{
+			Mesh* mesh = model.getMesh(k);
+			if (!mesh->isSkinned())
+			{
+				meshOffsets.push_back(VK_WHOLE_SIZE);
+				continue;
+			}
+
+			Dispatch dispatch;
+			dispatch.meshSet = getMeshSet(mesh);
+			dispatch.push.vertexCount = static_cast<uint32_t>(mesh->getVertexCount());
+			dispatch.push.outputOffset = skinnedVertexCount;
+			dispatch.push.paletteOffset = animation->paletteOffset;
+			dispatches.push_back(dispatch);
+
+			meshOffsets.push_back(static_cast<VkDeviceSize>(skinnedVertexCount) * sizeof(Vertex));
+			skinnedVertexCount += dispatch.push.vertexCount;
+		}
+	}
+
+	// -- OUTPUT --
+	// Earlier frames may still draw from the old buffer, growing it is as rare as a resize and waits like one
+	VkDeviceSize requiredSize = static_cast<VkDeviceSize>(skinnedVertexCount) * sizeof(Vertex);
+	if (requiredSize > outputCapacity)
+	{
+		vkDeviceWaitIdle(device);
+		VkDeviceSize newCapacity = std::max(requiredSize, outputCapacity * 2);
+		destroyOutputBuffer();
+		createOutputBuffer(newCapacity);
+		printf("Skinning: output buffer grown to %.1f MiB\n", newCapacity / (1024.0 * 1024.0));
+	}
+	graph->setImportedBuffer(outputResource, outputBuffer);
+
+	// -- JOINT MATRICES --
+	// Uploaded through the frame's ring, an identity stands in when nothing is posed
+	glm::mat4 identity(1.0f);
+	VkDescriptorBufferInfo paletteInfo = palette.empty() ? frame.uniforms.push(&identity, sizeof(glm::mat4))
+		: frame.uniforms.push(palette.data(), sizeof(glm::mat4) * palette.size());
+	VkDescriptorBufferInfo outputInfo = { outputBuffer, 0, VK_WHOLE_SIZE };
+
+	frameSet = frame.allocateDescriptorSet(frameSetLayout);
+	std::array<VkWriteDescriptorSet, 2> writes = {
+		bufferWrite(frameSet, 0, &paletteInfo),
+		bufferWrite(frameSet, 1, &outputInfo)
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+VkDescriptorSet GpuSkinning::getMeshSet(Mesh* mesh)
+{
+	auto found = meshSets.find(mesh->getVertexBuffer());
+	if (found != meshSets.end())
+	{
+		return found->second;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = meshDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &meshSetLayout;
+
+	VkDescriptorSet set;
+	if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate a skinning Descriptor Set, raise MAX_SKINNED_MESHES!");
+	}
+
+	VkDescriptorBufferInfo vertexInfo = { mesh->getVertexBuffer(), 0, VK_WHOLE_SIZE };
+	VkDescriptorBufferInfo influenceInfo = { mesh->getSkinBuffer(), 0, VK_WHOLE_SIZE };
+	std::array<VkWriteDescriptorSet, 2> writes = {
+		bufferWrite(set, 0, &vertexInfo),
+		bufferWrite(set, 1, &influenceInfo)
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	meshSets[mesh->getVertexBuffer()] = set;
+	return set;
+}
+
+bool GpuSkinning::getSkinnedVertices(Entity entity, uint32_t meshIndex, VkBuffer* outBuffer, VkDeviceSize* outOffset) const
+{
+	auto found = entityMeshes.find(entity);
+	if (found == entityMeshes.end() || meshOffsets[found->second + meshIndex] == VK_WHOLE_SIZE)
+	{
+		return false;
+	}
+
+	*outBuffer = outputBuffer;
+	*outOffset = meshOffsets[found->second + meshIndex];
+	return true;
+}
+
+void GpuSkinning::forgetMesh(Mesh* mesh)
+{
+	auto found = meshSets.find(mesh->getVertexBuffer());
+	if (found == meshSets.end())
+	{
+		return;
+	}
+
+	vkFreeDescriptorSets(device, meshDescriptorPool, 1, &found->second);
+	meshSets.erase(found);
+}
+
+void GpuSkinning::record(VkCommandBuffer commandBuffer)
+{
+	if (dispatches.empty())
+	{
+		return;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frameSet, 0, nullptr);
+
+	// The dispatches write disjoint ranges, no barriers between them
+	for (const Dispatch& dispatch : dispatches)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &dispatch.meshSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushSkinning), &dispatch.push);
+		vkCmdDispatch(commandBuffer, groupCount(dispatch.push.vertexCount, SKINNING_GROUP_SIZE), 1, 1);
+	}
+}
+
+void GpuSkinning::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyPipeline(device, pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, frameSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, meshSetLayout, nullptr);
+
+	// Frees the mesh sets with it
+	vkDestroyDescriptorPool(device, meshDescriptorPool, nullptr);
+	meshSets.clear();
+
+	destroyOutputBuffer();
+
+	device = VK_NULL_HANDLE;
+}
+
+GpuSkinning::~GpuSkinning()
+{
+}
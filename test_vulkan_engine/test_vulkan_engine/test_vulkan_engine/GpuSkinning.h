@@ -0,0 +1,146 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+
+#include "RenderGraph.h"
+#include "PipelineManager.h"
+#include "EntityRegistry.h"
+#include "MeshModel.h"
+
+class FrameContext;
+
+// Meshes whose bind pose and influences get a descriptor set, the sets are kept for the renderer's lifetime
+const uint32_t MAX_SKINNED_MESHES = 256;
+
+/**
+ * @class GpuSkinning
+ * @brief Skins the visible animated meshes in a compute pass, before anything draws them.
+ *
+ * Every skinned mesh of a posed entity is a dispatch reading the bind pose vertices, their
+ * influences and the entity's joint matrices, and writing the posed vertices (same layout as
+ * Vertex) into one shared buffer. The depth prepass, the scene pass and the G-buffer all draw
+ * from that buffer, so each mesh is skinned once per frame however many passes draw it. The
+ * buffer is imported into the render graph, which orders the dispatches before the vertex input.
+ */
+class GpuSkinning
+{
+public:
+	GpuSkinning();
+
+	/**
+	 * @brief Declares the skinning pass.
+	 *
+	 * @param newGraph Graph the pass is added to, before it is compiled.
+	 * @return The skinned vertices, to be read by the passes drawing the scene (VERTEX_BUFFER).
+	 */
+	RenderGraphResource addPass(RenderGraph& newGraph);
+
+	/**
+	 * @brief Creates the layouts, the descriptor pool of the meshes and the output buffer.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice);
+
+	/**
+	 * @brief Appends the compute pipeline and the member holding it, the caller creates it.
+	 */
+	void appendPipelineDescs(std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles);
+
+	/**
+	 * @brief Lays out the visible skinned meshes in the output buffer and uploads the joint matrices.
+	 *
+	 * The output buffer grows (after waiting for the device) if the meshes don't fit.
+	 *
+	 * @param frame The frame context being recorded.
+	 * @param registry The entity storage.
+	 * @param models The loaded models, indexed by RenderMeshComponent::modelIndex.
+	 * @param visibleEntities Entities drawn this frame.
+	 * @param palette Joint matrices written by the animation system this frame.
+	 * @throws std::runtime_error if the uniform ring, the mesh sets or the output buffer run out.
+	 */
+	void prepareFrame(FrameContext& frame, EntityRegistry& registry, std::vector<MeshModel>& models,
+		const std::vector<Entity>& visibleEntities, const std::vector<glm::mat4>& palette);
+
+	/**
+	 * @brief Where a mesh of an entity was skinned to this frame.
+	 *
+	 * @param entity The entity.
+	 * @param meshIndex Index of the mesh in the entity's model.
+	 * @param outBuffer Set to the skinned vertex buffer, unchanged if the mesh wasn't skinned.
+	 * @param outOffset Set to the first byte of the mesh's vertices.
+	 * @return True if the mesh was skinned this frame.
+	 */
+	bool getSkinnedVertices(Entity entity, uint32_t meshIndex, VkBuffer* outBuffer, VkDeviceSize* outOffset) const;
+
+	/**
+	 * @brief Frees the descriptor set of a mesh about to be destroyed, once no frame in flight uses it.
+	 *
+	 * A later buffer can get the same handle, the set would then point at the destroyed one.
+	 *
+	 * @param mesh The mesh, skinned or not.
+	 */
+	void forgetMesh(Mesh* mesh);
+
+	void destroy();
+
+	~GpuSkinning();
+
+private:
+	// Push constants, laid out as in skinning.comp
+	struct PushSkinning
+	{
+		uint32_t vertexCount;
+		uint32_t outputOffset;					// First vertex of the mesh in the output buffer
+		uint32_t paletteOffset;					// First joint matrix of the entity
+	};
+
+	struct Dispatch
+	{
+		VkDescriptorSet meshSet;
+		PushSkinning push;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	RenderGraph* graph = nullptr;
+	RenderGraphResource outputResource = RENDER_GRAPH_INVALID;
+
+	// -- OUTPUT --
+	VkBuffer outputBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory outputMemory = VK_NULL_HANDLE;
+	VkDeviceSize outputCapacity = 0;			// Bytes
+
+	// -- PIPELINE --
+	VkDescriptorSetLayout frameSetLayout = VK_NULL_HANDLE;		// Set 0: joint matrices, skinned vertices
+	VkDescriptorSetLayout meshSetLayout = VK_NULL_HANDLE;		// Set 1: bind pose vertices, influences
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	// The meshes' buffers never change, their sets are written once, keyed by the bind pose vertex buffer
+	VkDescriptorPool meshDescriptorPool = VK_NULL_HANDLE;
+	std::map<VkBuffer, VkDescriptorSet> meshSets;
+
+	// -- FRAME --
+	VkDescriptorSet frameSet = VK_NULL_HANDLE;
+	std::vector<Dispatch> dispatches;
+	std::unordered_map<Entity, size_t> entityMeshes;		// First entry of the entity in meshOffsets
+	std::vector<VkDeviceSize> meshOffsets;					// Per mesh of the skinned entities, VK_WHOLE_SIZE if not skinned
+	uint32_t skinnedVertexCount = 0;
+
+	void createOutputBuffer(VkDeviceSize size);
+	void destroyOutputBuffer();
+	VkDescriptorSet getMeshSet(Mesh* mesh);
+
+	void record(VkCommandBuffer commandBuffer);
+};
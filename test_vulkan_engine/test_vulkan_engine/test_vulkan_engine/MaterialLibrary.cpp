@@ -0,0 +1,328 @@
+#include "MaterialLibrary.h"
+
+#include "Utilities.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+std::string MaterialDesc::getKey() const
+{
+	char factors[256];
+	snprintf(factors, sizeof(factors), "%g %g %g %g|%g %g %g|%g %g %g",
+		baseColourFactor.r, baseColourFactor.g, baseColourFactor.b, baseColourFactor.a,
+		emissiveFactor.r, emissiveFactor.g, emissiveFactor.b,
+		metallic, roughness, normalScale);
+
+	std::string key = factors;
+	for (const auto& texture : textures)
+	{
+		key += "|" + texture;
+	}
+	if (virtualTexture)
+	{
+		key += "|virtual";
+	}
+	return key;
+}
+
+MaterialLibrary::MaterialLibrary()
+{
+}
+
+void MaterialLibrary::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkSampler newSampler)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	sampler = newSampler;
+
+	// -- SET LAYOUT --
+	// A texture per slot, then the parameter block, all read in the fragment shader
+	std::array<VkDescriptorSetLayoutBinding, MATERIAL_TEXTURE_SLOT_COUNT + 1> bindings = {};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i < MATERIAL_TEXTURE_SLOT_COUNT ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// -- DESCRIPTOR POOL --
+	// Sets are freed one by one when a streamed texture replaces them, room for the replaced ones in flight
+	const uint32_t maxSets = MAX_MATERIALS + MAX_RETIRED_MATERIAL_SETS;
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = maxSets * MATERIAL_TEXTURE_SLOT_COUNT;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = maxSets;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolCreateInfo.maxSets = maxSets;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+
+	// -- PARAMETER BUFFER --
+	// Every block starts at an offset a uniform buffer descriptor can point at
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	VkDeviceSize alignment = std::max<VkDeviceSize>(1, properties.limits.minUniformBufferOffsetAlignment);
+	paramsStride = (sizeof(MaterialParams) + alignment - 1) / alignment * alignment;
+
+	// Written once per material, read by every draw: device local, filled through a staging buffer
+	createBuffer(physicalDevice, device, paramsStride * MAX_MATERIALS,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&paramsBuffer, &paramsMemory);
+}
+
+void MaterialLibrary::setDefaultTexture(VkImageView view)
+{
+	defaultTexture = view;
+}
+
+uint32_t MaterialLibrary::acquire(const MaterialDesc& desc, VkQueue transferQueue, VkCommandPool transferCommandPool, const TextureLoader& loadTexture)
+{
+	// Already uploaded by this or another model
+	std::string key = desc.getKey();
+	auto cached = cache.find(key);
+	if (cached != cache.end())
+	{
+		return cached->second;
+	}
+
+	if (descriptorSets.size() >= MAX_MATERIALS)
+	{
+		throw std::runtime_error("Failed to add a Material, the library is full!");
+	}
+	uint32_t materialId = static_cast<uint32_t>(descriptorSets.size());
+
+	// -- TEXTURES --
+	// A missing file leaves its slot on the default texture, the flag tells the shader the slot is empty
+	MaterialParams params = {};
+	params.feedbackSlots = glm::uvec4(MATERIAL_TEXTURE_NO_FEEDBACK);
+	std::array<VkImageView, MATERIAL_TEXTURE_SLOT_COUNT> views;
+	for (uint32_t slot = 0; slot < MATERIAL_TEXTURE_SLOT_COUNT; slot++)
+	{
+		MaterialTexture texture;
+		if (!desc.textures[slot].empty())
+		{
+			bool srgb = slot == MATERIAL_TEXTURE_BASE_COLOUR || slot == MATERIAL_TEXTURE_EMISSIVE;
+			texture = loadTexture(desc.textures[slot], srgb);
+		}
+
+		if (texture.view != VK_NULL_HANDLE)
+		{
+			params.textureFlags |= 1u << slot;
+			params.feedbackSlots[slot] = texture.feedbackSlot;
+			params.textureLog2Sizes[slot] = texture.log2Size;
+		}
+
+		views[slot] = texture.view != VK_NULL_HANDLE ? texture.view : defaultTexture;
+	}
+
+	// Sampled by world position instead of the base colour texture
+	if (desc.virtualTexture)
+	{
+		params.textureFlags |= MATERIAL_FLAG_VIRTUAL_TEXTURE;
+	}
+
+	// -- PARAMETERS --
+	params.baseColourFactor = desc.baseColourFactor;
+	params.emissiveFactor = glm::vec4(desc.emissiveFactor, 0.0f);
+	params.metallic = desc.metallic;
+	params.roughness = desc.roughness;
+	params.normalScale = desc.normalScale;
+	uploadParams(materialId, params, transferQueue, transferCommandPool);
+
+	materialViews.push_back(views);
+	descs.push_back(desc);
+	descriptorSets.push_back(createDescriptorSet(materialId));
+	cache[key] = materialId;
+	return materialId;
+}
+
+void MaterialLibrary::replaceTexture(VkImageView oldView, VkImageView newView, uint32_t releaseFrame)
+{
+	// Empty slots of materials acquired later use it too
+	if (defaultTexture == oldView)
+	{
+		defaultTexture = newView;
+	}
+
+	for (uint32_t materialId = 0; materialId < descriptorSets.size(); materialId++)
+	{
+		bool uses = false;
+		for (VkImageView& view : materialViews[materialId])
+		{
+			if (view == oldView)
+			{
+				view = newView;
+				uses = true;
+			}
+		}
+
+		// A set can't be updated while a frame in flight may bind it, the material gets a new one
+		if (uses)
+		{
+			retiredSets.push_back({ descriptorSets[materialId], releaseFrame });
+			descriptorSets[materialId] = createDescriptorSet(materialId);
+		}
+	}
+}
+
+void MaterialLibrary::releaseRetiredSets(uint32_t frameNumber)
+{
+	for (size_t i = 0; i < retiredSets.size();)
+	{
+		if (frameNumber >= retiredSets[i].releaseFrame)
+		{
+			vkFreeDescriptorSets(device, descriptorPool, 1, &retiredSets[i].set);
+			retiredSets[i] = retiredSets.back();
+			retiredSets.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+VkDescriptorSet MaterialLibrary::createDescriptorSet(uint32_t materialId)
+{
+	VkDescriptorSetAllocateInfo setAllocInfo = {};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &setLayout;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate a Material Descriptor Set!");
+	}
+
+	std::array<VkDescriptorImageInfo, MATERIAL_TEXTURE_SLOT_COUNT> imageInfos = {};
+	for (uint32_t slot = 0; slot < MATERIAL_TEXTURE_SLOT_COUNT; slot++)
+	{
+		imageInfos[slot].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[slot].imageView = materialViews[materialId][slot];
+		imageInfos[slot].sampler = sampler;
+	}
+
+	VkDescriptorBufferInfo paramsInfo = {};
+	paramsInfo.buffer = paramsBuffer;
+	paramsInfo.offset = paramsStride * materialId;
+	paramsInfo.range = sizeof(MaterialParams);
+
+	std::array<VkWriteDescriptorSet, 2> setWrites = {};
+	setWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[0].dstSet = descriptorSet;
+	setWrites[0].dstBinding = 0;
+	setWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	setWrites[0].descriptorCount = static_cast<uint32_t>(imageInfos.size());
+	setWrites[0].pImageInfo = imageInfos.data();
+
+	setWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[1].dstSet = descriptorSet;
+	setWrites[1].dstBinding = MATERIAL_TEXTURE_SLOT_COUNT;
+	setWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	setWrites[1].descriptorCount = 1;
+	setWrites[1].pBufferInfo = &paramsInfo;
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+
+	return descriptorSet;
+}
+
+void MaterialLibrary::uploadParams(uint32_t materialId, const MaterialParams& params, VkQueue transferQueue, VkCommandPool transferCommandPool)
+{
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, sizeof(MaterialParams), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, sizeof(MaterialParams), 0, &data);
+	memcpy(data, &params, sizeof(MaterialParams));
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	// Only the material's block, the others may be in use by frames in flight
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, transferCommandPool);
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = 0;
+	copyRegion.dstOffset = paramsStride * materialId;
+	copyRegion.size = sizeof(MaterialParams);
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, paramsBuffer, 1, &copyRegion);
+
+	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, commandBuffer);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
+VkDescriptorSetLayout MaterialLibrary::getSetLayout() const
+{
+	return setLayout;
+}
+
+VkDescriptorSet MaterialLibrary::getDescriptorSet(uint32_t materialId) const
+{
+	return descriptorSets[materialId];
+}
+
+const MaterialDesc& MaterialLibrary::getDesc(uint32_t materialId) const
+{
+	return descs[materialId];
+}
+
+uint32_t MaterialLibrary::getCount() const
+{
+	return static_cast<uint32_t>(descriptorSets.size());
+}
+
+void MaterialLibrary::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// The sets go with the pool, the textures belong to the renderer
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroyBuffer(device, paramsBuffer, nullptr);
+	vkFreeMemory(device, paramsMemory, nullptr);
+
+	descriptorSets.clear();
+	materialViews.clear();
+	descs.clear();
+	retiredSets.clear();
+	cache.clear();
+	device = VK_NULL_HANDLE;
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+}
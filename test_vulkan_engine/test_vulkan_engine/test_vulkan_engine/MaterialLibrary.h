@@ -0,0 +1,184 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const uint32_t MAX_MATERIALS = 256;						// Distinct materials of every loaded model, material 0 is the default
+const uint32_t MAX_RETIRED_MATERIAL_SETS = 256;			// Replaced sets waiting for the frames in flight, on top of the live ones
+const uint32_t MATERIAL_TEXTURE_NO_FEEDBACK = 0xFFFFFFFF;	// Feedback slot of a texture that isn't streamed
+
+/**
+ * @enum MaterialTextureSlot
+ * @brief Texture slots of a material, also the bindings of its descriptor set.
+ */
+enum MaterialTextureSlot
+{
+	MATERIAL_TEXTURE_BASE_COLOUR,		///< sRGB colour, alpha is the opacity.
+	MATERIAL_TEXTURE_NORMAL,			///< Tangent space normal map.
+	MATERIAL_TEXTURE_METAL_ROUGHNESS,	///< Roughness in green, metallic in blue (glTF layout).
+	MATERIAL_TEXTURE_EMISSIVE,			///< sRGB emitted colour.
+	MATERIAL_TEXTURE_SLOT_COUNT
+};
+
+// Flag after the slot bits of MaterialParams::textureFlags, see MaterialDesc::virtualTexture
+const uint32_t MATERIAL_FLAG_VIRTUAL_TEXTURE = 1u << MATERIAL_TEXTURE_SLOT_COUNT;
+
+/**
+ * @struct MaterialDesc
+ * @brief A material as the model loader reads it, before it is uploaded.
+ *
+ * The factors multiply the textures, an empty file name leaves the slot on the default texture.
+ */
+struct MaterialDesc
+{
+	glm::vec4 baseColourFactor = glm::vec4(1.0f);
+	glm::vec3 emissiveFactor = glm::vec3(0.0f);
+	float metallic = 0.0f;
+	float roughness = 1.0f;
+	float normalScale = 1.0f;			///< Strength of the normal map's tilt.
+	std::array<std::string, MATERIAL_TEXTURE_SLOT_COUNT> textures;
+	bool virtualTexture = false;		///< Samples the virtual texture by world position instead of the base colour texture.
+
+	// Identifies the material in the cache: every factor and texture name
+	std::string getKey() const;
+};
+
+/**
+ * @struct MaterialTexture
+ * @brief A texture as a material slot uses it: its view and what the shaders need for the streaming feedback.
+ */
+struct MaterialTexture
+{
+	VkImageView view = VK_NULL_HANDLE;
+	uint32_t feedbackSlot = MATERIAL_TEXTURE_NO_FEEDBACK;	///< Where the shaders write the mip the texture needs.
+	float log2Size = 0.0f;									///< Of the larger side of the full size image, turns UV derivatives into a mip.
+};
+
+/**
+ * @class MaterialLibrary
+ * @brief Owns the materials of the loaded models: their parameter blocks and texture sets.
+ *
+ * The parameters of every material live in one device local uniform buffer, each material
+ * in its own aligned block. A material is one descriptor set: the texture of every slot and
+ * its block of the buffer, so a draw switches material with a single bind. Models that share
+ * a material (same factors and textures) share its set, acquire() looks them up in a cache.
+ *
+ * A streamed texture's view changes as its mips come and go, replaceTexture() then gives every
+ * material using it a new set. The old sets may still be bound by frames in flight, they are
+ * freed once those are done.
+ */
+class MaterialLibrary
+{
+public:
+	/**
+	 * @brief Loads a texture of a slot, returns a VK_NULL_HANDLE view if the file can't be loaded.
+	 *
+	 * Base colour and emissive textures are sRGB, the others hold linear data.
+	 */
+	typedef std::function<MaterialTexture(const std::string& fileName, bool srgb)> TextureLoader;
+
+	MaterialLibrary();
+
+	/**
+	 * @brief Creates the set layout, the descriptor pool and the parameter buffer.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param newSampler Sampler of every material texture.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkSampler newSampler);
+
+	/**
+	 * @brief Sets the texture of the empty slots, before the first material is acquired.
+	 *
+	 * @param view A white texture, so the factors of the slot are used as they are.
+	 */
+	void setDefaultTexture(VkImageView view);
+
+	/**
+	 * @brief Returns the material with the given properties, uploading it the first time it is seen.
+	 *
+	 * @param desc Factors and texture names of the material.
+	 * @param transferQueue Queue the parameter upload is submitted to.
+	 * @param transferCommandPool Pool of the upload's command buffer.
+	 * @param loadTexture Loads the textures of the material's slots.
+	 * @return ID of the material, the index of its descriptor set.
+	 * @throws std::runtime_error if the library is full.
+	 */
+	uint32_t acquire(const MaterialDesc& desc, VkQueue transferQueue, VkCommandPool transferCommandPool, const TextureLoader& loadTexture);
+
+	/**
+	 * @brief Points the materials sampling a texture at its new view, each gets a new descriptor set.
+	 *
+	 * @param oldView The view the materials use now.
+	 * @param newView The view replacing it.
+	 * @param releaseFrame Frame number from which no frame in flight binds the old sets.
+	 * @throws std::runtime_error if the pool has no room for the new sets.
+	 */
+	void replaceTexture(VkImageView oldView, VkImageView newView, uint32_t releaseFrame);
+
+	// Frees the replaced sets no frame in flight binds anymore
+	void releaseRetiredSets(uint32_t frameNumber);
+
+	VkDescriptorSetLayout getSetLayout() const;
+	VkDescriptorSet getDescriptorSet(uint32_t materialId) const;
+	const MaterialDesc& getDesc(uint32_t materialId) const;
+	uint32_t getCount() const;
+
+	void destroy();
+
+	~MaterialLibrary();
+
+private:
+	// Parameter block of a material, laid out as MaterialParams in the shaders (std140)
+	struct MaterialParams
+	{
+		glm::vec4 baseColourFactor;
+		glm::vec4 emissiveFactor;
+		float metallic;
+		float roughness;
+		float normalScale;
+		uint32_t textureFlags;			// Bit per MaterialTextureSlot that holds a texture of the material, then MATERIAL_FLAG_VIRTUAL_TEXTURE
+		glm::uvec4 feedbackSlots;		// Per MaterialTextureSlot, MATERIAL_TEXTURE_NO_FEEDBACK if not streamed
+		glm::vec4 textureLog2Sizes;		// Per MaterialTextureSlot
+	};
+
+	// A replaced set, freed once no frame in flight binds it
+	struct RetiredSet
+	{
+		VkDescriptorSet set;
+		uint32_t releaseFrame;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkImageView defaultTexture = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> descriptorSets;
+	std::vector<std::array<VkImageView, MATERIAL_TEXTURE_SLOT_COUNT>> materialViews;	// Per material, what its set holds
+	std::vector<MaterialDesc> descs;			// Per material, as it was acquired
+	std::vector<RetiredSet> retiredSets;
+
+	// -- PARAMETERS --
+	VkBuffer paramsBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory paramsMemory = VK_NULL_HANDLE;
+	VkDeviceSize paramsStride = 0;		// Size of a block, aligned to minUniformBufferOffsetAlignment
+
+	std::unordered_map<std::string, uint32_t> cache;
+
+	VkDescriptorSet createDescriptorSet(uint32_t materialId);
+	void uploadParams(uint32_t materialId, const MaterialParams& params, VkQueue transferQueue, VkCommandPool transferCommandPool);
+};
@@ -9,17 +9,28 @@ Mesh::Mesh()
 Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
 	VkQueue transferQueue, VkCommandPool transferCommandPool,
 	std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
-	int newTexId)
+	uint32_t newMaterialId, std::vector<SkinInfluence>* influences)
 {
 	vertexCount = vertices->size();
 	indexCount = indices->size();
 	physicalDevice = newPhysicalDevice;
 	device = newDevice;
+	skinned = influences != nullptr && !influences->empty();
 	createVertexBuffer(transferQueue, transferCommandPool, vertices);
 	createIndexBuffer(transferQueue, transferCommandPool, indices);
+	if (skinned)
+	{
+		createSkinBuffer(transferQueue, transferCommandPool, influences);
+	}
 
 	model.model = glm::mat4(1.0f);
-	texId = newTexId;
+	materialId = newMaterialId;
+
+	// Model space bounding box, used for culling and picking
+	for (const auto& vertex : *vertices)
+	{
+		bounds.expand(vertex.pos);
+	}
 }
 
 void Mesh::setModel(glm::mat4 newModel)
@@ -32,9 +43,19 @@ Model Mesh::getModel()
 	return model;
 }
 
-int Mesh::getTexId()
+void Mesh::setMaterialId(uint32_t newMaterialId)
 {
-	return texId;
+	materialId = newMaterialId;
+}
+
+uint32_t Mesh::getMaterialId()
+{
+	return materialId;
+}
+
+AABB Mesh::getBounds()
+{
+	return bounds;
 }
 
 int Mesh::getVertexCount()
@@ -57,12 +78,37 @@ VkBuffer Mesh::getIndexBuffer()
 	return indexBuffer;
 }
 
+bool Mesh::isSkinned()
+{
+	return skinned;
+}
+
+VkBuffer Mesh::getSkinBuffer()
+{
+	return skinBuffer;
+}
+
+VkDeviceSize Mesh::getMemorySize()
+{
+	VkDeviceSize size = sizeof(Vertex) * vertexCount + sizeof(uint32_t) * indexCount;
+	if (skinned)
+	{
+		size += sizeof(SkinInfluence) * vertexCount;
+	}
+	return size;
+}
+
 void Mesh::destroyBuffers()
 {
 	vkDestroyBuffer(device, vertexBuffer, nullptr);
 	vkFreeMemory(device, vertexBufferMemory, nullptr);
 	vkDestroyBuffer(device, indexBuffer, nullptr);
 	vkFreeMemory(device, indexBufferMemory, nullptr);
+	if (skinned)
+	{
+		vkDestroyBuffer(device, skinBuffer, nullptr);
+		vkFreeMemory(device, skinBufferMemory, nullptr);
+	}
 }
 
 
@@ -93,7 +139,13 @@ void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferComma
 
 	// Create buffer with TRANSFER_DST_BIT to mark as recipient of transfer data (also VERTEX_BUFFER)
 	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the GPU and only accessible by it and not CPU (host)
-	createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	// The bind pose of a skinned mesh is read by the skinning compute shader as a storage buffer
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	if (skinned)
+	{
+		usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	}
+	createBuffer(physicalDevice, device, bufferSize, usage,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &vertexBuffer, &vertexBufferMemory);
 
 	// Copy staging buffer to vertex buffer on GPU
@@ -132,3 +184,28 @@ void Mesh::createIndexBuffer(VkQueue transferQueue, VkCommandPool transferComman
 	vkDestroyBuffer(device, stagingBuffer, nullptr);
 	vkFreeMemory(device, stagingBufferMemory, nullptr);
 }
+
+void Mesh::createSkinBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<SkinInfluence>* influences)
+{
+	VkDeviceSize bufferSize = sizeof(SkinInfluence) * influences->size();
+
+	// Staged like the vertices
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+	memcpy(data, influences->data(), (size_t)bufferSize);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	// Only the skinning compute shader reads it
+	createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &skinBuffer, &skinBufferMemory);
+
+	copyBuffer(device, transferQueue, transferCommandPool, stagingBuffer, skinBuffer, bufferSize);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
@@ -6,6 +6,8 @@
 #include <vector>
 
 #include "Utilities.h"
+#include "Bounds.h"
+#include "Skeleton.h"
 
 struct Model {
 	glm::mat4 model;
@@ -18,12 +20,15 @@ public:
 	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
 		VkQueue transferQueue, VkCommandPool transferCommandPool,
 		std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
-		int newTexId);
+		uint32_t newMaterialId, std::vector<SkinInfluence>* influences = nullptr);
 
 	void setModel(glm::mat4 newModel);
 	Model getModel();
 
-	int getTexId();
+	void setMaterialId(uint32_t newMaterialId);
+	uint32_t getMaterialId();
+
+	AABB getBounds();
 
 	int getVertexCount();
 	VkBuffer getVertexBuffer();
@@ -31,13 +36,21 @@ public:
 	int getIndexCount();
 	VkBuffer getIndexBuffer();
 
+	// Skinned meshes keep the bind pose in the vertex buffer, the skinning pass reads it with the influences
+	bool isSkinned();
+	VkBuffer getSkinBuffer();
+
+	// Bytes of the mesh's buffers, the world streamer's budget counts them
+	VkDeviceSize getMemorySize();
+
 	void destroyBuffers();
 
 	~Mesh();
 
 private:
 	Model model;
-	int texId;
+	uint32_t materialId;
+	AABB bounds;
 
 	int vertexCount;
 	VkBuffer vertexBuffer;
@@ -47,10 +60,15 @@ private:
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
 
+	bool skinned = false;
+	VkBuffer skinBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory skinBufferMemory = VK_NULL_HANDLE;
+
 	VkPhysicalDevice physicalDevice;
 	VkDevice device;
 
 	void createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
 	void createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices);
+	void createSkinBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<SkinInfluence>* influences);
 };
 
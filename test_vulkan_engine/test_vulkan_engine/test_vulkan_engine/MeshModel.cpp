@@ -1,25 +1,96 @@
 #include "MeshModel.h"
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
 
+namespace
+{
+	glm::mat4 toMat4(const aiMatrix4x4& matrix)
+	{
+		// Assimp's matrices are row major
+		return glm::transpose(glm::mat4(
+			matrix.a1, matrix.a2, matrix.a3, matrix.a4,
+			matrix.b1, matrix.b2, matrix.b3, matrix.b4,
+			matrix.c1, matrix.c2, matrix.c3, matrix.c4,
+			matrix.d1, matrix.d2, matrix.d3, matrix.d4));
+	}
+
+	void addJoint(Skeleton& skeleton, const aiNode* node, int32_t parent)
+	{
+		aiVector3D scaling;
+		aiQuaternion rotation;
+		aiVector3D position;
+		node->mTransformation.Decompose(scaling, rotation, position);
+
+		int32_t index = static_cast<int32_t>(skeleton.parents.size());
+		skeleton.names.push_back(node->mName.C_Str());
+		skeleton.parents.push_back(parent);
+		skeleton.bindTranslations.push_back(glm::vec4(position.x, position.y, position.z, 0.0f));
+		skeleton.bindRotations.push_back(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+		skeleton.bindScales.push_back(glm::vec4(scaling.x, scaling.y, scaling.z, 0.0f));
+
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		{
+			addJoint(skeleton, node->mChildren[i], index);
+		}
+	}
+
+	// Keys are sampled at increasing times, the cursor remembers the last key pair instead of searching again
+	glm::vec4 sampleVectorKeys(const aiVectorKey* keys, unsigned int count, double time, unsigned int& cursor)
+	{
+		while (cursor + 1 < count && keys[cursor + 1].mTime <= time)
+		{
+			cursor++;
+		}
+
+		const aiVector3D& a = keys[cursor].mValue;
+		if (cursor + 1 >= count || time <= keys[cursor].mTime)
+		{
+			return glm::vec4(a.x, a.y, a.z, 0.0f);
+		}
+
+		const aiVector3D& b = keys[cursor + 1].mValue;
+		float t = static_cast<float>((time - keys[cursor].mTime) / (keys[cursor + 1].mTime - keys[cursor].mTime));
+		return glm::vec4(glm::mix(glm::vec3(a.x, a.y, a.z), glm::vec3(b.x, b.y, b.z), t), 0.0f);
+	}
+
+	glm::quat sampleQuatKeys(const aiQuatKey* keys, unsigned int count, double time, unsigned int& cursor)
+	{
+		while (cursor + 1 < count && keys[cursor + 1].mTime <= time)
+		{
+			cursor++;
+		}
+
+		const aiQuaternion& a = keys[cursor].mValue;
+		if (cursor + 1 >= count || time <= keys[cursor].mTime)
+		{
+			return glm::quat(a.w, a.x, a.y, a.z);
+		}
+
+		const aiQuaternion& b = keys[cursor + 1].mValue;
+		float t = static_cast<float>((time - keys[cursor].mTime) / (keys[cursor + 1].mTime - keys[cursor].mTime));
+		return glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+	}
+}
 
 MeshModel::MeshModel()
 {
 }
 
-MeshModel::MeshModel(std::vector<Mesh> newMeshList, bool isControlable, glm::vec3 startPos, glm::vec3 lookAt)
+MeshModel::MeshModel(std::vector<Mesh> newMeshList)
 {
     meshList = newMeshList;
-    model = glm::mat4(1.0f);
-    controlable = isControlable;
-    position = startPos;
-
-    glm::vec3 direction = glm::normalize(lookAt - startPos);
-
-    angleY = 0.0f;
-    angleX = 0.0f;
-    angleY = angleY + glm::degrees(atan2(direction.x, direction.z));
+}
 
-    this->setModel(glm::translate(glm::mat4(1.0f), position));
+MeshModel::MeshModel(std::vector<Mesh> newMeshList, Skeleton newSkeleton, std::vector<SkinBone> newSkinBones, std::vector<AnimationClip> newClips)
+{
+	meshList = newMeshList;
+	skeleton = newSkeleton;
+	skinBones = newSkinBones;
+	clips = newClips;
 }
 
 
@@ -38,34 +109,47 @@ Mesh* MeshModel::getMesh(size_t index)
 	return &meshList[index];
 }
 
-glm::mat4 MeshModel::getModel()
+AABB MeshModel::getBounds()
 {
-	return model;
+	// Union of the mesh boxes
+	AABB bounds;
+	for (auto& mesh : meshList)
+	{
+		bounds.expand(mesh.getBounds());
+	}
+
+	return bounds;
 }
 
-glm::mat4* MeshModel::getModelRef()
+VkDeviceSize MeshModel::getMemorySize()
 {
-	return &model;
+	VkDeviceSize size = 0;
+	for (auto& mesh : meshList)
+	{
+		size += mesh.getMemorySize();
+	}
+
+	return size;
 }
 
-bool MeshModel::getControlable()
+bool MeshModel::isSkinned()
 {
-	return this->controlable;
+	return !skinBones.empty();
 }
 
-void MeshModel::setModel(glm::mat4 newModel)
+const Skeleton& MeshModel::getSkeleton()
 {
-	model = newModel;
+	return skeleton;
 }
 
-glm::vec3 MeshModel::getPosition()
+const std::vector<SkinBone>& MeshModel::getSkinBones()
 {
-    return position;
+	return skinBones;
 }
 
-glm::vec3 MeshModel::getDirection() {
-    glm::vec3 forward = glm::normalize(glm::vec3(model[2]));
-    return forward;
+const std::vector<AnimationClip>& MeshModel::getClips()
+{
+	return clips;
 }
 
 void MeshModel::destroyMeshModel()
@@ -77,62 +161,192 @@ void MeshModel::destroyMeshModel()
 }
 
 
-std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
+std::vector<MaterialDesc> MeshModel::LoadMaterials(const aiScene* scene)
 {
-	// Create 1:1 sized list of textures
-	std::vector<std::string> textureList(scene->mNumMaterials);
+	// Create 1:1 sized list of materials
+	std::vector<MaterialDesc> materialList(scene->mNumMaterials);
 
-	// Go through each material and copy its texture file name (if it exists)
+	// Go through each material and copy its factors and texture file names (if they exist)
 	for (size_t i = 0; i < scene->mNumMaterials; i++)
 	{
 		// Get the material
 		aiMaterial* material = scene->mMaterials[i];
+		MaterialDesc& desc = materialList[i];
+
+		// Base colour: the diffuse texture, or the diffuse colour without one. Alpha is the opacity
+		desc.textures[MATERIAL_TEXTURE_BASE_COLOUR] = getTextureFileName(material, aiTextureType_DIFFUSE);
+
+		aiColor3D diffuse(1.0f, 1.0f, 1.0f);
+		float opacity = 1.0f;
+		if (desc.textures[MATERIAL_TEXTURE_BASE_COLOUR].empty())
+		{
+			material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+		}
+		material->Get(AI_MATKEY_OPACITY, opacity);
+		desc.baseColourFactor = glm::vec4(diffuse.r, diffuse.g, diffuse.b, opacity);
+
+		// Emission: the colour scales the texture, an emissive texture alone glows at full strength
+		aiColor3D emissive(0.0f, 0.0f, 0.0f);
+		material->Get(AI_MATKEY_COLOR_EMISSIVE, emissive);
+		desc.textures[MATERIAL_TEXTURE_EMISSIVE] = getTextureFileName(material, aiTextureType_EMISSIVE);
+		desc.emissiveFactor = glm::vec3(emissive.r, emissive.g, emissive.b);
+		if (!desc.textures[MATERIAL_TEXTURE_EMISSIVE].empty() && desc.emissiveFactor == glm::vec3(0.0f))
+		{
+			desc.emissiveFactor = glm::vec3(1.0f);
+		}
+
+		// Normal map. OBJ exporters write height and normal maps alike as map_Bump (Assimp's HEIGHT),
+		// only the ones named as normal maps are used, a height map read as normals tilts everything
+		desc.textures[MATERIAL_TEXTURE_NORMAL] = getTextureFileName(material, aiTextureType_NORMALS);
+		if (desc.textures[MATERIAL_TEXTURE_NORMAL].empty())
+		{
+			std::string heightMap = getTextureFileName(material, aiTextureType_HEIGHT);
+			std::string lowerName = heightMap;
+			std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+			if (lowerName.find("nor") != std::string::npos || lowerName.find("ddn") != std::string::npos)
+			{
+				desc.textures[MATERIAL_TEXTURE_NORMAL] = heightMap;
+			}
+		}
+
+		// Metal-roughness: glTF's metallicRoughnessTexture is UNKNOWN to this Assimp version, which
+		// also has no metallic and roughness factors. Without them the roughness follows the Phong
+		// exponent (the Blinn-Phong to Beckmann mapping) and the surface is a dielectric
+		desc.textures[MATERIAL_TEXTURE_METAL_ROUGHNESS] = getTextureFileName(material, aiTextureType_UNKNOWN);
+
+		float shininess = 0.0f;
+		material->Get(AI_MATKEY_SHININESS, shininess);
+		desc.roughness = std::sqrt(2.0f / (std::max(shininess, 0.0f) + 2.0f));
+		desc.metallic = 0.0f;
+		if (!desc.textures[MATERIAL_TEXTURE_METAL_ROUGHNESS].empty())
+		{
+			// The texture holds the values, the factors only scale it
+			desc.roughness = 1.0f;
+			desc.metallic = 1.0f;
+		}
+	}
+
+	return materialList;
+}
+
+std::string MeshModel::getTextureFileName(aiMaterial* material, aiTextureType type)
+{
+	aiString path;
+	if (material->GetTextureCount(type) == 0 || material->GetTexture(type, 0, &path) != AI_SUCCESS)
+	{
+		return "";
+	}
+
+	// Cut off any directory information aleady present
+	int idx = std::string(path.data).rfind("\\");
+	return std::string(path.data).substr(idx + 1);
+}
 
-		// Initialise the texture to empty string (will be replaced if texture exists)
-		textureList[i] = "";
+Skeleton MeshModel::LoadSkeleton(const aiScene* scene)
+{
+	// Bones refer to nodes by name, any node can be a joint
+	Skeleton skeleton;
+	addJoint(skeleton, scene->mRootNode, -1);
+	return skeleton;
+}
+
+std::vector<AnimationClip> MeshModel::LoadAnimations(const aiScene* scene, const Skeleton& skeleton)
+{
+	std::vector<AnimationClip> clips;
+	uint32_t jointCount = skeleton.getJointCount();
 
-		// Check for a Diffuse Texture (standard detail texture)
-		if (material->GetTextureCount(aiTextureType_DIFFUSE))
+	for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+	{
+		const aiAnimation* animation = scene->mAnimations[a];
+
+		// Formats without a tick rate get Assimp's default
+		double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+
+		AnimationClip clip;
+		clip.name = animation->mName.C_Str();
+		clip.duration = static_cast<float>(animation->mDuration / ticksPerSecond);
+		clip.frameCount = static_cast<uint32_t>(std::ceil(clip.duration * clip.sampleRate)) + 1;
+		clip.jointCount = jointCount;
+
+		// Joints without a track hold their bind pose in every frame
+		clip.translations.resize(static_cast<size_t>(clip.frameCount) * jointCount);
+		clip.rotations.resize(static_cast<size_t>(clip.frameCount) * jointCount);
+		clip.scales.resize(static_cast<size_t>(clip.frameCount) * jointCount);
+		for (uint32_t frame = 0; frame < clip.frameCount; frame++)
+		{
+			size_t first = static_cast<size_t>(frame) * jointCount;
+			std::copy(skeleton.bindTranslations.begin(), skeleton.bindTranslations.end(), clip.translations.begin() + first);
+			std::copy(skeleton.bindRotations.begin(), skeleton.bindRotations.end(), clip.rotations.begin() + first);
+			std::copy(skeleton.bindScales.begin(), skeleton.bindScales.end(), clip.scales.begin() + first);
+		}
+
+		for (unsigned int c = 0; c < animation->mNumChannels; c++)
 		{
-			// Get the path of the texture file
-			aiString path;
-			if (material->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+			const aiNodeAnim* channel = animation->mChannels[c];
+			int32_t joint = skeleton.findJoint(channel->mNodeName.C_Str());
+			if (joint < 0)
 			{
-				// Cut off any directory information aleady present
-				int idx = std::string(path.data).rfind("\\");
-				std::string fileName = std::string(path.data).substr(idx + 1);
+				continue;
+			}
 
-				textureList[i] = fileName;
+			unsigned int positionKey = 0;
+			unsigned int rotationKey = 0;
+			unsigned int scalingKey = 0;
+			for (uint32_t frame = 0; frame < clip.frameCount; frame++)
+			{
+				double time = std::min(frame / clip.sampleRate, clip.duration) * ticksPerSecond;
+				size_t slot = static_cast<size_t>(frame) * jointCount + joint;
+
+				if (channel->mNumPositionKeys > 0)
+				{
+					clip.translations[slot] = sampleVectorKeys(channel->mPositionKeys, channel->mNumPositionKeys, time, positionKey);
+				}
+				if (channel->mNumRotationKeys > 0)
+				{
+					clip.rotations[slot] = sampleQuatKeys(channel->mRotationKeys, channel->mNumRotationKeys, time, rotationKey);
+				}
+				if (channel->mNumScalingKeys > 0)
+				{
+					clip.scales[slot] = sampleVectorKeys(channel->mScalingKeys, channel->mNumScalingKeys, time, scalingKey);
+				}
 			}
 		}
+
+		printf("Animation clip %u: \"%s\", %.2f s, %u frames of %u joints\n", a, clip.name.c_str(), clip.duration, clip.frameCount, jointCount);
+		clips.push_back(clip);
 	}
 
-	return textureList;
+	return clips;
 }
 
-std::vector<Mesh> MeshModel::LoadNode(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int> matToTex)
+std::vector<Mesh> MeshModel::LoadNode(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, const std::vector<uint32_t>& matToMaterial, const Skeleton& skeleton, std::vector<SkinBone>& skinBones)
 {
 	std::vector<Mesh> meshList;
 
+	// The meshes of the node are in its space, skinned ones are moved there from the bones' spaces
+	uint32_t meshJoint = static_cast<uint32_t>(std::max(skeleton.findJoint(node->mName.C_Str()), 0));
+
 	// Go through each mesh at this node and create it, then add it to our meshList
 	for (size_t i = 0; i < node->mNumMeshes; i++)
 	{
 		meshList.push_back(
-			LoadMesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, scene->mMeshes[node->mMeshes[i]], scene, matToTex)
+			LoadMesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, scene->mMeshes[node->mMeshes[i]], scene, matToMaterial,
+				skeleton, meshJoint, skinBones)
 		);
 	}
 
 	// Go through each node attached to this node and load it, then append their meshes to this node's mesh list
 	for (size_t i = 0; i < node->mNumChildren; i++)
 	{
-		std::vector<Mesh> newList = LoadNode(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, node->mChildren[i], scene, matToTex);
+		std::vector<Mesh> newList = LoadNode(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, node->mChildren[i], scene, matToMaterial,
+			skeleton, skinBones);
 		meshList.insert(meshList.end(), newList.begin(), newList.end());
 	}
 
 	return meshList;
 }
 
-Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int> matToTex)
+Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, const std::vector<uint32_t>& matToMaterial, const Skeleton& skeleton, uint32_t meshJoint, std::vector<SkinBone>& skinBones)
 {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
@@ -203,83 +417,93 @@ Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
         }
     }
 
+    // Joints moving each vertex, if the mesh has bones
+    std::vector<SkinInfluence> influences;
+    if (mesh->HasBones()) {
+        influences = LoadInfluences(mesh, skeleton, meshJoint, skinBones);
+    }
+
     // Create new mesh with details and return it
-    Mesh newMesh = Mesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, &vertices, &indices, matToTex[mesh->mMaterialIndex]);
+    Mesh newMesh = Mesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, &vertices, &indices, matToMaterial[mesh->mMaterialIndex], &influences);
 
     return newMesh;
 }
 
-void MeshModel::keyControl(bool* keys, float deltaTime, float moveSpeed, float angleSpeed)
+std::vector<SkinInfluence> MeshModel::LoadInfluences(aiMesh* mesh, const Skeleton& skeleton, uint32_t meshJoint, std::vector<SkinBone>& skinBones)
 {
-    if (this->controlable)
-    {
-        // Irnyvektorok szmtsa
-        /*
-        glm::vec3 forward = glm::vec3(1.0f, 0.0f, 0.0f); // Az aktulis irny
-        glm::vec3 right = glm::vec3(0.0f, 0.0f, 1.0f); // Jobbra mutat vektor
-        glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f); // Felfel mutat vektor
-        */
-        glm::vec3 forward = getDirection(); // Az aktulis irny
-        glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f))); // Jobbra mutat vektor
-        glm::vec3 up = glm::normalize(glm::cross(right, forward)); // Felfel mutat vektor
-        glm::mat4 modelMatrix = glm::mat4(1.0f);
-
-        // Mozgs elre/htra
-        if (keys[GLFW_KEY_UP]) {
-            position += forward * moveSpeed * deltaTime; // Elre
-        }
-        if (keys[GLFW_KEY_DOWN]) {
-            position -= forward * moveSpeed * deltaTime; // Htra
-        }
+	uint32_t firstBone = static_cast<uint32_t>(skinBones.size());
+	if (firstBone + mesh->mNumBones > 0xFFFF)
+	{
+		throw std::runtime_error("Failed to load the bones of a mesh, a model can have at most 65535!");
+	}
 
-        // Mozgs balra/jobbra
-        /*
-        if (keys[GLFW_KEY_LEFT]) {
-            position -= right * moveSpeed * deltaTime; // Balra
-        }
-        if (keys[GLFW_KEY_RIGHT]) {
-            position += right * moveSpeed * deltaTime; // Jobbra
-        }
-        */
-
-        // Felfel/lefel mozgs (ha Ctrl nyomva van)
-        bool isCtrlPressed = keys[GLFW_KEY_RIGHT_CONTROL] || keys[GLFW_KEY_LEFT_CONTROL];
-        if (isCtrlPressed) {
-            if (keys[GLFW_KEY_UP]) {
-                position += up * moveSpeed * deltaTime; // Felfel
-            }
-            if (keys[GLFW_KEY_DOWN]) {
-                position -= up * moveSpeed * deltaTime; // Lefel
-            }
-        }
+	// The strongest weights of every vertex (weight, bone), kept sorted strongest first
+	typedef std::array<std::pair<float, uint32_t>, MAX_JOINT_INFLUENCES> VertexWeights;
+	VertexWeights noWeights;
+	noWeights.fill(std::make_pair(0.0f, 0u));
+	std::vector<VertexWeights> strongest(mesh->mNumVertices, noWeights);
 
-        // Forgats a sajt tengelyek krl
-        if (keys[GLFW_KEY_KP_8]) {
-            angleX -= angleSpeed * deltaTime; // Fel (X tengely krl)
-        }
-        if (keys[GLFW_KEY_KP_2]) {
-            angleX += angleSpeed * deltaTime; // Le (X tengely krl)
-        }
-        if (keys[GLFW_KEY_KP_4]) {
-            angleY += angleSpeed * deltaTime; // Balra (Y tengely krl)
-        }
-        if (keys[GLFW_KEY_KP_6]) {
-            angleY -= angleSpeed * deltaTime; // Jobbra (Y tengely krl)
-        }
+	for (unsigned int b = 0; b < mesh->mNumBones; b++)
+	{
+		const aiBone* bone = mesh->mBones[b];
+		int32_t joint = skeleton.findJoint(bone->mName.C_Str());
 
-        // Modell mtrix frisstse
-        
-        modelMatrix = glm::translate(modelMatrix, position); // Pozci alkalmazsa
-        modelMatrix = glm::rotate(modelMatrix, glm::radians(angleX), glm::vec3(1.0f, 0.0f, 0.0f)); // X tengely krli forgats (fel/le)
-        modelMatrix = glm::rotate(modelMatrix, glm::radians(angleY), glm::vec3(0.0f, 1.0f, 0.0f)); // Y tengely krli forgats (balra/jobbra)
+		SkinBone skinBone;
+		skinBone.joint = joint >= 0 ? static_cast<uint32_t>(joint) : meshJoint;
+		skinBone.meshJoint = meshJoint;
+		skinBone.offset = toMat4(bone->mOffsetMatrix);
+		skinBones.push_back(skinBone);
 
-        this->setModel(modelMatrix); // Frisstett mtrix belltsa
-    }
-}
+		for (unsigned int w = 0; w < bone->mNumWeights; w++)
+		{
+			// Insertion into the sorted slots, the weakest falls off the end
+			std::pair<float, uint32_t> entry(bone->mWeights[w].mWeight, firstBone + b);
+			for (auto& slot : strongest[bone->mWeights[w].mVertexId])
+			{
+				if (entry.first > slot.first)
+				{
+					std::swap(entry, slot);
+				}
+			}
+		}
+	}
 
+	// The kept weights are renormalised and quantised to bytes, the rounding error goes to the
+	// strongest so they still sum to exactly 255
+	std::vector<SkinInfluence> influences(mesh->mNumVertices);
+	for (size_t v = 0; v < strongest.size(); v++)
+	{
+		const VertexWeights& weights = strongest[v];
+		SkinInfluence& influence = influences[v];
+		influence = {};
 
+		float total = 0.0f;
+		for (const auto& weight : weights)
+		{
+			total += weight.first;
+		}
+		if (total <= 0.0f)
+		{
+			continue;
+		}
+
+		int bytes[MAX_JOINT_INFLUENCES];
+		int sum = 0;
+		for (uint32_t k = 0; k < MAX_JOINT_INFLUENCES; k++)
+		{
+			bytes[k] = static_cast<int>(weights[k].first / total * 255.0f + 0.5f);
+			sum += bytes[k];
+		}
+		bytes[0] += 255 - sum;
 
+		influence.bones[0] = weights[0].second | (weights[1].second << 16);
+		influence.bones[1] = weights[2].second | (weights[3].second << 16);
+		influence.weights = static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+			(static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	}
 
+	return influences;
+}
 
 MeshModel::~MeshModel()
 {
@@ -6,48 +6,61 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <assimp/scene.h>
+#include <assimp/postprocess.h>
 
 #include "Mesh.h"
+#include "MaterialLibrary.h"
+#include "Skeleton.h"
+
+// Post processing of every imported model file, the loader expects triangles with flipped UVs
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices;
 
 class MeshModel
 {
 public:
 	MeshModel();
-	MeshModel(std::vector<Mesh> newMeshList, bool isControlable, glm::vec3 startPos, glm::vec3 lookAt = glm::vec3(1.0f, 0.0f, 0.0f));
+	MeshModel(std::vector<Mesh> newMeshList);
+	MeshModel(std::vector<Mesh> newMeshList, Skeleton newSkeleton, std::vector<SkinBone> newSkinBones, std::vector<AnimationClip> newClips);
 
 	size_t getMeshCount();
 	Mesh* getMesh(size_t index);
 
-	glm::mat4 getModel();
-	glm::mat4* getModelRef();
-	bool getControlable();
-
-	void setModel(glm::mat4 newModel);
-	glm::vec3 getPosition();
+	AABB getBounds();
+	VkDeviceSize getMemorySize();
 
-	glm::vec3 getDirection();
+	// A model is skinned if any of its meshes has bones, the animation system poses it with the clips
+	bool isSkinned();
+	const Skeleton& getSkeleton();
+	const std::vector<SkinBone>& getSkinBones();
+	const std::vector<AnimationClip>& getClips();
 
 	void destroyMeshModel();
 
-	void keyControl(bool* keys, float deltaTime, float moveSpeed, float angleSpeed);
+	static std::vector<MaterialDesc> LoadMaterials(const aiScene* scene);
+
+	// Every node of the scene as a joint, parents first
+	static Skeleton LoadSkeleton(const aiScene* scene);
 
-	static std::vector<std::string> LoadMaterials(const aiScene* scene);
+	// The scene's animations, resampled at ANIMATION_SAMPLE_RATE for every joint of the skeleton
+	static std::vector<AnimationClip> LoadAnimations(const aiScene* scene, const Skeleton& skeleton);
+
+	// The bones of the meshes are appended to skinBones, their influences index into it
 	static std::vector<Mesh> LoadNode(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool,
-		aiNode* node, const aiScene* scene, std::vector<int> matToTex);
+		aiNode* node, const aiScene* scene, const std::vector<uint32_t>& matToMaterial, const Skeleton& skeleton, std::vector<SkinBone>& skinBones);
 	static Mesh LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool,
-		aiMesh* mesh, const aiScene* scene, std::vector<int> matToTex);
+		aiMesh* mesh, const aiScene* scene, const std::vector<uint32_t>& matToMaterial, const Skeleton& skeleton, uint32_t meshJoint,
+		std::vector<SkinBone>& skinBones);
 
 	~MeshModel();
 
 private:
 	std::vector<Mesh> meshList;
-	glm::mat4 model;
-
-	glm::vec3 position;
-	bool controlable;
-	float angleY = 0.0f; // Y tengely krli forgats
-	float angleX = 0.0f; // Z tengely krli forgats
+	Skeleton skeleton;
+	std::vector<SkinBone> skinBones;
+	std::vector<AnimationClip> clips;
 
+	static std::vector<SkinInfluence> LoadInfluences(aiMesh* mesh, const Skeleton& skeleton, uint32_t meshJoint, std::vector<SkinBone>& skinBones);
 	static glm::vec3 calculateNorm(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+	static std::string getTextureFileName(aiMaterial* material, aiTextureType type);
 };
 
@@ -0,0 +1,529 @@
+#include "ParticleSystem.h"
+
+#include "FrameContext.h"
+#include "Utilities.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t PARTICLE_GROUP_SIZE = 256;		// local_size of particle_emit.comp and particle_simulate.comp
+	const uint32_t SORT_BLOCK_SIZE = 1024;			// Elements a group of particle_sort.comp sorts in shared memory
+	const uint32_t MAX_SORT_LEVELS = 12;			// Merges above a block up to MAX_PARTICLE_CAPACITY, SORT_LEVELS in the shaders
+	const uint32_t PARTICLE_COUNTERS = 8;			// Living, dead, next living, emitted, sorted, unused
+
+	// Indirect dispatches in the arguments buffer, the draw follows them
+	const uint32_t DISPATCH_EMIT = 0;
+	const uint32_t DISPATCH_SIMULATE = 1;
+	const uint32_t DISPATCH_SORT = 2;				// The shared memory sort of every block
+	const uint32_t DISPATCH_SORT_LEVELS = 3;		// Then one per merge level, zero groups if the list is shorter
+	const uint32_t DISPATCH_COUNT = DISPATCH_SORT_LEVELS + MAX_SORT_LEVELS;
+	const VkDeviceSize DRAW_ARGUMENTS_OFFSET = DISPATCH_COUNT * sizeof(VkDispatchIndirectCommand);
+
+	// Modes of the shared pipelines, as in the shaders
+	const uint32_t ARGUMENTS_BEGIN = 0;				// Before the emission: the emission and simulation dispatches
+	const uint32_t ARGUMENTS_END = 1;				// After the simulation: the sort dispatches and the draw
+	const uint32_t SORT_BLOCKS = 0;
+	const uint32_t SORT_STEP = 1;					// A compare and swap across blocks
+	const uint32_t SORT_MERGE = 2;					// The steps left within a block
+
+	const glm::vec3 GRAVITY = glm::vec3(0.0f, -9.81f, 0.0f);
+	const float COLLISION_THICKNESS = 1.0f;			// Particles further behind the depth buffer's surface pass behind it
+	const float MAX_PARTICLE_DELTA_TIME = 0.1f;		// Longer frames (loading, a dragged window) are slowed down
+
+	VkWriteDescriptorSet bufferWrite(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo)
+	{
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.descriptorType = type;
+		write.descriptorCount = 1;
+		write.pBufferInfo = bufferInfo;
+		return write;
+	}
+
+	// Every dispatch of a pass reads what the previous one wrote, the counters and arguments included
+	void computeBarrier(VkCommandBuffer commandBuffer)
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+ParticleSystem::ParticleSystem()
+{
+}
+
+void ParticleSystem::addPasses(RenderGraph& newGraph, RenderGraphResource sceneColour, RenderGraphResource depth)
+{
+	graph = &newGraph;
+	depthResource = depth;
+
+	// Owned here and kept across frames, the last frame's draw reads both until the emission starts
+	stateResource = graph->importBuffer("Particle state", RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS);
+	graph->exportResource(stateResource, RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS);
+	argumentsResource = graph->importBuffer("Particle arguments", RENDER_GRAPH_ACCESS_INDIRECT_BUFFER);
+	graph->exportResource(argumentsResource, RENDER_GRAPH_ACCESS_INDIRECT_BUFFER);
+
+	// One pass per step so the profiler times each
+	graph->addPass("Particle emission", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.readWrite(stateResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.readWrite(argumentsResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordEmission(commandBuffer); });
+
+	graph->addPass("Particle simulation", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.readWrite(stateResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.readWrite(argumentsResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.read(depthResource, RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordSimulation(commandBuffer); });
+
+	graph->addPass("Particle sort", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.readWrite(stateResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.read(argumentsResource, RENDER_GRAPH_ACCESS_INDIRECT_BUFFER)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordSort(commandBuffer); });
+
+	// Blended over the scene, tested against its depth without writing it
+	drawPass = graph->addPass("Particles", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.writeColour(sceneColour, false)
+		.readDepth(depthResource)
+		.read(stateResource, RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS)
+		.read(argumentsResource, RENDER_GRAPH_ACCESS_INDIRECT_BUFFER)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordDraw(commandBuffer); })
+		.getHandle();
+}
+
+void ParticleSystem::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, uint32_t newCapacity, VkQueue queue, VkCommandPool commandPool)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	// A power of two, the sort works on whole bitonic sequences
+	capacity = SORT_BLOCK_SIZE;
+	while (capacity < std::min(newCapacity, MAX_PARTICLE_CAPACITY))
+	{
+		capacity *= 2;
+	}
+	sortLevels = 0;
+	while ((SORT_BLOCK_SIZE << sortLevels) < capacity)
+	{
+		sortLevels++;
+	}
+
+	createLayouts();
+	createPool(queue, commandPool);
+
+	// Only read with texelFetch
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.maxLod = 0.0f;
+
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &depthSampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Sampler!");
+	}
+
+	printf("Particles: %u at most, %.1f MiB\n", capacity, stateSize / (1024.0 * 1024.0));
+}
+
+void ParticleSystem::createLayouts()
+{
+	// The frame's uniforms and emitters, the pool's five ranges, the indirect arguments and the depth. The vertex
+	// shader reads the particles, the emitters and the sorted keys, the compute shaders everything
+	std::array<VkDescriptorType, 9> types = {
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+	};
+
+	std::array<VkDescriptorSetLayoutBinding, 9> bindings = {};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = types[i];
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// One layout for the compute pipelines and the draw, the same set is bound by all of them
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushParticles);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &setLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+}
+
+void ParticleSystem::createPool(VkQueue queue, VkCommandPool commandPool)
+{
+	// -- LAYOUT --
+	// Every range is bound on its own, at the storage buffers' offset alignment
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 16);
+
+	particlesOffset = 0;
+	deadListOffset = alignUp(particlesOffset + sizeof(Particle) * capacity, alignment);
+	aliveListsOffset = alignUp(deadListOffset + sizeof(uint32_t) * capacity, alignment);
+	sortKeysOffset = alignUp(aliveListsOffset + sizeof(uint32_t) * 2 * capacity, alignment);
+	countersOffset = alignUp(sortKeysOffset + sizeof(glm::uvec2) * capacity, alignment);
+	stateSize = countersOffset + sizeof(uint32_t) * PARTICLE_COUNTERS;
+
+	createBuffer(physicalDevice, device, stateSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &stateBuffer, &stateMemory);
+	createBuffer(physicalDevice, device, DRAW_ARGUMENTS_OFFSET + sizeof(VkDrawIndirectCommand),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &argumentsBuffer, &argumentsMemory);
+
+	// -- INITIAL STATE --
+	// Every slot on the dead list, nothing alive
+	VkDeviceSize deadListSize = sizeof(uint32_t) * capacity;
+	VkDeviceSize stagingSize = deadListSize + sizeof(uint32_t) * PARTICLE_COUNTERS;
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, &data);
+	uint32_t* words = static_cast<uint32_t*>(data);
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		words[i] = i;
+	}
+	uint32_t* counters = words + capacity;
+	memset(counters, 0, sizeof(uint32_t) * PARTICLE_COUNTERS);
+	counters[1] = capacity;
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+	std::array<VkBufferCopy, 2> regions = {};
+	regions[0] = { 0, deadListOffset, deadListSize };
+	regions[1] = { deadListSize, countersOffset, sizeof(uint32_t) * PARTICLE_COUNTERS };
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, stateBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+	vkCmdFillBuffer(commandBuffer, argumentsBuffer, 0, VK_WHOLE_SIZE, 0);
+	endAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
+void ParticleSystem::appendPipelineDescs(std::vector<GraphicsPipelineDesc>& graphicsDescs, std::vector<VkPipeline*>& graphicsHandles,
+	std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles)
+{
+	// Quads generated from the vertex index, blended back to front without writing depth
+	GraphicsPipelineDesc drawDesc;
+	drawDesc.name = "Particles";
+	drawDesc.vertexShader = "Shaders/particleVert.spv";
+	drawDesc.fragmentShader = "Shaders/particleFrag.spv";
+	drawDesc.layout = pipelineLayout;
+	drawDesc.renderPass = graph->getRenderPass(drawPass);
+	drawDesc.subpass = 0;
+	drawDesc.cullMode = VK_CULL_MODE_NONE;
+	drawDesc.depthTest = true;
+	drawDesc.depthWrite = false;
+	drawDesc.alphaBlend = true;
+	drawDesc.vertexInput = false;
+	graphicsDescs.push_back(drawDesc);
+	graphicsHandles.push_back(&drawPipeline);
+
+	computeDescs.push_back({ "Particle arguments", "Shaders/particleArgsComp.spv", pipelineLayout });
+	computeHandles.push_back(&argumentsPipeline);
+	computeDescs.push_back({ "Particle emission", "Shaders/particleEmitComp.spv", pipelineLayout });
+	computeHandles.push_back(&emitPipeline);
+	computeDescs.push_back({ "Particle simulation", "Shaders/particleSimulateComp.spv", pipelineLayout });
+	computeHandles.push_back(&simulatePipeline);
+	computeDescs.push_back({ "Particle sort", "Shaders/particleSortComp.spv", pipelineLayout });
+	computeHandles.push_back(&sortPipeline);
+}
+
+uint32_t ParticleSystem::addEmitter(const ParticleEmitterDesc& desc)
+{
+	if (emitters.size() >= MAX_PARTICLE_EMITTERS)
+	{
+		throw std::runtime_error("Failed to add a particle emitter, raise MAX_PARTICLE_EMITTERS!");
+	}
+
+	Emitter emitter;
+	emitter.desc = desc;
+	emitters.push_back(emitter);
+	return static_cast<uint32_t>(emitters.size() - 1);
+}
+
+void ParticleSystem::setEmitterTransform(uint32_t emitter, glm::vec3 position, glm::vec3 direction)
+{
+	if (emitter >= emitters.size())
+	{
+		return;
+	}
+
+	emitters[emitter].desc.position = position;
+	emitters[emitter].desc.direction = direction;
+}
+
+void ParticleSystem::setEmitterLength(uint32_t emitter, float length)
+{
+	if (emitter >= emitters.size())
+	{
+		return;
+	}
+
+	emitters[emitter].desc.length = length;
+}
+
+void ParticleSystem::prepareFrame(FrameContext& frame, const glm::mat4& viewProjection, const glm::mat4& view, VkExtent2D newRenderExtent)
+{
+	PROFILE_FUNCTION();
+
+	renderExtent = newRenderExtent;
+	currentList = frameNumber & 1;
+
+	// Frame rate independent emission, the fraction of a particle is carried over
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	float deltaTime = hasLastFrameTime ? std::min(std::chrono::duration<float>(now - lastFrameTime).count(), MAX_PARTICLE_DELTA_TIME) : 0.0f;
+	lastFrameTime = now;
+	hasLastFrameTime = true;
+
+	// -- EMITTERS --
+	// Each gets a range of this frame's emission threads, the GPU clamps the total to the free slots
+	std::vector<GpuEmitter> gpuEmitters(std::max<size_t>(emitters.size(), 1), GpuEmitter());
+	uint32_t requested = 0;
+	for (size_t i = 0; i < emitters.size(); i++)
+	{
+		Emitter& emitter = emitters[i];
+		const ParticleEmitterDesc& desc = emitter.desc;
+		emitter.pending += desc.rate * deltaTime;
+		uint32_t count = std::min(static_cast<uint32_t>(emitter.pending), capacity - requested);
+		emitter.pending -= std::floor(emitter.pending);
+
+		glm::vec3 direction = glm::length(desc.direction) > 0.0f ? glm::normalize(desc.direction) : glm::vec3(0.0f, 1.0f, 0.0f);
+		GpuEmitter& gpuEmitter = gpuEmitters[i];
+		gpuEmitter.position = glm::vec4(desc.position, desc.radius);
+		gpuEmitter.direction = glm::vec4(direction, std::cos(glm::radians(desc.angle)));
+		gpuEmitter.startColour = desc.startColour;
+		gpuEmitter.endColour = desc.endColour;
+		gpuEmitter.size = glm::vec4(desc.startSize, desc.endSize, desc.minSpeed, desc.maxSpeed);
+		gpuEmitter.life = glm::vec4(desc.minLife, std::max(desc.maxLife, desc.minLife), desc.gravityScale, desc.drag);
+		gpuEmitter.collision = glm::vec4(desc.bounce, desc.friction, desc.length, 0.0f);
+		gpuEmitter.emission = glm::uvec4(requested, count, static_cast<uint32_t>(desc.shape), 0);
+		requested += count;
+	}
+
+	// -- UNIFORMS --
+	glm::mat4 inverseView = glm::inverse(view);
+	VkExtent2D depthExtent = graph->getImageExtent(depthResource);
+
+	ParticleFrame uniforms = {};
+	uniforms.viewProjection = viewProjection;
+	uniforms.inverseViewProjection = glm::inverse(viewProjection);
+	uniforms.cameraPosition = glm::vec4(glm::vec3(inverseView[3]), deltaTime);
+	uniforms.cameraRight = glm::vec4(glm::vec3(inverseView[0]), 0.0f);
+	uniforms.cameraUp = glm::vec4(glm::vec3(inverseView[1]), 0.0f);
+	uniforms.gravity = glm::vec4(GRAVITY, COLLISION_THICKNESS);
+	uniforms.depthScale = glm::vec4(static_cast<float>(renderExtent.width) / depthExtent.width,
+		static_cast<float>(renderExtent.height) / depthExtent.height, 1.0f / depthExtent.width, 1.0f / depthExtent.height);
+	uniforms.counts = glm::uvec4(static_cast<uint32_t>(emitters.size()), requested, capacity, frameNumber);
+
+	graph->setImportedBuffer(stateResource, stateBuffer);
+	graph->setImportedBuffer(argumentsResource, argumentsBuffer);
+
+	// -- SET --
+	// The graph's depth view changes with a resize, the set is written every frame
+	std::array<VkDescriptorBufferInfo, 8> bufferInfos = {
+		frame.uniforms.push(&uniforms, sizeof(ParticleFrame)),
+		frame.uniforms.push(gpuEmitters.data(), sizeof(GpuEmitter) * gpuEmitters.size()),
+		VkDescriptorBufferInfo{ stateBuffer, particlesOffset, sizeof(Particle) * capacity },
+		VkDescriptorBufferInfo{ stateBuffer, deadListOffset, sizeof(uint32_t) * capacity },
+		VkDescriptorBufferInfo{ stateBuffer, aliveListsOffset, sizeof(uint32_t) * 2 * capacity },
+		VkDescriptorBufferInfo{ stateBuffer, sortKeysOffset, sizeof(glm::uvec2) * capacity },
+		VkDescriptorBufferInfo{ stateBuffer, countersOffset, sizeof(uint32_t) * PARTICLE_COUNTERS },
+		VkDescriptorBufferInfo{ argumentsBuffer, 0, VK_WHOLE_SIZE }
+	};
+	VkDescriptorImageInfo depthInfo = { depthSampler, graph->getImageView(depthResource), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+	frameSet = frame.allocateDescriptorSet(setLayout);
+
+	std::array<VkWriteDescriptorSet, 9> writes = {};
+	for (uint32_t i = 0; i < bufferInfos.size(); i++)
+	{
+		writes[i] = bufferWrite(frameSet, i, i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfos[i]);
+	}
+	writes[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[8].dstSet = frameSet;
+	writes[8].dstBinding = 8;
+	writes[8].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[8].descriptorCount = 1;
+	writes[8].pImageInfo = &depthInfo;
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	frameNumber++;
+}
+
+uint32_t ParticleSystem::getCapacity() const
+{
+	return capacity;
+}
+
+void ParticleSystem::bindCompute(VkCommandBuffer commandBuffer, VkPipeline pipeline) const
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frameSet, 0, nullptr);
+}
+
+void ParticleSystem::pushConstants(VkCommandBuffer commandBuffer, uint32_t mode, uint32_t sequenceSize, uint32_t stepSize) const
+{
+	PushParticles push = { currentList, mode, sequenceSize, stepSize };
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushParticles), &push);
+}
+
+void ParticleSystem::recordEmission(VkCommandBuffer commandBuffer)
+{
+	// The counters left by the last frame give the group counts, the CPU never sees them
+	bindCompute(commandBuffer, argumentsPipeline);
+	pushConstants(commandBuffer, ARGUMENTS_BEGIN, 0, 0);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+	computeBarrier(commandBuffer);
+
+	bindCompute(commandBuffer, emitPipeline);
+	pushConstants(commandBuffer, 0, 0, 0);
+	vkCmdDispatchIndirect(commandBuffer, argumentsBuffer, DISPATCH_EMIT * sizeof(VkDispatchIndirectCommand));
+}
+
+void ParticleSystem::recordSimulation(VkCommandBuffer commandBuffer)
+{
+	bindCompute(commandBuffer, simulatePipeline);
+	pushConstants(commandBuffer, 0, 0, 0);
+	vkCmdDispatchIndirect(commandBuffer, argumentsBuffer, DISPATCH_SIMULATE * sizeof(VkDispatchIndirectCommand));
+	computeBarrier(commandBuffer);
+
+	// The survivors are counted, the sort and the draw are sized for them
+	bindCompute(commandBuffer, argumentsPipeline);
+	pushConstants(commandBuffer, ARGUMENTS_END, 0, 0);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+}
+
+void ParticleSystem::recordSort(VkCommandBuffer commandBuffer)
+{
+	bindCompute(commandBuffer, sortPipeline);
+
+	// Blocks sorted in shared memory, in alternating directions so pairs of them form bitonic sequences
+	pushConstants(commandBuffer, SORT_BLOCKS, 0, 0);
+	vkCmdDispatchIndirect(commandBuffer, argumentsBuffer, DISPATCH_SORT * sizeof(VkDispatchIndirectCommand));
+
+	// Merged level by level: the steps wider than a block in global memory, the rest in shared memory.
+	// Every level the capacity allows is recorded, the ones the list doesn't need dispatch no groups
+	for (uint32_t level = 0; level < sortLevels; level++)
+	{
+		uint32_t sequenceSize = SORT_BLOCK_SIZE << (level + 1);
+		VkDeviceSize argumentsOffset = (DISPATCH_SORT_LEVELS + level) * sizeof(VkDispatchIndirectCommand);
+		for (uint32_t stepSize = sequenceSize / 2; stepSize >= SORT_BLOCK_SIZE; stepSize /= 2)
+		{
+			computeBarrier(commandBuffer);
+			pushConstants(commandBuffer, SORT_STEP, sequenceSize, stepSize);
+			vkCmdDispatchIndirect(commandBuffer, argumentsBuffer, argumentsOffset);
+		}
+
+		computeBarrier(commandBuffer);
+		pushConstants(commandBuffer, SORT_MERGE, sequenceSize, SORT_BLOCK_SIZE / 2);
+		vkCmdDispatchIndirect(commandBuffer, argumentsBuffer, argumentsOffset);
+	}
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+
+	// Same area as the scene pass
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(renderExtent.width);
+	viewport.height = static_cast<float>(renderExtent.height);
+	viewport.maxDepth = 1.0f;
+	VkRect2D scissor = {};
+	scissor.extent = renderExtent;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	// A quad (6 vertices) per living particle, the instance count was written by the simulation
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameSet, 0, nullptr);
+	vkCmdDrawIndirect(commandBuffer, argumentsBuffer, DRAW_ARGUMENTS_OFFSET, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void ParticleSystem::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyPipeline(device, argumentsPipeline, nullptr);
+	vkDestroyPipeline(device, emitPipeline, nullptr);
+	vkDestroyPipeline(device, simulatePipeline, nullptr);
+	vkDestroyPipeline(device, sortPipeline, nullptr);
+	vkDestroyPipeline(device, drawPipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroySampler(device, depthSampler, nullptr);
+
+	vkDestroyBuffer(device, stateBuffer, nullptr);
+	vkFreeMemory(device, stateMemory, nullptr);
+	vkDestroyBuffer(device, argumentsBuffer, nullptr);
+	vkFreeMemory(device, argumentsMemory, nullptr);
+
+	emitters.clear();
+	device = VK_NULL_HANDLE;
+}
+
+ParticleSystem::~ParticleSystem()
+{
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "RenderGraph.h"
+#include "PipelineManager.h"
+
+class FrameContext;
+
+const uint32_t DEFAULT_PARTICLE_CAPACITY = 1u << 18;	// Particles alive at once, rounded up to a power of two
+const uint32_t MAX_PARTICLE_CAPACITY = 1u << 22;		// The sort's dispatches are recorded up to this size
+const uint32_t MAX_PARTICLE_EMITTERS = 16;
+
+/**
+ * @enum ParticleEmitterShape
+ * @brief Where an emitter spawns its particles and which way it throws them.
+ */
+enum ParticleEmitterShape
+{
+	PARTICLE_SHAPE_CONE,		///< Inside a cone along the direction, thrown away from its apex (a light's beam).
+	PARTICLE_SHAPE_RING			///< On a disc facing the direction, thrown outwards and tilted towards it (rotor downwash).
+};
+
+/**
+ * @struct ParticleEmitterDesc
+ * @brief An emitter's shape, rate and the look of its particles over their life.
+ */
+struct ParticleEmitterDesc
+{
+	ParticleEmitterShape shape = PARTICLE_SHAPE_CONE;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 direction = glm::vec3(0.0f, 1.0f, 0.0f);	///< Axis of the cone, normal of the ring.
+	float angle = 30.0f;						///< Half angle of the cone, or the tilt of the ring's particles off its plane (degrees).
+	float radius = 1.0f;						///< Of the ring.
+	float length = 0.0f;						///< The cone's particles spawn up to this far into it, 0 for its apex.
+	float rate = 100.0f;						///< Particles per second.
+	float minSpeed = 1.0f;
+	float maxSpeed = 2.0f;
+	float minLife = 1.0f;						///< Seconds.
+	float maxLife = 2.0f;
+	float startSize = 0.5f;
+	float endSize = 1.0f;
+	glm::vec4 startColour = glm::vec4(1.0f);	///< Linear HDR colour and opacity at birth.
+	glm::vec4 endColour = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+	float gravityScale = 1.0f;
+	float drag = 0.0f;							///< Share of the velocity lost per second.
+	float bounce = 0.3f;						///< Share of the velocity into a surface kept when a particle hits it.
+	float friction = 0.2f;						///< Share of the velocity along a surface lost when a particle hits it.
+};
+
+/**
+ * @class ParticleSystem
+ * @brief Particles emitted, simulated, sorted and drawn on the GPU, the CPU only records a fixed set of commands.
+ *
+ * Every particle lives in a pool of fixed capacity. The free slots are a stack (the dead list),
+ * the living ones are a list rebuilt every frame. A one thread dispatch turns the counters into
+ * the arguments of the indirect dispatches: the emission pops slots off the dead list and
+ * appends them to the living list, the simulation ages and moves every living particle, pushes
+ * the expired ones back onto the dead list and appends the others to the next frame's list,
+ * which compacts it. Particles collide with the depth buffer, reconstructing the surface's
+ * position and normal from it, so they bounce off anything on screen.
+ *
+ * The simulation also writes a sort key per particle, its squared distance to the camera. A
+ * bitonic sort orders them back to front, blocks of 1024 in shared memory, then merged in
+ * global memory. Its passes are recorded for the whole capacity, the counters zero the group
+ * counts of the passes a smaller list doesn't need. The particles are then drawn with one
+ * indirect draw of camera facing quads, blended over the scene before the TAA resolves it.
+ *
+ * The CPU only tells the GPU how many particles each emitter spawns this frame, it never reads
+ * a count back.
+ */
+class ParticleSystem
+{
+public:
+	ParticleSystem();
+
+	/**
+	 * @brief Declares the emission, simulation, sort and draw passes.
+	 *
+	 * @param newGraph Graph the passes are added to, after the scene pass and before the TAA.
+	 * @param sceneColour The scene's colour, the particles are blended over it.
+	 * @param depth Single sampled depth of the scene, collided against and tested (not written).
+	 */
+	void addPasses(RenderGraph& newGraph, RenderGraphResource sceneColour, RenderGraphResource depth);
+
+	/**
+	 * @brief Creates the layouts, the sampler and the particle pool with every slot free, after the graph is compiled.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param newCapacity Particles alive at once, rounded up to a power of two (1024 to MAX_PARTICLE_CAPACITY).
+	 * @param queue Queue the pool's initial state is uploaded on.
+	 * @param commandPool Pool of the upload's command buffer.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, uint32_t newCapacity, VkQueue queue, VkCommandPool commandPool);
+
+	/**
+	 * @brief Appends the draw pipeline, the compute pipelines and the members holding them, the caller creates them.
+	 */
+	void appendPipelineDescs(std::vector<GraphicsPipelineDesc>& graphicsDescs, std::vector<VkPipeline*>& graphicsHandles,
+		std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles);
+
+	/**
+	 * @brief Adds an emitter, it spawns particles from the next frame on.
+	 *
+	 * @param desc The emitter.
+	 * @return Index of the emitter.
+	 * @throws std::runtime_error if there are MAX_PARTICLE_EMITTERS emitters already.
+	 */
+	uint32_t addEmitter(const ParticleEmitterDesc& desc);
+
+	/**
+	 * @brief Moves an emitter, e.g. along with the entity it is attached to.
+	 *
+	 * @param emitter Index of the emitter.
+	 * @param position New position.
+	 * @param direction New axis of its shape.
+	 */
+	void setEmitterTransform(uint32_t emitter, glm::vec3 position, glm::vec3 direction);
+
+	/**
+	 * @brief Changes how far into its cone an emitter spawns, e.g. to stop a beam at what it hits.
+	 *
+	 * @param emitter Index of the emitter.
+	 * @param length New length of the cone.
+	 */
+	void setEmitterLength(uint32_t emitter, float length);
+
+	/**
+	 * @brief Works out this frame's emission and writes the uniforms and the descriptor set of the passes.
+	 *
+	 * @param frame The frame context being recorded.
+	 * @param viewProjection The camera's matrix, jittered like the depth buffer.
+	 * @param view View matrix of the frame, the quads face the camera.
+	 * @param renderExtent Area of the depth buffer rendered this frame, from its top left corner.
+	 */
+	void prepareFrame(FrameContext& frame, const glm::mat4& viewProjection, const glm::mat4& view, VkExtent2D renderExtent);
+
+	uint32_t getCapacity() const;
+
+	void destroy();
+
+	~ParticleSystem();
+
+private:
+	// A particle, laid out as Particle in the shaders (std430)
+	struct Particle
+	{
+		glm::vec3 position;
+		float age;
+		glm::vec3 velocity;
+		float life;
+		uint32_t emitter;
+		float rotation;
+		float sizeScale;
+		float padding;
+	};
+
+	// Laid out as Emitter in the shaders (std430)
+	struct GpuEmitter
+	{
+		glm::vec4 position;			// xyz, radius of the ring
+		glm::vec4 direction;		// xyz, cosine of the cone's half angle or of the ring's tilt
+		glm::vec4 startColour;
+		glm::vec4 endColour;
+		glm::vec4 size;				// Start size, end size, lowest speed, highest speed
+		glm::vec4 life;				// Shortest life, longest life, gravity scale, drag
+		glm::vec4 collision;		// Bounce, friction, length of the cone
+		glm::uvec4 emission;		// First particle of this frame's emission, particles emitted, shape
+	};
+
+	// Laid out as ParticleFrame in the shaders (std140)
+	struct ParticleFrame
+	{
+		glm::mat4 viewProjection;
+		glm::mat4 inverseViewProjection;
+		glm::vec4 cameraPosition;	// xyz, seconds since the last frame
+		glm::vec4 cameraRight;
+		glm::vec4 cameraUp;
+		glm::vec4 gravity;			// xyz, how far behind the depth buffer's surface a particle still collides with it
+		glm::vec4 depthScale;		// Rendered share of the depth image (xy), size of a texel in UV (zw)
+		glm::uvec4 counts;			// Emitters, particles asked for this frame, capacity, frame number
+	};
+
+	// Push constants, laid out as in the compute shaders
+	struct PushParticles
+	{
+		uint32_t currentList;		// Which of the two living lists the emission and simulation read
+		uint32_t mode;				// Step of particle_args.comp or particle_sort.comp
+		uint32_t sequenceSize;		// Bitonic sequence being merged
+		uint32_t stepSize;			// Distance of the compared elements
+	};
+
+	struct Emitter
+	{
+		ParticleEmitterDesc desc;
+		float pending = 0.0f;		// Fraction of a particle carried over to the next frame
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	RenderGraph* graph = nullptr;
+	RenderGraphPass drawPass = RENDER_GRAPH_INVALID;
+	RenderGraphResource depthResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource stateResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource argumentsResource = RENDER_GRAPH_INVALID;
+
+	// -- POOL --
+	// The particles, the dead list, the two living lists, the sort keys and the counters, one after the other
+	uint32_t capacity = 0;
+	uint32_t sortLevels = 0;					// Merge levels above the shared memory blocks the capacity needs
+	VkBuffer stateBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stateMemory = VK_NULL_HANDLE;
+	VkDeviceSize particlesOffset = 0;
+	VkDeviceSize deadListOffset = 0;
+	VkDeviceSize aliveListsOffset = 0;
+	VkDeviceSize sortKeysOffset = 0;
+	VkDeviceSize countersOffset = 0;
+	VkDeviceSize stateSize = 0;
+	VkBuffer argumentsBuffer = VK_NULL_HANDLE;	// Indirect dispatches, then the indirect draw
+	VkDeviceMemory argumentsMemory = VK_NULL_HANDLE;
+
+	// -- PIPELINES --
+	VkSampler depthSampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline argumentsPipeline = VK_NULL_HANDLE;
+	VkPipeline emitPipeline = VK_NULL_HANDLE;
+	VkPipeline simulatePipeline = VK_NULL_HANDLE;
+	VkPipeline sortPipeline = VK_NULL_HANDLE;
+	VkPipeline drawPipeline = VK_NULL_HANDLE;
+
+	// -- EMITTERS --
+	std::vector<Emitter> emitters;
+	std::chrono::steady_clock::time_point lastFrameTime;
+	bool hasLastFrameTime = false;
+
+	// -- FRAME --
+	VkDescriptorSet frameSet = VK_NULL_HANDLE;
+	VkExtent2D renderExtent = {};
+	uint32_t currentList = 0;
+	uint32_t frameNumber = 0;
+
+	void createLayouts();
+	void createPool(VkQueue queue, VkCommandPool commandPool);
+
+	void bindCompute(VkCommandBuffer commandBuffer, VkPipeline pipeline) const;
+	void pushConstants(VkCommandBuffer commandBuffer, uint32_t mode, uint32_t sequenceSize, uint32_t stepSize) const;
+
+	void recordEmission(VkCommandBuffer commandBuffer);
+	void recordSimulation(VkCommandBuffer commandBuffer);
+	void recordSort(VkCommandBuffer commandBuffer);
+	void recordDraw(VkCommandBuffer commandBuffer);
+};
@@ -0,0 +1,567 @@
+#include "PipelineManager.h"
+
+#include "Utilities.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	typedef std::chrono::steady_clock PipelineClock;
+
+	const uint32_t CACHE_FILE_MAGIC = 0x43504B56;		// "VKPC"
+	const uint32_t CACHE_FILE_VERSION = 1;
+
+	// Written in front of the Vulkan blob
+	struct CacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;			// Not part of the Vulkan header, a driver update keeps the UUID on some vendors
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t checksum;
+	};
+
+	// Size of the header Vulkan puts in front of the cache data (VkPipelineCacheHeaderVersionOne)
+	const size_t VULKAN_CACHE_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+	// FNV-1a, only catches truncated or damaged files
+	uint64_t computeChecksum(const char* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint32_t readUint32(const char* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	double elapsedMs(PipelineClock::time_point start, PipelineClock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+PipelineManager::PipelineManager()
+{
+}
+
+void PipelineManager::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, const std::string& newCacheFile)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	cacheFile = newCacheFile;
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	std::vector<char> initialData = loadCacheData();
+	cacheLoaded = !initialData.empty();
+
+	VkPipelineCacheCreateInfo cacheCreateInfo = {};
+	cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheCreateInfo.initialDataSize = initialData.size();
+	cacheCreateInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	VkResult result = vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &pipelineCache);
+	if (result != VK_SUCCESS && cacheLoaded)
+	{
+		// The driver may still refuse data that passed our checks, start over without it
+		printf("Pipeline cache: driver rejected %s, starting empty\n", cacheFile.c_str());
+		cacheCreateInfo.initialDataSize = 0;
+		cacheCreateInfo.pInitialData = nullptr;
+		cacheLoaded = false;
+		result = vkCreatePipelineCache(device, &cacheCreateInfo, nullptr, &pipelineCache);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Pipeline Cache!");
+	}
+}
+
+std::vector<char> PipelineManager::loadCacheData() const
+{
+	std::ifstream file(cacheFile, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		printf("Pipeline cache: no cache file, starting empty\n");
+		return {};
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+
+	CacheFileHeader header;
+	if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		printf("Pipeline cache: %s is truncated, ignored\n", cacheFile.c_str());
+		return {};
+	}
+
+	if (header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION)
+	{
+		printf("Pipeline cache: %s has an unknown format, ignored\n", cacheFile.c_str());
+		return {};
+	}
+
+	if (header.vendorID != deviceProperties.vendorID || header.deviceID != deviceProperties.deviceID ||
+		header.driverVersion != deviceProperties.driverVersion ||
+		memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		printf("Pipeline cache: written by another GPU or driver version, ignored\n");
+		return {};
+	}
+
+	if (header.dataSize != fileSize - sizeof(header) || header.dataSize < VULKAN_CACHE_HEADER_SIZE)
+	{
+		printf("Pipeline cache: %s has a wrong size, ignored\n", cacheFile.c_str());
+		return {};
+	}
+
+	std::vector<char> data(static_cast<size_t>(header.dataSize));
+	if (!file.read(data.data(), data.size()) || computeChecksum(data.data(), data.size()) != header.checksum)
+	{
+		printf("Pipeline cache: %s is damaged, ignored\n", cacheFile.c_str());
+		return {};
+	}
+
+	// Same checks on the header written by the driver itself
+	uint32_t headerLength = readUint32(&data[0]);
+	uint32_t headerVersion = readUint32(&data[4]);
+	if (headerLength < VULKAN_CACHE_HEADER_SIZE || headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		readUint32(&data[8]) != deviceProperties.vendorID || readUint32(&data[12]) != deviceProperties.deviceID ||
+		memcmp(&data[16], deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		printf("Pipeline cache: blob header doesn't match the device, ignored\n");
+		return {};
+	}
+
+	printf("Pipeline cache: loaded %zu bytes from %s\n", data.size(), cacheFile.c_str());
+	return data;
+}
+
+bool PipelineManager::saveCache() const
+{
+	if (pipelineCache == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+	{
+		return false;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+	{
+		return false;
+	}
+	data.resize(dataSize);
+
+	CacheFileHeader header = {};
+	header.magic = CACHE_FILE_MAGIC;
+	header.version = CACHE_FILE_VERSION;
+	header.vendorID = deviceProperties.vendorID;
+	header.deviceID = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.checksum = computeChecksum(data.data(), data.size());
+
+	// Write to a temporary file first, so a crash mid write never leaves a damaged cache behind
+	std::string tempFile = cacheFile + ".tmp";
+	{
+		std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		if (!file.good())
+		{
+			return false;
+		}
+	}
+
+	std::remove(cacheFile.c_str());
+	return std::rename(tempFile.c_str(), cacheFile.c_str()) == 0;
+}
+
+std::vector<VkPipeline> PipelineManager::createGraphicsPipelines(const std::vector<GraphicsPipelineDesc>& descs)
+{
+	PipelineClock::time_point start = PipelineClock::now();
+
+	// Shader modules are cheap, create them up front so the workers only compile
+	std::vector<VkShaderModule> vertexModules(descs.size(), VK_NULL_HANDLE);
+	std::vector<VkShaderModule> fragmentModules(descs.size(), VK_NULL_HANDLE);
+	try
+	{
+		for (size_t i = 0; i < descs.size(); i++)
+		{
+			vertexModules[i] = createShaderModule(descs[i].vertexShader);
+			if (!descs[i].fragmentShader.empty())
+			{
+				fragmentModules[i] = createShaderModule(descs[i].fragmentShader);
+			}
+		}
+	}
+	catch (...)
+	{
+		for (size_t i = 0; i < descs.size(); i++)
+		{
+			vkDestroyShaderModule(device, vertexModules[i], nullptr);
+			vkDestroyShaderModule(device, fragmentModules[i], nullptr);
+		}
+		throw;
+	}
+
+	std::vector<VkPipeline> pipelines(descs.size(), VK_NULL_HANDLE);
+	std::vector<VkResult> results(descs.size(), VK_SUCCESS);
+
+	size_t workerCount = 0;
+	std::vector<double> compileMs = buildInParallel(descs.size(), [&](size_t i)
+	{
+		results[i] = buildPipeline(descs[i], vertexModules[i], fragmentModules[i], &pipelines[i]);
+	}, &workerCount);
+
+	for (size_t i = 0; i < descs.size(); i++)
+	{
+		vkDestroyShaderModule(device, vertexModules[i], nullptr);
+		vkDestroyShaderModule(device, fragmentModules[i], nullptr);
+	}
+
+	bool failed = std::any_of(results.begin(), results.end(), [](VkResult result) { return result != VK_SUCCESS; });
+	if (failed)
+	{
+		destroyCreatedPipelines(pipelines, results);
+		throw std::runtime_error("Failed to create a Graphics Pipeline!");
+	}
+
+	std::vector<std::string> names;
+	for (const auto& desc : descs)
+	{
+		names.push_back(desc.name);
+	}
+	printReport("graphics", names, compileMs, workerCount, elapsedMs(start, PipelineClock::now()));
+
+	return pipelines;
+}
+
+std::vector<VkPipeline> PipelineManager::createComputePipelines(const std::vector<ComputePipelineDesc>& descs)
+{
+	PipelineClock::time_point start = PipelineClock::now();
+
+	std::vector<VkShaderModule> computeModules(descs.size(), VK_NULL_HANDLE);
+	try
+	{
+		for (size_t i = 0; i < descs.size(); i++)
+		{
+			computeModules[i] = createShaderModule(descs[i].computeShader);
+		}
+	}
+	catch (...)
+	{
+		for (auto module : computeModules)
+		{
+			vkDestroyShaderModule(device, module, nullptr);
+		}
+		throw;
+	}
+
+	std::vector<VkPipeline> pipelines(descs.size(), VK_NULL_HANDLE);
+	std::vector<VkResult> results(descs.size(), VK_SUCCESS);
+
+	size_t workerCount = 0;
+	std::vector<double> compileMs = buildInParallel(descs.size(), [&](size_t i)
+	{
+		VkComputePipelineCreateInfo pipelineCreateInfo = {};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCreateInfo.stage.module = computeModules[i];
+		pipelineCreateInfo.stage.pName = "main";
+		pipelineCreateInfo.layout = descs[i].layout;
+		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineCreateInfo.basePipelineIndex = -1;
+
+		results[i] = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines[i]);
+	}, &workerCount);
+
+	for (auto module : computeModules)
+	{
+		vkDestroyShaderModule(device, module, nullptr);
+	}
+
+	bool failed = std::any_of(results.begin(), results.end(), [](VkResult result) { return result != VK_SUCCESS; });
+	if (failed)
+	{
+		destroyCreatedPipelines(pipelines, results);
+		throw std::runtime_error("Failed to create a Compute Pipeline!");
+	}
+
+	std::vector<std::string> names;
+	for (const auto& desc : descs)
+	{
+		names.push_back(desc.name);
+	}
+	printReport("compute", names, compileMs, workerCount, elapsedMs(start, PipelineClock::now()));
+
+	return pipelines;
+}
+
+void PipelineManager::destroyCreatedPipelines(std::vector<VkPipeline>& pipelines, const std::vector<VkResult>& results) const
+{
+	// A failed creation leaves its handle undefined on some drivers, only the successful ones are destroyed
+	for (size_t i = 0; i < pipelines.size(); i++)
+	{
+		if (results[i] == VK_SUCCESS)
+		{
+			vkDestroyPipeline(device, pipelines[i], nullptr);
+		}
+		pipelines[i] = VK_NULL_HANDLE;
+	}
+}
+
+std::vector<double> PipelineManager::buildInParallel(size_t count, const std::function<void(size_t)>& build, size_t* outWorkerCount) const
+{
+	std::vector<double> compileMs(count, 0.0);
+
+	// The pipeline cache is internally synchronised, every worker takes the next pipeline left
+	std::atomic<size_t> nextPipeline{ 0 };
+	auto worker = [&]()
+	{
+		for (size_t i = nextPipeline++; i < count; i = nextPipeline++)
+		{
+			PipelineClock::time_point pipelineStart = PipelineClock::now();
+			build(i);
+			compileMs[i] = elapsedMs(pipelineStart, PipelineClock::now());
+		}
+	};
+
+	size_t workerCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(count, 1));
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < workerCount; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();		// The calling thread works too
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+
+	*outWorkerCount = workerCount;
+	return compileMs;
+}
+
+void PipelineManager::printReport(const char* kind, const std::vector<std::string>& names, const std::vector<double>& compileMs, size_t workerCount, double totalMs) const
+{
+	printf("Created %zu %s pipeline(s) on %zu thread(s) in %.2f ms (%s pipeline cache)\n",
+		names.size(), kind, workerCount, totalMs, cacheLoaded ? "warm" : "cold");
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		printf("  %-24s %8.2f ms\n", names[i].c_str(), compileMs[i]);
+	}
+}
+
+VkPipelineCache PipelineManager::getCache() const
+{
+	return pipelineCache;
+}
+
+bool PipelineManager::isCacheLoaded() const
+{
+	return cacheLoaded;
+}
+
+void PipelineManager::destroy()
+{
+	if (pipelineCache == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if (!saveCache())
+	{
+		printf("Pipeline cache: failed to write %s\n", cacheFile.c_str());
+	}
+
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+	pipelineCache = VK_NULL_HANDLE;
+}
+
+PipelineManager::~PipelineManager()
+{
+}
+
+VkShaderModule PipelineManager::createShaderModule(const std::string& fileName)
+{
+	std::vector<char> code = readFile(fileName);
+
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = code.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	VkResult result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a shader module!");
+	}
+
+	return shaderModule;
+}
+
+VkResult PipelineManager::buildPipeline(const GraphicsPipelineDesc& desc, VkShaderModule vertexModule, VkShaderModule fragmentModule, VkPipeline* outPipeline) const
+{
+	// --- Shader Stages ---
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertexModule;
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragmentModule;
+	shaderStages[1].pName = "main";
+
+	// --- Vertex Input (the Vertex struct) ---
+	VkVertexInputBindingDescription bindingDescription = {};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(Vertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions;
+	attributeDescriptions[0] = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, pos)) };		// Position
+	attributeDescriptions[1] = { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, col)) };		// Colour
+	attributeDescriptions[2] = { 2, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, tex)) };			// Texture coords
+	attributeDescriptions[3] = { 3, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, norm)) };		// Normal
+
+	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	if (desc.vertexInput)
+	{
+		vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
+		vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+	}
+
+	// --- Input Assembly ---
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	// --- Viewport and Scissor ---
+	// Only the counts, the rectangles are dynamic state
+	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
+	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportStateCreateInfo.viewportCount = 1;
+	viewportStateCreateInfo.scissorCount = 1;
+
+	// --- Rasterizer ---
+	VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
+	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizerCreateInfo.depthClampEnable = VK_FALSE;
+	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+	rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizerCreateInfo.lineWidth = 1.0f;
+	rasterizerCreateInfo.cullMode = desc.cullMode;
+	rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizerCreateInfo.depthBiasEnable = desc.depthBias ? VK_TRUE : VK_FALSE;
+
+	// --- Multisampling ---
+	VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
+	multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;
+	multisamplingCreateInfo.rasterizationSamples = desc.samples;
+
+	// --- Color Blending ---
+	// (src alpha * new colour) + (1 - src alpha) * old colour, alpha is replaced
+	VkPipelineColorBlendAttachmentState colourState = {};
+	colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colourState.blendEnable = desc.alphaBlend ? VK_TRUE : VK_FALSE;
+	colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colourState.colorBlendOp = VK_BLEND_OP_ADD;
+	colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colourState.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	std::vector<VkPipelineColorBlendAttachmentState> colourStates(desc.colourAttachmentCount, colourState);
+
+	VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
+	colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colourBlendingCreateInfo.logicOpEnable = VK_FALSE;
+	colourBlendingCreateInfo.attachmentCount = static_cast<uint32_t>(colourStates.size());
+	colourBlendingCreateInfo.pAttachments = colourStates.data();
+
+	// --- Depth Stencil ---
+	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilCreateInfo.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencilCreateInfo.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencilCreateInfo.depthCompareOp = desc.depthCompareOp;
+	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
+	// --- Dynamic State ---
+	// Viewport and scissor follow the swapchain, depth bias values are set per shadow map with vkCmdSetDepthBias
+	std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	if (desc.depthBias)
+	{
+		dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
+	}
+
+	VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+	dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+	// --- Create Graphics Pipeline ---
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stageCount = fragmentModule != VK_NULL_HANDLE ? 2 : 1;
+	pipelineCreateInfo.pStages = shaderStages;
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+	pipelineCreateInfo.layout = desc.layout;
+	pipelineCreateInfo.renderPass = desc.renderPass;
+	pipelineCreateInfo.subpass = desc.subpass;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	return vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, outPipeline);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+/**
+ * @struct GraphicsPipelineDesc
+ * @brief Everything needed to build one graphics pipeline for the Vertex layout.
+ *
+ * Shaders are given as paths to SPIR-V files, a pipeline without fragment shader
+ * (e.g. depth only) leaves fragmentShader empty. Viewport and scissor are dynamic state,
+ * set with vkCmdSetViewport and vkCmdSetScissor, so pipelines survive a swapchain resize.
+ */
+struct GraphicsPipelineDesc
+{
+	std::string name;											///< Name used in the startup report.
+	std::string vertexShader;									///< Path of the vertex shader SPIR-V.
+	std::string fragmentShader;									///< Path of the fragment shader SPIR-V (optional).
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	bool depthTest = true;
+	bool depthWrite = true;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;			///< LESS_OR_EQUAL after a depth prepass.
+	bool depthBias = false;										///< Enables depth bias (shadow maps).
+	bool alphaBlend = true;										///< Source alpha blending on every colour attachment.
+	uint32_t colourAttachmentCount = 1;							///< 0 for depth only passes.
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;		///< Must match the attachments of the render pass.
+	bool vertexInput = true;									///< False for full screen passes generating their vertices.
+};
+
+/**
+ * @struct ComputePipelineDesc
+ * @brief One compute pipeline: a compute shader and its layout.
+ */
+struct ComputePipelineDesc
+{
+	std::string name;											///< Name used in the startup report.
+	std::string computeShader;									///< Path of the compute shader SPIR-V.
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+};
+
+/**
+ * @class PipelineManager
+ * @brief Creates graphics and compute pipelines in parallel through a pipeline cache persisted on disk.
+ *
+ * The cache file starts with a small header of our own (driver version, device and a checksum)
+ * followed by the blob returned by vkGetPipelineCacheData. A blob written by another GPU or
+ * driver, or a damaged file, is ignored and the cache starts empty.
+ */
+class PipelineManager
+{
+public:
+	PipelineManager();
+
+	/**
+	 * @brief Creates the pipeline cache, seeded from the cache file if it's valid for this device.
+	 *
+	 * @param newPhysicalDevice The GPU the pipelines are created for.
+	 * @param newDevice The logical device.
+	 * @param newCacheFile Path of the cache file.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, const std::string& newCacheFile);
+
+	/**
+	 * @brief Creates the pipelines, spread over worker threads, and prints how long they took.
+	 *
+	 * @param descs Description of every pipeline.
+	 * @return The pipelines, in the order of descs. The caller owns them.
+	 * @throws std::runtime_error if a shader can't be loaded or a pipeline fails to compile.
+	 */
+	std::vector<VkPipeline> createGraphicsPipelines(const std::vector<GraphicsPipelineDesc>& descs);
+
+	/**
+	 * @brief Creates the compute pipelines, spread over worker threads, and prints how long they took.
+	 *
+	 * @param descs Description of every pipeline.
+	 * @return The pipelines, in the order of descs. The caller owns them.
+	 * @throws std::runtime_error if a shader can't be loaded or a pipeline fails to compile.
+	 */
+	std::vector<VkPipeline> createComputePipelines(const std::vector<ComputePipelineDesc>& descs);
+
+	/**
+	 * @brief Writes the current content of the cache to the cache file.
+	 *
+	 * @return True on success.
+	 */
+	bool saveCache() const;
+
+	VkPipelineCache getCache() const;
+
+	// True if the cache was seeded from the cache file
+	bool isCacheLoaded() const;
+
+	/**
+	 * @brief Saves and destroys the cache.
+	 */
+	void destroy();
+
+	~PipelineManager();
+
+private:
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties deviceProperties = {};
+
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	std::string cacheFile;
+	bool cacheLoaded = false;
+
+	// Returns the Vulkan blob of the cache file, empty if missing or not valid for this device
+	std::vector<char> loadCacheData() const;
+
+	VkShaderModule createShaderModule(const std::string& fileName);
+
+	// Destroys the pipelines of a failed batch that were created, and clears every handle
+	void destroyCreatedPipelines(std::vector<VkPipeline>& pipelines, const std::vector<VkResult>& results) const;
+
+	// Runs build(i) for every pipeline on worker threads, returns the time each took
+	std::vector<double> buildInParallel(size_t count, const std::function<void(size_t)>& build, size_t* outWorkerCount) const;
+
+	// Prints the startup report of a batch of pipelines
+	void printReport(const char* kind, const std::vector<std::string>& names, const std::vector<double>& compileMs, size_t workerCount, double totalMs) const;
+
+	// Builds the fixed function state of a desc and creates its pipeline (called from the workers)
+	VkResult buildPipeline(const GraphicsPipelineDesc& desc, VkShaderModule vertexModule, VkShaderModule fragmentModule, VkPipeline* outPipeline) const;
+};
@@ -0,0 +1,510 @@
+#include "PostProcessing.h"
+
+#include "FrameContext.h"
+#include "Utilities.h"
+
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	const uint32_t BLOOM_GROUP_SIZE = 8;			// local_size of bloom_down.comp and bloom_up.comp
+	const uint32_t HISTOGRAM_GROUP_SIZE = 16;		// local_size of histogram.comp
+
+	uint32_t groupCount(uint32_t size, uint32_t groupSize)
+	{
+		return (size + groupSize - 1) / groupSize;
+	}
+
+	bool isSrgbFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+	}
+
+	VkDescriptorSetLayout createSetLayout(VkDevice device, const std::vector<VkDescriptorType>& types, VkShaderStageFlags stages)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = types[i];
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = stages;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutCreateInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout;
+		VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &layout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+		}
+
+		return layout;
+	}
+
+	VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout, VkShaderStageFlags stages, uint32_t pushConstantSize)
+	{
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = stages;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = pushConstantSize;
+
+		VkPipelineLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.setLayoutCount = 1;
+		layoutCreateInfo.pSetLayouts = &setLayout;
+		layoutCreateInfo.pushConstantRangeCount = 1;
+		layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout layout;
+		VkResult result = vkCreatePipelineLayout(device, &layoutCreateInfo, nullptr, &layout);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create Pipeline Layout!");
+		}
+
+		return layout;
+	}
+
+	// Collects the descriptor writes of a frame, the infos stay in place until vkUpdateDescriptorSets
+	struct DescriptorWriter
+	{
+		std::deque<VkDescriptorImageInfo> imageInfos;
+		std::deque<VkDescriptorBufferInfo> bufferInfos;
+		std::vector<VkWriteDescriptorSet> writes;
+
+		void image(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view)
+		{
+			VkDescriptorImageInfo imageInfo = {};
+			imageInfo.sampler = sampler;
+			imageInfo.imageView = view;
+			imageInfo.imageLayout = type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfos.push_back(imageInfo);
+
+			VkWriteDescriptorSet write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding;
+			write.descriptorType = type;
+			write.descriptorCount = 1;
+			write.pImageInfo = &imageInfos.back();
+			writes.push_back(write);
+		}
+
+		void buffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer)
+		{
+			VkDescriptorBufferInfo bufferInfo = {};
+			bufferInfo.buffer = buffer;
+			bufferInfo.offset = 0;
+			bufferInfo.range = VK_WHOLE_SIZE;
+			bufferInfos.push_back(bufferInfo);
+
+			VkWriteDescriptorSet write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = binding;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.descriptorCount = 1;
+			write.pBufferInfo = &bufferInfos.back();
+			writes.push_back(write);
+		}
+	};
+}
+
+PostProcessing::PostProcessing()
+{
+}
+
+void PostProcessing::addPasses(RenderGraph& newGraph, RenderGraphResource hdrColour, RenderGraphResource output)
+{
+	graph = &newGraph;
+	hdrColourResource = hdrColour;
+
+	// -- RESOURCES --
+	// Every level half the size of the previous one, the first one half the output
+	RenderGraphImageDesc bloomDesc;
+	bloomDesc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	for (uint32_t i = 0; i < BLOOM_LEVELS; i++)
+	{
+		bloomDesc.scale = 1.0f / static_cast<float>(2u << i);
+		bloomDownResources[i] = graph->createImage("Bloom down " + std::to_string(i), bloomDesc);
+		if (i < BLOOM_LEVELS - 1)
+		{
+			bloomUpResources[i] = graph->createImage("Bloom up " + std::to_string(i), bloomDesc);
+		}
+	}
+
+	RenderGraphBufferDesc histogramDesc;
+	histogramDesc.size = LUMINANCE_HISTOGRAM_BINS * sizeof(uint32_t);
+	histogramResource = graph->createBuffer("Luminance histogram", histogramDesc);
+
+	// Adapted over frames, read by the tonemap at the end of every frame. Shared by both queue families,
+	// the adaptation reads it on the compute queue
+	adaptedLuminanceResource = graph->importImage("Adapted luminance", VK_FORMAT_R32_SFLOAT, RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS, true);
+	graph->exportResource(adaptedLuminanceResource, RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS);
+
+	// -- BLOOM --
+	// The bloom and exposure run on the compute queue. The tonemap waits for them, the first graphics
+	// passes of the next frame can run beside them
+	for (uint32_t i = 0; i < BLOOM_LEVELS; i++)
+	{
+		graph->addPass("Bloom downsample " + std::to_string(i), RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+			.read(i == 0 ? hdrColourResource : bloomDownResources[i - 1], RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+			.write(bloomDownResources[i], RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+			.setExecute([this, i](VkCommandBuffer commandBuffer) { recordBloomDownsample(commandBuffer, i); });
+	}
+
+	for (uint32_t i = BLOOM_LEVELS - 1; i-- > 0;)
+	{
+		RenderGraphResource smaller = i == BLOOM_LEVELS - 2 ? bloomDownResources[BLOOM_LEVELS - 1] : bloomUpResources[i + 1];
+		graph->addPass("Bloom upsample " + std::to_string(i), RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+			.read(bloomDownResources[i], RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+			.read(smaller, RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+			.write(bloomUpResources[i], RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+			.setExecute([this, i](VkCommandBuffer commandBuffer) { recordBloomUpsample(commandBuffer, i); });
+	}
+
+	// -- EXPOSURE --
+	graph->addPass("Histogram clear", RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+		.write(histogramResource, RENDER_GRAPH_ACCESS_TRANSFER_WRITE)
+		.setExecute([this](VkCommandBuffer commandBuffer)
+		{
+			vkCmdFillBuffer(commandBuffer, graph->getBuffer(histogramResource), 0, VK_WHOLE_SIZE, 0);
+		});
+
+	graph->addPass("Luminance histogram", RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+		.read(hdrColourResource, RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE)
+		.readWrite(histogramResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordHistogram(commandBuffer); });
+
+	graph->addPass("Exposure adaptation", RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+		.read(histogramResource, RENDER_GRAPH_ACCESS_STORAGE_READ_COMPUTE)
+		.readWrite(adaptedLuminanceResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordExposure(commandBuffer); });
+
+	// -- TONEMAP --
+	tonemapPass = graph->addPass("Tonemap", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.read(hdrColourResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+		.read(bloomUpResources[0], RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+		.read(adaptedLuminanceResource, RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS)
+		.writeColour(output, false)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordTonemap(commandBuffer); })
+		.getHandle();
+}
+
+void PostProcessing::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue queue, VkCommandPool commandPool, VkFormat outputFormat)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	encodeSrgb = !isSrgbFormat(outputFormat);
+
+	createLayouts();
+	createAdaptedLuminance(queue, commandPool);
+
+	// Bilinear, the bloom filters rely on it to average 4 texels per tap
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.maxLod = 0.0f;
+
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Sampler!");
+	}
+
+	lastFrameTime = std::chrono::steady_clock::now();
+
+	printf("Post processing: %u bloom levels, %u bin luminance histogram (log2 %.0f to %.0f), %s output\n",
+		BLOOM_LEVELS, LUMINANCE_HISTOGRAM_BINS, LUMINANCE_MIN_LOG, LUMINANCE_MAX_LOG, encodeSrgb ? "sRGB encoded" : "sRGB format");
+}
+
+void PostProcessing::createLayouts()
+{
+	bloomDownSetLayout = createSetLayout(device, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	bloomUpSetLayout = createSetLayout(device, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	histogramSetLayout = createSetLayout(device, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	exposureSetLayout = createSetLayout(device, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	tonemapSetLayout = createSetLayout(device, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
+		VK_SHADER_STAGE_FRAGMENT_BIT);
+
+	bloomDownPipelineLayout = createPipelineLayout(device, bloomDownSetLayout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushBloomDown));
+	bloomUpPipelineLayout = createPipelineLayout(device, bloomUpSetLayout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushBloomUp));
+	histogramPipelineLayout = createPipelineLayout(device, histogramSetLayout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushHistogram));
+	exposurePipelineLayout = createPipelineLayout(device, exposureSetLayout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushExposure));
+	tonemapPipelineLayout = createPipelineLayout(device, tonemapSetLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushTonemap));
+}
+
+void PostProcessing::createAdaptedLuminance(VkQueue queue, VkCommandPool commandPool)
+{
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { 1, 1, 1 };
+	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	graph->setConcurrentSharing(imageCreateInfo);		// Imported as concurrent
+
+	VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &adaptedLuminanceImage);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Image!");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, adaptedLuminanceImage, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, &adaptedLuminanceMemory);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate memory for image!");
+	}
+	vkBindImageMemory(device, adaptedLuminanceImage, adaptedLuminanceMemory, 0);
+
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = adaptedLuminanceImage;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = 0;
+	viewCreateInfo.subresourceRange.levelCount = 1;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(device, &viewCreateInfo, nullptr, &adaptedLuminanceView);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Image View!");
+	}
+
+	// Every frame starts with it in the storage layout (the state the graph leaves it in)
+	transitionImageLayout(device, queue, commandPool, adaptedLuminanceImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+	resetExposure = true;
+}
+
+void PostProcessing::appendPipelineDescs(std::vector<GraphicsPipelineDesc>& graphicsDescs, std::vector<VkPipeline*>& graphicsHandles,
+	std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles)
+{
+	GraphicsPipelineDesc tonemapDesc;
+	tonemapDesc.name = "Tonemap";
+	tonemapDesc.vertexShader = "Shaders/fullscreenVert.spv";
+	tonemapDesc.fragmentShader = "Shaders/tonemapFrag.spv";
+	tonemapDesc.layout = tonemapPipelineLayout;
+	tonemapDesc.renderPass = graph->getRenderPass(tonemapPass);
+	tonemapDesc.subpass = 0;
+	tonemapDesc.cullMode = VK_CULL_MODE_NONE;
+	tonemapDesc.depthTest = false;
+	tonemapDesc.depthWrite = false;
+	tonemapDesc.alphaBlend = false;
+	tonemapDesc.vertexInput = false;
+	graphicsDescs.push_back(tonemapDesc);
+	graphicsHandles.push_back(&tonemapPipeline);
+
+	computeDescs.push_back({ "Bloom downsample", "Shaders/bloomDownComp.spv", bloomDownPipelineLayout });
+	computeHandles.push_back(&bloomDownPipeline);
+	computeDescs.push_back({ "Bloom upsample", "Shaders/bloomUpComp.spv", bloomUpPipelineLayout });
+	computeHandles.push_back(&bloomUpPipeline);
+	computeDescs.push_back({ "Luminance histogram", "Shaders/histogramComp.spv", histogramPipelineLayout });
+	computeHandles.push_back(&histogramPipeline);
+	computeDescs.push_back({ "Exposure adaptation", "Shaders/exposureComp.spv", exposurePipelineLayout });
+	computeHandles.push_back(&exposurePipeline);
+}
+
+void PostProcessing::prepareFrame(FrameContext& frame)
+{
+	// Frame rate independent adaptation: the same share of the way is covered per second
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	float deltaTime = std::chrono::duration<float>(now - lastFrameTime).count();
+	lastFrameTime = now;
+	adaptation = 1.0f - std::exp(-deltaTime * settings.adaptationSpeed);
+
+	graph->setImportedImage(adaptedLuminanceResource, adaptedLuminanceImage, adaptedLuminanceView, { 1, 1 }, VK_NULL_HANDLE);
+
+	// The graph's views change with a resize, the sets are written every frame
+	DescriptorWriter writer;
+	for (uint32_t i = 0; i < BLOOM_LEVELS; i++)
+	{
+		RenderGraphResource source = i == 0 ? hdrColourResource : bloomDownResources[i - 1];
+		bloomDownSets[i] = frame.allocateDescriptorSet(bloomDownSetLayout);
+		writer.image(bloomDownSets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, graph->getImageView(source));
+		writer.image(bloomDownSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, graph->getImageView(bloomDownResources[i]));
+	}
+
+	for (uint32_t i = 0; i < BLOOM_LEVELS - 1; i++)
+	{
+		RenderGraphResource smaller = i == BLOOM_LEVELS - 2 ? bloomDownResources[BLOOM_LEVELS - 1] : bloomUpResources[i + 1];
+		bloomUpSets[i] = frame.allocateDescriptorSet(bloomUpSetLayout);
+		writer.image(bloomUpSets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, graph->getImageView(bloomDownResources[i]));
+		writer.image(bloomUpSets[i], 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, graph->getImageView(smaller));
+		writer.image(bloomUpSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, graph->getImageView(bloomUpResources[i]));
+	}
+
+	histogramSet = frame.allocateDescriptorSet(histogramSetLayout);
+	writer.image(histogramSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, graph->getImageView(hdrColourResource));
+	writer.buffer(histogramSet, 1, graph->getBuffer(histogramResource));
+
+	exposureSet = frame.allocateDescriptorSet(exposureSetLayout);
+	writer.buffer(exposureSet, 0, graph->getBuffer(histogramResource));
+	writer.image(exposureSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, adaptedLuminanceView);
+
+	tonemapSet = frame.allocateDescriptorSet(tonemapSetLayout);
+	writer.image(tonemapSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, graph->getImageView(hdrColourResource));
+	writer.image(tonemapSet, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, graph->getImageView(bloomUpResources[0]));
+	writer.image(tonemapSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, adaptedLuminanceView);
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writer.writes.size()), writer.writes.data(), 0, nullptr);
+}
+
+PostProcessingSettings& PostProcessing::getSettings()
+{
+	return settings;
+}
+
+void PostProcessing::recordBloomDownsample(VkCommandBuffer commandBuffer, uint32_t level)
+{
+	RenderGraphResource source = level == 0 ? hdrColourResource : bloomDownResources[level - 1];
+	VkExtent2D sourceExtent = graph->getImageExtent(source);
+	VkExtent2D extent = graph->getImageExtent(bloomDownResources[level]);
+
+	PushBloomDown push;
+	push.sourceTexelSize = glm::vec2(1.0f / sourceExtent.width, 1.0f / sourceExtent.height);
+	push.threshold = settings.bloomThreshold;
+	push.knee = settings.bloomKnee;
+	push.prefilter = level == 0 ? 1 : 0;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomDownPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomDownPipelineLayout, 0, 1, &bloomDownSets[level], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, bloomDownPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushBloomDown), &push);
+	vkCmdDispatch(commandBuffer, groupCount(extent.width, BLOOM_GROUP_SIZE), groupCount(extent.height, BLOOM_GROUP_SIZE), 1);
+}
+
+void PostProcessing::recordBloomUpsample(VkCommandBuffer commandBuffer, uint32_t level)
+{
+	RenderGraphResource smaller = level == BLOOM_LEVELS - 2 ? bloomDownResources[BLOOM_LEVELS - 1] : bloomUpResources[level + 1];
+	VkExtent2D smallerExtent = graph->getImageExtent(smaller);
+	VkExtent2D extent = graph->getImageExtent(bloomUpResources[level]);
+
+	PushBloomUp push;
+	push.smallerTexelSize = glm::vec2(1.0f / smallerExtent.width, 1.0f / smallerExtent.height);
+	push.radius = settings.bloomRadius;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomUpPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bloomUpPipelineLayout, 0, 1, &bloomUpSets[level], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, bloomUpPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushBloomUp), &push);
+	vkCmdDispatch(commandBuffer, groupCount(extent.width, BLOOM_GROUP_SIZE), groupCount(extent.height, BLOOM_GROUP_SIZE), 1);
+}
+
+void PostProcessing::recordHistogram(VkCommandBuffer commandBuffer)
+{
+	VkExtent2D extent = graph->getImageExtent(hdrColourResource);
+
+	PushHistogram push;
+	push.minLogLuminance = LUMINANCE_MIN_LOG;
+	push.inverseLogLuminanceRange = 1.0f / (LUMINANCE_MAX_LOG - LUMINANCE_MIN_LOG);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, histogramPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, histogramPipelineLayout, 0, 1, &histogramSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, histogramPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushHistogram), &push);
+	vkCmdDispatch(commandBuffer, groupCount(extent.width, HISTOGRAM_GROUP_SIZE), groupCount(extent.height, HISTOGRAM_GROUP_SIZE), 1);
+}
+
+void PostProcessing::recordExposure(VkCommandBuffer commandBuffer)
+{
+	VkExtent2D extent = graph->getImageExtent(hdrColourResource);
+
+	PushExposure push;
+	push.minLogLuminance = LUMINANCE_MIN_LOG;
+	push.logLuminanceRange = LUMINANCE_MAX_LOG - LUMINANCE_MIN_LOG;
+	push.adaptation = adaptation;
+	push.pixelCount = static_cast<float>(extent.width) * static_cast<float>(extent.height);
+	push.reset = resetExposure ? 1 : 0;
+
+	// Recorded once per frame, from the next one on the image holds a luminance to adapt from
+	resetExposure = false;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, exposurePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, exposurePipelineLayout, 0, 1, &exposureSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, exposurePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushExposure), &push);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+}
+
+void PostProcessing::recordTonemap(VkCommandBuffer commandBuffer)
+{
+	PushTonemap push;
+	push.bloomStrength = settings.bloomStrength;
+	push.exposureKey = settings.exposureKey;
+	push.encodeSrgb = encodeSrgb ? 1 : 0;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, tonemapPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, tonemapPipelineLayout, 0, 1, &tonemapSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, tonemapPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushTonemap), &push);
+
+	// Full screen triangle, the vertex shader generates it from the vertex index
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void PostProcessing::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyPipeline(device, bloomDownPipeline, nullptr);
+	vkDestroyPipeline(device, bloomUpPipeline, nullptr);
+	vkDestroyPipeline(device, histogramPipeline, nullptr);
+	vkDestroyPipeline(device, exposurePipeline, nullptr);
+	vkDestroyPipeline(device, tonemapPipeline, nullptr);
+
+	vkDestroyPipelineLayout(device, bloomDownPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, bloomUpPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, histogramPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, exposurePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, tonemapPipelineLayout, nullptr);
+
+	vkDestroyDescriptorSetLayout(device, bloomDownSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, bloomUpSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, histogramSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, exposureSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, tonemapSetLayout, nullptr);
+
+	vkDestroySampler(device, sampler, nullptr);
+
+	vkDestroyImageView(device, adaptedLuminanceView, nullptr);
+	vkDestroyImage(device, adaptedLuminanceImage, nullptr);
+	vkFreeMemory(device, adaptedLuminanceMemory, nullptr);
+
+	device = VK_NULL_HANDLE;
+}
+
+PostProcessing::~PostProcessing()
+{
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "RenderGraph.h"
+#include "PipelineManager.h"
+
+class FrameContext;
+
+const uint32_t BLOOM_LEVELS = 5;						// Downsample steps, the smallest level is 1/32 of the output
+const uint32_t LUMINANCE_HISTOGRAM_BINS = 256;			// Must match HISTOGRAM_BINS in histogram.comp and exposure.comp
+const float LUMINANCE_MIN_LOG = -8.0f;					// log2 luminance range of the histogram
+const float LUMINANCE_MAX_LOG = 4.0f;
+
+/**
+ * @struct PostProcessingSettings
+ * @brief Tunables of the bloom and the exposure.
+ */
+struct PostProcessingSettings
+{
+	float bloomThreshold = 1.0f;			///< Brightness the bloom starts at.
+	float bloomKnee = 0.5f;					///< Width of the soft transition below the threshold.
+	float bloomRadius = 1.0f;				///< Upsample filter radius in texels.
+	float bloomStrength = 0.05f;			///< Weight of the bloom added to the scene.
+	float exposureKey = 0.18f;				///< Luminance the scene's average is mapped to.
+	float adaptationSpeed = 1.5f;			///< How fast the exposure follows the scene, per second.
+};
+
+/**
+ * @class PostProcessing
+ * @brief HDR post processing chain: bloom, automatic exposure and tonemapping.
+ *
+ * Every stage is a pass of the render graph, so the graph places the barriers between them and
+ * the GPU profiler times each one. The bloom downsamples the bright parts of the scene into a
+ * pyramid of half sized images and upsamples it back with a tent filter, adding every level on
+ * the way. The exposure comes from a luminance histogram built with shared memory atomics, a
+ * single workgroup averages it and adapts the luminance kept in a 1x1 image across frames.
+ * The bloom and the exposure run in compute, the tonemap is a full screen fragment pass, as the
+ * swapchain images can't be storage images on every device.
+ */
+class PostProcessing
+{
+public:
+	PostProcessing();
+
+	/**
+	 * @brief Declares the passes of the chain.
+	 *
+	 * @param newGraph Graph the passes are added to, before it is compiled.
+	 * @param hdrColour The scene in linear HDR, at the output resolution.
+	 * @param output Image the tonemapped result is rendered into (the backbuffer).
+	 */
+	void addPasses(RenderGraph& newGraph, RenderGraphResource hdrColour, RenderGraphResource output);
+
+	/**
+	 * @brief Creates the layouts, the sampler and the adapted luminance image, after the graph is compiled.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param queue Queue the initial layout transition is submitted to.
+	 * @param commandPool Pool of the transition's command buffer.
+	 * @param outputFormat Format of the output, UNORM formats get the sRGB curve in the shader.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue queue, VkCommandPool commandPool, VkFormat outputFormat);
+
+	/**
+	 * @brief Appends the pipelines of the chain and the members holding them, the caller creates them.
+	 *
+	 * The pipelines stay owned by the post processing, rebuilt ones are written through the handles.
+	 */
+	void appendPipelineDescs(std::vector<GraphicsPipelineDesc>& graphicsDescs, std::vector<VkPipeline*>& graphicsHandles,
+		std::vector<ComputePipelineDesc>& computeDescs, std::vector<VkPipeline*>& computeHandles);
+
+	/**
+	 * @brief Writes the descriptor sets of the frame and imports the adapted luminance.
+	 *
+	 * @param frame The frame context being recorded.
+	 */
+	void prepareFrame(FrameContext& frame);
+
+	PostProcessingSettings& getSettings();
+
+	void destroy();
+
+	~PostProcessing();
+
+private:
+	// Push constants, laid out as in the shaders
+	struct PushBloomDown
+	{
+		glm::vec2 sourceTexelSize;
+		float threshold;
+		float knee;
+		uint32_t prefilter;
+	};
+
+	struct PushBloomUp
+	{
+		glm::vec2 smallerTexelSize;
+		float radius;
+	};
+
+	struct PushHistogram
+	{
+		float minLogLuminance;
+		float inverseLogLuminanceRange;
+	};
+
+	struct PushExposure
+	{
+		float minLogLuminance;
+		float logLuminanceRange;
+		float adaptation;
+		float pixelCount;
+		uint32_t reset;
+	};
+
+	struct PushTonemap
+	{
+		float bloomStrength;
+		float exposureKey;
+		uint32_t encodeSrgb;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	RenderGraph* graph = nullptr;
+	PostProcessingSettings settings;
+	bool encodeSrgb = false;
+
+	// -- GRAPH --
+	RenderGraphResource hdrColourResource = RENDER_GRAPH_INVALID;
+	std::array<RenderGraphResource, BLOOM_LEVELS> bloomDownResources = {};
+	std::array<RenderGraphResource, BLOOM_LEVELS - 1> bloomUpResources = {};		// Level i has the size of bloomDownResources[i]
+	RenderGraphResource histogramResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource adaptedLuminanceResource = RENDER_GRAPH_INVALID;
+	RenderGraphPass tonemapPass = RENDER_GRAPH_INVALID;
+
+	// -- ADAPTED LUMINANCE --
+	// Owned here, the graph's transient memory doesn't survive the frame
+	VkImage adaptedLuminanceImage = VK_NULL_HANDLE;
+	VkDeviceMemory adaptedLuminanceMemory = VK_NULL_HANDLE;
+	VkImageView adaptedLuminanceView = VK_NULL_HANDLE;
+	bool resetExposure = true;				// The image holds no luminance yet
+	std::chrono::steady_clock::time_point lastFrameTime;
+
+	// -- PIPELINES --
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout bloomDownSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout bloomUpSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout histogramSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout exposureSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout tonemapSetLayout = VK_NULL_HANDLE;
+
+	VkPipelineLayout bloomDownPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout bloomUpPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout histogramPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout exposurePipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout tonemapPipelineLayout = VK_NULL_HANDLE;
+
+	VkPipeline bloomDownPipeline = VK_NULL_HANDLE;
+	VkPipeline bloomUpPipeline = VK_NULL_HANDLE;
+	VkPipeline histogramPipeline = VK_NULL_HANDLE;
+	VkPipeline exposurePipeline = VK_NULL_HANDLE;
+	VkPipeline tonemapPipeline = VK_NULL_HANDLE;
+
+	// -- FRAME --
+	std::array<VkDescriptorSet, BLOOM_LEVELS> bloomDownSets = {};
+	std::array<VkDescriptorSet, BLOOM_LEVELS - 1> bloomUpSets = {};
+	VkDescriptorSet histogramSet = VK_NULL_HANDLE;
+	VkDescriptorSet exposureSet = VK_NULL_HANDLE;
+	VkDescriptorSet tonemapSet = VK_NULL_HANDLE;
+	float adaptation = 1.0f;				// Share of the way to the new luminance covered this frame
+
+	void createLayouts();
+	void createAdaptedLuminance(VkQueue queue, VkCommandPool commandPool);
+
+	void recordBloomDownsample(VkCommandBuffer commandBuffer, uint32_t level);
+	void recordBloomUpsample(VkCommandBuffer commandBuffer, uint32_t level);
+	void recordHistogram(VkCommandBuffer commandBuffer);
+	void recordExposure(VkCommandBuffer commandBuffer);
+	void recordTonemap(VkCommandBuffer commandBuffer);
+};
@@ -0,0 +1,1723 @@
+#include "RenderGraph.h"
+
+#include "FrameContext.h"
+#include "GpuProfiler.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+	struct AccessInfo
+	{
+		VkPipelineStageFlags stage;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		VkImageUsageFlags imageUsage;
+		VkBufferUsageFlags bufferUsage;
+	};
+
+	// Indexed by RenderGraphAccess
+	const AccessInfo ACCESS_INFO[RENDER_GRAPH_ACCESS_COUNT] = {
+		// NONE
+		{ VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, 0 },
+		// COLOUR_ATTACHMENT
+		{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0 },
+		// DEPTH_ATTACHMENT
+		{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },
+		// DEPTH_READ
+		{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },
+		// SAMPLED_FRAGMENT
+		{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT },
+		// SAMPLED_COMPUTE
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT },
+		// STORAGE_READ_GRAPHICS
+		{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+		// STORAGE_READ_COMPUTE
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+		// STORAGE_WRITE_COMPUTE
+		{ VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+		// STORAGE_WRITE_GRAPHICS
+		{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+		// VERTEX_BUFFER
+		{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT },
+		// INDIRECT_BUFFER
+		{ VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT },
+		// TRANSFER_READ
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT },
+		// TRANSFER_WRITE
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT },
+		// HOST_READ
+		{ VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, 0, 0 },
+		// PRESENT
+		{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, 0 },
+	};
+
+	const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	bool isDepthFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+			format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	bool hasStencil(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	// Lazily allocated memory (tile memory on mobile GPUs) if the device has it, plain device local memory otherwise
+	uint32_t findAttachmentMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, bool lazy)
+	{
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+		VkMemoryPropertyFlags preferred = lazy ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		for (VkMemoryPropertyFlags properties : { preferred, static_cast<VkMemoryPropertyFlags>(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) })
+		{
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+			{
+				if ((allowedTypes & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+				{
+					return i;
+				}
+			}
+		}
+
+		throw std::runtime_error("Failed to find a device local memory type for a render graph resource!");
+	}
+}
+
+RenderGraphPassBuilder::RenderGraphPassBuilder(RenderGraph* newGraph, RenderGraphPass newPass)
+	: graph(newGraph), pass(newPass)
+{
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::writeColour(RenderGraphResource image, bool clear, VkClearColorValue clearColour)
+{
+	RenderGraph::Pass& target = graph->passes[pass];
+	target.colourAttachments.push_back(image);
+	target.clearColour.push_back(clear);
+	target.clearColours.push_back(clearColour);
+	target.resolveAttachments.push_back(RENDER_GRAPH_INVALID);
+	target.colourSubpasses.push_back(target.subpassCount - 1);
+	target.accesses.push_back({ image, RENDER_GRAPH_ACCESS_COLOUR_ATTACHMENT, !clear, true });
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::writeDepth(RenderGraphResource image, bool clear, float clearDepth)
+{
+	RenderGraph::Pass& target = graph->passes[pass];
+	target.depthAttachment = image;
+	target.depthSubpass = target.subpassCount - 1;
+	target.depthReadOnly = false;
+	target.clearDepth = clear;
+	target.clearDepthValue = clearDepth;
+	target.accesses.push_back({ image, RENDER_GRAPH_ACCESS_DEPTH_ATTACHMENT, !clear, true });
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::readDepth(RenderGraphResource image)
+{
+	RenderGraph::Pass& target = graph->passes[pass];
+	target.depthAttachment = image;
+	target.depthSubpass = target.subpassCount - 1;
+	target.depthReadOnly = true;
+	target.clearDepth = false;
+	target.accesses.push_back({ image, RENDER_GRAPH_ACCESS_DEPTH_READ, true, false });
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::resolveColour(RenderGraphResource source, RenderGraphResource target)
+{
+	RenderGraph::Pass& pass = graph->passes[this->pass];
+	for (size_t i = 0; i < pass.colourAttachments.size(); i++)
+	{
+		if (pass.colourAttachments[i] == source)
+		{
+			pass.resolveAttachments[i] = target;
+			pass.accesses.push_back({ target, RENDER_GRAPH_ACCESS_COLOUR_ATTACHMENT, false, true });
+			return *this;
+		}
+	}
+
+	throw std::runtime_error("Failed to add a resolve, the source is not a colour attachment of the pass!");
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::nextSubpass()
+{
+	graph->passes[pass].subpassCount++;
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::readInput(RenderGraphResource image)
+{
+	// Already declared by the attachment, the graph only sees the render pass as a whole
+	RenderGraph::Pass& target = graph->passes[pass];
+	uint32_t subpass = target.subpassCount - 1;
+	bool written = target.depthAttachment == image && target.depthSubpass < subpass;
+	for (size_t i = 0; i < target.colourAttachments.size(); i++)
+	{
+		written |= target.colourAttachments[i] == image && target.colourSubpasses[i] < subpass;
+	}
+
+	if (!written)
+	{
+		throw std::runtime_error("Failed to add an input attachment, it is not written by an earlier subpass of the pass!");
+	}
+
+	target.inputAttachments.push_back(image);
+	target.inputSubpasses.push_back(subpass);
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::read(RenderGraphResource resource, RenderGraphAccess access)
+{
+	graph->passes[pass].accesses.push_back({ resource, access, true, false });
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::write(RenderGraphResource resource, RenderGraphAccess access)
+{
+	graph->passes[pass].accesses.push_back({ resource, access, false, true });
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::readWrite(RenderGraphResource resource, RenderGraphAccess access)
+{
+	graph->passes[pass].accesses.push_back({ resource, access, true, true });
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::setSideEffect()
+{
+	graph->passes[pass].sideEffect = true;
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::setPipelineStatistics()
+{
+	graph->passes[pass].pipelineStatistics = true;
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::setExecute(std::function<void(VkCommandBuffer)> execute)
+{
+	graph->passes[pass].execute = execute;
+	return *this;
+}
+
+RenderGraphPass RenderGraphPassBuilder::getHandle() const
+{
+	return pass;
+}
+
+RenderGraph::RenderGraph()
+{
+}
+
+void RenderGraph::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue newGraphicsQueue, uint32_t graphicsFamily,
+	VkQueue newComputeQueue, uint32_t computeFamily, bool timelineSemaphores)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	// Without timeline semaphores the queues can't be ordered, everything goes to the graphics queue
+	asyncCompute = newComputeQueue != VK_NULL_HANDLE && timelineSemaphores;
+	queues[RENDER_GRAPH_QUEUE_GRAPHICS] = newGraphicsQueue;
+	queues[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE] = asyncCompute ? newComputeQueue : newGraphicsQueue;
+	queueFamilies[RENDER_GRAPH_QUEUE_GRAPHICS] = graphicsFamily;
+	queueFamilies[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE] = asyncCompute ? computeFamily : graphicsFamily;
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.imageDesc = desc;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createBuffer(const std::string& name, const RenderGraphBufferDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = false;
+	resource.bufferDesc = desc;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, VkFormat format, RenderGraphAccess initialAccess, bool concurrent)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.concurrent = concurrent;
+	resource.imageDesc.format = format;
+	resource.initialAccess = initialAccess;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, RenderGraphAccess initialAccess)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.initialAccess = initialAccess;
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+void RenderGraph::setConcurrentSharing(VkImageCreateInfo& imageCreateInfo) const
+{
+	if (queueFamilies[RENDER_GRAPH_QUEUE_GRAPHICS] == queueFamilies[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE])
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCreateInfo.queueFamilyIndexCount = 0;
+		imageCreateInfo.pQueueFamilyIndices = nullptr;
+		return;
+	}
+
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+	imageCreateInfo.queueFamilyIndexCount = RENDER_GRAPH_QUEUE_COUNT;
+	imageCreateInfo.pQueueFamilyIndices = queueFamilies;
+}
+
+void RenderGraph::exportResource(RenderGraphResource resource, RenderGraphAccess finalAccess)
+{
+	resources[resource].exported = true;
+	resources[resource].finalAccess = finalAccess;
+}
+
+RenderGraphPassBuilder RenderGraph::addPass(const std::string& name, RenderGraphQueue queue)
+{
+	Pass pass;
+	pass.name = name;
+	pass.queue = queue;
+	passes.push_back(pass);
+	return RenderGraphPassBuilder(this, static_cast<RenderGraphPass>(passes.size() - 1));
+}
+
+void RenderGraph::compile(VkExtent2D newExtent)
+{
+	extent = newExtent;
+
+	for (auto& pass : passes)
+	{
+		pass.effectiveQueue = asyncCompute ? pass.queue : RENDER_GRAPH_QUEUE_GRAPHICS;
+		if (pass.queue != RENDER_GRAPH_QUEUE_GRAPHICS && (!pass.colourAttachments.empty() || pass.depthAttachment != RENDER_GRAPH_INVALID))
+		{
+			throw std::runtime_error("Failed to compile the render graph, only graphics passes can have attachments!");
+		}
+	}
+
+	// Imported contents are owned by the graphics family between frames, passes reading them stay on its queue.
+	// Concurrent images belong to both families, they need no transfer
+	if (queueFamilies[RENDER_GRAPH_QUEUE_GRAPHICS] != queueFamilies[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE])
+	{
+		for (auto& pass : passes)
+		{
+			for (const auto& access : pass.accesses)
+			{
+				const Resource& resource = resources[access.resource];
+				if (resource.imported && !resource.concurrent && resource.initialAccess != RENDER_GRAPH_ACCESS_NONE)
+				{
+					pass.effectiveQueue = RENDER_GRAPH_QUEUE_GRAPHICS;
+				}
+			}
+		}
+	}
+
+	cullPasses();
+	orderPasses();
+	buildBatches();
+	computeQueueTransfers();
+	computeLifetimes();
+	createRenderPasses();
+	createTimelines();
+	allocateResources();
+
+	compiled = true;
+	printSummary();
+}
+
+void RenderGraph::resize(VkExtent2D newExtent)
+{
+	extent = newExtent;
+	destroyResources();
+	allocateResources();
+}
+
+void RenderGraph::cullPasses()
+{
+	// Backwards through the declaration (execution) order: a resource is needed when it is exported or a
+	// later live pass reads it, a pass lives when it has side effects or writes a needed resource. A pass
+	// only reading and writing a resource (readWrite, loaded attachments) does not keep itself alive
+	std::vector<bool> needed(resources.size(), false);
+	for (RenderGraphResource r = 0; r < resources.size(); r++)
+	{
+		needed[r] = resources[r].exported;
+	}
+
+	for (size_t p = passes.size(); p-- > 0;)
+	{
+		Pass& pass = passes[p];
+		pass.culled = !pass.sideEffect;
+		for (const auto& access : pass.accesses)
+		{
+			if (access.write && needed[access.resource])
+			{
+				pass.culled = false;
+			}
+		}
+
+		if (pass.culled)
+		{
+			continue;
+		}
+		for (const auto& access : pass.accesses)
+		{
+			if (access.read)
+			{
+				needed[access.resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::orderPasses()
+{
+	// Dependencies in declaration order: read after write, write after read and write after write
+	size_t passCount = passes.size();
+	std::vector<std::vector<bool>> dependsOn(passCount, std::vector<bool>(passCount, false));
+
+	for (RenderGraphResource r = 0; r < resources.size(); r++)
+	{
+		uint32_t lastWriter = RENDER_GRAPH_INVALID;
+		std::vector<uint32_t> readers;
+
+		for (uint32_t p = 0; p < passCount; p++)
+		{
+			if (passes[p].culled)
+			{
+				continue;
+			}
+			for (const auto& access : passes[p].accesses)
+			{
+				if (access.resource != r)
+				{
+					continue;
+				}
+
+				if (lastWriter != RENDER_GRAPH_INVALID && lastWriter != p)
+				{
+					dependsOn[p][lastWriter] = true;
+				}
+				if (access.write)
+				{
+					for (uint32_t reader : readers)
+					{
+						if (reader != p) dependsOn[p][reader] = true;
+					}
+					readers.clear();
+					lastWriter = p;
+				}
+				else
+				{
+					readers.push_back(p);
+				}
+			}
+		}
+	}
+
+	// Topological order. Ready async compute passes go first, so they overlap the graphics passes after them,
+	// otherwise the declaration order is kept
+	executionOrder.clear();
+	std::vector<bool> scheduled(passCount, false);
+	for (uint32_t p = 0; p < passCount; p++)
+	{
+		if (passes[p].culled) scheduled[p] = true;
+	}
+
+	while (true)
+	{
+		uint32_t next = RENDER_GRAPH_INVALID;
+		for (uint32_t p = 0; p < passCount; p++)
+		{
+			if (scheduled[p])
+			{
+				continue;
+			}
+
+			bool ready = true;
+			for (uint32_t d = 0; d < passCount && ready; d++)
+			{
+				ready = !dependsOn[p][d] || scheduled[d];
+			}
+			if (!ready)
+			{
+				continue;
+			}
+
+			if (next == RENDER_GRAPH_INVALID)
+			{
+				next = p;
+			}
+			if (passes[p].effectiveQueue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+			{
+				next = p;
+				break;
+			}
+		}
+
+		if (next == RENDER_GRAPH_INVALID)
+		{
+			break;
+		}
+		scheduled[next] = true;
+		executionOrder.push_back(next);
+	}
+}
+
+void RenderGraph::buildBatches()
+{
+	batches.clear();
+	for (uint32_t p : executionOrder)
+	{
+		if (batches.empty() || batches.back().queue != passes[p].effectiveQueue)
+		{
+			Batch batch;
+			batch.queue = passes[p].effectiveQueue;
+			batches.push_back(batch);
+		}
+		batches.back().passes.push_back(p);
+	}
+
+	// The frame ends on the graphics queue: the final transitions, the signal for the present and the fence
+	if (batches.empty() || batches.back().queue != RENDER_GRAPH_QUEUE_GRAPHICS)
+	{
+		batches.push_back(Batch());
+	}
+}
+
+void RenderGraph::computeQueueTransfers()
+{
+	for (auto& batch : batches)
+	{
+		batch.releases.clear();
+	}
+
+	// Queues of one family share ownership, the timeline waits are enough
+	if (queueFamilies[RENDER_GRAPH_QUEUE_GRAPHICS] == queueFamilies[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE])
+	{
+		return;
+	}
+
+	std::vector<uint32_t> passBatch(passes.size(), RENDER_GRAPH_INVALID);
+	for (uint32_t b = 0; b < batches.size(); b++)
+	{
+		for (uint32_t p : batches[b].passes)
+		{
+			passBatch[p] = b;
+		}
+	}
+
+	// Transfer where consecutive accesses change queue and the second one needs the contents,
+	// a write only access discards them and takes the resource over without a transfer.
+	// Concurrent resources are never transferred, the timeline waits are enough
+	for (RenderGraphResource r = 0; r < resources.size(); r++)
+	{
+		if (resources[r].concurrent)
+		{
+			continue;
+		}
+
+		int lastQueue = -1;
+		uint32_t lastBatch = 0;
+
+		for (uint32_t p : executionOrder)
+		{
+			for (const auto& access : passes[p].accesses)
+			{
+				if (access.resource != r)
+				{
+					continue;
+				}
+
+				if (lastQueue >= 0 && lastQueue != static_cast<int>(passes[p].effectiveQueue) && access.read)
+				{
+					batches[lastBatch].releases.push_back({ r, access.access, true, false });
+				}
+				lastQueue = passes[p].effectiveQueue;
+				lastBatch = passBatch[p];
+			}
+		}
+
+		// The final transition of an exported resource is on the graphics queue
+		if (resources[r].exported && resources[r].finalAccess != RENDER_GRAPH_ACCESS_NONE && lastQueue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+		{
+			batches[lastBatch].releases.push_back({ r, resources[r].finalAccess, true, false });
+		}
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	for (auto& resource : resources)
+	{
+		resource.imageUsage = 0;
+		resource.bufferUsage = 0;
+		resource.firstPass = RENDER_GRAPH_INVALID;
+		resource.lastPass = 0;
+		resource.queueMask = 0;
+	}
+
+	for (uint32_t order = 0; order < executionOrder.size(); order++)
+	{
+		const Pass& pass = passes[executionOrder[order]];
+		for (const auto& access : pass.accesses)
+		{
+			Resource& resource = resources[access.resource];
+			resource.imageUsage |= ACCESS_INFO[access.access].imageUsage;
+			resource.bufferUsage |= ACCESS_INFO[access.access].bufferUsage;
+			resource.firstPass = std::min(resource.firstPass, order);
+			resource.lastPass = std::max(resource.lastPass, order);
+			resource.queueMask |= 1u << pass.effectiveQueue;
+		}
+		for (RenderGraphResource input : pass.inputAttachments)
+		{
+			resources[input].imageUsage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+		}
+	}
+
+	for (auto& resource : resources)
+	{
+		if (resource.isImage)
+		{
+			VkFormat format = resource.imageDesc.format;
+			resource.aspect = isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+			if (hasStencil(format))
+			{
+				resource.aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+		}
+	}
+}
+
+bool RenderGraph::hasContentsBefore(RenderGraphResource resource, uint32_t orderIndex) const
+{
+	const Resource& target = resources[resource];
+	if (target.imported && target.initialAccess != RENDER_GRAPH_ACCESS_NONE)
+	{
+		return true;
+	}
+
+	for (uint32_t order = 0; order < orderIndex; order++)
+	{
+		for (const auto& access : passes[executionOrder[order]].accesses)
+		{
+			if (access.resource == resource && access.write)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool RenderGraph::isUsedAfter(RenderGraphResource resource, uint32_t orderIndex) const
+{
+	if (resources[resource].exported)
+	{
+		return true;
+	}
+
+	for (uint32_t order = orderIndex + 1; order < executionOrder.size(); order++)
+	{
+		for (const auto& access : passes[executionOrder[order]].accesses)
+		{
+			if (access.resource == resource && access.read)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void RenderGraph::createRenderPasses()
+{
+	for (uint32_t order = 0; order < executionOrder.size(); order++)
+	{
+		Pass& pass = passes[executionOrder[order]];
+		if (pass.colourAttachments.empty() && pass.depthAttachment == RENDER_GRAPH_INVALID)
+		{
+			continue;
+		}
+
+		// Layouts don't change inside the render pass, the barriers before it do the transitions
+		std::vector<VkAttachmentDescription> attachments;
+		std::vector<VkAttachmentReference> colourReferences;
+		for (size_t i = 0; i < pass.colourAttachments.size(); i++)
+		{
+			RenderGraphResource resource = pass.colourAttachments[i];
+
+			VkAttachmentDescription attachment = {};
+			attachment.format = resources[resource].imageDesc.format;
+			attachment.samples = resources[resource].imageDesc.samples;
+			attachment.loadOp = pass.clearColour[i] ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+				hasContentsBefore(resource, order) ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.storeOp = isUsedAfter(resource, order) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachments.push_back(attachment);
+
+			VkAttachmentReference reference = {};
+			reference.attachment = static_cast<uint32_t>(i);
+			reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colourReferences.push_back(reference);
+		}
+
+		VkAttachmentReference depthReference = {};
+		if (pass.depthAttachment != RENDER_GRAPH_INVALID)
+		{
+			RenderGraphResource resource = pass.depthAttachment;
+			VkImageLayout layout = pass.depthReadOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+			VkAttachmentDescription attachment = {};
+			attachment.format = resources[resource].imageDesc.format;
+			attachment.samples = resources[resource].imageDesc.samples;
+			attachment.loadOp = pass.clearDepth ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+				hasContentsBefore(resource, order) ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.storeOp = isUsedAfter(resource, order) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = layout;
+			attachment.finalLayout = layout;
+			attachments.push_back(attachment);
+
+			depthReference.attachment = static_cast<uint32_t>(attachments.size() - 1);
+			depthReference.layout = layout;
+		}
+
+		// Resolve targets after the depth attachment, one reference per colour attachment
+		std::vector<VkAttachmentReference> resolveReferences;
+		bool hasResolve = false;
+		for (RenderGraphResource resource : pass.resolveAttachments)
+		{
+			VkAttachmentReference reference = {};
+			reference.attachment = VK_ATTACHMENT_UNUSED;
+			reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+			if (resource != RENDER_GRAPH_INVALID)
+			{
+				// Fully overwritten by the resolve
+				VkAttachmentDescription attachment = {};
+				attachment.format = resources[resource].imageDesc.format;
+				attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+				attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.storeOp = isUsedAfter(resource, order) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				attachments.push_back(attachment);
+
+				reference.attachment = static_cast<uint32_t>(attachments.size() - 1);
+				hasResolve = true;
+			}
+			resolveReferences.push_back(reference);
+		}
+
+		// Every subpass references its own attachments. Inputs are read in a shader readable layout,
+		// the render pass moves them there and back to the attachment layout at the end
+		std::vector<std::vector<VkAttachmentReference>> subpassColours(pass.subpassCount);
+		std::vector<std::vector<VkAttachmentReference>> subpassResolves(pass.subpassCount);
+		std::vector<std::vector<VkAttachmentReference>> subpassInputs(pass.subpassCount);
+		for (size_t i = 0; i < pass.colourAttachments.size(); i++)
+		{
+			subpassColours[pass.colourSubpasses[i]].push_back(colourReferences[i]);
+			subpassResolves[pass.colourSubpasses[i]].push_back(resolveReferences[i]);
+		}
+		for (size_t i = 0; i < pass.inputAttachments.size(); i++)
+		{
+			VkAttachmentReference reference = {};
+			if (pass.inputAttachments[i] == pass.depthAttachment)
+			{
+				reference.attachment = depthReference.attachment;
+				reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			}
+			else
+			{
+				size_t colour = std::find(pass.colourAttachments.begin(), pass.colourAttachments.end(), pass.inputAttachments[i]) - pass.colourAttachments.begin();
+				reference.attachment = static_cast<uint32_t>(colour);
+				reference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+			subpassInputs[pass.inputSubpasses[i]].push_back(reference);
+		}
+
+		std::vector<VkSubpassDescription> subpasses(pass.subpassCount);
+		for (uint32_t s = 0; s < pass.subpassCount; s++)
+		{
+			VkSubpassDescription& subpass = subpasses[s];
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = static_cast<uint32_t>(subpassColours[s].size());
+			subpass.pColorAttachments = subpassColours[s].data();
+			subpass.pResolveAttachments = hasResolve && !subpassResolves[s].empty() ? subpassResolves[s].data() : nullptr;
+			subpass.inputAttachmentCount = static_cast<uint32_t>(subpassInputs[s].size());
+			subpass.pInputAttachments = subpassInputs[s].data();
+			subpass.pDepthStencilAttachment = pass.depthAttachment != RENDER_GRAPH_INVALID && pass.depthSubpass == s ? &depthReference : nullptr;
+		}
+
+		// A subpass reading inputs waits for the attachment writes of every subpass before it, per pixel.
+		// A depth attachment is accessed in both fragment test stages, on either side of the dependency
+		const VkPipelineStageFlags fragmentTestStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		std::vector<VkSubpassDependency> dependencies;
+		for (uint32_t s = 1; s < pass.subpassCount; s++)
+		{
+			if (subpassInputs[s].empty())
+			{
+				continue;
+			}
+
+			for (uint32_t source = 0; source < s; source++)
+			{
+				VkSubpassDependency dependency = {};
+				dependency.srcSubpass = source;
+				dependency.dstSubpass = s;
+				dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+				dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+				dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+				dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+				dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+				if (pass.depthAttachment != RENDER_GRAPH_INVALID && pass.depthSubpass == source)
+				{
+					dependency.srcStageMask |= fragmentTestStages;
+					dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+					dependency.dstStageMask |= fragmentTestStages;
+					dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+				}
+				dependencies.push_back(dependency);
+			}
+		}
+
+		VkRenderPassCreateInfo renderPassCreateInfo = {};
+		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassCreateInfo.pAttachments = attachments.data();
+		renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+		renderPassCreateInfo.pSubpasses = subpasses.data();
+		renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassCreateInfo.pDependencies = dependencies.data();
+
+		VkResult result = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &pass.renderPass);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Render Pass!");
+		}
+	}
+}
+
+void RenderGraph::createTimelines()
+{
+	if (!asyncCompute)
+	{
+		return;
+	}
+
+	VkSemaphoreTypeCreateInfo typeCreateInfo = {};
+	typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &typeCreateInfo;
+
+	for (uint32_t q = 0; q < RENDER_GRAPH_QUEUE_COUNT; q++)
+	{
+		if (vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &timelines[q]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Timeline Semaphore!");
+		}
+		timelineValues[q] = 0;
+	}
+}
+
+void RenderGraph::allocateResources()
+{
+	// Create the transient resources, alive ones only (a culled graph branch costs no memory)
+	std::vector<RenderGraphResource> transients;
+	std::vector<VkMemoryRequirements> requirements(resources.size());
+	for (RenderGraphResource r = 0; r < resources.size(); r++)
+	{
+		Resource& resource = resources[r];
+		resource.memoryBlock = RENDER_GRAPH_INVALID;
+		resource.touched = false;
+		resource.lazy = false;
+		if (resource.imported || resource.firstPass == RENDER_GRAPH_INVALID)
+		{
+			continue;
+		}
+
+		if (resource.isImage)
+		{
+			const RenderGraphImageDesc& desc = resource.imageDesc;
+			resource.extent.width = desc.width != 0 ? desc.width : std::max(1u, static_cast<uint32_t>(extent.width * desc.scale));
+			resource.extent.height = desc.height != 0 ? desc.height : std::max(1u, static_cast<uint32_t>(extent.height * desc.scale));
+
+			VkImageCreateInfo imageCreateInfo = {};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.extent.width = resource.extent.width;
+			imageCreateInfo.extent.height = resource.extent.height;
+			imageCreateInfo.extent.depth = 1;
+			imageCreateInfo.mipLevels = desc.mipLevels;
+			imageCreateInfo.arrayLayers = 1;
+			imageCreateInfo.format = desc.format;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageCreateInfo.usage = resource.imageUsage;
+			imageCreateInfo.samples = desc.samples;
+
+			// Attachments produced and consumed inside a single render pass never need to leave the tile,
+			// e.g. multisampled targets that are resolved at the end of the pass
+			const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+			if (!resource.exported && resource.firstPass == resource.lastPass && (resource.imageUsage & ~attachmentUsage) == 0)
+			{
+				resource.lazy = true;
+				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			}
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateImage(device, &imageCreateInfo, nullptr, &resource.image) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a render graph Image!");
+			}
+			vkGetImageMemoryRequirements(device, resource.image, &requirements[r]);
+		}
+		else
+		{
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = resource.bufferDesc.size;
+			bufferInfo.usage = resource.bufferUsage;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateBuffer(device, &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create a render graph Buffer!");
+			}
+			vkGetBufferMemoryRequirements(device, resource.buffer, &requirements[r]);
+		}
+
+		transients.push_back(r);
+	}
+
+	// Largest first, so the first occupant of a block sets its size
+	std::sort(transients.begin(), transients.end(), [&](RenderGraphResource a, RenderGraphResource b)
+	{
+		return requirements[a].size > requirements[b].size;
+	});
+
+	// Greedy placement: share a block with resources whose lifetimes don't overlap
+	memoryBlocks.clear();
+	for (RenderGraphResource r : transients)
+	{
+		Resource& resource = resources[r];
+		uint32_t memoryTypeIndex = findAttachmentMemoryTypeIndex(physicalDevice, requirements[r].memoryTypeBits, resource.lazy);
+
+		// Resources used by several queues would need cross queue ordering with every other occupant, they get their own block
+		bool singleQueue = (resource.queueMask & (resource.queueMask - 1)) == 0;
+
+		for (uint32_t b = 0; b < memoryBlocks.size() && singleQueue; b++)
+		{
+			MemoryBlock& block = memoryBlocks[b];
+			if (block.forImages != resource.isImage || block.queueMask != resource.queueMask ||
+				block.memoryTypeIndex != memoryTypeIndex || block.size < requirements[r].size)
+			{
+				continue;
+			}
+
+			bool overlaps = false;
+			for (RenderGraphResource other : block.resources)
+			{
+				if (resource.firstPass <= resources[other].lastPass && resources[other].firstPass <= resource.lastPass)
+				{
+					overlaps = true;
+					break;
+				}
+			}
+
+			if (!overlaps)
+			{
+				block.resources.push_back(r);
+				resource.memoryBlock = b;
+				break;
+			}
+		}
+
+		if (resource.memoryBlock == RENDER_GRAPH_INVALID)
+		{
+			MemoryBlock block;
+			block.size = requirements[r].size;
+			block.memoryTypeIndex = memoryTypeIndex;
+			block.forImages = resource.isImage;
+			block.queueMask = singleQueue ? resource.queueMask : 0;
+			block.resources.push_back(r);
+			memoryBlocks.push_back(block);
+			resource.memoryBlock = static_cast<uint32_t>(memoryBlocks.size() - 1);
+		}
+	}
+
+	// Allocate the blocks and bind every occupant at the start
+	for (auto& block : memoryBlocks)
+	{
+		VkMemoryAllocateInfo memoryAllocInfo = {};
+		memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocInfo.allocationSize = block.size;
+		memoryAllocInfo.memoryTypeIndex = block.memoryTypeIndex;
+
+		if (vkAllocateMemory(device, &memoryAllocInfo, nullptr, &block.memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate memory for the render graph!");
+		}
+
+		for (RenderGraphResource r : block.resources)
+		{
+			if (resources[r].isImage)
+			{
+				vkBindImageMemory(device, resources[r].image, block.memory, 0);
+			}
+			else
+			{
+				vkBindBufferMemory(device, resources[r].buffer, block.memory, 0);
+			}
+		}
+	}
+
+	// Views for the images
+	for (RenderGraphResource r : transients)
+	{
+		Resource& resource = resources[r];
+		if (!resource.isImage)
+		{
+			continue;
+		}
+
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = resource.image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = resource.imageDesc.format;
+		viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+		// Depth only, a view can't be sampled with both aspects
+		viewCreateInfo.subresourceRange.aspectMask = isDepthFormat(resource.imageDesc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCreateInfo.subresourceRange.baseMipLevel = 0;
+		viewCreateInfo.subresourceRange.levelCount = resource.imageDesc.mipLevels;
+		viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+		viewCreateInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &viewCreateInfo, nullptr, &resource.view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a render graph Image View!");
+		}
+	}
+}
+
+void RenderGraph::destroyResources()
+{
+	for (auto& framebuffer : framebuffers)
+	{
+		vkDestroyFramebuffer(device, framebuffer.second, nullptr);
+	}
+	framebuffers.clear();
+
+	for (auto& resource : resources)
+	{
+		if (resource.imported)
+		{
+			continue;
+		}
+
+		if (resource.view != VK_NULL_HANDLE) vkDestroyImageView(device, resource.view, nullptr);
+		if (resource.image != VK_NULL_HANDLE) vkDestroyImage(device, resource.image, nullptr);
+		if (resource.buffer != VK_NULL_HANDLE) vkDestroyBuffer(device, resource.buffer, nullptr);
+		resource.view = VK_NULL_HANDLE;
+		resource.image = VK_NULL_HANDLE;
+		resource.buffer = VK_NULL_HANDLE;
+	}
+
+	for (auto& block : memoryBlocks)
+	{
+		vkFreeMemory(device, block.memory, nullptr);
+	}
+	memoryBlocks.clear();
+}
+
+void RenderGraph::setImportedImage(RenderGraphResource resource, VkImage image, VkImageView view, VkExtent2D imageExtent, VkSemaphore waitSemaphore)
+{
+	Resource& target = resources[resource];
+	target.image = image;
+	target.view = view;
+	target.extent = imageExtent;
+	target.waitSemaphore = waitSemaphore;
+}
+
+void RenderGraph::setImportedBuffer(RenderGraphResource resource, VkBuffer buffer)
+{
+	resources[resource].buffer = buffer;
+}
+
+void RenderGraph::setProfiler(GpuProfiler* newProfiler)
+{
+	profiler = newProfiler;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(const Pass& pass, VkExtent2D* outExtent)
+{
+	std::vector<VkImageView> views;
+	for (RenderGraphResource resource : pass.colourAttachments)
+	{
+		views.push_back(resources[resource].view);
+	}
+	if (pass.depthAttachment != RENDER_GRAPH_INVALID)
+	{
+		views.push_back(resources[pass.depthAttachment].view);
+	}
+	for (RenderGraphResource resource : pass.resolveAttachments)
+	{
+		if (resource != RENDER_GRAPH_INVALID)
+		{
+			views.push_back(resources[resource].view);
+		}
+	}
+
+	RenderGraphResource first = pass.colourAttachments.empty() ? pass.depthAttachment : pass.colourAttachments[0];
+	*outExtent = resources[first].extent;
+
+	// Imported images change every frame (swapchain), the framebuffers are cached per set of views
+	auto key = std::make_pair(pass.renderPass, views);
+	auto found = framebuffers.find(key);
+	if (found != framebuffers.end())
+	{
+		return found->second;
+	}
+
+	VkFramebufferCreateInfo framebufferCreateInfo = {};
+	framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferCreateInfo.renderPass = pass.renderPass;
+	framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(views.size());
+	framebufferCreateInfo.pAttachments = views.data();
+	framebufferCreateInfo.width = outExtent->width;
+	framebufferCreateInfo.height = outExtent->height;
+	framebufferCreateInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(device, &framebufferCreateInfo, nullptr, &framebuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Framebuffer!");
+	}
+	framebuffers[key] = framebuffer;
+	return framebuffer;
+}
+
+void RenderGraph::prepareAccess(RenderGraphResource resourceIndex, RenderGraphAccess access, bool write, RenderGraphQueue queue,
+	uint64_t submitValue, BarrierBatch& barriers, std::vector<SemaphoreWait>& waits)
+{
+	Resource& resource = resources[resourceIndex];
+	ResourceState& state = resource.state;
+	const AccessInfo& info = ACCESS_INFO[access];
+
+	// -- FIRST ACCESS OF THE FRAME --
+	if (!resource.touched)
+	{
+		resource.touched = true;
+		state = ResourceState();
+
+		if (resource.imported)
+		{
+			const AccessInfo& initial = ACCESS_INFO[resource.initialAccess];
+			state.layout = initial.layout;
+			state.writeAccess = initial.access & WRITE_ACCESS_MASK;
+
+			// Discarded contents only need to wait for the semaphore guarding the image, at the stage of the access
+			state.writeStages = resource.initialAccess == RENDER_GRAPH_ACCESS_NONE ? info.stage : initial.stage;
+
+			// Owned by the graphics queue between frames
+			resource.stateQueue = RENDER_GRAPH_QUEUE_GRAPHICS;
+			resource.stateValue = lastFrameGraphicsValue;
+
+			if (resource.waitSemaphore != VK_NULL_HANDLE)
+			{
+				waits.push_back({ resource.waitSemaphore, 0, info.stage });
+			}
+		}
+		else
+		{
+			// Contents are discarded, but the memory may still be in use by the previous occupant (or frame)
+			MemoryBlock& block = memoryBlocks[resource.memoryBlock];
+			state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			state.writeStages = block.pendingStages;
+			state.writeAccess = block.pendingAccess;
+
+			bool singleQueue = (resource.queueMask & (resource.queueMask - 1)) == 0;
+			resource.stateQueue = singleQueue ? queue : RENDER_GRAPH_QUEUE_GRAPHICS;
+			resource.stateValue = singleQueue ? 0 : lastFrameGraphicsValue;
+		}
+	}
+
+	// -- CROSS QUEUE --
+	// The timeline wait orders the queues and makes the other queue's writes available, continue from this queue's stage
+	bool acquired = false;
+	if (resource.stateQueue >= 0 && resource.stateQueue != static_cast<int>(queue))
+	{
+		if (resource.stateValue > 0)
+		{
+			waits.push_back({ timelines[resource.stateQueue], resource.stateValue, info.stage });
+		}
+
+		if (resource.released)
+		{
+			// Acquire half of the ownership transfer, with the same layouts and families as the release.
+			// Its source stage is the stage of the semaphore wait, so the transition happens after the wait
+			VkImageLayout newLayout = resource.isImage && info.layout != VK_IMAGE_LAYOUT_UNDEFINED ? info.layout : state.layout;
+			addBarrier(resource, barriers, info.stage, 0, info.stage, info.access, state.layout, newLayout,
+				queueFamilies[resource.stateQueue], queueFamilies[queue]);
+
+			state.layout = newLayout;
+			resource.released = false;
+			acquired = true;
+		}
+		else if (queueFamilies[resource.stateQueue] != queueFamilies[queue] && !resource.concurrent)
+		{
+			// Not transferred, the contents aren't needed: the new family starts from an undefined layout
+			state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+
+		// A concurrent resource keeps its layout, the wait made the other queue's writes visible at this stage
+		state.writeStages = info.stage;
+		state.writeAccess = 0;
+		state.readStages = 0;
+		state.visibleStages = acquired || resource.concurrent ? info.stage : 0;
+	}
+
+	// -- BARRIER --
+	bool layoutChange = resource.isImage && state.layout != info.layout && info.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags srcStages = 0;
+	VkAccessFlags srcAccess = 0;
+	bool needBarrier = false;
+
+	if (acquired)
+	{
+		// The acquire barrier covered it
+	}
+	else if (write || layoutChange)
+	{
+		// Write after write / read, and every transition, waits for everything before
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+		needBarrier = srcStages != 0 || layoutChange;
+	}
+	else if (state.writeStages != 0 && (state.visibleStages & info.stage) != info.stage)
+	{
+		// Read after write, once per reading stage
+		srcStages = state.writeStages;
+		srcAccess = state.writeAccess;
+		needBarrier = true;
+	}
+
+	if (needBarrier)
+	{
+		addBarrier(resource, barriers, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, srcAccess, info.stage, info.access,
+			layoutChange ? state.layout : info.layout, layoutChange ? info.layout : state.layout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+	}
+
+	// -- NEW STATE --
+	if (layoutChange)
+	{
+		state.layout = info.layout;
+	}
+
+	if (write)
+	{
+		state.writeStages = info.stage;
+		state.writeAccess = info.access & WRITE_ACCESS_MASK;
+		state.readStages = 0;
+		state.visibleStages = 0;
+	}
+	else
+	{
+		if (layoutChange)
+		{
+			// The transition is a write only the barrier's destination stage has seen
+			state.writeStages = info.stage;
+			state.writeAccess = 0;
+			state.readStages = 0;
+		}
+		state.readStages |= info.stage;
+		state.visibleStages |= info.stage;
+	}
+
+	resource.stateQueue = queue;
+	resource.stateValue = submitValue;
+
+	if (resource.memoryBlock != RENDER_GRAPH_INVALID)
+	{
+		memoryBlocks[resource.memoryBlock].pendingStages = state.writeStages | state.readStages;
+		memoryBlocks[resource.memoryBlock].pendingAccess = state.writeAccess;
+	}
+}
+
+void RenderGraph::releaseResource(RenderGraphResource resourceIndex, RenderGraphAccess nextAccess, RenderGraphQueue dstQueue, BarrierBatch& barriers)
+{
+	Resource& resource = resources[resourceIndex];
+	if (!resource.touched || resource.stateQueue < 0 || resource.stateQueue == static_cast<int>(dstQueue))
+	{
+		return;
+	}
+
+	// The layout transition to the next access happens as part of the transfer
+	const AccessInfo& info = ACCESS_INFO[nextAccess];
+	ResourceState& state = resource.state;
+	VkImageLayout newLayout = resource.isImage && info.layout != VK_IMAGE_LAYOUT_UNDEFINED ? info.layout : state.layout;
+	VkPipelineStageFlags srcStages = state.writeStages | state.readStages;
+
+	addBarrier(resource, barriers, srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, state.writeAccess,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, state.layout, newLayout, queueFamilies[resource.stateQueue], queueFamilies[dstQueue]);
+	resource.released = true;
+}
+
+void RenderGraph::addBarrier(const Resource& resource, BarrierBatch& barriers, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+	VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily)
+{
+	barriers.srcStages |= srcStages;
+	barriers.dstStages |= dstStages;
+
+	if (resource.isImage)
+	{
+		VkImageMemoryBarrier imageBarrier = {};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.srcAccessMask = srcAccess;
+		imageBarrier.dstAccessMask = dstAccess;
+		imageBarrier.oldLayout = oldLayout;
+		imageBarrier.newLayout = newLayout;
+		imageBarrier.srcQueueFamilyIndex = srcFamily;
+		imageBarrier.dstQueueFamilyIndex = dstFamily;
+		imageBarrier.image = resource.image;
+		imageBarrier.subresourceRange.aspectMask = resource.aspect;
+		imageBarrier.subresourceRange.baseMipLevel = 0;
+		imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		imageBarrier.subresourceRange.baseArrayLayer = 0;
+		imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		barriers.imageBarriers.push_back(imageBarrier);
+	}
+	else
+	{
+		VkBufferMemoryBarrier bufferBarrier = {};
+		bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferBarrier.srcAccessMask = srcAccess;
+		bufferBarrier.dstAccessMask = dstAccess;
+		bufferBarrier.srcQueueFamilyIndex = srcFamily;
+		bufferBarrier.dstQueueFamilyIndex = dstFamily;
+		bufferBarrier.buffer = resource.buffer;
+		bufferBarrier.offset = 0;
+		bufferBarrier.size = VK_WHOLE_SIZE;
+		barriers.bufferBarriers.push_back(bufferBarrier);
+	}
+}
+
+void RenderGraph::flushBarriers(VkCommandBuffer commandBuffer, BarrierBatch& barriers)
+{
+	if (barriers.imageBarriers.empty() && barriers.bufferBarriers.empty())
+	{
+		return;
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		barriers.srcStages, barriers.dstStages,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(barriers.bufferBarriers.size()), barriers.bufferBarriers.data(),
+		static_cast<uint32_t>(barriers.imageBarriers.size()), barriers.imageBarriers.data());
+
+	barriers = BarrierBatch();
+}
+
+void RenderGraph::recordPass(VkCommandBuffer commandBuffer, uint32_t passIndex, uint64_t submitValue, std::vector<SemaphoreWait>& waits)
+{
+	Pass& pass = passes[passIndex];
+
+	BarrierBatch barriers;
+	for (const auto& access : pass.accesses)
+	{
+		prepareAccess(access.resource, access.access, access.write, pass.effectiveQueue, submitValue, barriers, waits);
+	}
+	flushBarriers(commandBuffer, barriers);
+
+	// Every queue writes into the profiler's pool for it
+	GpuProfilerQueue profilerQueue = pass.effectiveQueue == RENDER_GRAPH_QUEUE_GRAPHICS ? GPU_PROFILER_QUEUE_GRAPHICS : GPU_PROFILER_QUEUE_COMPUTE;
+	bool profiled = profiler != nullptr;
+	uint32_t scope = profiled ? profiler->beginScope(commandBuffer, pass.name.c_str(), pass.pipelineStatistics, profilerQueue) : 0;
+
+	if (pass.renderPass != VK_NULL_HANDLE)
+	{
+		VkExtent2D renderExtent;
+		VkFramebuffer framebuffer = getFramebuffer(pass, &renderExtent);
+
+		std::vector<VkClearValue> clearValues;
+		for (const auto& clearColour : pass.clearColours)
+		{
+			VkClearValue clearValue = {};
+			clearValue.color = clearColour;
+			clearValues.push_back(clearValue);
+		}
+		if (pass.depthAttachment != RENDER_GRAPH_INVALID)
+		{
+			VkClearValue clearValue = {};
+			clearValue.depthStencil.depth = pass.clearDepthValue;
+			clearValues.push_back(clearValue);
+		}
+
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.renderPass = pass.renderPass;
+		renderPassBeginInfo.framebuffer = framebuffer;
+		renderPassBeginInfo.renderArea.offset = { 0, 0 };
+		renderPassBeginInfo.renderArea.extent = renderExtent;
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.pClearValues = clearValues.data();
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		// Viewport and scissor are dynamic state in every pipeline
+		VkViewport viewport = {};
+		viewport.width = static_cast<float>(renderExtent.width);
+		viewport.height = static_cast<float>(renderExtent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.extent = renderExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		if (pass.execute)
+		{
+			pass.execute(commandBuffer);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+	else if (pass.execute)
+	{
+		pass.execute(commandBuffer);
+	}
+
+	if (profiled)
+	{
+		profiler->endScope(commandBuffer, scope);
+	}
+}
+
+void RenderGraph::execute(FrameContext& frame, uint32_t frameSlot, VkSemaphore signalSemaphore, VkFence fence)
+{
+	for (auto& resource : resources)
+	{
+		resource.touched = false;
+		resource.released = false;
+	}
+
+	bool profilerStarted = false;
+	bool profilerQueueStarted[RENDER_GRAPH_QUEUE_COUNT] = {};
+	uint32_t frameScope = 0;
+
+	if (profiler != nullptr)
+	{
+		profiler->beginFrame(frameSlot);
+	}
+	uint64_t computeFrameValue = 0;
+	bool firstComputeBatch = true;
+
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		const Batch& batch = batches[b];
+		bool lastBatch = b == batches.size() - 1;
+
+		// Value this submission signals on its queue's timeline
+		uint64_t submitValue = asyncCompute ? timelineValues[batch.queue] + 1 : 0;
+		std::vector<SemaphoreWait> waits;
+
+		VkCommandBuffer commandBuffer = batch.queue == RENDER_GRAPH_QUEUE_GRAPHICS ? frame.acquireCommandBuffer() : frame.acquireComputeCommandBuffer();
+
+		VkCommandBufferBeginInfo bufferBeginInfo = {};
+		bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to start recording a Command Buffer!");
+		}
+
+		// The queries of a queue are reset by its first submission of the frame
+		if (profiler != nullptr && !profilerQueueStarted[batch.queue])
+		{
+			profiler->beginQueue(commandBuffer, batch.queue == RENDER_GRAPH_QUEUE_GRAPHICS ? GPU_PROFILER_QUEUE_GRAPHICS : GPU_PROFILER_QUEUE_COMPUTE);
+			profilerQueueStarted[batch.queue] = true;
+		}
+
+		if (batch.queue == RENDER_GRAPH_QUEUE_GRAPHICS && profiler != nullptr && !profilerStarted)
+		{
+			frameScope = profiler->beginScope(commandBuffer, "Frame");
+			profilerStarted = true;
+		}
+
+		// The compute queue may run ahead into the next frame, it starts after the previous frame's graphics work
+		if (batch.queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE && firstComputeBatch)
+		{
+			if (lastFrameGraphicsValue > 0)
+			{
+				waits.push_back({ timelines[RENDER_GRAPH_QUEUE_GRAPHICS], lastFrameGraphicsValue, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+			}
+			firstComputeBatch = false;
+		}
+
+		for (uint32_t passIndex : batch.passes)
+		{
+			recordPass(commandBuffer, passIndex, submitValue, waits);
+		}
+
+		// Hand the resources the other queue continues with over to its family
+		if (!batch.releases.empty())
+		{
+			BarrierBatch barriers;
+			RenderGraphQueue otherQueue = batch.queue == RENDER_GRAPH_QUEUE_GRAPHICS ? RENDER_GRAPH_QUEUE_ASYNC_COMPUTE : RENDER_GRAPH_QUEUE_GRAPHICS;
+			for (const auto& release : batch.releases)
+			{
+				releaseResource(release.resource, release.access, otherQueue, barriers);
+			}
+			flushBarriers(commandBuffer, barriers);
+		}
+
+		if (lastBatch)
+		{
+			// Leave the exported resources in their final state
+			BarrierBatch barriers;
+			for (RenderGraphResource r = 0; r < resources.size(); r++)
+			{
+				if (resources[r].exported && resources[r].touched && resources[r].finalAccess != RENDER_GRAPH_ACCESS_NONE)
+				{
+					prepareAccess(r, resources[r].finalAccess, false, RENDER_GRAPH_QUEUE_GRAPHICS, submitValue, barriers, waits);
+				}
+			}
+			flushBarriers(commandBuffer, barriers);
+
+			// The fence covers the whole frame, including the compute work nothing on the graphics queue waited for
+			if (computeFrameValue > 0)
+			{
+				waits.push_back({ timelines[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE], computeFrameValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT });
+			}
+
+			if (profilerStarted)
+			{
+				profiler->endScope(commandBuffer, frameScope);
+			}
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to stop recording a Command Buffer!");
+		}
+
+		// -- SUBMIT --
+		std::vector<VkSemaphore> waitSemaphores;
+		std::vector<uint64_t> waitValues;
+		std::vector<VkPipelineStageFlags> waitStages;
+		for (const auto& wait : waits)
+		{
+			waitSemaphores.push_back(wait.semaphore);
+			waitValues.push_back(wait.value);
+			waitStages.push_back(wait.stage);
+		}
+
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<uint64_t> signalValues;
+		if (asyncCompute)
+		{
+			signalSemaphores.push_back(timelines[batch.queue]);
+			signalValues.push_back(submitValue);
+		}
+		if (lastBatch && signalSemaphore != VK_NULL_HANDLE)
+		{
+			signalSemaphores.push_back(signalSemaphore);
+			signalValues.push_back(0);
+		}
+
+		// Binary semaphores ignore their value
+		VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+		timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineSubmitInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineSubmitInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+		timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = asyncCompute ? &timelineSubmitInfo : nullptr;
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+		VkResult result = vkQueueSubmit(queues[batch.queue], 1, &submitInfo, lastBatch ? fence : VK_NULL_HANDLE);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit Command Buffer to Queue!");
+		}
+
+		if (asyncCompute)
+		{
+			timelineValues[batch.queue] = submitValue;
+			if (batch.queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+			{
+				computeFrameValue = submitValue;
+			}
+		}
+	}
+
+	if (asyncCompute)
+	{
+		lastFrameGraphicsValue = timelineValues[RENDER_GRAPH_QUEUE_GRAPHICS];
+	}
+}
+
+VkRenderPass RenderGraph::getRenderPass(RenderGraphPass pass) const
+{
+	return passes[pass].renderPass;
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource) const
+{
+	return resources[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource resource) const
+{
+	return resources[resource].view;
+}
+
+VkBuffer RenderGraph::getBuffer(RenderGraphResource resource) const
+{
+	return resources[resource].buffer;
+}
+
+VkExtent2D RenderGraph::getImageExtent(RenderGraphResource resource) const
+{
+	return resources[resource].extent;
+}
+
+bool RenderGraph::isPassCulled(RenderGraphPass pass) const
+{
+	return passes[pass].culled;
+}
+
+void RenderGraph::printSummary() const
+{
+	uint32_t culledCount = 0;
+	for (const auto& pass : passes)
+	{
+		if (pass.culled) culledCount++;
+	}
+
+	uint32_t transientCount = 0;
+	uint32_t lazyCount = 0;
+	VkDeviceSize allocated = 0;
+	for (const auto& block : memoryBlocks)
+	{
+		transientCount += static_cast<uint32_t>(block.resources.size());
+		allocated += block.size;
+		for (RenderGraphResource r : block.resources)
+		{
+			if (resources[r].lazy) lazyCount++;
+		}
+	}
+
+	const char* computeMode = !asyncCompute ? "" :
+		queueFamilies[RENDER_GRAPH_QUEUE_GRAPHICS] != queueFamilies[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE] ? " with async compute (dedicated family)" :
+		" with async compute (graphics family)";
+	printf("Render graph: %u pass(es), %u culled, %u submission(s)%s\n", static_cast<uint32_t>(passes.size()), culledCount,
+		static_cast<uint32_t>(batches.size()), computeMode);
+	printf("Render graph: %u transient resource(s) (%u lazily allocated) in %u memory block(s), %.2f MiB\n", transientCount, lazyCount,
+		static_cast<uint32_t>(memoryBlocks.size()), allocated / (1024.0 * 1024.0));
+	for (uint32_t order = 0; order < executionOrder.size(); order++)
+	{
+		const Pass& pass = passes[executionOrder[order]];
+		printf("  %u: %s (%s)\n", order, pass.name.c_str(), pass.effectiveQueue == RENDER_GRAPH_QUEUE_GRAPHICS ? "graphics" : "compute");
+	}
+}
+
+void RenderGraph::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	destroyResources();
+
+	for (auto& pass : passes)
+	{
+		if (pass.renderPass != VK_NULL_HANDLE)
+		{
+			vkDestroyRenderPass(device, pass.renderPass, nullptr);
+		}
+	}
+
+	for (uint32_t q = 0; q < RENDER_GRAPH_QUEUE_COUNT; q++)
+	{
+		if (timelines[q] != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(device, timelines[q], nullptr);
+			timelines[q] = VK_NULL_HANDLE;
+		}
+	}
+
+	passes.clear();
+	resources.clear();
+	executionOrder.clear();
+	batches.clear();
+	compiled = false;
+	device = VK_NULL_HANDLE;
+}
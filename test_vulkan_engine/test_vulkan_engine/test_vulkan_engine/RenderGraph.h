@@ -0,0 +1,465 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+class FrameContext;
+class GpuProfiler;
+
+typedef uint32_t RenderGraphResource;
+typedef uint32_t RenderGraphPass;
+
+const uint32_t RENDER_GRAPH_INVALID = 0xFFFFFFFF;
+
+// Queue a pass is recorded on
+enum RenderGraphQueue
+{
+	RENDER_GRAPH_QUEUE_GRAPHICS,
+	RENDER_GRAPH_QUEUE_ASYNC_COMPUTE,		///< Falls back to the graphics queue if there is no compute queue.
+	RENDER_GRAPH_QUEUE_COUNT
+};
+
+// How a pass uses a resource, decides the pipeline stage, access mask and image layout
+enum RenderGraphAccess
+{
+	RENDER_GRAPH_ACCESS_NONE,					///< Contents undefined (e.g. a freshly acquired swapchain image).
+	RENDER_GRAPH_ACCESS_COLOUR_ATTACHMENT,
+	RENDER_GRAPH_ACCESS_DEPTH_ATTACHMENT,
+	RENDER_GRAPH_ACCESS_DEPTH_READ,				///< Read only depth attachment (depth test without writes).
+	RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT,
+	RENDER_GRAPH_ACCESS_SAMPLED_COMPUTE,
+	RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS,	///< Storage image / buffer read in the vertex or fragment shader.
+	RENDER_GRAPH_ACCESS_STORAGE_READ_COMPUTE,
+	RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE,	///< Read-modify-write is allowed.
+	RENDER_GRAPH_ACCESS_STORAGE_WRITE_GRAPHICS,	///< Storage buffer written (atomics allowed) in the fragment shader.
+	RENDER_GRAPH_ACCESS_VERTEX_BUFFER,
+	RENDER_GRAPH_ACCESS_INDIRECT_BUFFER,
+	RENDER_GRAPH_ACCESS_TRANSFER_READ,
+	RENDER_GRAPH_ACCESS_TRANSFER_WRITE,
+	RENDER_GRAPH_ACCESS_HOST_READ,				///< Read back by the CPU once the frame's fence signalled, as a final access.
+	RENDER_GRAPH_ACCESS_PRESENT,
+	RENDER_GRAPH_ACCESS_COUNT
+};
+
+/**
+ * @struct RenderGraphImageDesc
+ * @brief Image created by the graph. The usage flags come from the accesses declared on it.
+ */
+struct RenderGraphImageDesc
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	float scale = 1.0f;										///< Size relative to the graph's extent.
+	uint32_t width = 0;										///< Fixed size, overrides scale if not 0.
+	uint32_t height = 0;
+	uint32_t mipLevels = 1;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+/**
+ * @struct RenderGraphBufferDesc
+ * @brief Buffer created by the graph. The usage flags come from the accesses declared on it.
+ */
+struct RenderGraphBufferDesc
+{
+	VkDeviceSize size = 0;
+};
+
+class RenderGraph;
+
+/**
+ * @class RenderGraphPassBuilder
+ * @brief Declares what a pass reads and writes, returned by RenderGraph::addPass().
+ */
+class RenderGraphPassBuilder
+{
+public:
+	RenderGraphPassBuilder(RenderGraph* newGraph, RenderGraphPass newPass);
+
+	/**
+	 * @brief Renders into a colour attachment.
+	 *
+	 * @param image The attachment.
+	 * @param clear Clear it to clearColour, otherwise the previous contents are loaded.
+	 * @param clearColour The clear value.
+	 */
+	RenderGraphPassBuilder& writeColour(RenderGraphResource image, bool clear, VkClearColorValue clearColour = {});
+
+	/**
+	 * @brief Depth tests and writes against a depth attachment.
+	 *
+	 * @param image The attachment.
+	 * @param clear Clear it to clearDepth, otherwise the previous contents are loaded.
+	 * @param clearDepth The clear value.
+	 */
+	RenderGraphPassBuilder& writeDepth(RenderGraphResource image, bool clear, float clearDepth = 1.0f);
+
+	// Depth tests against a depth attachment without writing it
+	RenderGraphPassBuilder& readDepth(RenderGraphResource image);
+
+	/**
+	 * @brief Resolves a multisampled colour attachment of the pass into a single sampled image at the end of the render pass.
+	 *
+	 * @param source A colour attachment declared with writeColour.
+	 * @param target The resolved image, written completely (its previous contents are discarded).
+	 */
+	RenderGraphPassBuilder& resolveColour(RenderGraphResource source, RenderGraphResource target);
+
+	/**
+	 * @brief Starts the next subpass of the pass's render pass, the attachments declared after it belong to it.
+	 *
+	 * The execute function moves on with vkCmdNextSubpass. Attachments only passed between the
+	 * subpasses stay in tile memory on tiled GPUs.
+	 */
+	RenderGraphPassBuilder& nextSubpass();
+
+	/**
+	 * @brief Reads an attachment written by an earlier subpass of this pass as an input attachment (subpassLoad).
+	 *
+	 * @param image A colour or depth attachment of an earlier subpass.
+	 */
+	RenderGraphPassBuilder& readInput(RenderGraphResource image);
+
+	// Any other read or write (sampling, storage, vertex / indirect buffers, transfers)
+	// A resource is declared once per pass
+	RenderGraphPassBuilder& read(RenderGraphResource resource, RenderGraphAccess access);
+	RenderGraphPassBuilder& write(RenderGraphResource resource, RenderGraphAccess access);
+	RenderGraphPassBuilder& readWrite(RenderGraphResource resource, RenderGraphAccess access);
+
+	// The pass has effects outside the graph, it is never culled
+	RenderGraphPassBuilder& setSideEffect();
+
+	// Collect the pipeline statistics of the pass in the GPU profiler (graphics queue passes only)
+	RenderGraphPassBuilder& setPipelineStatistics();
+
+	/**
+	 * @brief Sets the function recording the pass.
+	 *
+	 * Render passes are begun with the viewport and scissor covering the attachments before the call.
+	 */
+	RenderGraphPassBuilder& setExecute(std::function<void(VkCommandBuffer)> execute);
+
+	RenderGraphPass getHandle() const;
+
+private:
+	RenderGraph* graph;
+	RenderGraphPass pass;
+};
+
+/**
+ * @class RenderGraph
+ * @brief Frame graph: passes declare their resource accesses, the graph does the synchronisation.
+ *
+ * compile() culls the passes that contribute to no exported resource or side effect, orders the
+ * rest (async compute passes are hoisted as early as their dependencies allow), splits them into
+ * per queue submissions, creates the render passes and places the transient resources in memory,
+ * letting resources with disjoint lifetimes alias the same allocation.
+ *
+ * execute() records the passes, inserting the barriers and layout transitions from the tracked
+ * state of each resource, and submits them. Submissions on different queues are ordered with one
+ * timeline semaphore per queue. If the compute queue is of another family, resources whose contents
+ * cross between the queues get a release barrier at the end of the submission last using them and
+ * an acquire barrier before the next use. Imported images shared concurrently only need the waits.
+ */
+class RenderGraph
+{
+public:
+	RenderGraph();
+
+	/**
+	 * @brief Sets up the graph.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param newGraphicsQueue Queue the graphics passes are submitted to.
+	 * @param graphicsFamily Queue family of the graphics queue.
+	 * @param newComputeQueue Queue of the async compute passes, VK_NULL_HANDLE to use the graphics queue.
+	 * @param computeFamily Queue family of the compute queue (a dedicated compute family or the graphics one).
+	 * @param timelineSemaphores True if the device has timeline semaphores (needed for a compute queue).
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue newGraphicsQueue, uint32_t graphicsFamily,
+		VkQueue newComputeQueue, uint32_t computeFamily, bool timelineSemaphores);
+
+	// -- DECLARATION --
+	// Resources and passes can be added until compile()
+
+	RenderGraphResource createImage(const std::string& name, const RenderGraphImageDesc& desc);
+	RenderGraphResource createBuffer(const std::string& name, const RenderGraphBufferDesc& desc);
+
+	/**
+	 * @brief Declares an image owned outside the graph, set the actual image each frame.
+	 *
+	 * @param name Name for debugging.
+	 * @param format Format of the image.
+	 * @param initialAccess State the image is in when the frame starts (NONE discards the contents).
+	 * @param concurrent True if the image was created with setConcurrentSharing, async compute passes can
+	 *                   then read the contents it keeps across frames.
+	 */
+	RenderGraphResource importImage(const std::string& name, VkFormat format, RenderGraphAccess initialAccess, bool concurrent = false);
+
+	/**
+	 * @brief Declares a buffer owned outside the graph, set the actual buffer each frame.
+	 *
+	 * @param name Name for debugging.
+	 * @param initialAccess State the buffer is in when the frame starts (NONE discards the contents).
+	 */
+	RenderGraphResource importBuffer(const std::string& name, RenderGraphAccess initialAccess);
+
+	/**
+	 * @brief Lets the queue families of both queues use an image created outside the graph.
+	 *
+	 * Exclusive images are owned by the graphics family between frames, a pass reading their contents
+	 * stays on the graphics queue. A concurrent image needs no ownership transfer, the pass can run on
+	 * the compute queue. Nothing changes if both queues are of one family.
+	 *
+	 * @param imageCreateInfo Create info of the image, its family indices point into the graph.
+	 */
+	void setConcurrentSharing(VkImageCreateInfo& imageCreateInfo) const;
+
+	/**
+	 * @brief Keeps a resource alive: the passes writing it are not culled, and it is left in finalAccess.
+	 */
+	void exportResource(RenderGraphResource resource, RenderGraphAccess finalAccess);
+
+	RenderGraphPassBuilder addPass(const std::string& name, RenderGraphQueue queue);
+
+	/**
+	 * @brief Culls, orders and batches the passes, creates the render passes and the transient resources.
+	 *
+	 * @param newExtent Size the relative image sizes are based on (the swapchain extent).
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void compile(VkExtent2D newExtent);
+
+	/**
+	 * @brief Recreates the transient resources for a new extent. The device must be idle.
+	 */
+	void resize(VkExtent2D newExtent);
+
+	// -- EXECUTION --
+
+	/**
+	 * @brief Sets the image behind an imported resource for this frame.
+	 *
+	 * @param resource The imported resource.
+	 * @param image The image.
+	 * @param view View of the image.
+	 * @param extent Size of the image.
+	 * @param waitSemaphore Waited on before the first access (e.g. the acquire semaphore), can be VK_NULL_HANDLE.
+	 */
+	void setImportedImage(RenderGraphResource resource, VkImage image, VkImageView view, VkExtent2D extent, VkSemaphore waitSemaphore);
+
+	// Same, for an imported buffer, which has to be set before the first execute()
+	void setImportedBuffer(RenderGraphResource resource, VkBuffer buffer);
+
+	// Profiles the passes of both queues, each in its own scope
+	void setProfiler(GpuProfiler* newProfiler);
+
+	/**
+	 * @brief Records and submits the frame.
+	 *
+	 * @param frame Context the command buffers are taken from (already begun).
+	 * @param frameSlot Index of the context, for the profiler.
+	 * @param signalSemaphore Signalled when the frame finished (e.g. render finished for the present), can be VK_NULL_HANDLE.
+	 * @param fence Signalled when all submissions of the frame finished.
+	 * @throws std::runtime_error if recording or a submission fails.
+	 */
+	void execute(FrameContext& frame, uint32_t frameSlot, VkSemaphore signalSemaphore, VkFence fence);
+
+	// -- QUERIES --
+
+	// Render pass of a graphics pass with attachments, valid after compile(); pipelines are created against it
+	VkRenderPass getRenderPass(RenderGraphPass pass) const;
+
+	// Physical resources, valid after compile() (imported ones after setImportedImage() / setImportedBuffer())
+	VkImage getImage(RenderGraphResource resource) const;
+	VkImageView getImageView(RenderGraphResource resource) const;
+	VkBuffer getBuffer(RenderGraphResource resource) const;
+	VkExtent2D getImageExtent(RenderGraphResource resource) const;
+
+	bool isPassCulled(RenderGraphPass pass) const;
+
+	void printSummary() const;
+
+	void destroy();
+
+private:
+	friend class RenderGraphPassBuilder;
+
+	// Resource state at a point in the frame, used to derive the next barrier
+	struct ResourceState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStages = 0;			// Stages of the last write
+		VkAccessFlags writeAccess = 0;					// Access of the last write, made available by the next barrier
+		VkPipelineStageFlags readStages = 0;			// Stages reading since the last write
+		VkPipelineStageFlags visibleStages = 0;			// Stages the last write was made visible to
+	};
+
+	struct Resource
+	{
+		std::string name;
+		bool isImage = true;
+		bool imported = false;
+		bool concurrent = false;						// Imported, shared by both queue families
+		bool exported = false;
+		RenderGraphImageDesc imageDesc;
+		RenderGraphBufferDesc bufferDesc;
+		RenderGraphAccess initialAccess = RENDER_GRAPH_ACCESS_NONE;
+		RenderGraphAccess finalAccess = RENDER_GRAPH_ACCESS_NONE;
+
+		// Compiled
+		VkImageUsageFlags imageUsage = 0;
+		VkBufferUsageFlags bufferUsage = 0;
+		VkImageAspectFlags aspect = 0;					// Aspects touched by barriers
+		bool lazy = false;								// Attachment living inside one render pass, lazily allocated where supported
+		uint32_t firstPass = RENDER_GRAPH_INVALID;		// Lifetime in execution order
+		uint32_t lastPass = 0;
+		uint32_t queueMask = 0;							// Queues accessing it
+		uint32_t memoryBlock = RENDER_GRAPH_INVALID;
+
+		// Physical
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkExtent2D extent = {};
+		VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+
+		// Execution
+		ResourceState state;
+		bool touched = false;							// Accessed yet this frame
+		int stateQueue = -1;							// Queue of the last access
+		uint64_t stateValue = 0;						// Timeline value of the submission of the last access
+		bool released = false;							// Ownership released to the other queue family, not acquired yet
+	};
+
+	struct PassAccess
+	{
+		RenderGraphResource resource;
+		RenderGraphAccess access;
+		bool read;								// Depends on the previous contents
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		RenderGraphQueue queue = RENDER_GRAPH_QUEUE_GRAPHICS;
+		std::vector<PassAccess> accesses;
+		std::vector<RenderGraphResource> colourAttachments;
+		std::vector<VkClearColorValue> clearColours;
+		std::vector<bool> clearColour;
+		std::vector<RenderGraphResource> resolveAttachments;	// Per colour attachment, RENDER_GRAPH_INVALID if not resolved
+		std::vector<uint32_t> colourSubpasses;					// Per colour attachment, the subpass writing it
+		std::vector<RenderGraphResource> inputAttachments;
+		std::vector<uint32_t> inputSubpasses;					// Per input attachment, the subpass reading it
+		uint32_t subpassCount = 1;
+		RenderGraphResource depthAttachment = RENDER_GRAPH_INVALID;
+		uint32_t depthSubpass = 0;
+		bool depthReadOnly = false;
+		bool clearDepth = false;
+		float clearDepthValue = 1.0f;
+		bool sideEffect = false;
+		bool pipelineStatistics = false;
+		std::function<void(VkCommandBuffer)> execute;
+
+		// Compiled
+		bool culled = false;
+		RenderGraphQueue effectiveQueue = RENDER_GRAPH_QUEUE_GRAPHICS;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+	};
+
+	// Passes submitted together on one queue
+	struct Batch
+	{
+		RenderGraphQueue queue = RENDER_GRAPH_QUEUE_GRAPHICS;
+		std::vector<uint32_t> passes;
+		std::vector<PassAccess> releases;		// Handed to the other queue family at the end, with the access they are released for
+	};
+
+	// Allocation shared by transient resources with disjoint lifetimes
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		bool forImages = true;
+		uint32_t queueMask = 0;					// Only resources of a single queue share a block
+		std::vector<RenderGraphResource> resources;
+
+		// Stages and accesses of the last occupant, the next one's first barrier waits for them
+		VkPipelineStageFlags pendingStages = 0;
+		VkAccessFlags pendingAccess = 0;
+	};
+
+	struct SemaphoreWait
+	{
+		VkSemaphore semaphore;
+		uint64_t value;							// 0 for binary semaphores
+		VkPipelineStageFlags stage;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queues[RENDER_GRAPH_QUEUE_COUNT] = {};
+	uint32_t queueFamilies[RENDER_GRAPH_QUEUE_COUNT] = {};
+	bool asyncCompute = false;
+	GpuProfiler* profiler = nullptr;
+	VkExtent2D extent = {};
+	bool compiled = false;
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<uint32_t> executionOrder;
+	std::vector<Batch> batches;
+	std::vector<MemoryBlock> memoryBlocks;
+	std::map<std::pair<VkRenderPass, std::vector<VkImageView>>, VkFramebuffer> framebuffers;
+
+	// One timeline per queue, every submission signals the next value
+	VkSemaphore timelines[RENDER_GRAPH_QUEUE_COUNT] = {};
+	uint64_t timelineValues[RENDER_GRAPH_QUEUE_COUNT] = {};
+	uint64_t lastFrameGraphicsValue = 0;
+
+	void cullPasses();
+	void orderPasses();
+	void buildBatches();
+	void computeQueueTransfers();
+	void computeLifetimes();
+	void createRenderPasses();
+	void createTimelines();
+	void allocateResources();
+	void destroyResources();
+
+	VkFramebuffer getFramebuffer(const Pass& pass, VkExtent2D* outExtent);
+
+	// Barriers of one pass, recorded as a single vkCmdPipelineBarrier
+	struct BarrierBatch
+	{
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+	};
+
+	// Adds the barrier (and cross queue wait) needed before a pass accesses a resource
+	void prepareAccess(RenderGraphResource resourceIndex, RenderGraphAccess access, bool write, RenderGraphQueue queue,
+		uint64_t submitValue, BarrierBatch& barriers, std::vector<SemaphoreWait>& waits);
+
+	// Release half of a queue family ownership transfer, recorded on the queue giving the resource up
+	void releaseResource(RenderGraphResource resourceIndex, RenderGraphAccess nextAccess, RenderGraphQueue dstQueue, BarrierBatch& barriers);
+
+	void addBarrier(const Resource& resource, BarrierBatch& barriers, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t srcFamily, uint32_t dstFamily);
+
+	void flushBarriers(VkCommandBuffer commandBuffer, BarrierBatch& barriers);
+
+	void recordPass(VkCommandBuffer commandBuffer, uint32_t passIndex, uint64_t submitValue, std::vector<SemaphoreWait>& waits);
+
+	bool hasContentsBefore(RenderGraphResource resource, uint32_t orderIndex) const;
+	bool isUsedAfter(RenderGraphResource resource, uint32_t orderIndex) const;
+};
@@ -0,0 +1,160 @@
+#include "SceneSystems.h"
+
+#include <cmath>
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+glm::vec3 getTransformDirection(const TransformComponent& transform)
+{
+	return glm::normalize(glm::vec3(transform.model[2]));
+}
+
+glm::mat4 composeTransformMatrix(const glm::vec3& position, float angleX, float angleY)
+{
+	// translate * rotate(X) * rotate(Y) written out, glm::rotate's general axis-angle matrix
+	// and the two 4x4 products cost more than the rest of a controller update
+	float sinX = std::sin(glm::radians(angleX));
+	float cosX = std::cos(glm::radians(angleX));
+	float sinY = std::sin(glm::radians(angleY));
+	float cosY = std::cos(glm::radians(angleY));
+
+	glm::mat4 model;
+	model[0] = glm::vec4(cosY, sinX * sinY, -cosX * sinY, 0.0f);
+	model[1] = glm::vec4(0.0f, cosX, sinX, 0.0f);
+	model[2] = glm::vec4(sinY, -sinX * cosY, cosX * cosY, 0.0f);
+	model[3] = glm::vec4(position, 1.0f);
+	return model;
+}
+
+void updateTransformMatrix(TransformComponent& transform)
+{
+	transform.model = composeTransformMatrix(transform.position, transform.angleX, transform.angleY);
+}
+
+void updateControllerSystem(EntityRegistry& registry, bool* keys, float deltaTime)
+{
+	// Input is the same for every entity, so resolve it once per frame
+	float forwardInput = (keys[GLFW_KEY_UP] ? 1.0f : 0.0f) - (keys[GLFW_KEY_DOWN] ? 1.0f : 0.0f);
+	bool isCtrlPressed = keys[GLFW_KEY_RIGHT_CONTROL] || keys[GLFW_KEY_LEFT_CONTROL];
+	float pitchInput = (keys[GLFW_KEY_KP_2] ? 1.0f : 0.0f) - (keys[GLFW_KEY_KP_8] ? 1.0f : 0.0f);
+	float yawInput = (keys[GLFW_KEY_KP_4] ? 1.0f : 0.0f) - (keys[GLFW_KEY_KP_6] ? 1.0f : 0.0f);
+
+	registry.forEachChunk(TRANSFORM_BIT | CONTROLLER_BIT, [&](ArchetypeChunk& chunk)
+		{
+			TransformComponent* transforms = chunk.get<TransformComponent>();
+			ControllerComponent* controllers = chunk.get<ControllerComponent>();
+
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				TransformComponent& transform = transforms[i];
+				float move = controllers[i].moveSpeed * deltaTime;
+				float turn = controllers[i].angleSpeed * deltaTime;
+
+				// Direction vectors of the entity
+				glm::vec3 forward = getTransformDirection(transform);
+				glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+				glm::vec3 up = glm::normalize(glm::cross(right, forward));
+
+				// Forward/backward movement
+				transform.position += forward * move * forwardInput;
+
+				// Up/down movement while Ctrl is held
+				if (isCtrlPressed)
+				{
+					transform.position += up * move * forwardInput;
+				}
+
+				// Rotation around the entity's own axes
+				transform.angleX += turn * pitchInput;
+				transform.angleY += turn * yawInput;
+
+				updateTransformMatrix(transform);
+			}
+		});
+}
+
+void updateSceneBVH(EntityRegistry& registry, BVH& bvh)
+{
+	const ComponentMask required = TRANSFORM_BIT | BOUNDS_BIT;
+
+	// New entities have no BVH slot yet, removed ones change the count
+	size_t boundsCount = 0;
+	bool needsRebuild = false;
+	registry.forEachChunk(required, [&](ArchetypeChunk& chunk)
+		{
+			BoundsComponent* bounds = chunk.get<BoundsComponent>();
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				needsRebuild |= bounds[i].bvhPrimitive == BVH_INVALID_PRIMITIVE;
+			}
+			boundsCount += chunk.count;
+		});
+	needsRebuild |= boundsCount != bvh.getPrimitiveCount();
+
+	if (needsRebuild)
+	{
+		std::vector<AABB> worldBounds;
+		std::vector<Entity> entities;
+		worldBounds.reserve(boundsCount);
+		entities.reserve(boundsCount);
+
+		registry.forEachChunk(required, [&](ArchetypeChunk& chunk)
+			{
+				TransformComponent* transforms = chunk.get<TransformComponent>();
+				BoundsComponent* bounds = chunk.get<BoundsComponent>();
+				for (uint32_t i = 0; i < chunk.count; i++)
+				{
+					bounds[i].worldBounds = transformAABB(bounds[i].localBounds, transforms[i].model);
+					bounds[i].bvhPrimitive = static_cast<uint32_t>(worldBounds.size());
+					worldBounds.push_back(bounds[i].worldBounds);
+					entities.push_back(chunk.entities[i]);
+				}
+			});
+
+		bvh.build(worldBounds, entities);
+		return;
+	}
+
+	// Only refit the entities that actually moved
+	registry.forEachChunk(required, [&](ArchetypeChunk& chunk)
+		{
+			TransformComponent* transforms = chunk.get<TransformComponent>();
+			BoundsComponent* bounds = chunk.get<BoundsComponent>();
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				AABB worldBounds = transformAABB(bounds[i].localBounds, transforms[i].model);
+				if (worldBounds.min != bounds[i].worldBounds.min || worldBounds.max != bounds[i].worldBounds.max)
+				{
+					bounds[i].worldBounds = worldBounds;
+					bvh.updatePrimitive(bounds[i].bvhPrimitive, worldBounds);
+				}
+			}
+		});
+}
+
+void gatherCullingSpheres(EntityRegistry& registry, FrustumCuller& culler)
+{
+	culler.clear();
+
+	registry.forEachChunk(TRANSFORM_BIT | RENDER_MESH_BIT | BOUNDS_BIT, [&](ArchetypeChunk& chunk)
+		{
+			BoundsComponent* bounds = chunk.get<BoundsComponent>();
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				culler.addBounds(chunk.entities[i], bounds[i].worldBounds);
+			}
+		});
+}
+
+void storePreviousTransforms(EntityRegistry& registry)
+{
+	registry.forEachChunk(TRANSFORM_BIT, [&](ArchetypeChunk& chunk)
+		{
+			TransformComponent* transforms = chunk.get<TransformComponent>();
+			for (uint32_t i = 0; i < chunk.count; i++)
+			{
+				transforms[i].previousModel = transforms[i].model;
+			}
+		});
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "EntityRegistry.h"
+#include "BVH.h"
+#include "FrustumCuller.h"
+
+/**
+ * @brief Returns the forward direction encoded in a transform's model matrix.
+ *
+ * @param transform The transform to read.
+ * @return The normalised forward (Z) axis of the model matrix.
+ */
+glm::vec3 getTransformDirection(const TransformComponent& transform);
+
+/**
+ * @brief Composes translate(position) * rotateX(angleX) * rotateY(angleY) in closed form.
+ *
+ * @param position The translation.
+ * @param angleX Rotation around X (up/down) in degrees.
+ * @param angleY Rotation around Y (left/right) in degrees.
+ * @return The model matrix.
+ */
+glm::mat4 composeTransformMatrix(const glm::vec3& position, float angleX, float angleY);
+
+/**
+ * @brief Builds the model matrix of a transform from its position and angles.
+ *
+ * @param transform The transform to update.
+ */
+void updateTransformMatrix(TransformComponent& transform);
+
+/**
+ * @brief Moves and rotates every controllable entity based on the pressed keys.
+ *
+ * Iterates only the chunks owning both a TransformComponent and a ControllerComponent,
+ * touching nothing but those two arrays.
+ *
+ * @param registry The entity storage.
+ * @param keys A boolean array representing the state of keys.
+ * @param deltaTime The time elapsed since the last frame.
+ */
+void updateControllerSystem(EntityRegistry& registry, bool* keys, float deltaTime);
+
+/**
+ * @brief Keeps the scene BVH in sync with the transforms of the entities.
+ *
+ * Recomputes the world box of every entity owning a TransformComponent and a BoundsComponent,
+ * and refits the BVH path of the ones that changed. The BVH is rebuilt when entities with
+ * bounds were added or removed since the last build.
+ *
+ * @param registry The entity storage.
+ * @param bvh The hierarchy to update.
+ */
+void updateSceneBVH(EntityRegistry& registry, BVH& bvh);
+
+/**
+ * @brief Refills the culler with the bounding spheres of the drawable entities.
+ *
+ * Reads the world boxes written by updateSceneBVH, so it has to run after it.
+ *
+ * @param registry The entity storage.
+ * @param culler The culler to fill.
+ */
+void gatherCullingSpheres(EntityRegistry& registry, FrustumCuller& culler);
+
+/**
+ * @brief Copies every model matrix into previousModel, once the frame using them was recorded.
+ *
+ * @param registry The entity storage.
+ */
+void storePreviousTransforms(EntityRegistry& registry);
@@ -0,0 +1,246 @@
+#include "ShaderHotReloader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// Required, shaderc ships with the Vulkan SDK and the project links shaderc_shared.lib
+#include <shaderc/shaderc.hpp>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace
+{
+	// Platforms without change notifications compare timestamps at this interval
+	const std::chrono::milliseconds TIMESTAMP_POLL_INTERVAL(500);
+
+	std::string getExtension(const std::string& fileName)
+	{
+		size_t dot = fileName.find_last_of('.');
+		return dot == std::string::npos ? std::string() : fileName.substr(dot + 1);
+	}
+}
+
+ShaderHotReloader::ShaderHotReloader()
+{
+}
+
+bool ShaderHotReloader::create(const std::string& newDirectory)
+{
+	directory = newDirectory;
+
+#if defined(__linux__)
+	// Editors either rewrite the file (close after write) or replace it (move over it)
+	inotifyHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyHandle < 0 || inotify_add_watch(inotifyHandle, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		printf("Shader hot reload disabled: can't watch %s\n", directory.c_str());
+		destroy();
+		return false;
+	}
+#elif defined(_WIN32)
+	HANDLE handle = FindFirstChangeNotificationA(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		printf("Shader hot reload disabled: can't watch %s\n", directory.c_str());
+		return false;
+	}
+	changeHandle = handle;
+#else
+	lastPollTime = std::chrono::steady_clock::now();
+#endif
+
+	enabled = true;
+	printf("Shader hot reload: watching %s\n", directory.c_str());
+	return true;
+}
+
+void ShaderHotReloader::addShader(const std::string& sourceFile, const std::string& spirvFile)
+{
+	shaders.push_back({ sourceFile, spirvFile, getLastWriteTime(sourceFile) });
+}
+
+std::vector<std::string> ShaderHotReloader::poll()
+{
+	std::vector<std::string> reloaded;
+	if (!enabled)
+	{
+		return reloaded;
+	}
+
+	std::vector<std::string> changes = collectChanges();
+	if (changes.empty())
+	{
+		return reloaded;
+	}
+
+	bool checkTimestamps = std::find(changes.begin(), changes.end(), std::string()) != changes.end();
+
+	for (auto& shader : shaders)
+	{
+		bool changed;
+		if (checkTimestamps)
+		{
+			int64_t writeTime = getLastWriteTime(shader.sourceFile);
+			changed = writeTime != shader.lastWriteTime;
+			shader.lastWriteTime = writeTime;
+		}
+		else
+		{
+			changed = std::find(changes.begin(), changes.end(), shader.sourceFile) != changes.end();
+		}
+
+		if (changed && compileShader(shader))
+		{
+			reloaded.push_back(shader.spirvFile);
+		}
+	}
+
+	return reloaded;
+}
+
+bool ShaderHotReloader::isEnabled() const
+{
+	return enabled;
+}
+
+void ShaderHotReloader::destroy()
+{
+#if defined(__linux__)
+	if (inotifyHandle >= 0)
+	{
+		close(inotifyHandle);
+	}
+#elif defined(_WIN32)
+	if (changeHandle != nullptr)
+	{
+		FindCloseChangeNotification(static_cast<HANDLE>(changeHandle));
+	}
+#endif
+
+	inotifyHandle = -1;
+	changeHandle = nullptr;
+	enabled = false;
+	shaders.clear();
+}
+
+ShaderHotReloader::~ShaderHotReloader()
+{
+}
+
+std::vector<std::string> ShaderHotReloader::collectChanges()
+{
+	std::vector<std::string> changes;
+
+#if defined(__linux__)
+	// Drain every pending event, the buffer is aligned for inotify_event
+	alignas(inotify_event) char buffer[4096];
+	while (true)
+	{
+		ssize_t length = read(inotifyHandle, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			break;		// EAGAIN: nothing left
+		}
+
+		for (ssize_t offset = 0; offset < length; )
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				changes.push_back(std::string());		// Events were lost
+			}
+			else if (event->len > 0)
+			{
+				changes.push_back(event->name);
+			}
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+#elif defined(_WIN32)
+	// The handle only says something changed in the directory
+	HANDLE handle = static_cast<HANDLE>(changeHandle);
+	if (WaitForSingleObject(handle, 0) == WAIT_OBJECT_0)
+	{
+		changes.push_back(std::string());
+		FindNextChangeNotification(handle);
+	}
+#else
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - lastPollTime >= TIMESTAMP_POLL_INTERVAL)
+	{
+		changes.push_back(std::string());
+		lastPollTime = now;
+	}
+#endif
+
+	return changes;
+}
+
+bool ShaderHotReloader::compileShader(const WatchedShader& shader) const
+{
+	std::string sourcePath = directory + "/" + shader.sourceFile;
+	std::ifstream sourceStream(sourcePath);
+	if (!sourceStream.is_open())
+	{
+		printf("Shader hot reload: can't open %s\n", sourcePath.c_str());
+		return false;
+	}
+
+	std::stringstream source;
+	source << sourceStream.rdbuf();
+
+	std::string extension = getExtension(shader.sourceFile);
+	shaderc_shader_kind kind;
+	if (extension == "vert") kind = shaderc_glsl_vertex_shader;
+	else if (extension == "frag") kind = shaderc_glsl_fragment_shader;
+	else if (extension == "comp") kind = shaderc_glsl_compute_shader;
+	else if (extension == "geom") kind = shaderc_glsl_geometry_shader;
+	else if (extension == "tesc") kind = shaderc_glsl_tess_control_shader;
+	else if (extension == "tese") kind = shaderc_glsl_tess_evaluation_shader;
+	else
+	{
+		printf("Shader hot reload: unknown shader stage of %s\n", shader.sourceFile.c_str());
+		return false;
+	}
+
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source.str(), kind, shader.sourceFile.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		printf("Shader hot reload: %s failed to compile, keeping the old version\n%s\n", shader.sourceFile.c_str(), result.GetErrorMessage().c_str());
+		return false;
+	}
+
+	std::vector<uint32_t> spirv(result.cbegin(), result.cend());
+	std::ofstream spirvStream(shader.spirvFile, std::ios::binary | std::ios::trunc);
+	spirvStream.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+	if (!spirvStream.good())
+	{
+		printf("Shader hot reload: can't write %s\n", shader.spirvFile.c_str());
+		return false;
+	}
+
+	printf("Shader hot reload: recompiled %s\n", shader.sourceFile.c_str());
+	return true;
+}
+
+int64_t ShaderHotReloader::getLastWriteTime(const std::string& sourceFile) const
+{
+	std::error_code error;
+	std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(directory + "/" + sourceFile, error);
+	return error ? 0 : static_cast<int64_t>(writeTime.time_since_epoch().count());
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+
+/**
+ * @class ShaderHotReloader
+ * @brief Watches GLSL sources and recompiles them to SPIR-V while the application runs.
+ *
+ * Changes are detected with inotify on Linux and a change notification handle on Windows
+ * (timestamps are polled elsewhere). Sources are compiled with shaderc from the Vulkan SDK,
+ * the result overwrites the SPIR-V file the pipelines are created from, so a reload and a
+ * restart see the same code. shaderc is required, a build without it fails to compile.
+ */
+class ShaderHotReloader
+{
+public:
+	ShaderHotReloader();
+
+	/**
+	 * @brief Starts watching a directory of shader sources.
+	 *
+	 * @param newDirectory Directory containing the GLSL sources (and their SPIR-V output).
+	 * @return False if hot reload is not available in this build or on this platform.
+	 */
+	bool create(const std::string& newDirectory);
+
+	/**
+	 * @brief Registers a GLSL source and the SPIR-V file it is compiled to.
+	 *
+	 * The shader stage comes from the source extension (.vert, .frag, .comp, .geom, .tesc, .tese).
+	 *
+	 * @param sourceFile Name of the GLSL file inside the watched directory.
+	 * @param spirvFile Path of the SPIR-V file used by the pipelines.
+	 */
+	void addShader(const std::string& sourceFile, const std::string& spirvFile);
+
+	/**
+	 * @brief Recompiles the sources changed since the last call. Never blocks.
+	 *
+	 * Compile errors are printed and the old SPIR-V is kept.
+	 *
+	 * @return SPIR-V files rewritten by this call.
+	 */
+	std::vector<std::string> poll();
+
+	bool isEnabled() const;
+
+	void destroy();
+
+	~ShaderHotReloader();
+
+private:
+	struct WatchedShader
+	{
+		std::string sourceFile;		// Name inside the watched directory
+		std::string spirvFile;
+		int64_t lastWriteTime;		// Used where there are no file names in the notifications
+	};
+
+	std::string directory;
+	std::vector<WatchedShader> shaders;
+	bool enabled = false;
+
+	int inotifyHandle = -1;									// Linux
+	void* changeHandle = nullptr;							// Windows
+	std::chrono::steady_clock::time_point lastPollTime;		// Other platforms
+
+	// Names of the changed files (an empty name means "check every timestamp")
+	std::vector<std::string> collectChanges();
+
+	bool compileShader(const WatchedShader& shader) const;
+
+	int64_t getLastWriteTime(const std::string& sourceFile) const;
+};
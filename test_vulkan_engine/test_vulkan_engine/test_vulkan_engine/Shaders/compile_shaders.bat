@@ -1,3 +1,26 @@
 C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V shader.vert
 C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V fullscreen.vert -o fullscreenVert.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V taa.frag -o taaFrag.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V tonemap.frag -o tonemapFrag.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V bloom_down.comp -o bloomDownComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V bloom_up.comp -o bloomUpComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V histogram.comp -o histogramComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V exposure.comp -o exposureComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V gbuffer.frag -o gbufferFrag.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V deferred_lighting.frag -o deferredLightingFrag.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V light_culling.comp -o lightCullingComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V equirect_to_cube.comp -o equirectToCubeComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V sh_irradiance.comp -o shIrradianceComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V prefilter_environment.comp -o prefilterEnvironmentComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V ssao.comp -o ssaoComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V ssao_temporal.comp -o ssaoTemporalComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V skinning.comp -o skinningComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V terrain.vert -o terrainVert.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V particle_args.comp -o particleArgsComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V particle_emit.comp -o particleEmitComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V particle_simulate.comp -o particleSimulateComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V particle_sort.comp -o particleSortComp.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V particle.vert -o particleVert.spv
+C:/VulkanSDK/1.3.290.0/Bin/glslangValidator.exe -V particle.frag -o particleFrag.spv
 pause
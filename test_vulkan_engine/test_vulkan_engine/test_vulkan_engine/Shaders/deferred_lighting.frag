@@ -0,0 +1,239 @@
+#version 450
+
+// Deferred path, subpass 1: shades every pixel from the G-buffer with the environment, the spotlight
+// and the point lights of the pixel's tile. Same lighting as shader.frag, so both paths render the same image
+
+#define MAX_LIGHTS_PER_TILE 63
+
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gbufferAlbedo;      // Base colour, metallic in alpha
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gbufferNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gbufferEmissive;    // Emission, roughness in alpha
+layout(input_attachment_index = 3, set = 1, binding = 3) uniform subpassInput gbufferDepth;
+
+// Per tile: the light count, then MAX_LIGHTS_PER_TILE light indices
+layout(set = 1, binding = 4) readonly buffer TileLights {
+    uint data[];
+} tileLights;
+
+layout(location = 0) out vec4 outColour;
+
+struct Spotlight {
+    vec3 lightPosition;
+    float innerCutOff;
+    vec3 lightDirection;
+    float outerCutOff;
+    vec3 lightColor;
+    float intensity;
+};
+
+layout(set = 0, binding = 1) uniform UboLighting {
+    vec3 ambiantLightColor;
+    float ambiantStr;
+    Spotlight spotlight;
+    vec2 depthParams;
+    float ambientOcclusionStrength;
+} ubo;
+
+struct PointLight {
+    vec4 positionRadius;    // World position, distance the light fades out at
+    vec4 colourIntensity;   // Colour, brightness multiplier
+};
+
+layout(set = 0, binding = 2) readonly buffer PointLights {
+    uint count;
+    PointLight lights[];
+} pointLights;
+
+layout(set = 0, binding = 3) uniform sampler2D ambientOcclusion;
+
+// Same as in shader.frag
+layout(set = 2, binding = 0) uniform EnvironmentIrradiance {
+    vec4 coefficients[9];
+} environmentIrradiance;
+
+layout(set = 2, binding = 1) uniform samplerCube prefilteredEnvironment;
+
+layout(push_constant) uniform PushDeferredLighting {
+    mat4 inverseViewProjection;     // Jittered like the G-buffer, NDC to world space
+    vec4 cameraPosition;
+    vec2 renderSize;                // Rendered area in pixels
+    uint tileSize;
+    uint tileCountX;
+} push;
+
+const float PI = 3.14159265359;
+
+struct Surface {
+    vec3 albedo;
+    float metallic;
+    float roughness;
+    vec3 normal;
+};
+
+// -- SHADING --
+// Same as in shader.frag
+
+float distributionGGX(float NdotH, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    return a2 / (PI * d * d);
+}
+
+float geometrySmith(float NdotV, float NdotL, float roughness) {
+    float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+    return (NdotV / (NdotV * (1.0 - k) + k)) * (NdotL / (NdotL * (1.0 - k) + k));
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 f0) {
+    return f0 + (1.0 - f0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 shadeSurface(Surface surface, vec3 lightDir, vec3 viewDir, vec3 radiance) {
+    float NdotL = max(dot(surface.normal, lightDir), 0.0);
+    if (NdotL <= 0.0) {
+        return vec3(0.0);
+    }
+
+    vec3 halfway = normalize(lightDir + viewDir);
+    float NdotV = max(dot(surface.normal, viewDir), 0.0001);
+    float NdotH = max(dot(surface.normal, halfway), 0.0);
+    float VdotH = max(dot(viewDir, halfway), 0.0);
+
+    vec3 f0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+    vec3 fresnel = fresnelSchlick(VdotH, f0);
+    vec3 specular = distributionGGX(NdotH, surface.roughness) * geometrySmith(NdotV, NdotL, surface.roughness) * fresnel
+        / (4.0 * NdotV * NdotL + 0.0001);
+    vec3 diffuse = (1.0 - fresnel) * (1.0 - surface.metallic) * surface.albedo / PI;
+
+    return (diffuse + specular) * radiance * NdotL;
+}
+
+vec3 shadeSpotlight(Surface surface, vec3 position, vec3 viewDir) {
+    vec3 toLight = ubo.spotlight.lightPosition - position;
+    float distance = length(toLight);
+    vec3 lightDir = toLight / max(distance, 0.0001);
+
+    float theta = dot(lightDir, normalize(-ubo.spotlight.lightDirection));
+    float epsilon = max(ubo.spotlight.innerCutOff - ubo.spotlight.outerCutOff, 0.001);
+    float cone = clamp((theta - ubo.spotlight.outerCutOff) / epsilon, 0.0, 1.0);
+    float attenuation = 1.0 / (1.0 + 0.01 * distance + 0.001 * (distance * distance));
+
+    vec3 radiance = ubo.spotlight.lightColor * ubo.spotlight.intensity * cone * attenuation;
+    return shadeSurface(surface, lightDir, viewDir, radiance);
+}
+
+vec3 shadePointLight(PointLight light, Surface surface, vec3 position, vec3 viewDir) {
+    vec3 toLight = light.positionRadius.xyz - position;
+    float distance = length(toLight);
+    float radius = light.positionRadius.w;
+    if (distance >= radius) {
+        return vec3(0.0);
+    }
+
+    // Inverse square falloff, windowed to reach zero at the radius
+    vec3 lightDir = toLight / max(distance, 0.0001);
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    float attenuation = window * window / (distance * distance + 1.0);
+
+    vec3 radiance = light.colourIntensity.rgb * light.colourIntensity.a * attenuation;
+    return shadeSurface(surface, lightDir, viewDir, radiance);
+}
+
+vec3 evaluateIrradiance(vec3 n) {
+    vec3 irradiance = environmentIrradiance.coefficients[0].rgb * 0.282095
+        + environmentIrradiance.coefficients[1].rgb * 0.488603 * n.y
+        + environmentIrradiance.coefficients[2].rgb * 0.488603 * n.z
+        + environmentIrradiance.coefficients[3].rgb * 0.488603 * n.x
+        + environmentIrradiance.coefficients[4].rgb * 1.092548 * n.x * n.y
+        + environmentIrradiance.coefficients[5].rgb * 1.092548 * n.y * n.z
+        + environmentIrradiance.coefficients[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+        + environmentIrradiance.coefficients[7].rgb * 1.092548 * n.x * n.z
+        + environmentIrradiance.coefficients[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+    return max(irradiance, vec3(0.0));
+}
+
+vec3 environmentBRDF(vec3 f0, float roughness, float NdotV) {
+    const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+    const vec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+    vec4 r = roughness * c0 + c1;
+    float a004 = min(r.x * r.x, exp2(-9.28 * NdotV)) * r.x + r.y;
+    vec2 scaleBias = vec2(-1.04, 1.04) * a004 + r.zw;
+    return f0 * scaleBias.x + scaleBias.y;
+}
+
+vec3 shadeEnvironment(Surface surface, vec3 viewDir) {
+    float NdotV = max(dot(surface.normal, viewDir), 0.0001);
+    vec3 f0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+    vec3 specularColour = environmentBRDF(f0, surface.roughness, NdotV);
+
+    vec3 diffuse = evaluateIrradiance(surface.normal) * surface.albedo / PI * (1.0 - surface.metallic) * (1.0 - specularColour);
+
+    float lod = surface.roughness * float(textureQueryLevels(prefilteredEnvironment) - 1);
+    vec3 specular = textureLod(prefilteredEnvironment, reflect(-viewDir, surface.normal), lod).rgb * specularColour;
+
+    return (diffuse + specular) * ubo.ambiantLightColor * ubo.ambiantStr;
+}
+
+float sampleAmbientOcclusion(vec2 fragCoord, float depth) {
+    float pixelDepth = ubo.depthParams.y / (depth + ubo.depthParams.x);
+
+    // Texel i was computed for the full resolution pixel 2i
+    vec2 position = (fragCoord - 0.5) * 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+    ivec2 maxTexel = textureSize(ambientOcclusion, 0) - 1;
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 value = texelFetch(ambientOcclusion, clamp(base + offset, ivec2(0), maxTexel), 0).rg;
+        float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        float similarity = max(0.0, 1.0 - abs(value.g - pixelDepth) / (0.1 * pixelDepth));
+        float weight = bilinear * similarity + 0.0001;
+        sum += value.r * weight;
+        weightSum += weight;
+    }
+
+    return mix(1.0, sum / weightSum, ubo.ambientOcclusionStrength);
+}
+
+void main() {
+    // Nothing was drawn here, the background keeps the clear colour
+    float depth = subpassLoad(gbufferDepth).r;
+    if (depth >= 1.0) {
+        discard;
+    }
+
+    vec4 albedoMetallic = subpassLoad(gbufferAlbedo);
+    vec4 emissiveRoughness = subpassLoad(gbufferEmissive);
+
+    Surface surface;
+    surface.albedo = albedoMetallic.rgb;
+    surface.metallic = albedoMetallic.a;
+    surface.roughness = emissiveRoughness.a;
+    surface.normal = normalize(subpassLoad(gbufferNormal).xyz * 2.0 - 1.0);
+
+    // World position from the depth, the viewport covers the rendered area from the top left corner
+    vec2 ndc = gl_FragCoord.xy / push.renderSize * 2.0 - 1.0;
+    vec4 worldPos = push.inverseViewProjection * vec4(ndc, depth, 1.0);
+    vec3 fragPos = worldPos.xyz / worldPos.w;
+    vec3 viewDir = normalize(push.cameraPosition.xyz - fragPos);
+
+    // Environment, darkened by the ambient occlusion, and spotlight
+    vec3 lighting = shadeEnvironment(surface, viewDir) * sampleAmbientOcclusion(gl_FragCoord.xy, depth);
+    lighting += shadeSpotlight(surface, fragPos, viewDir);
+
+    // Point lights: only the ones the light culling found in this tile
+    uvec2 tile = uvec2(gl_FragCoord.xy) / push.tileSize;
+    uint tileStart = (tile.y * push.tileCountX + tile.x) * (MAX_LIGHTS_PER_TILE + 1);
+    uint lightCount = min(tileLights.data[tileStart], MAX_LIGHTS_PER_TILE);
+    for (uint i = 0; i < lightCount; i++) {
+        lighting += shadePointLight(pointLights.lights[tileLights.data[tileStart + 1 + i]], surface, fragPos, viewDir);
+    }
+
+    lighting += emissiveRoughness.rgb;
+
+    outColour = vec4(lighting, 1.0);
+}
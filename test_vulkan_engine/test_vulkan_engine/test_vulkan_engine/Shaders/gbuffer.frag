@@ -0,0 +1,172 @@
+#version 450
+
+// Deferred path, subpass 0: writes the surface instead of shading it
+
+layout(location = 0) in vec3 fragCol;
+layout(location = 1) in vec2 fragTex;
+layout(location = 2) in vec3 fragNorm;          // World space normal
+layout(location = 3) in vec3 fragPos;
+layout(location = 4) in vec3 viewPos;
+layout(location = 5) in vec4 currentClipPos;    // Without jitter, this frame
+layout(location = 6) in vec4 previousClipPos;   // Without jitter, previous frame
+
+// Same material set as shader.frag
+layout(set = 1, binding = 0) uniform sampler2D baseColourTexture;
+layout(set = 1, binding = 1) uniform sampler2D normalTexture;
+layout(set = 1, binding = 2) uniform sampler2D metalRoughnessTexture;
+layout(set = 1, binding = 3) uniform sampler2D emissiveTexture;
+
+#define MATERIAL_HAS_NORMAL_TEXTURE 2u
+
+layout(set = 1, binding = 4) uniform MaterialParams {
+    vec4 baseColourFactor;
+    vec4 emissiveFactor;
+    float metallic;
+    float roughness;
+    float normalScale;
+    uint textureFlags;
+    uvec4 feedbackSlots;    // Per slot, where the texture streamer reads the mip it needs (0xFFFFFFFF: not streamed)
+    vec4 textureLog2Sizes;  // Per slot, of the larger side of the full size texture
+} material;
+
+// Same as in shader.frag
+layout(set = 0, binding = 4) buffer TextureFeedback {
+    uint feedbackPixel;
+    uint requestedMips[];
+} feedback;
+
+// Same virtual texture set as shader.frag
+#define MATERIAL_VIRTUAL_TEXTURE 16u
+
+layout(set = 3, binding = 0) uniform usampler2D virtualPageTable;
+layout(set = 3, binding = 1) uniform sampler2D virtualAtlas;
+
+layout(set = 3, binding = 2) buffer VirtualTextureFeedback {
+    vec4 area;
+    uint feedbackPixel;
+    uint mipCount;
+    uint pagesPerSide;
+    uint padding;
+    uint requestedPages[];
+} virtualTexture;
+
+const float VIRTUAL_PAGE_SIZE = 128.0;
+const float VIRTUAL_PAGE_BORDER = 4.0;
+
+layout(location = 0) out vec4 outAlbedo;        // Base colour (sRGB attachment), metallic in alpha
+layout(location = 1) out vec4 outNormal;        // World space normal mapped to [0, 1], 10 bits per axis
+layout(location = 2) out vec4 outEmissive;      // HDR emission, roughness in alpha
+layout(location = 3) out vec4 outVelocity;      // Same as shader.frag
+
+// Same as in shader.frag
+vec3 perturbNormal(vec3 normal, vec3 position, vec2 uv) {
+    vec3 mapNormal = texture(normalTexture, uv).xyz * 2.0 - 1.0;
+    mapNormal.xy *= material.normalScale;
+    mapNormal.y = -mapNormal.y;     // The loader flips the V axis
+
+    vec3 dp1 = dFdx(position);
+    vec3 dp2 = dFdy(position);
+    vec2 duv1 = dFdx(uv);
+    vec2 duv2 = dFdy(uv);
+
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+
+    float frameSize = max(dot(tangent, tangent), dot(bitangent, bitangent));
+    if (frameSize <= 0.0) {
+        return normal;
+    }
+
+    float invMax = inversesqrt(frameSize);
+    return normalize(mat3(tangent * invMax, bitangent * invMax, normal) * mapNormal);
+}
+
+// Same as in shader.frag
+void writeTextureFeedback(vec2 uv) {
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+
+    uvec2 blockPixel = uvec2(gl_FragCoord.xy) & 7u;
+    if (blockPixel.y * 8u + blockPixel.x != feedback.feedbackPixel) {
+        return;
+    }
+
+    // As the sampler picks it with 16x anisotropy: the longer axis, divided by up to 16 samples along it
+    float longAxis = max(length(dx), length(dy));
+    float shortAxis = max(min(length(dx), length(dy)), 1e-8);
+    float uvLod = log2(max(longAxis / min(ceil(longAxis / shortAxis), 16.0), 1e-8));
+
+    for (int slot = 0; slot < 4; slot++) {
+        uint feedbackSlot = material.feedbackSlots[slot];
+        if (feedbackSlot != 0xFFFFFFFFu) {
+            uint mip = uint(max(uvLod + material.textureLog2Sizes[slot], 0.0));
+            atomicMin(feedback.requestedMips[feedbackSlot], mip);
+        }
+    }
+}
+
+// Same as in shader.frag
+vec4 sampleVirtualMip(vec2 uv, uint mip) {
+    float pages = float(virtualTexture.pagesPerSide >> mip);
+    uvec4 entry = texelFetch(virtualPageTable, ivec2(min(uv * pages, vec2(pages - 1.0))), int(mip));
+
+    float entryPages = float(virtualTexture.pagesPerSide >> entry.z);
+    vec2 entryUv = uv * entryPages;
+    vec2 inPage = entryUv - min(floor(entryUv), vec2(entryPages - 1.0));
+
+    vec2 atlasTexel = vec2(entry.xy) * (VIRTUAL_PAGE_SIZE + 2.0 * VIRTUAL_PAGE_BORDER) + VIRTUAL_PAGE_BORDER + inPage * VIRTUAL_PAGE_SIZE;
+    return textureLod(virtualAtlas, atlasTexel / vec2(textureSize(virtualAtlas, 0)), 0.0);
+}
+
+// Same as in shader.frag
+vec4 sampleVirtualTexture(vec3 position) {
+    vec2 uv = clamp((position.xz - virtualTexture.area.xy) * virtualTexture.area.zw, 0.0, 1.0);
+    vec2 texels = uv * float(virtualTexture.pagesPerSide) * VIRTUAL_PAGE_SIZE;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float lod = clamp(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)), 0.0, float(virtualTexture.mipCount - 1u));
+    uint mip = uint(lod);
+
+    uvec2 blockPixel = uvec2(gl_FragCoord.xy) & 7u;
+    if (blockPixel.y * 8u + blockPixel.x == virtualTexture.feedbackPixel) {
+        uint pages = virtualTexture.pagesPerSide >> mip;
+        uvec2 page = min(uvec2(uv * float(pages)), uvec2(pages - 1u));
+        uint offset = 0u;
+        for (uint i = 0u; i < mip; i++) {
+            offset += (virtualTexture.pagesPerSide >> i) * (virtualTexture.pagesPerSide >> i);
+        }
+        virtualTexture.requestedPages[offset + page.y * pages + page.x] = 1u;
+    }
+
+    uint nextMip = min(mip + 1u, virtualTexture.mipCount - 1u);
+    return mix(sampleVirtualMip(uv, mip), sampleVirtualMip(uv, nextMip), fract(lod));
+}
+
+void main() {
+    writeTextureFeedback(fragTex);
+
+    vec4 baseColour;
+    if ((material.textureFlags & MATERIAL_VIRTUAL_TEXTURE) != 0u) {
+        baseColour = sampleVirtualTexture(fragPos) * material.baseColourFactor;
+    } else {
+        baseColour = texture(baseColourTexture, fragTex) * material.baseColourFactor;
+    }
+    vec2 metalRoughness = texture(metalRoughnessTexture, fragTex).bg;
+    float metallic = clamp(material.metallic * metalRoughness.x, 0.0, 1.0);
+    float roughness = clamp(material.roughness * metalRoughness.y, 0.045, 1.0);
+
+    vec3 normal = normalize(fragNorm);
+    if ((material.textureFlags & MATERIAL_HAS_NORMAL_TEXTURE) != 0u) {
+        normal = perturbNormal(normal, fragPos, fragTex);
+    }
+
+    outAlbedo = vec4(baseColour.rgb, metallic);
+    outNormal = vec4(normal * 0.5 + 0.5, 0.0);
+    outEmissive = vec4(texture(emissiveTexture, fragTex).rgb * material.emissiveFactor.rgb, roughness);
+
+    vec2 currentUv = currentClipPos.xy / currentClipPos.w * 0.5;
+    vec2 previousUv = previousClipPos.xy / previousClipPos.w * 0.5;
+    outVelocity = vec4(currentUv - previousUv, 0.0, 1.0);
+}
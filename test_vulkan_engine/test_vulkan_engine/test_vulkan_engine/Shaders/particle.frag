@@ -0,0 +1,16 @@
+#version 450
+
+// Particles: a soft disc, blended over the scene. Unlit, the colour is the emitter's HDR colour
+
+layout(location = 0) in vec2 fragCorner;
+layout(location = 1) in vec4 fragColour;
+
+layout(location = 0) out vec4 outColour;
+
+void main() {
+    float alpha = fragColour.a * (1.0 - smoothstep(0.3, 1.0, length(fragCorner)));
+    if (alpha < 1.0 / 255.0) {
+        discard;
+    }
+    outColour = vec4(fragColour.rgb, alpha);
+}
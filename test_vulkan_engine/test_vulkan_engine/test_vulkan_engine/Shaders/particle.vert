@@ -0,0 +1,75 @@
+#version 450
+
+// Particles: a camera facing quad per living particle, farthest first. The instance is an entry of the
+// sorted keys, the vertex a corner of its two triangles; size and colour follow the particle's age
+
+const vec2 CORNERS[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+const float FADE_IN = 0.1;      // Share of the life the particle fades in over
+
+layout(set = 0, binding = 0) uniform ParticleFrame {
+    mat4 viewProjection;        // Jittered, as the scene
+    mat4 inverseViewProjection;
+    vec4 cameraPosition;
+    vec4 cameraRight;
+    vec4 cameraUp;
+    vec4 gravity;
+    vec4 depthScale;
+    uvec4 counts;
+} frame;
+
+struct Emitter {
+    vec4 position;
+    vec4 direction;
+    vec4 startColour;
+    vec4 endColour;
+    vec4 size;                  // Start size, end size, lowest speed, highest speed
+    vec4 life;
+    vec4 collision;
+    uvec4 emission;
+};
+
+struct Particle {
+    vec3 position;
+    float age;
+    vec3 velocity;
+    float life;
+    uint emitter;
+    float rotation;
+    float sizeScale;
+    float padding;
+};
+
+layout(set = 0, binding = 1) readonly buffer Emitters {
+    Emitter emitters[];
+};
+layout(set = 0, binding = 2) readonly buffer Particles {
+    Particle particles[];
+};
+layout(set = 0, binding = 5) readonly buffer SortKeys {
+    uvec2 sortKeys[];
+};
+
+layout(location = 0) out vec2 fragCorner;
+layout(location = 1) out vec4 fragColour;
+
+void main() {
+    Particle particle = particles[sortKeys[gl_InstanceIndex].y];
+    Emitter emitter = emitters[particle.emitter];
+    float t = clamp(particle.age / particle.life, 0.0, 1.0);
+
+    vec2 corner = CORNERS[gl_VertexIndex];
+    float s = sin(particle.rotation);
+    float c = cos(particle.rotation);
+    vec2 rotated = vec2(corner.x * c - corner.y * s, corner.x * s + corner.y * c);
+    float halfSize = 0.5 * particle.sizeScale * mix(emitter.size.x, emitter.size.y, t);
+
+    vec3 worldPos = particle.position + (frame.cameraRight.xyz * rotated.x + frame.cameraUp.xyz * rotated.y) * halfSize;
+    gl_Position = frame.viewProjection * vec4(worldPos, 1.0);
+
+    fragCorner = corner;
+    fragColour = mix(emitter.startColour, emitter.endColour, t);
+    fragColour.a *= smoothstep(0.0, FADE_IN, t);
+}
@@ -5,23 +5,39 @@ layout(location = 1) in vec2 fragTex;   // Textúra koordináták
 layout(location = 2) in vec3 fragNorm;  // Világ térbeli normálok
 layout(location = 3) in vec3 fragPos;   // Világ térbeli pozíció
 layout(location = 4) in vec3 viewPos;   // Kamera pozíció világ térben
+layout(location = 5) in vec4 currentClipPos;    // Without jitter, this frame
+layout(location = 6) in vec4 previousClipPos;   // Without jitter, previous frame
 
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;  // Textúra mintázó
+// Material: a texture per slot and the parameter block, see MaterialLibrary
+layout(set = 1, binding = 0) uniform sampler2D baseColourTexture;      // sRGB, alpha is the opacity
+layout(set = 1, binding = 1) uniform sampler2D normalTexture;          // Tangent space
+layout(set = 1, binding = 2) uniform sampler2D metalRoughnessTexture;  // Roughness in green, metallic in blue
+layout(set = 1, binding = 3) uniform sampler2D emissiveTexture;        // sRGB
+
+#define MATERIAL_HAS_NORMAL_TEXTURE 2u
+
+layout(set = 1, binding = 4) uniform MaterialParams {
+    vec4 baseColourFactor;
+    vec4 emissiveFactor;
+    float metallic;
+    float roughness;
+    float normalScale;
+    uint textureFlags;      // Bit per slot that holds a texture of the material
+    uvec4 feedbackSlots;    // Per slot, where the texture streamer reads the mip it needs (0xFFFFFFFF: not streamed)
+    vec4 textureLog2Sizes;  // Per slot, of the larger side of the full size texture
+} material;
 
 layout(location = 0) out vec4 outColour;  // Kimeneti szín
+layout(location = 1) out vec4 outVelocity;    // UV offset from the previous frame (alpha 1, the attachment is blended like the colour)
 
 // Spotlight struktúra deklarálása kívül
 struct Spotlight {
-    vec3 lightDirection; // A fény iránya
-    float diffuseStr;    // Diffúz fény erőssége
-    vec3 lightColor;     // A fény színe
-    float specularStr;   // Speculáris fény erőssége
-    float shininess;     // Speculáris élesség
-
+    vec3 lightPosition;  // A fény pozíciója
     float innerCutOff;   // A fény kúp szögének belső határa
+    vec3 lightDirection; // A fény iránya
     float outerCutOff;   // A fény kúp szögének külső határa
-
-    vec3 lightPosition;  // ÚJ: A fény pozíciója
+    vec3 lightColor;     // A fény színe
+    float intensity;     // Brightness multiplier of the colour
 };
 
 
@@ -29,41 +45,333 @@ layout(set = 0, binding = 1) uniform UboLighting {
     vec3 ambiantLightColor; // Ambient fény színe
     float ambiantStr;       // Ambient erősség
     Spotlight spotlight;     // A spotlight struktúra használata
+    vec2 depthParams;        // P[2][2], P[3][2] of the projection: depth buffer to linear depth
+    float ambientOcclusionStrength;
 } ubo;
 
-void main() {
-    vec3 norm = normalize(fragNorm);
-    vec3 lightDir = normalize(ubo.spotlight.lightPosition - fragPos); // Spotlight irány
-    vec3 viewDir = normalize(viewPos - fragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
+struct PointLight {
+    vec4 positionRadius;    // World position, distance the light fades out at
+    vec4 colourIntensity;   // Colour, brightness multiplier
+};
 
-    // Ambient lighting
-    vec3 ambient = ubo.ambiantStr * ubo.ambiantLightColor;
+layout(set = 0, binding = 2) readonly buffer PointLights {
+    uint count;
+    PointLight lights[];
+} pointLights;
 
-    // Diffuse lighting
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = ubo.spotlight.diffuseStr * diff * ubo.spotlight.lightColor;
+layout(set = 0, binding = 3) uniform sampler2D ambientOcclusion;   // Half resolution, occlusion in r and linear depth in g
+
+// Texture streaming feedback of this frame, see TextureStreamer
+layout(set = 0, binding = 4) buffer TextureFeedback {
+    uint feedbackPixel;     // The pixel of every 8x8 block that writes this frame
+    uint requestedMips[];   // Per streamed texture, the finest mip a pixel needed
+} feedback;
+
+// Environment lighting, see EnvironmentLighting
+layout(set = 2, binding = 0) uniform EnvironmentIrradiance {
+    vec4 coefficients[9];   // SH9 of the irradiance, already convolved with the cosine lobe
+} environmentIrradiance;
+
+layout(set = 2, binding = 1) uniform samplerCube prefilteredEnvironment;  // GGX prefiltered, roughness grows with the level
+
+// Virtual texture stretched over the XZ plane, see VirtualTexture. A material with the flag samples it
+// instead of its base colour texture
+#define MATERIAL_VIRTUAL_TEXTURE 16u
+
+layout(set = 3, binding = 0) uniform usampler2D virtualPageTable;   // Texel per page, a level per mip: atlas slot x, y, mip of the page there, 1
+layout(set = 3, binding = 1) uniform sampler2D virtualAtlas;        // The resident pages, with their borders
+
+layout(set = 3, binding = 2) buffer VirtualTextureFeedback {
+    vec4 area;              // World XZ of the first texel, 1 / extent of the area
+    uint feedbackPixel;     // The pixel of every 8x8 block that writes this frame
+    uint mipCount;
+    uint pagesPerSide;      // At mip 0
+    uint padding;
+    uint requestedPages[];  // Per page (mip after mip, row by row), set when a pixel sampled it
+} virtualTexture;
+
+const float VIRTUAL_PAGE_SIZE = 128.0;
+const float VIRTUAL_PAGE_BORDER = 4.0;
+
+const float PI = 3.14159265359;
+
+struct Surface {
+    vec3 albedo;
+    float metallic;
+    float roughness;        // Perceptual, squared for the distribution
+    vec3 normal;
+};
 
-    // Specular lighting
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), ubo.spotlight.shininess);
-    vec3 specular = ubo.spotlight.specularStr * spec * ubo.spotlight.lightColor;
+// -- SHADING --
+// Same as in deferred_lighting.frag, so both paths render the same image
+
+// GGX (Trowbridge-Reitz) normal distribution
+float distributionGGX(float NdotH, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    return a2 / (PI * d * d);
+}
+
+// Smith shadowing-masking with the Schlick-GGX approximation, k remapped for punctual lights
+float geometrySmith(float NdotV, float NdotL, float roughness) {
+    float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+    return (NdotV / (NdotV * (1.0 - k) + k)) * (NdotL / (NdotL * (1.0 - k) + k));
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 f0) {
+    return f0 + (1.0 - f0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// Cook-Torrance specular and Lambert diffuse, for light of the given radiance arriving from lightDir
+vec3 shadeSurface(Surface surface, vec3 lightDir, vec3 viewDir, vec3 radiance) {
+    float NdotL = max(dot(surface.normal, lightDir), 0.0);
+    if (NdotL <= 0.0) {
+        return vec3(0.0);
+    }
+
+    vec3 halfway = normalize(lightDir + viewDir);
+    float NdotV = max(dot(surface.normal, viewDir), 0.0001);
+    float NdotH = max(dot(surface.normal, halfway), 0.0);
+    float VdotH = max(dot(viewDir, halfway), 0.0);
+
+    // Dielectrics reflect 4% head on, metals reflect their colour and have no diffuse
+    vec3 f0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+    vec3 fresnel = fresnelSchlick(VdotH, f0);
+    vec3 specular = distributionGGX(NdotH, surface.roughness) * geometrySmith(NdotV, NdotL, surface.roughness) * fresnel
+        / (4.0 * NdotV * NdotL + 0.0001);
+    vec3 diffuse = (1.0 - fresnel) * (1.0 - surface.metallic) * surface.albedo / PI;
+
+    return (diffuse + specular) * radiance * NdotL;
+}
+
+vec3 shadeSpotlight(Surface surface, vec3 position, vec3 viewDir) {
+    vec3 toLight = ubo.spotlight.lightPosition - position;
+    float distance = length(toLight);
+    vec3 lightDir = toLight / max(distance, 0.0001);
 
     // Spotlight cutoff
     float theta = dot(lightDir, normalize(-ubo.spotlight.lightDirection));
     float epsilon = max(ubo.spotlight.innerCutOff - ubo.spotlight.outerCutOff, 0.001); // Biztonsági tartomány
-    float spotlightIntensity = clamp((theta - ubo.spotlight.outerCutOff) / epsilon, 0.0, 1.0);
+    float cone = clamp((theta - ubo.spotlight.outerCutOff) / epsilon, 0.0, 1.0);
 
     // Attenuation (distance-based)
-    float distance = length(ubo.spotlight.lightPosition - fragPos);
-    float attenuation = 1.0 / (1.0 + 0.01 * distance + 0.001 * (distance * distance)); // Példa paraméterek
-	//float attenuation = 1.0;
+    float attenuation = 1.0 / (1.0 + 0.01 * distance + 0.001 * (distance * distance));
+
+    vec3 radiance = ubo.spotlight.lightColor * ubo.spotlight.intensity * cone * attenuation;
+    return shadeSurface(surface, lightDir, viewDir, radiance);
+}
+
+vec3 shadePointLight(PointLight light, Surface surface, vec3 position, vec3 viewDir) {
+    vec3 toLight = light.positionRadius.xyz - position;
+    float distance = length(toLight);
+    float radius = light.positionRadius.w;
+    if (distance >= radius) {
+        return vec3(0.0);
+    }
+
+    // Inverse square falloff, windowed to reach zero at the radius
+    vec3 lightDir = toLight / max(distance, 0.0001);
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    float attenuation = window * window / (distance * distance + 1.0);
+
+    vec3 radiance = light.colourIntensity.rgb * light.colourIntensity.a * attenuation;
+    return shadeSurface(surface, lightDir, viewDir, radiance);
+}
+
+// Irradiance arriving at a surface facing the normal, in the basis order of sh_irradiance.comp
+vec3 evaluateIrradiance(vec3 n) {
+    vec3 irradiance = environmentIrradiance.coefficients[0].rgb * 0.282095
+        + environmentIrradiance.coefficients[1].rgb * 0.488603 * n.y
+        + environmentIrradiance.coefficients[2].rgb * 0.488603 * n.z
+        + environmentIrradiance.coefficients[3].rgb * 0.488603 * n.x
+        + environmentIrradiance.coefficients[4].rgb * 1.092548 * n.x * n.y
+        + environmentIrradiance.coefficients[5].rgb * 1.092548 * n.y * n.z
+        + environmentIrradiance.coefficients[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+        + environmentIrradiance.coefficients[7].rgb * 1.092548 * n.x * n.z
+        + environmentIrradiance.coefficients[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+    return max(irradiance, vec3(0.0));     // Three bands can ring below zero behind very bright lights
+}
+
+// Scale and bias of f0 from the split sum's BRDF integral, an analytic fit (Karis) instead of a lookup texture
+vec3 environmentBRDF(vec3 f0, float roughness, float NdotV) {
+    const vec4 c0 = vec4(-1.0, -0.0275, -0.572, 0.022);
+    const vec4 c1 = vec4(1.0, 0.0425, 1.04, -0.04);
+    vec4 r = roughness * c0 + c1;
+    float a004 = min(r.x * r.x, exp2(-9.28 * NdotV)) * r.x + r.y;
+    vec2 scaleBias = vec2(-1.04, 1.04) * a004 + r.zw;
+    return f0 * scaleBias.x + scaleBias.y;
+}
+
+// Diffuse from the SH irradiance, specular from the prefiltered level matching the roughness
+vec3 shadeEnvironment(Surface surface, vec3 viewDir) {
+    float NdotV = max(dot(surface.normal, viewDir), 0.0001);
+    vec3 f0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+    vec3 specularColour = environmentBRDF(f0, surface.roughness, NdotV);
+
+    vec3 diffuse = evaluateIrradiance(surface.normal) * surface.albedo / PI * (1.0 - surface.metallic) * (1.0 - specularColour);
+
+    float lod = surface.roughness * float(textureQueryLevels(prefilteredEnvironment) - 1);
+    vec3 specular = textureLod(prefilteredEnvironment, reflect(-viewDir, surface.normal), lod).rgb * specularColour;
+
+    return (diffuse + specular) * ubo.ambiantLightColor * ubo.ambiantStr;
+}
+
+// Bilateral upsample of the half resolution occlusion: the bilinear weights of the four nearest
+// texels, reduced where their depth differs from the pixel's so the occlusion doesn't bleed across edges
+float sampleAmbientOcclusion(vec2 fragCoord, float depth) {
+    float pixelDepth = ubo.depthParams.y / (depth + ubo.depthParams.x);
+
+    // Texel i was computed for the full resolution pixel 2i
+    vec2 position = (fragCoord - 0.5) * 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+    ivec2 maxTexel = textureSize(ambientOcclusion, 0) - 1;
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 value = texelFetch(ambientOcclusion, clamp(base + offset, ivec2(0), maxTexel), 0).rg;
+        float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        float similarity = max(0.0, 1.0 - abs(value.g - pixelDepth) / (0.1 * pixelDepth));
+        float weight = bilinear * similarity + 0.0001;
+        sum += value.r * weight;
+        weightSum += weight;
+    }
+
+    return mix(1.0, sum / weightSum, ubo.ambientOcclusionStrength);
+}
+
+// Same as in gbuffer.frag. The meshes have no tangents, the tangent frame comes from the screen space
+// derivatives of the position and the UVs
+vec3 perturbNormal(vec3 normal, vec3 position, vec2 uv) {
+    vec3 mapNormal = texture(normalTexture, uv).xyz * 2.0 - 1.0;
+    mapNormal.xy *= material.normalScale;
+    mapNormal.y = -mapNormal.y;     // The loader flips the V axis
+
+    vec3 dp1 = dFdx(position);
+    vec3 dp2 = dFdy(position);
+    vec2 duv1 = dFdx(uv);
+    vec2 duv2 = dFdy(uv);
+
+    vec3 dp2perp = cross(dp2, normal);
+    vec3 dp1perp = cross(normal, dp1);
+    vec3 tangent = dp2perp * duv1.x + dp1perp * duv2.x;
+    vec3 bitangent = dp2perp * duv1.y + dp1perp * duv2.y;
+
+    // Surfaces without UVs have no frame to tilt the normal in
+    float frameSize = max(dot(tangent, tangent), dot(bitangent, bitangent));
+    if (frameSize <= 0.0) {
+        return normal;
+    }
+
+    float invMax = inversesqrt(frameSize);
+    return normalize(mat3(tangent * invMax, bitangent * invMax, normal) * mapNormal);
+}
+
+// One pixel of every 8x8 block reports the mip each texture of the material needs, a different one each
+// frame. The derivatives are taken before the branch, while the whole quad still runs
+void writeTextureFeedback(vec2 uv) {
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+
+    uvec2 blockPixel = uvec2(gl_FragCoord.xy) & 7u;
+    if (blockPixel.y * 8u + blockPixel.x != feedback.feedbackPixel) {
+        return;
+    }
+
+    // As the sampler picks it with 16x anisotropy: the longer axis, divided by up to 16 samples along it
+    float longAxis = max(length(dx), length(dy));
+    float shortAxis = max(min(length(dx), length(dy)), 1e-8);
+    float uvLod = log2(max(longAxis / min(ceil(longAxis / shortAxis), 16.0), 1e-8));
+
+    for (int slot = 0; slot < 4; slot++) {
+        uint feedbackSlot = material.feedbackSlots[slot];
+        if (feedbackSlot != 0xFFFFFFFFu) {
+            uint mip = uint(max(uvLod + material.textureLog2Sizes[slot], 0.0));
+            atomicMin(feedback.requestedMips[feedbackSlot], mip);
+        }
+    }
+}
+
+// The page table entry of a missing page points at its finest resident ancestor, the position
+// is then taken inside that page, at its own mip
+vec4 sampleVirtualMip(vec2 uv, uint mip) {
+    float pages = float(virtualTexture.pagesPerSide >> mip);
+    uvec4 entry = texelFetch(virtualPageTable, ivec2(min(uv * pages, vec2(pages - 1.0))), int(mip));
+
+    float entryPages = float(virtualTexture.pagesPerSide >> entry.z);
+    vec2 entryUv = uv * entryPages;
+    vec2 inPage = entryUv - min(floor(entryUv), vec2(entryPages - 1.0));
+
+    vec2 atlasTexel = vec2(entry.xy) * (VIRTUAL_PAGE_SIZE + 2.0 * VIRTUAL_PAGE_BORDER) + VIRTUAL_PAGE_BORDER + inPage * VIRTUAL_PAGE_SIZE;
+    return textureLod(virtualAtlas, atlasTexel / vec2(textureSize(virtualAtlas, 0)), 0.0);
+}
+
+// Trilinear from two page lookups. One pixel of every 8x8 block flags the page it needs, like
+// writeTextureFeedback, the derivatives are taken before the branch
+vec4 sampleVirtualTexture(vec3 position) {
+    vec2 uv = clamp((position.xz - virtualTexture.area.xy) * virtualTexture.area.zw, 0.0, 1.0);
+    vec2 texels = uv * float(virtualTexture.pagesPerSide) * VIRTUAL_PAGE_SIZE;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float lod = clamp(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)), 0.0, float(virtualTexture.mipCount - 1u));
+    uint mip = uint(lod);
+
+    uvec2 blockPixel = uvec2(gl_FragCoord.xy) & 7u;
+    if (blockPixel.y * 8u + blockPixel.x == virtualTexture.feedbackPixel) {
+        uint pages = virtualTexture.pagesPerSide >> mip;
+        uvec2 page = min(uvec2(uv * float(pages)), uvec2(pages - 1u));
+        uint offset = 0u;
+        for (uint i = 0u; i < mip; i++) {
+            offset += (virtualTexture.pagesPerSide >> i) * (virtualTexture.pagesPerSide >> i);
+        }
+        virtualTexture.requestedPages[offset + page.y * pages + page.x] = 1u;
+    }
+
+    uint nextMip = min(mip + 1u, virtualTexture.mipCount - 1u);
+    return mix(sampleVirtualMip(uv, mip), sampleVirtualMip(uv, nextMip), fract(lod));
+}
+
+void main() {
+    writeTextureFeedback(fragTex);
+
+    vec4 baseColour;
+    if ((material.textureFlags & MATERIAL_VIRTUAL_TEXTURE) != 0u) {
+        baseColour = sampleVirtualTexture(fragPos) * material.baseColourFactor;
+    } else {
+        baseColour = texture(baseColourTexture, fragTex) * material.baseColourFactor;
+    }
+    vec2 metalRoughness = texture(metalRoughnessTexture, fragTex).bg;
+
+    Surface surface;
+    surface.albedo = baseColour.rgb;
+    surface.metallic = clamp(material.metallic * metalRoughness.x, 0.0, 1.0);
+    surface.roughness = clamp(material.roughness * metalRoughness.y, 0.045, 1.0);    // A perfect mirror turns a point light into a single pixel
+    surface.normal = normalize(fragNorm);
+    if ((material.textureFlags & MATERIAL_HAS_NORMAL_TEXTURE) != 0u) {
+        surface.normal = perturbNormal(surface.normal, fragPos, fragTex);
+    }
+
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    // Environment lighting, darkened in creases and contacts by the ambient occlusion
+    vec3 lighting = shadeEnvironment(surface, viewDir) * sampleAmbientOcclusion(gl_FragCoord.xy, gl_FragCoord.z);
+
+    lighting += shadeSpotlight(surface, fragPos, viewDir);
+
+    // Every point light, the deferred path only shades the ones of the pixel's tile
+    for (uint i = 0; i < pointLights.count; i++) {
+        lighting += shadePointLight(pointLights.lights[i], surface, fragPos, viewDir);
+    }
 
+    lighting += texture(emissiveTexture, fragTex).rgb * material.emissiveFactor.rgb;
 
-    // Combined lighting
-    float intensity = spotlightIntensity * attenuation;
-    vec4 texColor = texture(textureSampler, fragTex);
-    vec3 lighting = ambient + intensity * (diffuse + specular);
-    vec3 finalColor = texColor.rgb * lighting;
+    outColour = vec4(lighting, baseColour.a);
 
-    outColour = vec4(finalColor, texColor.a);
+    // Motion in UV units: the TAA pass finds last frame's pixel at uv - velocity
+    vec2 currentUv = currentClipPos.xy / currentClipPos.w * 0.5;
+    vec2 previousUv = previousClipPos.xy / previousClipPos.w * 0.5;
+    outVelocity = vec4(currentUv - previousUv, 0.0, 1.0);
 }
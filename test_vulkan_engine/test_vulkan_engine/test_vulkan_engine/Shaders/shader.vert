@@ -6,12 +6,15 @@ layout(location = 2) in vec2 tex;       // Textúra koordináták
 layout(location = 3) in vec3 norm;      // Normálvektorok
 
 layout(set = 0, binding = 0) uniform UboViewProjection {
-    mat4 projection;
+    mat4 projection;                // Jittered for TAA
     mat4 view;
+    mat4 viewProjection;            // Without jitter, for the motion vectors
+    mat4 previousViewProjection;    // Same, of the previous frame
 } uboViewProjection;
 
 layout(push_constant) uniform PushModel {
     mat4 model;
+    mat4 previousModel;             // Model matrix of the previous frame
 } pushModel;
 
 layout(location = 0) out vec3 fragCol;   // Szín továbbítása
@@ -19,6 +22,11 @@ layout(location = 1) out vec2 fragTex;   // Textúra koordináták továbbítás
 layout(location = 2) out vec3 fragNorm;  // Normál továbbítása világ térben
 layout(location = 3) out vec3 fragPos;   // Fragment világ térbeli pozíciója
 layout(location = 4) out vec3 viewPos;   // Kamera pozíciója világ térben
+layout(location = 5) out vec4 currentClipPos;    // Clip space position without jitter, this frame
+layout(location = 6) out vec4 previousClipPos;   // Same, previous frame
+
+// The depth prepass uses this shader too, the main pass tests its depth for equality
+invariant gl_Position;
 
 void main() {
     mat4 modelMatrix = pushModel.model;
@@ -33,6 +41,10 @@ void main() {
 
     // Kamera pozíció helyes kiszámítása
     viewPos = vec3(inverse(uboViewProjection.view) * vec4(0, 0, 0, 1));
+
+    // Screen space motion of the vertex, interpolated for the velocity buffer
+    currentClipPos = uboViewProjection.viewProjection * modelMatrix * vec4(pos, 1.0);
+    previousClipPos = uboViewProjection.previousViewProjection * pushModel.previousModel * vec4(pos, 1.0);
 }
 
 
@@ -0,0 +1,88 @@
+#version 450
+
+// Temporal antialiasing and upsampling: the scene, rendered at a lower (dynamic) resolution with
+// a different sub-pixel jitter every frame, is accumulated into a history at the output resolution
+
+layout(location = 0) in vec2 fragUv;
+
+layout(set = 0, binding = 0) uniform sampler2D sceneColour;      // Rendered area in the top left corner
+layout(set = 0, binding = 1) uniform sampler2D velocityTexture;  // Same size as the scene colour
+layout(set = 0, binding = 2) uniform sampler2D historyTexture;   // Output resolution
+
+layout(push_constant) uniform PushTaa {
+    vec2 renderScale;       // Rendered area / scene target size
+    vec2 jitter;            // Jitter of this frame, in UV of the rendered area
+    vec2 sceneTexelSize;    // 1 / scene target size
+    float blendFactor;      // Weight of the current frame
+    float historyValid;     // 0 when there is no usable history (first frame, resize)
+} taa;
+
+layout(location = 0) out vec4 outColour;    // HDR colour, tonemapped by the post processing
+layout(location = 1) out vec4 outHistory;   // History of the next frame
+
+vec3 rgbToYCoCg(vec3 c) {
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 yCoCgToRgb(vec3 c) {
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// Pulls the history towards the centre of the box until it is inside, keeps its hue better than a clamp
+vec3 clipToBox(vec3 boxMin, vec3 boxMax, vec3 history) {
+    vec3 centre = 0.5 * (boxMax + boxMin);
+    vec3 extents = 0.5 * (boxMax - boxMin) + 0.0001;
+    vec3 offset = history - centre;
+    vec3 units = abs(offset / extents);
+    float largest = max(units.x, max(units.y, units.z));
+    return largest > 1.0 ? centre + offset / largest : history;
+}
+
+void main() {
+    // Position in the rendered area without this frame's jitter, kept inside the rendered texels
+    vec2 minUv = 0.5 * taa.sceneTexelSize;
+    vec2 maxUv = taa.renderScale - 0.5 * taa.sceneTexelSize;
+    vec2 sceneUv = clamp((fragUv + taa.jitter) * taa.renderScale, minUv, maxUv);
+    vec3 current = rgbToYCoCg(texture(sceneColour, sceneUv).rgb);
+
+    // Colour distribution of the neighbourhood bounds the history (variance clipping), and the
+    // longest motion around is used so the edges of moving objects reproject with the object
+    vec3 moment1 = vec3(0.0);
+    vec3 moment2 = vec3(0.0);
+    vec2 velocity = vec2(0.0);
+    float longest = -1.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec2 uv = clamp(sceneUv + vec2(x, y) * taa.sceneTexelSize, minUv, maxUv);
+            vec3 colour = rgbToYCoCg(texture(sceneColour, uv).rgb);
+            moment1 += colour;
+            moment2 += colour * colour;
+
+            vec2 motion = texture(velocityTexture, uv).xy;
+            float length2 = dot(motion, motion);
+            if (length2 > longest) {
+                longest = length2;
+                velocity = motion;
+            }
+        }
+    }
+    vec3 mean = moment1 / 9.0;
+    vec3 sigma = sqrt(max(moment2 / 9.0 - mean * mean, vec3(0.0)));
+    vec3 boxMin = mean - 1.25 * sigma;
+    vec3 boxMax = mean + 1.25 * sigma;
+
+    vec3 result = current;
+    vec2 historyUv = fragUv - velocity;
+    if (taa.historyValid > 0.5 && all(greaterThanEqual(historyUv, vec2(0.0))) && all(lessThanEqual(historyUv, vec2(1.0)))) {
+        vec3 history = clipToBox(boxMin, boxMax, rgbToYCoCg(texture(historyTexture, historyUv).rgb));
+
+        // Weighted by inverse luminance, a single bright sample doesn't flicker through the history
+        float currentWeight = taa.blendFactor / (1.0 + current.x);
+        float historyWeight = (1.0 - taa.blendFactor) / (1.0 + history.x);
+        result = (current * currentWeight + history * historyWeight) / (currentWeight + historyWeight);
+    }
+
+    vec3 rgb = max(yCoCgToRgb(result), vec3(0.0));
+    outColour = vec4(rgb, 1.0);
+    outHistory = vec4(rgb, 1.0);
+}
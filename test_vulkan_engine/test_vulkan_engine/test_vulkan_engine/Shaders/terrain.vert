@@ -0,0 +1,97 @@
+#version 450
+
+// Terrain: every instance is a patch of the quadtree, every vertex a point of the same grid. The grid is
+// stretched over the patch, displaced by the heightmap, and morphed onto the grid of the next coarser LOD
+// near the end of the patch's range, so patches of neighbouring LODs meet without cracks.
+// The outputs are shader.vert's, the scene's fragment shaders are used as they are
+
+const uint PATCH_RESOLUTION = 32;       // TERRAIN_PATCH_RESOLUTION
+const uint MAX_LODS = 12;               // MAX_TERRAIN_LODS
+
+layout(set = 0, binding = 0) uniform UboViewProjection {
+    mat4 projection;                // Jittered for TAA
+    mat4 view;
+    mat4 viewProjection;            // Without jitter, for the motion vectors
+    mat4 previousViewProjection;    // Same, of the previous frame
+} uboViewProjection;
+
+layout(set = 4, binding = 0) uniform sampler2D heightmap;      // World Y per texel, fetched
+layout(set = 4, binding = 1) uniform TerrainParams {
+    vec4 area;                      // World XZ of the first texel, 1 / size, size
+    vec4 cameraPosition;
+    vec4 morphRanges[MAX_LODS];     // Per LOD: distance the morph starts at, 1 / distance it takes
+} terrain;
+
+struct TerrainPatch {
+    vec2 origin;                    // World XZ of the patch's corner
+    float size;
+    uint lod;
+};
+
+layout(set = 4, binding = 2) readonly buffer Patches {
+    TerrainPatch patches[];
+};
+
+layout(location = 0) out vec3 fragCol;
+layout(location = 1) out vec2 fragTex;
+layout(location = 2) out vec3 fragNorm;
+layout(location = 3) out vec3 fragPos;
+layout(location = 4) out vec3 viewPos;
+layout(location = 5) out vec4 currentClipPos;
+layout(location = 6) out vec4 previousClipPos;
+
+// The depth prepass uses this shader too, the main pass tests its depth for equality
+invariant gl_Position;
+
+// Bilinear between the four texels around a world position, as Terrain::getHeight does
+float sampleHeight(vec2 worldXZ) {
+    ivec2 size = textureSize(heightmap, 0);
+    vec2 uv = clamp((worldXZ - terrain.area.xy) * terrain.area.z, 0.0, 1.0);
+    vec2 texel = uv * vec2(size - 1);
+    ivec2 corner = min(ivec2(texel), size - 2);
+    vec2 f = texel - vec2(corner);
+
+    float h00 = texelFetch(heightmap, corner, 0).r;
+    float h10 = texelFetch(heightmap, corner + ivec2(1, 0), 0).r;
+    float h01 = texelFetch(heightmap, corner + ivec2(0, 1), 0).r;
+    float h11 = texelFetch(heightmap, corner + ivec2(1, 1), 0).r;
+    return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+}
+
+void main() {
+    TerrainPatch terrainPatch = patches[gl_InstanceIndex];
+    uint row = PATCH_RESOLUTION + 1;
+    vec2 grid = vec2(gl_VertexIndex % row, gl_VertexIndex / row);
+    float quadSize = terrainPatch.size / float(PATCH_RESOLUTION);
+
+    // -- MORPH --
+    // Odd vertices slide onto their even neighbours, the patch then is the coarser LOD's grid
+    vec2 worldXZ = terrainPatch.origin + grid * quadSize;
+    vec3 unmorphed = vec3(worldXZ.x, sampleHeight(worldXZ), worldXZ.y);
+    vec4 morphRange = terrain.morphRanges[terrainPatch.lod];
+    float morph = clamp((distance(unmorphed, terrain.cameraPosition.xyz) - morphRange.x) * morphRange.y, 0.0, 1.0);
+
+    grid -= fract(grid * 0.5) * 2.0 * morph;
+    worldXZ = terrainPatch.origin + grid * quadSize;
+    vec3 worldPos = vec3(worldXZ.x, sampleHeight(worldXZ), worldXZ.y);
+
+    // -- NORMAL --
+    // Central differences a texel apart
+    float texelSize = terrain.area.w / float(textureSize(heightmap, 0).x - 1);
+    float hL = sampleHeight(worldXZ - vec2(texelSize, 0.0));
+    float hR = sampleHeight(worldXZ + vec2(texelSize, 0.0));
+    float hD = sampleHeight(worldXZ - vec2(0.0, texelSize));
+    float hU = sampleHeight(worldXZ + vec2(0.0, texelSize));
+
+    gl_Position = uboViewProjection.projection * uboViewProjection.view * vec4(worldPos, 1.0);
+
+    fragCol = vec3(1.0);
+    fragTex = (worldXZ - terrain.area.xy) * terrain.area.z;
+    fragNorm = normalize(vec3(hL - hR, 2.0 * texelSize, hD - hU));
+    fragPos = worldPos;
+    viewPos = terrain.cameraPosition.xyz;
+
+    // The terrain never moves, only the camera's motion is in the velocity
+    currentClipPos = uboViewProjection.viewProjection * vec4(worldPos, 1.0);
+    previousClipPos = uboViewProjection.previousViewProjection * vec4(worldPos, 1.0);
+}
@@ -0,0 +1,43 @@
+#version 450
+
+// Last pass of the post processing: exposes the HDR scene with the adapted luminance, adds the
+// bloom, tonemaps it to the display range and encodes it for the backbuffer
+
+layout(location = 0) in vec2 fragUv;
+
+layout(set = 0, binding = 0) uniform sampler2D hdrColour;
+layout(set = 0, binding = 1) uniform sampler2D bloomTexture;                      // Half resolution
+layout(set = 0, binding = 2, r32f) uniform readonly image2D adaptedLuminance;    // 1x1
+
+layout(push_constant) uniform PushTonemap {
+    float bloomStrength;
+    float exposureKey;      // Luminance the average of the scene is mapped to (middle grey)
+    uint encodeSrgb;        // 1 if the backbuffer is UNORM, the sRGB curve is applied here
+} tonemap;
+
+layout(location = 0) out vec4 outColour;
+
+// ACES filmic curve fitted by Krzysztof Narkowicz
+vec3 acesFilm(vec3 x) {
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 linearToSrgb(vec3 colour) {
+    vec3 low = colour * 12.92;
+    vec3 high = 1.055 * pow(colour, vec3(1.0 / 2.4)) - 0.055;
+    return mix(high, low, vec3(lessThanEqual(colour, vec3(0.0031308))));
+}
+
+void main() {
+    vec3 colour = texture(hdrColour, fragUv).rgb + texture(bloomTexture, fragUv).rgb * tonemap.bloomStrength;
+
+    float averageLuminance = imageLoad(adaptedLuminance, ivec2(0)).r;
+    colour *= tonemap.exposureKey / max(averageLuminance, 0.0001);
+
+    colour = acesFilm(colour);
+    if (tonemap.encodeSrgb != 0u) {
+        colour = linearToSrgb(colour);
+    }
+
+    outColour = vec4(colour, 1.0);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Joints a vertex can follow, the weakest ones beyond it are dropped on import
+const uint32_t MAX_JOINT_INFLUENCES = 4;
+
+// Keyframes per second the clips are resampled to
+const float ANIMATION_SAMPLE_RATE = 30.0f;
+
+/**
+ * @struct SkinInfluence
+ * @brief The skin bones moving a vertex and their weights, 12 bytes per vertex next to the vertex buffer.
+ */
+struct SkinInfluence
+{
+	uint32_t bones[2];		///< Four 16 bit indices into the model's skin bones, the first of each pair in the low half.
+	uint32_t weights;		///< Four unorm8 weights in the same order, summing to 255 (0 for a vertex no bone moves).
+};
+
+/**
+ * @struct SkinBone
+ * @brief A joint as a mesh sees it: the joint matrix of the bone is jointToMesh * global(joint) * offset.
+ */
+struct SkinBone
+{
+	uint32_t joint;			///< Joint of the skeleton the bone follows.
+	uint32_t meshJoint;		///< Joint of the node the mesh hangs from, its space is the mesh's model space.
+	glm::mat4 offset;		///< Inverse bind matrix: mesh space to the joint's space in the bind pose.
+};
+
+/**
+ * @struct Skeleton
+ * @brief Node hierarchy of a model, flattened so every parent comes before its children.
+ *
+ * The local transforms are kept as translation, rotation and scale, the same form the clips are
+ * stored in, so joints without an animation track simply keep their bind values.
+ */
+struct Skeleton
+{
+	std::vector<std::string> names;
+	std::vector<int32_t> parents;				///< -1 for the root.
+	std::vector<glm::vec4> bindTranslations;	///< Local, w unused.
+	std::vector<glm::quat> bindRotations;
+	std::vector<glm::vec4> bindScales;			///< Local, w unused.
+
+	uint32_t getJointCount() const
+	{
+		return static_cast<uint32_t>(parents.size());
+	}
+
+	// Index of the joint with the given node name, -1 if there is none
+	int32_t findJoint(const std::string& name) const
+	{
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			if (names[i] == name)
+			{
+				return static_cast<int32_t>(i);
+			}
+		}
+		return -1;
+	}
+};
+
+/**
+ * @struct AnimationClip
+ * @brief Keyframes of every joint, resampled at a fixed rate.
+ *
+ * Stored frame major as separate translation, rotation and scale arrays, so sampling reads two
+ * contiguous runs of the joints and blends them lane by lane, without searching for keys.
+ */
+struct AnimationClip
+{
+	std::string name;
+	float duration = 0.0f;						///< Seconds.
+	float sampleRate = ANIMATION_SAMPLE_RATE;
+	uint32_t frameCount = 0;					///< The last frame is the pose at the duration.
+	uint32_t jointCount = 0;
+	std::vector<glm::vec4> translations;		///< frameCount * jointCount, w unused.
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec4> scales;
+};
@@ -0,0 +1,552 @@
+#include "Terrain.h"
+
+#include "Utilities.h"
+#include "CpuProfiler.h"
+#include "FrameContext.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const VkFormat HEIGHT_FORMAT = VK_FORMAT_R32_SFLOAT;		// Filtered in the shader, linear filtering of R32F isn't guaranteed
+
+	VkWriteDescriptorSet bufferWrite(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo* info)
+	{
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.descriptorType = type;
+		write.descriptorCount = 1;
+		write.pBufferInfo = info;
+		return write;
+	}
+}
+
+Terrain::Terrain()
+{
+}
+
+void Terrain::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, const std::array<VkDescriptorSetLayout, 4>& sceneSetLayouts,
+	const VkPushConstantRange& pushConstantRange)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	// -- SAMPLER --
+	// The heights are fetched texel by texel, the vertex shader interpolates them itself
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+
+	VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &heightSampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Terrain Sampler!");
+	}
+
+	// -- SET LAYOUT --
+	// The heights, the parameters and the patches of the frame, all read in the vertex shader
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// -- PIPELINE LAYOUT --
+	// The scene's sets and push constants, so the fragment shaders are shared, then the terrain's set
+	std::array<VkDescriptorSetLayout, 5> setLayouts = { sceneSetLayouts[0], sceneSetLayouts[1], sceneSetLayouts[2], sceneSetLayouts[3], setLayout };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+}
+
+void Terrain::appendPipelineDescs(std::vector<GraphicsPipelineDesc>& descs, std::vector<VkPipeline*>& handles,
+	const GraphicsPipelineDesc& prepassDesc, const GraphicsPipelineDesc& sceneDesc)
+{
+	// The vertices come from the heightmap, the grid is seen from both sides (cliffs, the camera below the surface)
+	GraphicsPipelineDesc terrainPrepassDesc = prepassDesc;
+	terrainPrepassDesc.name = "Terrain depth prepass";
+	terrainPrepassDesc.vertexShader = "Shaders/terrainVert.spv";
+	terrainPrepassDesc.layout = pipelineLayout;
+	terrainPrepassDesc.cullMode = VK_CULL_MODE_NONE;
+	terrainPrepassDesc.vertexInput = false;
+
+	GraphicsPipelineDesc terrainSceneDesc = sceneDesc;
+	terrainSceneDesc.name = "Terrain";
+	terrainSceneDesc.vertexShader = "Shaders/terrainVert.spv";
+	terrainSceneDesc.layout = pipelineLayout;
+	terrainSceneDesc.cullMode = VK_CULL_MODE_NONE;
+	terrainSceneDesc.vertexInput = false;
+
+	descs.push_back(terrainPrepassDesc);
+	descs.push_back(terrainSceneDesc);
+	handles.push_back(&prepassPipeline);
+	handles.push_back(&scenePipeline);
+}
+
+void Terrain::load(const std::string& heightmapFile, const TerrainSettings& newSettings, VkQueue queue, VkCommandPool commandPool)
+{
+	PROFILE_FUNCTION();
+
+	settings = newSettings;
+
+	// 8 bit images are widened to 16 bits, a single channel
+	int imageWidth, imageHeight, channels;
+	std::string fileLoc = "Textures/" + heightmapFile;
+	stbi_us* image = stbi_load_16(fileLoc.c_str(), &imageWidth, &imageHeight, &channels, STBI_grey);
+	if (!image)
+	{
+		throw std::runtime_error("Failed to load a Terrain heightmap! (" + heightmapFile + ")");
+	}
+	if (imageWidth < 2 || imageHeight < 2)
+	{
+		stbi_image_free(image);
+		throw std::runtime_error("Failed to load a Terrain heightmap, it needs 2x2 texels at least! (" + heightmapFile + ")");
+	}
+
+	width = static_cast<uint32_t>(imageWidth);
+	height = static_cast<uint32_t>(imageHeight);
+	heights.resize(size_t(width) * height);
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		heights[i] = settings.origin.y + image[i] / 65535.0f * settings.heightScale;
+	}
+	stbi_image_free(image);
+
+	buildQuadtree();
+	createHeightImage(queue, commandPool);
+	createIndexBuffer(queue, commandPool);
+	loaded = true;
+
+	printf("Terrain: %s, %ux%u heights, %u LODs, %.0f x %.0f world units\n", heightmapFile.c_str(), width, height, lodCount,
+		settings.size, settings.size);
+}
+
+void Terrain::buildQuadtree()
+{
+	// Leaves about as large as TERRAIN_PATCH_RESOLUTION texels, so a leaf patch's quad is a texel
+	uint32_t texels = std::max(width, height) - 1;
+	lodCount = 1;
+	while (lodCount < MAX_TERRAIN_LODS && (TERRAIN_PATCH_RESOLUTION << lodCount) <= texels)
+	{
+		lodCount++;
+	}
+
+	// -- LEAVES --
+	// The lowest and highest texel under the leaf, the edges included (neighbouring leaves share them)
+	uint32_t leaves = 1u << (lodCount - 1);
+	nodeHeights.assign(lodCount, std::vector<glm::vec2>());
+	nodeHeights[0].resize(size_t(leaves) * leaves);
+	for (uint32_t z = 0; z < leaves; z++)
+	{
+		uint32_t z0 = static_cast<uint32_t>(std::floor(float(z) / leaves * (height - 1)));
+		uint32_t z1 = static_cast<uint32_t>(std::ceil(float(z + 1) / leaves * (height - 1)));
+		for (uint32_t x = 0; x < leaves; x++)
+		{
+			uint32_t x0 = static_cast<uint32_t>(std::floor(float(x) / leaves * (width - 1)));
+			uint32_t x1 = static_cast<uint32_t>(std::ceil(float(x + 1) / leaves * (width - 1)));
+
+			glm::vec2 range(FLT_MAX, -FLT_MAX);
+			for (uint32_t texelZ = z0; texelZ <= std::min(z1, height - 1); texelZ++)
+			{
+				for (uint32_t texelX = x0; texelX <= std::min(x1, width - 1); texelX++)
+				{
+					float texelHeight = heights[size_t(texelZ) * width + texelX];
+					range.x = std::min(range.x, texelHeight);
+					range.y = std::max(range.y, texelHeight);
+				}
+			}
+			nodeHeights[0][size_t(z) * leaves + x] = range;
+		}
+	}
+
+	// -- INNER NODES --
+	for (uint32_t lod = 1; lod < lodCount; lod++)
+	{
+		uint32_t nodes = leaves >> lod;
+		uint32_t childNodes = nodes * 2;
+		nodeHeights[lod].resize(size_t(nodes) * nodes);
+		for (uint32_t z = 0; z < nodes; z++)
+		{
+			for (uint32_t x = 0; x < nodes; x++)
+			{
+				glm::vec2 range(FLT_MAX, -FLT_MAX);
+				for (uint32_t child = 0; child < 4; child++)
+				{
+					glm::vec2 childRange = nodeHeights[lod - 1][size_t(z * 2 + child / 2) * childNodes + x * 2 + child % 2];
+					range.x = std::min(range.x, childRange.x);
+					range.y = std::max(range.y, childRange.y);
+				}
+				nodeHeights[lod][size_t(z) * nodes + x] = range;
+			}
+		}
+	}
+
+	// -- RANGES --
+	// A LOD's patches are drawn up to its range, the next coarser LOD takes over beyond. The range
+	// grows with the patch size, a patch must fit between the morph start and the range's end
+	float leafSize = settings.size / leaves;
+	for (uint32_t lod = 0; lod < MAX_TERRAIN_LODS; lod++)
+	{
+		lodRanges[lod] = leafSize * TERRAIN_LOD_RANGE_FACTOR * static_cast<float>(1u << lod);
+	}
+}
+
+void Terrain::createHeightImage(VkQueue queue, VkCommandPool commandPool)
+{
+	// -- STAGING --
+	VkDeviceSize imageSize = heights.size() * sizeof(float);
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+	memcpy(data, heights.data(), static_cast<size_t>(imageSize));
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	// -- IMAGE --
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { width, height, 1 };
+	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = HEIGHT_FORMAT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &heightImage);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the Terrain height Image!");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, heightImage, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, &heightMemory);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate memory for the Terrain height Image!");
+	}
+	vkBindImageMemory(device, heightImage, heightMemory, 0);
+
+	transitionImageLayout(device, queue, commandPool, heightImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	copyImageBuffer(device, queue, commandPool, stagingBuffer, heightImage, width, height);
+	transitionImageLayout(device, queue, commandPool, heightImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = heightImage;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = HEIGHT_FORMAT;
+	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = 0;
+	viewCreateInfo.subresourceRange.levelCount = 1;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(device, &viewCreateInfo, nullptr, &heightView);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the Terrain height Image View!");
+	}
+}
+
+void Terrain::createIndexBuffer(VkQueue queue, VkCommandPool commandPool)
+{
+	// Two triangles per quad, the indices are the grid vertex numbers terrain.vert turns into positions.
+	// The diagonals alternate so the morphed triangles fold evenly
+	const uint32_t rowVertices = TERRAIN_PATCH_RESOLUTION + 1;
+	std::vector<uint32_t> indices;
+	indices.reserve(TERRAIN_PATCH_RESOLUTION * TERRAIN_PATCH_RESOLUTION * 6);
+	for (uint32_t z = 0; z < TERRAIN_PATCH_RESOLUTION; z++)
+	{
+		for (uint32_t x = 0; x < TERRAIN_PATCH_RESOLUTION; x++)
+		{
+			uint32_t corner = z * rowVertices + x;
+			uint32_t quad[4] = { corner, corner + 1, corner + rowVertices, corner + rowVertices + 1 };
+			if ((x + z) % 2 == 0)
+			{
+				uint32_t triangles[6] = { quad[0], quad[2], quad[3], quad[0], quad[3], quad[1] };
+				indices.insert(indices.end(), triangles, triangles + 6);
+			}
+			else
+			{
+				uint32_t triangles[6] = { quad[0], quad[2], quad[1], quad[1], quad[2], quad[3] };
+				indices.insert(indices.end(), triangles, triangles + 6);
+			}
+		}
+	}
+	indexCount = static_cast<uint32_t>(indices.size());
+
+	// Same upload as the meshes' index buffers
+	VkDeviceSize bufferSize = sizeof(uint32_t) * indices.size();
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+	memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	createBuffer(physicalDevice, device, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBuffer, &indexMemory);
+	copyBuffer(device, queue, commandPool, stagingBuffer, indexBuffer, bufferSize);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
+void Terrain::prepareFrame(FrameContext& frame, const glm::mat4& viewProjection, glm::vec3 cameraPosition)
+{
+	PROFILE_FUNCTION();
+
+	patches.clear();
+	frameSet = VK_NULL_HANDLE;
+	if (!loaded)
+	{
+		return;
+	}
+
+	// -- SELECTION --
+	selectNode(lodCount - 1, 0, 0, extractFrustum(viewProjection), false, cameraPosition);
+	if (patches.empty())
+	{
+		return;
+	}
+
+	// -- PARAMETERS --
+	// A LOD's vertices morph over the last part of its range, they reach the coarser grid at its end
+	TerrainParams params = {};
+	params.area = glm::vec4(settings.origin.x, settings.origin.z, 1.0f / settings.size, settings.size);
+	params.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+	for (uint32_t lod = 0; lod < MAX_TERRAIN_LODS; lod++)
+	{
+		float morphStart = lodRanges[lod] * TERRAIN_MORPH_START;
+		params.morphRanges[lod] = glm::vec4(morphStart, 1.0f / (lodRanges[lod] - morphStart), 0.0f, 0.0f);
+	}
+
+	// -- SET --
+	VkDescriptorBufferInfo paramsInfo = frame.uniforms.push(&params, sizeof(params));
+	VkDescriptorBufferInfo patchesInfo = frame.uniforms.push(patches.data(), sizeof(TerrainPatch) * patches.size());
+
+	VkDescriptorImageInfo heightInfo = {};
+	heightInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	heightInfo.imageView = heightView;
+	heightInfo.sampler = heightSampler;
+
+	frameSet = frame.allocateDescriptorSet(setLayout);
+
+	VkWriteDescriptorSet heightWrite = {};
+	heightWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	heightWrite.dstSet = frameSet;
+	heightWrite.dstBinding = 0;
+	heightWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	heightWrite.descriptorCount = 1;
+	heightWrite.pImageInfo = &heightInfo;
+
+	std::array<VkWriteDescriptorSet, 3> writes = {
+		heightWrite,
+		bufferWrite(frameSet, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &paramsInfo),
+		bufferWrite(frameSet, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &patchesInfo)
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void Terrain::selectNode(uint32_t lod, uint32_t x, uint32_t z, const Frustum& frustum, bool inside, glm::vec3 cameraPosition)
+{
+	AABB bounds = getNodeBounds(lod, x, z);
+
+	// The children of a node fully inside the frustum are inside too
+	if (!inside)
+	{
+		FrustumTestResult test = testFrustumAABB(frustum, bounds);
+		if (test == FRUSTUM_OUTSIDE)
+		{
+			return;
+		}
+		inside = test == FRUSTUM_INSIDE;
+	}
+
+	// Drawn as it is unless part of it is in the range of the finer LOD
+	bool split = lod > 0 && distanceSquaredPointAABB(cameraPosition, bounds) < lodRanges[lod - 1] * lodRanges[lod - 1];
+	if (!split)
+	{
+		if (patches.size() < MAX_TERRAIN_PATCHES)
+		{
+			patches.push_back({ glm::vec2(bounds.min.x, bounds.min.z), bounds.max.x - bounds.min.x, lod });
+		}
+		return;
+	}
+
+	for (uint32_t child = 0; child < 4; child++)
+	{
+		selectNode(lod - 1, x * 2 + child % 2, z * 2 + child / 2, frustum, inside, cameraPosition);
+	}
+}
+
+AABB Terrain::getNodeBounds(uint32_t lod, uint32_t x, uint32_t z) const
+{
+	uint32_t nodes = 1u << (lodCount - 1 - lod);
+	float nodeSize = settings.size / nodes;
+	glm::vec2 range = nodeHeights[lod][size_t(z) * nodes + x];
+
+	AABB bounds;
+	bounds.min = glm::vec3(settings.origin.x + x * nodeSize, range.x, settings.origin.z + z * nodeSize);
+	bounds.max = glm::vec3(bounds.min.x + nodeSize, range.y, bounds.min.z + nodeSize);
+	return bounds;
+}
+
+void Terrain::record(VkCommandBuffer commandBuffer, bool depthOnly, const std::array<VkDescriptorSet, 4>& sceneSets) const
+{
+	if (frameSet == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	std::array<VkDescriptorSet, 5> sets = { sceneSets[0], sceneSets[1], sceneSets[2], sceneSets[3], frameSet };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly ? prepassPipeline : scenePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+		0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+
+	// A single instanced draw, the instance is the patch
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdDrawIndexed(commandBuffer, indexCount, static_cast<uint32_t>(patches.size()), 0, 0, 0);
+}
+
+bool Terrain::getHeight(float x, float z, float* outHeight) const
+{
+	if (!loaded)
+	{
+		return false;
+	}
+
+	glm::vec2 uv = (glm::vec2(x, z) - glm::vec2(settings.origin.x, settings.origin.z)) / settings.size;
+	if (uv.x < 0.0f || uv.y < 0.0f || uv.x > 1.0f || uv.y > 1.0f)
+	{
+		return false;
+	}
+
+	// Bilinear between the four texels around the point, as terrain.vert samples them
+	glm::vec2 texel = uv * glm::vec2(width - 1, height - 1);
+	uint32_t x0 = std::min(static_cast<uint32_t>(texel.x), width - 2);
+	uint32_t z0 = std::min(static_cast<uint32_t>(texel.y), height - 2);
+	glm::vec2 f = texel - glm::vec2(x0, z0);
+
+	const float* row0 = heights.data() + size_t(z0) * width + x0;
+	const float* row1 = row0 + width;
+	float top = row0[0] + (row0[1] - row0[0]) * f.x;
+	float bottom = row1[0] + (row1[1] - row1[0]) * f.x;
+	*outHeight = top + (bottom - top) * f.y;
+	return true;
+}
+
+bool Terrain::isLoaded() const
+{
+	return loaded;
+}
+
+AABB Terrain::getBounds() const
+{
+	if (!loaded)
+	{
+		return AABB();
+	}
+
+	AABB bounds = getNodeBounds(lodCount - 1, 0, 0);
+	return bounds;
+}
+
+uint32_t Terrain::getPatchCount() const
+{
+	return static_cast<uint32_t>(patches.size());
+}
+
+void Terrain::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyBuffer(device, indexBuffer, nullptr);
+	vkFreeMemory(device, indexMemory, nullptr);
+	vkDestroyImageView(device, heightView, nullptr);
+	vkDestroyImage(device, heightImage, nullptr);
+	vkFreeMemory(device, heightMemory, nullptr);
+
+	vkDestroyPipeline(device, prepassPipeline, nullptr);
+	vkDestroyPipeline(device, scenePipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroySampler(device, heightSampler, nullptr);
+
+	heights.clear();
+	nodeHeights.clear();
+	patches.clear();
+	loaded = false;
+	device = VK_NULL_HANDLE;
+}
+
+Terrain::~Terrain()
+{
+}
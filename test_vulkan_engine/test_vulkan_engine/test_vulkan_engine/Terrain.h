@@ -0,0 +1,186 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Bounds.h"
+#include "PipelineManager.h"
+
+class FrameContext;
+
+const uint32_t TERRAIN_PATCH_RESOLUTION = 32;	// Quads on a side of a patch, every patch has the same vertices whatever its size
+const uint32_t MAX_TERRAIN_LODS = 12;			// Levels of the quadtree, the finest first
+const uint32_t MAX_TERRAIN_PATCHES = 2048;		// Patches drawn a frame at most
+const float TERRAIN_LOD_RANGE_FACTOR = 6.0f;	// Range of the finest LOD in leaf patch sizes, every LOD doubles it
+const float TERRAIN_MORPH_START = 0.8f;			// Share of a LOD's range where its vertices start morphing towards the coarser grid
+
+/**
+ * @struct TerrainSettings
+ * @brief Where the heightmap is stretched in the world.
+ */
+struct TerrainSettings
+{
+	float size = 2048.0f;						///< Extent of the terrain along X and Z.
+	float heightScale = 200.0f;					///< Height of the heightmap's white.
+	glm::vec3 origin = glm::vec3(-1024.0f, -20.0f, -1024.0f);	///< Corner of the first texel, at the heightmap's black.
+};
+
+/**
+ * @class Terrain
+ * @brief Heightmap terrain drawn as a CDLOD quadtree of equal patches displaced in the vertex shader.
+ *
+ * The heightmap covers a square of the XZ plane. Its quadtree's leaves are as large as
+ * TERRAIN_PATCH_RESOLUTION texels, every node keeps the lowest and highest height under it.
+ * Each frame the tree is walked from the root: nodes outside the frustum are skipped, a node
+ * reaching into the range of the next finer LOD is split, any other node is drawn as a patch.
+ * The ranges double with every LOD, so the patches drawn depend on the view distance and not
+ * on the size of the terrain.
+ *
+ * Every patch is the same grid of vertices, generated from the index buffer and the instance
+ * in the vertex shader, which reads the heights from an R32F image. Near the end of its
+ * LOD's range a vertex morphs onto the grid of the next coarser LOD, so neighbouring patches of
+ * different LODs meet without cracks and the LODs change without popping. The terrain is one
+ * instanced draw per pass, with the scene's fragment shaders and material set.
+ */
+class Terrain
+{
+public:
+	Terrain();
+
+	/**
+	 * @brief Creates the set layout of the heightmap and the patches, the sampler and the pipeline layout.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param sceneSetLayouts Sets 0 to 3 of the scene pipelines, the terrain's set is set 4.
+	 * @param pushConstantRange Push constants of the scene pipelines, kept so their sets stay compatible.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, const std::array<VkDescriptorSetLayout, 4>& sceneSetLayouts,
+		const VkPushConstantRange& pushConstantRange);
+
+	/**
+	 * @brief Appends the depth prepass and scene pipelines of the terrain and the members holding them.
+	 *
+	 * They are the scene's pipelines with the terrain's vertex shader, the pipelines stay owned by the terrain.
+	 *
+	 * @param descs Pipelines the caller creates.
+	 * @param handles Where each of them is written.
+	 * @param prepassDesc The depth prepass pipeline of the entities.
+	 * @param sceneDesc The forward or G-buffer pipeline of the entities.
+	 */
+	void appendPipelineDescs(std::vector<GraphicsPipelineDesc>& descs, std::vector<VkPipeline*>& handles,
+		const GraphicsPipelineDesc& prepassDesc, const GraphicsPipelineDesc& sceneDesc);
+
+	/**
+	 * @brief Loads the heightmap, builds the quadtree and uploads the heights and the patch grid.
+	 *
+	 * @param heightmapFile Greyscale image in the Textures folder, 16 bits per texel preferably.
+	 * @param newSettings Placement of the terrain.
+	 * @param queue Queue the uploads are submitted to.
+	 * @param commandPool Pool of their command buffers.
+	 * @throws std::runtime_error if the image can't be loaded or a Vulkan object can't be created.
+	 */
+	void load(const std::string& heightmapFile, const TerrainSettings& newSettings, VkQueue queue, VkCommandPool commandPool);
+
+	/**
+	 * @brief Selects the patches the camera sees and writes them and the terrain's set into the frame.
+	 *
+	 * @param frame The frame context being recorded.
+	 * @param viewProjection The camera's matrix, its frustum culls the patches.
+	 * @param cameraPosition The camera's position, the LODs are chosen by the distance to it.
+	 * @throws std::runtime_error if the frame's uniform ring runs out.
+	 */
+	void prepareFrame(FrameContext& frame, const glm::mat4& viewProjection, glm::vec3 cameraPosition);
+
+	/**
+	 * @brief Draws the selected patches in a pass drawing the scene.
+	 *
+	 * @param commandBuffer The pass's command buffer.
+	 * @param depthOnly True in the depth prepass.
+	 * @param sceneSets Sets 0 to 3 as the scene's draws bind them, set 1 being the terrain's material.
+	 */
+	void record(VkCommandBuffer commandBuffer, bool depthOnly, const std::array<VkDescriptorSet, 4>& sceneSets) const;
+
+	/**
+	 * @brief Height of the terrain's surface, interpolated like the vertex shader does.
+	 *
+	 * @param x World X.
+	 * @param z World Z.
+	 * @param outHeight Receives the world Y of the surface.
+	 * @return False if no terrain is loaded or the point is outside it.
+	 */
+	bool getHeight(float x, float z, float* outHeight) const;
+
+	bool isLoaded() const;
+	AABB getBounds() const;
+	uint32_t getPatchCount() const;		// Drawn this frame
+
+	void destroy();
+
+	~Terrain();
+
+private:
+	// A drawn node, laid out as TerrainPatch in terrain.vert (std430)
+	struct TerrainPatch
+	{
+		glm::vec2 origin;		// World XZ of the node's corner
+		float size;
+		uint32_t lod;
+	};
+
+	// Laid out as TerrainParams in terrain.vert (std140)
+	struct TerrainParams
+	{
+		glm::vec4 area;									// World XZ of the first texel, 1 / size, size
+		glm::vec4 cameraPosition;
+		glm::vec4 morphRanges[MAX_TERRAIN_LODS];		// Per LOD: distance the morph starts at, 1 / distance it takes
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkSampler heightSampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline prepassPipeline = VK_NULL_HANDLE;
+	VkPipeline scenePipeline = VK_NULL_HANDLE;
+
+	// -- GPU DATA --
+	VkImage heightImage = VK_NULL_HANDLE;
+	VkDeviceMemory heightMemory = VK_NULL_HANDLE;
+	VkImageView heightView = VK_NULL_HANDLE;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+	uint32_t indexCount = 0;
+
+	// -- HEIGHTS --
+	TerrainSettings settings;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<float> heights;					// World Y per texel, row by row
+	bool loaded = false;
+
+	// -- QUADTREE --
+	uint32_t lodCount = 1;
+	std::vector<std::vector<glm::vec2>> nodeHeights;	// Per LOD, per node (row by row): lowest and highest height
+	std::array<float, MAX_TERRAIN_LODS> lodRanges = {};
+
+	// -- THIS FRAME --
+	std::vector<TerrainPatch> patches;
+	VkDescriptorSet frameSet = VK_NULL_HANDLE;
+
+	void buildQuadtree();
+	void createHeightImage(VkQueue queue, VkCommandPool commandPool);
+	void createIndexBuffer(VkQueue queue, VkCommandPool commandPool);
+
+	AABB getNodeBounds(uint32_t lod, uint32_t x, uint32_t z) const;
+	void selectNode(uint32_t lod, uint32_t x, uint32_t z, const Frustum& frustum, bool inside, glm::vec3 cameraPosition);
+};
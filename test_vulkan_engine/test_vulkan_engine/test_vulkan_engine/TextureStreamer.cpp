@@ -0,0 +1,582 @@
+#include "TextureStreamer.h"
+
+#include "Utilities.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t TEXEL_SIZE = 4;								// RGBA8
+	const uint32_t FEEDBACK_NONE = 0xFFFFFFFF;					// Reset value of a slot, no pixel asked for the texture
+	const uint32_t FEEDBACK_HEADER_WORDS = 1;					// The pixel of the 8x8 blocks writing this frame
+	const VkDeviceSize FEEDBACK_BUFFER_SIZE = (FEEDBACK_HEADER_WORDS + MAX_STREAMED_TEXTURES) * sizeof(uint32_t);
+
+	// Part of the heap VK_EXT_memory_budget reports that is left to the rest of the renderer
+	const VkDeviceSize HEAP_MARGIN_DIVISOR = 10;
+
+	// sRGB texels are averaged in linear space, or the mips darken
+	struct SrgbTables
+	{
+		float toLinear[256];
+		uint8_t fromLinear[4096];		// Linear value quantised to 12 bits
+
+		SrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < 4096; i++)
+			{
+				float l = i / 4095.0f;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = static_cast<uint8_t>(std::min(255.0f, c * 255.0f + 0.5f));
+			}
+		}
+	};
+
+	const SrgbTables& getSrgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	bool isSrgbFormat(VkFormat format)
+	{
+		return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+
+	// 2x2 box filter, an odd side repeats its last texel. Alpha is always linear
+	void downsample(const unsigned char* source, uint32_t sourceWidth, uint32_t sourceHeight,
+		unsigned char* target, uint32_t targetWidth, uint32_t targetHeight, bool srgb)
+	{
+		const SrgbTables& tables = getSrgbTables();
+		for (uint32_t y = 0; y < targetHeight; y++)
+		{
+			uint32_t y0 = std::min(y * 2, sourceHeight - 1);
+			uint32_t y1 = std::min(y * 2 + 1, sourceHeight - 1);
+			for (uint32_t x = 0; x < targetWidth; x++)
+			{
+				uint32_t x0 = std::min(x * 2, sourceWidth - 1);
+				uint32_t x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				const unsigned char* texels[4] = {
+					source + (y0 * sourceWidth + x0) * TEXEL_SIZE, source + (y0 * sourceWidth + x1) * TEXEL_SIZE,
+					source + (y1 * sourceWidth + x0) * TEXEL_SIZE, source + (y1 * sourceWidth + x1) * TEXEL_SIZE
+				};
+
+				unsigned char* out = target + (y * targetWidth + x) * TEXEL_SIZE;
+				for (uint32_t c = 0; c < TEXEL_SIZE; c++)
+				{
+					if (srgb && c < 3)
+					{
+						float sum = tables.toLinear[texels[0][c]] + tables.toLinear[texels[1][c]] +
+							tables.toLinear[texels[2][c]] + tables.toLinear[texels[3][c]];
+						out[c] = tables.fromLinear[static_cast<uint32_t>(sum * 0.25f * 4095.0f + 0.5f)];
+					}
+					else
+					{
+						out[c] = static_cast<unsigned char>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+}
+
+TextureStreamer::TextureStreamer()
+{
+}
+
+void TextureStreamer::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue newTransferQueue, VkCommandPool newTransferCommandPool,
+	MaterialLibrary* newMaterials, uint32_t frameCount, bool memoryBudgetQuery, VkDeviceSize newBudget)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+	transferQueue = newTransferQueue;
+	transferCommandPool = newTransferCommandPool;
+	materials = newMaterials;
+	queryMemoryBudget = memoryBudgetQuery;
+	budget = newBudget;
+
+	// The largest device local heap holds the textures
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	VkDeviceSize largestHeap = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if ((memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memoryProperties.memoryHeaps[i].size > largestHeap)
+		{
+			largestHeap = memoryProperties.memoryHeaps[i].size;
+			deviceLocalHeap = i;
+		}
+	}
+
+	// -- FEEDBACK BUFFERS --
+	// Written by the GPU with atomics, read back by the CPU a few frames later: host visible, mapped for good
+	feedbackBuffers.resize(frameCount);
+	for (FeedbackBuffer& feedback : feedbackBuffers)
+	{
+		createBuffer(physicalDevice, device, FEEDBACK_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&feedback.buffer, &feedback.memory);
+
+		void* data;
+		vkMapMemory(device, feedback.memory, 0, FEEDBACK_BUFFER_SIZE, 0, &data);
+		feedback.data = static_cast<uint32_t*>(data);
+		memset(feedback.data, 0xFF, static_cast<size_t>(FEEDBACK_BUFFER_SIZE));
+		feedback.data[0] = 0;
+	}
+
+	printf("Texture streaming: %llu MiB budget%s\n", static_cast<unsigned long long>(budget / (1024 * 1024)),
+		queryMemoryBudget ? ", limited by VK_EXT_memory_budget" : "");
+}
+
+uint32_t TextureStreamer::addTexture(const unsigned char* pixels, uint32_t width, uint32_t height, VkFormat format)
+{
+	if (textures.size() >= MAX_STREAMED_TEXTURES)
+	{
+		throw std::runtime_error("Failed to add a Texture, the texture streamer is full!");
+	}
+
+	uint32_t textureId = static_cast<uint32_t>(textures.size());
+	textures.emplace_back();
+	StreamedTexture& texture = textures.back();
+	texture.format = format;
+	texture.log2Size = std::log2(static_cast<float>(std::max(width, height)));
+
+	// -- MIP CHAIN --
+	// Every level down to 1x1, one after the other, so the resident ones upload as a single range
+	size_t chainSize = 0;
+	for (uint32_t mipWidth = width, mipHeight = height;; mipWidth = std::max(1u, mipWidth / 2), mipHeight = std::max(1u, mipHeight / 2))
+	{
+		texture.mips.push_back({ mipWidth, mipHeight, chainSize });
+		chainSize += static_cast<size_t>(mipWidth) * mipHeight * TEXEL_SIZE;
+		if (mipWidth == 1 && mipHeight == 1)
+		{
+			break;
+		}
+	}
+
+	texture.pixels.resize(chainSize);
+	memcpy(texture.pixels.data(), pixels, static_cast<size_t>(width) * height * TEXEL_SIZE);
+	for (size_t i = 1; i < texture.mips.size(); i++)
+	{
+		const MipLevel& source = texture.mips[i - 1];
+		const MipLevel& target = texture.mips[i];
+		downsample(texture.pixels.data() + source.offset, source.width, source.height,
+			texture.pixels.data() + target.offset, target.width, target.height, isSrgbFormat(format));
+	}
+
+	// The first mip no larger than the tail size, a small texture is resident as a whole
+	texture.tailMip = 0;
+	while (std::max(texture.mips[texture.tailMip].width, texture.mips[texture.tailMip].height) > TEXTURE_TAIL_SIZE)
+	{
+		texture.tailMip++;
+	}
+	texture.requestedMip = texture.tailMip;
+
+	setResidentMip(textureId, texture.tailMip, 0);
+	return textureId;
+}
+
+void TextureStreamer::update(uint32_t frameSlot, uint32_t frameNumber, uint32_t framesInFlight)
+{
+	PROFILE_FUNCTION();
+
+	destroyRetiredImages(frameNumber, false);
+	readFeedback(feedbackBuffers[frameSlot], frameNumber);
+
+	uint32_t releaseFrame = frameNumber + framesInFlight;
+	uint32_t changes = 0;
+
+	// -- OVER BUDGET --
+	// The heap shrank (another application, or the rest of the renderer grew), drop mips until the textures fit
+	makeRoom(0, MAX_STREAMED_TEXTURES, releaseFrame, &changes);
+
+	// -- STREAM IN --
+	// Textures missing mips the screen asked for, the most recently asked first, then the furthest off
+	std::vector<uint32_t> wanted;
+	for (uint32_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].requested && textures[i].requestedMip < textures[i].residentMip)
+		{
+			wanted.push_back(i);
+		}
+	}
+	std::sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b)
+	{
+		if (textures[a].lastRequestFrame != textures[b].lastRequestFrame)
+		{
+			return textures[a].lastRequestFrame > textures[b].lastRequestFrame;
+		}
+		return textures[a].residentMip - textures[a].requestedMip > textures[b].residentMip - textures[b].requestedMip;
+	});
+
+	VkDeviceSize uploaded = 0;
+	for (uint32_t textureId : wanted)
+	{
+		if (changes >= MAX_TEXTURE_CHANGES_PER_FRAME)
+		{
+			break;
+		}
+
+		// Straight to the requested mip if the frame's upload budget allows, a mip at a time otherwise
+		StreamedTexture& texture = textures[textureId];
+		uint32_t targetMip = texture.requestedMip;
+		while (targetMip + 1 < texture.residentMip && uploaded + getChainBytes(texture, targetMip) > MAX_TEXTURE_UPLOAD_PER_FRAME)
+		{
+			targetMip++;
+		}
+
+		VkDeviceSize bytes = getChainBytes(texture, targetMip);
+		if (uploaded > 0 && uploaded + bytes > MAX_TEXTURE_UPLOAD_PER_FRAME)
+		{
+			break;
+		}
+
+		// Room from textures seen less recently, or from this one's own resident mips
+		if (!makeRoom(bytes > texture.residentBytes ? bytes - texture.residentBytes : 0, textureId, releaseFrame, &changes))
+		{
+			continue;
+		}
+
+		setResidentMip(textureId, targetMip, releaseFrame);
+		uploaded += bytes;
+		changes++;
+	}
+}
+
+void TextureStreamer::readFeedback(FeedbackBuffer& feedback, uint32_t frameNumber)
+{
+	// The GPU finished the frame that wrote it, the graph's final barrier made the writes visible to the host
+	for (uint32_t i = 0; i < textures.size(); i++)
+	{
+		uint32_t mip = feedback.data[FEEDBACK_HEADER_WORDS + i];
+		if (mip == FEEDBACK_NONE)
+		{
+			continue;
+		}
+
+		// The sparse pixels of one frame see part of the screen, requests are gathered over a window.
+		// A texture seen again after a gap starts over, so one far away now can drop its fine mips
+		StreamedTexture& texture = textures[i];
+		mip = std::min(mip, texture.tailMip);
+		if (!texture.requested || frameNumber - texture.lastRequestFrame > TEXTURE_FEEDBACK_WINDOW)
+		{
+			texture.requestedMip = mip;
+		}
+		else
+		{
+			texture.requestedMip = std::min(texture.requestedMip, mip);
+		}
+		texture.requested = true;
+		texture.lastRequestFrame = frameNumber;
+	}
+
+	// Reset for the new frame. The writing pixel visits the 64 of the 8x8 block in a scattered order
+	memset(feedback.data + FEEDBACK_HEADER_WORDS, 0xFF, textures.size() * sizeof(uint32_t));
+	feedback.data[0] = (frameNumber * 23) % 64;
+}
+
+VkDeviceSize TextureStreamer::getBudget() const
+{
+	if (!queryMemoryBudget)
+	{
+		return budget;
+	}
+
+	// What the textures hold now plus what the heap has left, less a margin for everything else.
+	// Over the heap's budget it is less than the textures hold, so they give some back. The heap's
+	// usage still has the retired images in it, they are already off residentBytes and about to be freed
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+	memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties.pNext = &budgetProperties;
+	vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties);
+
+	VkDeviceSize heapBudget = budgetProperties.heapBudget[deviceLocalHeap];
+	VkDeviceSize heapUsage = budgetProperties.heapUsage[deviceLocalHeap] + heapBudget / HEAP_MARGIN_DIVISOR;
+	VkDeviceSize heapBudgetLeft = residentBytes + retiredBytes + heapBudget;
+	return std::min(budget, heapBudgetLeft > heapUsage ? heapBudgetLeft - heapUsage : 0);
+}
+
+VkDeviceSize TextureStreamer::getChainBytes(const StreamedTexture& texture, uint32_t firstMip) const
+{
+	return static_cast<VkDeviceSize>(texture.pixels.size() - texture.mips[firstMip].offset);
+}
+
+bool TextureStreamer::makeRoom(VkDeviceSize bytes, uint32_t keepTexture, uint32_t releaseFrame, uint32_t* changes)
+{
+	VkDeviceSize currentBudget = getBudget();
+	while (residentBytes + bytes > currentBudget)
+	{
+		// Least recently seen first, mips beyond the request before those in use. Textures asked for
+		// in the same frame as the one making room keep theirs, unless making room for nothing (over budget)
+		const StreamedTexture* kept = keepTexture < textures.size() ? &textures[keepTexture] : nullptr;
+		uint32_t victim = MAX_STREAMED_TEXTURES;
+		for (uint32_t i = 0; i < textures.size(); i++)
+		{
+			const StreamedTexture& texture = textures[i];
+			if (i == keepTexture || texture.residentMip >= texture.tailMip)
+			{
+				continue;
+			}
+
+			bool surplus = texture.residentMip < texture.requestedMip;
+			if (kept != nullptr && !surplus && texture.lastRequestFrame >= kept->lastRequestFrame)
+			{
+				continue;
+			}
+
+			if (victim == MAX_STREAMED_TEXTURES)
+			{
+				victim = i;
+				continue;
+			}
+
+			const StreamedTexture& best = textures[victim];
+			bool bestSurplus = best.residentMip < best.requestedMip;
+			if (surplus != bestSurplus ? surplus : texture.lastRequestFrame < best.lastRequestFrame)
+			{
+				victim = i;
+			}
+		}
+
+		if (victim == MAX_STREAMED_TEXTURES || *changes >= MAX_TEXTURE_CHANGES_PER_FRAME)
+		{
+			return false;
+		}
+
+		// Down to the request if it holds more, a mip at a time otherwise
+		StreamedTexture& texture = textures[victim];
+		uint32_t targetMip = texture.residentMip < texture.requestedMip ? texture.requestedMip : texture.residentMip + 1;
+		setResidentMip(victim, std::min(targetMip, texture.tailMip), releaseFrame);
+		(*changes)++;
+	}
+
+	return true;
+}
+
+void TextureStreamer::setResidentMip(uint32_t textureId, uint32_t firstMip, uint32_t releaseFrame)
+{
+	StreamedTexture& texture = textures[textureId];
+	uint32_t levelCount = static_cast<uint32_t>(texture.mips.size()) - firstMip;
+	const MipLevel& top = texture.mips[firstMip];
+
+	// -- IMAGE --
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.extent = { top.width, top.height, 1 };
+	imageCreateInfo.mipLevels = levelCount;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.format = texture.format;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkImage image;
+	VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, &image);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Texture Image!");
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VkDeviceMemory memory;
+	result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, &memory);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate memory for a Texture Image!");
+	}
+	vkBindImageMemory(device, image, memory, 0);
+
+	// -- UPLOAD --
+	// The resident mips are the end of the CPU chain, one staging buffer and a region per level
+	VkDeviceSize uploadSize = getChainBytes(texture, firstMip);
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(physicalDevice, device, uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer, &stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, uploadSize, 0, &data);
+	memcpy(data, texture.pixels.data() + top.offset, static_cast<size_t>(uploadSize));
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	std::vector<VkBufferImageCopy> regions(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		const MipLevel& mip = texture.mips[firstMip + level];
+		regions[level] = {};
+		regions[level].bufferOffset = mip.offset - top.offset;
+		regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[level].imageSubresource.mipLevel = level;
+		regions[level].imageSubresource.baseArrayLayer = 0;
+		regions[level].imageSubresource.layerCount = 1;
+		regions[level].imageExtent = { mip.width, mip.height, 1 };
+	}
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, transferCommandPool);
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = levelCount;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	endAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, commandBuffer);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	// -- VIEW --
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = image;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = texture.format;
+	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = 0;
+	viewCreateInfo.subresourceRange.levelCount = levelCount;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 1;
+
+	VkImageView view;
+	result = vkCreateImageView(device, &viewCreateInfo, nullptr, &view);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Texture Image View!");
+	}
+
+	// -- SWAP --
+	// The materials move to the new view, the old image stays until no frame in flight samples it
+	if (texture.view != VK_NULL_HANDLE)
+	{
+		materials->replaceTexture(texture.view, view, releaseFrame);
+		retiredImages.push_back({ texture.image, texture.memory, texture.view, texture.residentBytes, releaseFrame });
+		residentBytes -= texture.residentBytes;
+		retiredBytes += texture.residentBytes;
+	}
+
+	texture.image = image;
+	texture.memory = memory;
+	texture.view = view;
+	texture.residentMip = firstMip;
+	texture.residentBytes = memoryRequirements.size;
+	residentBytes += texture.residentBytes;
+}
+
+void TextureStreamer::destroyRetiredImages(uint32_t frameNumber, bool all)
+{
+	for (size_t i = 0; i < retiredImages.size();)
+	{
+		if (all || frameNumber >= retiredImages[i].releaseFrame)
+		{
+			vkDestroyImageView(device, retiredImages[i].view, nullptr);
+			vkDestroyImage(device, retiredImages[i].image, nullptr);
+			vkFreeMemory(device, retiredImages[i].memory, nullptr);
+			retiredBytes -= retiredImages[i].bytes;
+			retiredImages[i] = retiredImages.back();
+			retiredImages.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+MaterialTexture TextureStreamer::getMaterialTexture(uint32_t textureId) const
+{
+	MaterialTexture materialTexture;
+	materialTexture.view = textures[textureId].view;
+	materialTexture.feedbackSlot = textureId;
+	materialTexture.log2Size = textures[textureId].log2Size;
+	return materialTexture;
+}
+
+VkImageView TextureStreamer::getView(uint32_t textureId) const
+{
+	return textures[textureId].view;
+}
+
+VkBuffer TextureStreamer::getFeedbackBuffer(uint32_t frameSlot) const
+{
+	return feedbackBuffers[frameSlot].buffer;
+}
+
+VkDeviceSize TextureStreamer::getResidentBytes() const
+{
+	return residentBytes;
+}
+
+void TextureStreamer::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	destroyRetiredImages(0, true);
+	for (StreamedTexture& texture : textures)
+	{
+		vkDestroyImageView(device, texture.view, nullptr);
+		vkDestroyImage(device, texture.image, nullptr);
+		vkFreeMemory(device, texture.memory, nullptr);
+	}
+	textures.clear();
+
+	for (FeedbackBuffer& feedback : feedbackBuffers)
+	{
+		vkUnmapMemory(device, feedback.memory);
+		vkDestroyBuffer(device, feedback.buffer, nullptr);
+		vkFreeMemory(device, feedback.memory, nullptr);
+	}
+	feedbackBuffers.clear();
+
+	residentBytes = 0;
+	device = VK_NULL_HANDLE;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
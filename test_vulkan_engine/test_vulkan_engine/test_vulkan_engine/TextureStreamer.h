@@ -0,0 +1,164 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "MaterialLibrary.h"
+
+const uint32_t MAX_STREAMED_TEXTURES = 1024;						// Feedback slots, a texture keeps its slot for the whole run
+const uint32_t TEXTURE_TAIL_SIZE = 64;								// Mips this size or smaller are always resident
+const VkDeviceSize DEFAULT_TEXTURE_BUDGET = 512ull * 1024 * 1024;	// Bytes the texture images may hold when not set
+const VkDeviceSize MAX_TEXTURE_UPLOAD_PER_FRAME = 16ull * 1024 * 1024;	// Beyond the first upload of a frame, each upload blocks the frame
+const uint32_t MAX_TEXTURE_CHANGES_PER_FRAME = 8;					// Uploads and evictions a frame, each one replaces the sets of its materials
+const uint32_t TEXTURE_FEEDBACK_WINDOW = 64;						// Frames the feedback needs to see every pixel once
+
+/**
+ * @class TextureStreamer
+ * @brief Keeps the mips of the textures the screen needs on the GPU, within a memory budget.
+ *
+ * A texture's full mip chain is built on the CPU when it is added and stays in system memory,
+ * the GPU starts with only the tail (the mips no larger than TEXTURE_TAIL_SIZE). The material
+ * shaders write feedback: one pixel of every 8x8 block, a different one each frame, takes the
+ * atomic minimum of the mip each of its textures needs into the texture's slot of this frame's
+ * feedback buffer. When a frame context comes around again its buffer is read back, and textures
+ * asked for finer mips than they hold are streamed in, those needed most recently first.
+ *
+ * A texture's image always holds its resident mips down to 1x1, so streaming a mip in (or
+ * dropping one) replaces the image with one of the new size, uploaded from the CPU chain. The
+ * materials using the texture get new descriptor sets, the old image lives until no frame in
+ * flight can sample it. If the textures don't fit the budget the finest mips of the textures
+ * that went longest without being seen are evicted first. With VK_EXT_memory_budget the budget
+ * also shrinks to what the heap has left, so other applications' memory is respected.
+ */
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+
+	/**
+	 * @brief Creates the feedback buffers, one per frame context.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @param newTransferQueue Queue the mip uploads are submitted to.
+	 * @param newTransferCommandPool Pool of the uploads' command buffers.
+	 * @param newMaterials Materials whose sets are replaced when a texture's image changes.
+	 * @param frameCount Frame contexts, each has its own feedback buffer.
+	 * @param memoryBudgetQuery True if VK_EXT_memory_budget is enabled on the device.
+	 * @param newBudget Bytes the texture images may hold at most.
+	 * @throws std::runtime_error if a buffer can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue newTransferQueue, VkCommandPool newTransferCommandPool,
+		MaterialLibrary* newMaterials, uint32_t frameCount, bool memoryBudgetQuery, VkDeviceSize newBudget);
+
+	/**
+	 * @brief Builds the mip chain of an RGBA8 image and uploads its tail.
+	 *
+	 * @param pixels width * height RGBA8 texels, copied.
+	 * @param width Width of the image.
+	 * @param height Height of the image.
+	 * @param format RGBA8 format, the sRGB one for colour data (its mips are averaged in linear space).
+	 * @return ID of the texture, also its feedback slot.
+	 * @throws std::runtime_error if the streamer is full or the image can't be created.
+	 */
+	uint32_t addTexture(const unsigned char* pixels, uint32_t width, uint32_t height, VkFormat format);
+
+	/**
+	 * @brief Reads the feedback the frame context's last frame wrote, streams mips in and out.
+	 *
+	 * Called once the context's fence is waited on, its feedback buffer is then reset for the new frame.
+	 *
+	 * @param frameSlot Index of the frame context.
+	 * @param frameNumber Number of the frame being recorded.
+	 * @param framesInFlight Frames the GPU may still be drawing, the replaced images are kept that long.
+	 */
+	void update(uint32_t frameSlot, uint32_t frameNumber, uint32_t framesInFlight);
+
+	// The texture as a material slot uses it, its view changes as mips are streamed
+	MaterialTexture getMaterialTexture(uint32_t textureId) const;
+	VkImageView getView(uint32_t textureId) const;
+
+	// Written by the material shaders, set 0 binding 4
+	VkBuffer getFeedbackBuffer(uint32_t frameSlot) const;
+
+	VkDeviceSize getResidentBytes() const;
+
+	void destroy();
+
+	~TextureStreamer();
+
+private:
+	struct MipLevel
+	{
+		uint32_t width;
+		uint32_t height;
+		size_t offset;					// Into the texture's pixels
+	};
+
+	struct StreamedTexture
+	{
+		VkFormat format;
+		std::vector<MipLevel> mips;
+		std::vector<unsigned char> pixels;	// Every mip, the finest first
+		uint32_t tailMip;				// Coarsest mip that is streamed, the ones from it on are always resident
+		float log2Size;					// Of the larger side of mip 0
+
+		// -- GPU --
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		uint32_t residentMip = 0;		// Finest mip on the GPU
+		VkDeviceSize residentBytes = 0;
+
+		// -- FEEDBACK --
+		uint32_t requestedMip = 0;		// Finest mip the screen asked for in the current feedback window
+		uint32_t lastRequestFrame = 0;
+		bool requested = false;			// Never asked for, the tail is enough
+	};
+
+	// An image replaced by one with more or fewer mips, destroyed once no frame in flight samples it
+	struct RetiredImage
+	{
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		VkDeviceSize bytes;
+		uint32_t releaseFrame;
+	};
+
+	// Persistently mapped: the pixel writing this frame, then a mip per texture slot (std430)
+	struct FeedbackBuffer
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		uint32_t* data = nullptr;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	MaterialLibrary* materials = nullptr;
+
+	std::vector<StreamedTexture> textures;
+	std::vector<RetiredImage> retiredImages;
+	std::vector<FeedbackBuffer> feedbackBuffers;
+
+	// -- BUDGET --
+	VkDeviceSize budget = DEFAULT_TEXTURE_BUDGET;
+	VkDeviceSize residentBytes = 0;
+	VkDeviceSize retiredBytes = 0;		// Of the retired images, still allocated until their frames finish
+	bool queryMemoryBudget = false;
+	uint32_t deviceLocalHeap = 0;		// Heap VK_EXT_memory_budget is asked about
+
+	void readFeedback(FeedbackBuffer& feedback, uint32_t frameNumber);
+	VkDeviceSize getBudget() const;
+	VkDeviceSize getChainBytes(const StreamedTexture& texture, uint32_t firstMip) const;
+
+	bool makeRoom(VkDeviceSize bytes, uint32_t keepTexture, uint32_t releaseFrame, uint32_t* changes);
+	void setResidentMip(uint32_t textureId, uint32_t firstMip, uint32_t releaseFrame);
+	void destroyRetiredImages(uint32_t frameNumber, bool all);
+};
@@ -27,6 +27,7 @@ struct Vertex
 struct QueueFamilyIndices {
 	int graphicsFamily = -1;			// Location of Graphics Queue Family
 	int presentationFamily = -1;		// Location of Presentation Queue Family
+	int computeFamily = -1;				// Location of a Compute Queue Family without graphics (optional, async compute)
 
 	// Check if queue families are valid
 	bool isValid()
@@ -75,6 +76,35 @@ static std::vector<char> readFile(const std::string& filename)
 	return fileBuffer;
 }
 
+// Escapes the characters JSON doesn't allow in a string, for the profilers' trace exports
+static std::string escapeJson(const std::string& text)
+{
+	const char* HEX_DIGITS = "0123456789abcdef";
+
+	std::string escaped;
+	for (char c : text)
+	{
+		unsigned char code = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+			escaped += c;
+		}
+		else if (code < 0x20)
+		{
+			// Control characters as \u00XX
+			escaped += "\\u00";
+			escaped += HEX_DIGITS[code >> 4];
+			escaped += HEX_DIGITS[code & 0xF];
+		}
+		else
+		{
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
 static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
 {
 	// Get properties of physical device memory
@@ -256,6 +286,24 @@ static void transitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool
 		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 	}
+	// If a new image is only read before it is first rendered to (e.g. a history buffer)...
+	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	{
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
+	// If a new image is used as a storage image (read and written by shaders)...
+	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_GENERAL)
+	{
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	}
 
 	vkCmdPipelineBarrier(
 		commandBuffer,
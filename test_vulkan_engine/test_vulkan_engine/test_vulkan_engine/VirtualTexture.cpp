@@ -0,0 +1,1045 @@
+#include "VirtualTexture.h"
+
+#include "Utilities.h"
+#include "CpuProfiler.h"
+#include "FrameContext.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t TILE_FILE_MAGIC = 0x54564B56;		// "VKVT"
+	const uint32_t TILE_FILE_VERSION = 1;				// Bumped when the layout of the pages changes
+
+	// Written in front of the pages
+	struct TileFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t virtualSize;			// Side of mip 0, a power of two
+		uint32_t pageSize;
+		uint32_t pageBorder;
+		uint32_t mipCount;
+		uint64_t sourceChecksum;		// Of the image the pages were built from
+	};
+
+	const uint32_t TEXEL_SIZE = 4;										// RGBA8
+	const uint32_t PADDED_PAGE_SIZE = VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER;
+	const VkDeviceSize PAGE_BYTES = VkDeviceSize(PADDED_PAGE_SIZE) * PADDED_PAGE_SIZE * TEXEL_SIZE;
+	const uint32_t NO_PAGE = UINT32_MAX;
+
+	const VkFormat ATLAS_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+	const VkFormat PAGE_TABLE_FORMAT = VK_FORMAT_R8G8B8A8_UINT;		// Atlas slot x, y, mip of the page held there, 1
+
+	// FNV-1a, same as the pipeline cache's
+	uint64_t computeChecksum(const char* data, size_t size)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// The texture holds colour, it is filtered in linear space like the streamed textures' mips
+	struct SrgbTables
+	{
+		float toLinear[256];
+		uint8_t fromLinear[4096];		// Linear value quantised to 12 bits
+
+		SrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < 4096; i++)
+			{
+				float l = i / 4095.0f;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = static_cast<uint8_t>(std::min(255.0f, c * 255.0f + 0.5f));
+			}
+		}
+	};
+
+	const SrgbTables& getSrgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	// Weighted sum of RGBA8 texels, the colour in linear space and the alpha as it is
+	void blendTexels(const unsigned char* const* texels, const float* weights, uint32_t count, unsigned char* out)
+	{
+		const SrgbTables& tables = getSrgbTables();
+		for (uint32_t c = 0; c < TEXEL_SIZE; c++)
+		{
+			float sum = 0.0f;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				sum += weights[i] * (c < 3 ? tables.toLinear[texels[i][c]] : texels[i][c] / 255.0f);
+			}
+			sum = std::min(std::max(sum, 0.0f), 1.0f);
+			out[c] = c < 3 ? tables.fromLinear[static_cast<uint32_t>(sum * 4095.0f + 0.5f)] : static_cast<unsigned char>(sum * 255.0f + 0.5f);
+		}
+	}
+
+	// Bilinear resample of the source to a size x size square
+	std::vector<unsigned char> resample(const unsigned char* source, uint32_t width, uint32_t height, uint32_t size)
+	{
+		std::vector<unsigned char> target(size_t(size) * size * TEXEL_SIZE);
+		if (width == size && height == size)
+		{
+			memcpy(target.data(), source, target.size());
+			return target;
+		}
+
+		for (uint32_t y = 0; y < size; y++)
+		{
+			float v = std::max((y + 0.5f) * height / size - 0.5f, 0.0f);
+			uint32_t y0 = std::min(static_cast<uint32_t>(v), height - 1);
+			uint32_t y1 = std::min(y0 + 1, height - 1);
+			float fy = v - y0;
+			for (uint32_t x = 0; x < size; x++)
+			{
+				float u = std::max((x + 0.5f) * width / size - 0.5f, 0.0f);
+				uint32_t x0 = std::min(static_cast<uint32_t>(u), width - 1);
+				uint32_t x1 = std::min(x0 + 1, width - 1);
+				float fx = u - x0;
+
+				const unsigned char* texels[4] = {
+					source + (size_t(y0) * width + x0) * TEXEL_SIZE, source + (size_t(y0) * width + x1) * TEXEL_SIZE,
+					source + (size_t(y1) * width + x0) * TEXEL_SIZE, source + (size_t(y1) * width + x1) * TEXEL_SIZE
+				};
+				float weights[4] = { (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy };
+				blendTexels(texels, weights, 4, target.data() + (size_t(y) * size + x) * TEXEL_SIZE);
+			}
+		}
+		return target;
+	}
+
+	// 2x2 box filter of a square power of two level
+	std::vector<unsigned char> downsample(const std::vector<unsigned char>& source, uint32_t sourceSize)
+	{
+		uint32_t size = sourceSize / 2;
+		std::vector<unsigned char> target(size_t(size) * size * TEXEL_SIZE);
+		const float weights[4] = { 0.25f, 0.25f, 0.25f, 0.25f };
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				const unsigned char* row0 = source.data() + (size_t(y * 2) * sourceSize + x * 2) * TEXEL_SIZE;
+				const unsigned char* row1 = row0 + size_t(sourceSize) * TEXEL_SIZE;
+				const unsigned char* texels[4] = { row0, row0 + TEXEL_SIZE, row1, row1 + TEXEL_SIZE };
+				blendTexels(texels, weights, 4, target.data() + (size_t(y) * size + x) * TEXEL_SIZE);
+			}
+		}
+		return target;
+	}
+
+	void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	void createImage(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t size, uint32_t mipLevels, VkFormat format,
+		VkImage* image, VkDeviceMemory* memory, VkImageView* view)
+	{
+		VkImageCreateInfo imageCreateInfo = {};
+		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageCreateInfo.extent = { size, size, 1 };
+		imageCreateInfo.mipLevels = mipLevels;
+		imageCreateInfo.arrayLayers = 1;
+		imageCreateInfo.format = format;
+		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkResult result = vkCreateImage(device, &imageCreateInfo, nullptr, image);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Virtual Texture Image!");
+		}
+
+		VkMemoryRequirements memoryRequirements;
+		vkGetImageMemoryRequirements(device, *image, &memoryRequirements);
+
+		VkMemoryAllocateInfo memoryAllocInfo = {};
+		memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocInfo.allocationSize = memoryRequirements.size;
+		memoryAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		result = vkAllocateMemory(device, &memoryAllocInfo, nullptr, memory);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate memory for a Virtual Texture Image!");
+		}
+		vkBindImageMemory(device, *image, *memory, 0);
+
+		VkImageViewCreateInfo viewCreateInfo = {};
+		viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewCreateInfo.image = *image;
+		viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCreateInfo.format = format;
+		viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+		viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewCreateInfo.subresourceRange.baseMipLevel = 0;
+		viewCreateInfo.subresourceRange.levelCount = mipLevels;
+		viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+		viewCreateInfo.subresourceRange.layerCount = 1;
+
+		result = vkCreateImageView(device, &viewCreateInfo, nullptr, view);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Virtual Texture Image View!");
+		}
+	}
+
+	VkSampler createSampler(VkDevice device, VkFilter filter)
+	{
+		VkSamplerCreateInfo samplerCreateInfo = {};
+		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerCreateInfo.magFilter = filter;
+		samplerCreateInfo.minFilter = filter;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+		samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+		samplerCreateInfo.minLod = 0.0f;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.anisotropyEnable = VK_FALSE;
+
+		VkSampler sampler;
+		VkResult result = vkCreateSampler(device, &samplerCreateInfo, nullptr, &sampler);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create a Virtual Texture Sampler!");
+		}
+		return sampler;
+	}
+}
+
+VirtualTexture::VirtualTexture()
+{
+}
+
+VirtualTextureResources VirtualTexture::addPass(RenderGraph& newGraph)
+{
+	graph = &newGraph;
+
+	// Owned here and kept across frames, the images are sampled between the uploads
+	resources.pageTable = graph->importImage("Virtual page table", PAGE_TABLE_FORMAT, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+	resources.atlas = graph->importImage("Virtual texture atlas", ATLAS_FORMAT, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+	graph->exportResource(resources.pageTable, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+	graph->exportResource(resources.atlas, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+
+	// Flags of the pages the scene sampled, read back by the CPU when the frame's fence signalled
+	resources.feedback = graph->importBuffer("Virtual texture feedback", RENDER_GRAPH_ACCESS_NONE);
+	graph->exportResource(resources.feedback, RENDER_GRAPH_ACCESS_HOST_READ);
+
+	// Only part of the atlas is written, the rest keeps its pages
+	graph->addPass("Virtual texture upload", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.readWrite(resources.pageTable, RENDER_GRAPH_ACCESS_TRANSFER_WRITE)
+		.readWrite(resources.atlas, RENDER_GRAPH_ACCESS_TRANSFER_WRITE)
+		.setExecute([this](VkCommandBuffer commandBuffer) { record(commandBuffer); });
+
+	return resources;
+}
+
+void VirtualTexture::create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice)
+{
+	physicalDevice = newPhysicalDevice;
+	device = newDevice;
+
+	// -- SAMPLERS --
+	pageTableSampler = createSampler(device, VK_FILTER_NEAREST);
+	atlasSampler = createSampler(device, VK_FILTER_LINEAR);
+
+	// -- SET LAYOUT --
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutCreateInfo.pBindings = bindings.data();
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &setLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// -- DESCRIPTOR POOL --
+	// A set per frame context, their feedback buffers differ
+	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = 2 * MAX_FRAMES_IN_FLIGHT;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	result = vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &descriptorPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Pool!");
+	}
+}
+
+void VirtualTexture::load(const std::string& sourceFile, uint32_t frameCount, VkQueue queue, VkCommandPool commandPool)
+{
+	if (sourceFile.empty())
+	{
+		// The scene pipelines still bind the set, it points at placeholders no material samples
+		computePageLayout(VIRTUAL_PAGE_SIZE);
+		createImages(1, 1, 1);
+	}
+	else
+	{
+		prepareTileFile(sourceFile);
+		createImages(VIRTUAL_ATLAS_PAGES * PADDED_PAGE_SIZE, pagesPerSide, mipCount);
+		pages.assign(pageCount, Page());
+		slotPages.assign(VIRTUAL_ATLAS_PAGES * VIRTUAL_ATLAS_PAGES, NO_PAGE);
+		loaded = true;
+	}
+
+	createFrameResources(frameCount);
+	uploadFirstPage(queue, commandPool);
+
+	if (loaded)
+	{
+		stopping = false;
+		loader = std::thread(&VirtualTexture::loaderLoop, this);
+
+		printf("Virtual texture: %s, %ux%u texels in %u pages, %ux%u atlas\n", sourceFile.c_str(), virtualSize, virtualSize,
+			pageCount, atlasExtent.width, atlasExtent.height);
+	}
+}
+
+void VirtualTexture::prepareTileFile(const std::string& sourceFile)
+{
+	std::string sourcePath = "Textures/" + sourceFile;
+	std::ifstream file(sourcePath, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open a Virtual Texture file! (" + sourceFile + ")");
+	}
+
+	std::vector<char> source(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(source.data(), source.size());
+
+	// The pages belong to these exact bytes, an edited image is tiled again
+	uint64_t sourceChecksum = computeChecksum(source.data(), source.size());
+	tileFile = sourcePath + ".vt";
+
+	if (!checkTileFile(sourceChecksum))
+	{
+		auto start = std::chrono::steady_clock::now();
+		buildTileFile(source, sourceChecksum);
+		double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		printf("Virtual texture: tiled %s into %u mips in %.2f ms\n", sourceFile.c_str(), mipCount, buildMs);
+	}
+}
+
+bool VirtualTexture::checkTileFile(uint64_t sourceChecksum)
+{
+	std::ifstream file(tileFile, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		printf("Virtual texture: no tiled file, building it\n");
+		return false;
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+
+	TileFileHeader header;
+	if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		printf("Virtual texture: %s is truncated, building it\n", tileFile.c_str());
+		return false;
+	}
+
+	bool powerOfTwo = header.virtualSize >= VIRTUAL_PAGE_SIZE && (header.virtualSize & (header.virtualSize - 1)) == 0;
+	if (header.magic != TILE_FILE_MAGIC || header.version != TILE_FILE_VERSION || header.pageSize != VIRTUAL_PAGE_SIZE ||
+		header.pageBorder != VIRTUAL_PAGE_BORDER || !powerOfTwo)
+	{
+		printf("Virtual texture: %s has an unknown format, building it\n", tileFile.c_str());
+		return false;
+	}
+
+	if (header.sourceChecksum != sourceChecksum)
+	{
+		printf("Virtual texture: %s was built from another image, building it\n", tileFile.c_str());
+		return false;
+	}
+
+	computePageLayout(header.virtualSize);
+	if (header.mipCount != mipCount || fileSize != sizeof(header) + pageCount * PAGE_BYTES)
+	{
+		printf("Virtual texture: %s has a wrong size, building it\n", tileFile.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void VirtualTexture::buildTileFile(const std::vector<char>& source, uint64_t sourceChecksum)
+{
+	int width, height, channels;
+	stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), static_cast<int>(source.size()),
+		&width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels)
+	{
+		throw std::runtime_error("Failed to load a Virtual Texture file! (" + tileFile + ")");
+	}
+
+	// A square power of two, so every mip is a whole number of pages
+	uint32_t size = VIRTUAL_PAGE_SIZE;
+	while (size < static_cast<uint32_t>(std::max(width, height)) && size < MAX_VIRTUAL_TEXTURE_SIZE)
+	{
+		size *= 2;
+	}
+	computePageLayout(size);
+
+	std::vector<unsigned char> level = resample(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), size);
+	stbi_image_free(pixels);
+
+	std::ofstream file(tileFile, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to create a Virtual Texture tile file! (" + tileFile + ")");
+	}
+
+	TileFileHeader header = {};
+	header.magic = TILE_FILE_MAGIC;
+	header.version = TILE_FILE_VERSION;
+	header.virtualSize = virtualSize;
+	header.pageSize = VIRTUAL_PAGE_SIZE;
+	header.pageBorder = VIRTUAL_PAGE_BORDER;
+	header.mipCount = mipCount;
+	header.sourceChecksum = sourceChecksum;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	// Only the current level is in memory, its pages are written and it is halved for the next mip
+	std::vector<unsigned char> tile(static_cast<size_t>(PAGE_BYTES));
+	for (uint32_t mip = 0; mip < mipCount; mip++)
+	{
+		int levelSize = static_cast<int>(virtualSize >> mip);
+		uint32_t levelPages = pagesPerSide >> mip;
+		for (uint32_t pageY = 0; pageY < levelPages; pageY++)
+		{
+			for (uint32_t pageX = 0; pageX < levelPages; pageX++)
+			{
+				// The border repeats the neighbouring pages, the texture's edge is clamped
+				for (uint32_t y = 0; y < PADDED_PAGE_SIZE; y++)
+				{
+					int sourceY = std::min(std::max(static_cast<int>(pageY * VIRTUAL_PAGE_SIZE + y) - static_cast<int>(VIRTUAL_PAGE_BORDER), 0), levelSize - 1);
+					for (uint32_t x = 0; x < PADDED_PAGE_SIZE; x++)
+					{
+						int sourceX = std::min(std::max(static_cast<int>(pageX * VIRTUAL_PAGE_SIZE + x) - static_cast<int>(VIRTUAL_PAGE_BORDER), 0), levelSize - 1);
+						memcpy(tile.data() + (size_t(y) * PADDED_PAGE_SIZE + x) * TEXEL_SIZE,
+							level.data() + (size_t(sourceY) * levelSize + sourceX) * TEXEL_SIZE, TEXEL_SIZE);
+					}
+				}
+				file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+			}
+		}
+
+		if (mip + 1 < mipCount)
+		{
+			level = downsample(level, static_cast<uint32_t>(levelSize));
+		}
+	}
+
+	if (!file)
+	{
+		throw std::runtime_error("Failed to write a Virtual Texture tile file! (" + tileFile + ")");
+	}
+}
+
+void VirtualTexture::computePageLayout(uint32_t size)
+{
+	virtualSize = size;
+	pagesPerSide = size / VIRTUAL_PAGE_SIZE;
+
+	// Down to the mip that is a single page
+	mipCount = 1;
+	while ((pagesPerSide >> (mipCount - 1)) > 1)
+	{
+		mipCount++;
+	}
+
+	mipOffsets.resize(mipCount);
+	pageCount = 0;
+	for (uint32_t mip = 0; mip < mipCount; mip++)
+	{
+		mipOffsets[mip] = pageCount;
+		pageCount += (pagesPerSide >> mip) * (pagesPerSide >> mip);
+	}
+}
+
+void VirtualTexture::createImages(uint32_t atlasSize, uint32_t pageTableSize, uint32_t pageTableMips)
+{
+	createImage(physicalDevice, device, atlasSize, 1, ATLAS_FORMAT, &atlasImage, &atlasMemory, &atlasView);
+	createImage(physicalDevice, device, pageTableSize, pageTableMips, PAGE_TABLE_FORMAT, &pageTableImage, &pageTableMemory, &pageTableView);
+	atlasExtent = { atlasSize, atlasSize };
+}
+
+void VirtualTexture::createFrameResources(uint32_t frameCount)
+{
+	VkDeviceSize feedbackSize = sizeof(FeedbackHeader) + pageCount * sizeof(uint32_t);
+	VkDeviceSize stagingSize = MAX_PAGE_UPLOADS_PER_FRAME * PAGE_BYTES + getPageTableBytes();
+
+	frameResources.resize(frameCount);
+	for (FrameResources& frame : frameResources)
+	{
+		// -- FEEDBACK --
+		// Written by the GPU, read back by the CPU a few frames later: host visible, mapped for good
+		createBuffer(physicalDevice, device, feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame.feedbackBuffer, &frame.feedbackMemory);
+
+		void* data;
+		vkMapMemory(device, frame.feedbackMemory, 0, feedbackSize, 0, &data);
+		memset(data, 0, static_cast<size_t>(feedbackSize));
+		frame.feedback = static_cast<FeedbackHeader*>(data);
+		frame.feedback->area = area;
+		frame.feedback->mipCount = mipCount;
+		frame.feedback->pagesPerSide = pagesPerSide;
+		frame.requestedPages = reinterpret_cast<uint32_t*>(frame.feedback + 1);
+
+		// -- STAGING --
+		// The pages and the page table of the frame, written when the frame's fence signalled
+		if (loaded)
+		{
+			createBuffer(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&frame.stagingBuffer, &frame.stagingMemory);
+
+			vkMapMemory(device, frame.stagingMemory, 0, stagingSize, 0, &data);
+			frame.staging = static_cast<unsigned char*>(data);
+		}
+
+		// -- DESCRIPTOR SET --
+		VkDescriptorSetAllocateInfo setAllocInfo = {};
+		setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setAllocInfo.descriptorPool = descriptorPool;
+		setAllocInfo.descriptorSetCount = 1;
+		setAllocInfo.pSetLayouts = &setLayout;
+
+		VkResult result = vkAllocateDescriptorSets(device, &setAllocInfo, &frame.descriptorSet);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate a Virtual Texture Descriptor Set!");
+		}
+
+		std::array<VkDescriptorImageInfo, 2> imageInfos = {};
+		imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[0].imageView = pageTableView;
+		imageInfos[0].sampler = pageTableSampler;
+		imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[1].imageView = atlasView;
+		imageInfos[1].sampler = atlasSampler;
+
+		VkDescriptorBufferInfo feedbackInfo = {};
+		feedbackInfo.buffer = frame.feedbackBuffer;
+		feedbackInfo.offset = 0;
+		feedbackInfo.range = feedbackSize;
+
+		std::array<VkWriteDescriptorSet, 3> setWrites = {};
+		for (uint32_t i = 0; i < setWrites.size(); i++)
+		{
+			setWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			setWrites[i].dstSet = frame.descriptorSet;
+			setWrites[i].dstBinding = i;
+			setWrites[i].descriptorCount = 1;
+		}
+		setWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		setWrites[0].pImageInfo = &imageInfos[0];
+		setWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		setWrites[1].pImageInfo = &imageInfos[1];
+		setWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		setWrites[2].pBufferInfo = &feedbackInfo;
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+	}
+}
+
+void VirtualTexture::uploadFirstPage(VkQueue queue, VkCommandPool commandPool)
+{
+	// The single page of the coarsest mip is read here and pinned to slot 0, every page falls back to it
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+	VkDeviceSize pageTableOffset = PAGE_BYTES;
+	if (loaded)
+	{
+		uint32_t firstPage = pageCount - 1;
+		std::vector<unsigned char> pixels;
+		std::ifstream file(tileFile, std::ios::binary);
+		if (!readPage(file, firstPage, pixels))
+		{
+			throw std::runtime_error("Failed to read a Virtual Texture tile file! (" + tileFile + ")");
+		}
+		pages[firstPage].slot = 0;
+		slotPages[0] = firstPage;
+
+		VkDeviceSize stagingSize = pageTableOffset + getPageTableBytes();
+		createBuffer(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer, &stagingBufferMemory);
+
+		void* mapped;
+		vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, &mapped);
+		memcpy(mapped, pixels.data(), pixels.size());
+		writePageTable(static_cast<unsigned char*>(mapped) + pageTableOffset);
+		vkUnmapMemory(device, stagingBufferMemory);
+	}
+
+	VkCommandBuffer commandBuffer = beginCommandBuffer(device, commandPool);
+
+	imageBarrier(commandBuffer, atlasImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	imageBarrier(commandBuffer, pageTableImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	if (loaded)
+	{
+		VkBufferImageCopy pageRegion = {};
+		pageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		pageRegion.imageSubresource.layerCount = 1;
+		pageRegion.imageExtent = { PADDED_PAGE_SIZE, PADDED_PAGE_SIZE, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &pageRegion);
+
+		std::vector<VkBufferImageCopy> tableRegions(mipCount);
+		for (uint32_t mip = 0; mip < mipCount; mip++)
+		{
+			tableRegions[mip] = {};
+			tableRegions[mip].bufferOffset = pageTableOffset + mipOffsets[mip] * TEXEL_SIZE;
+			tableRegions[mip].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			tableRegions[mip].imageSubresource.mipLevel = mip;
+			tableRegions[mip].imageSubresource.layerCount = 1;
+			tableRegions[mip].imageExtent = { pagesPerSide >> mip, pagesPerSide >> mip, 1 };
+		}
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(tableRegions.size()), tableRegions.data());
+	}
+
+	// The graph imports both as sampled, the state every frame starts and ends in
+	imageBarrier(commandBuffer, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	imageBarrier(commandBuffer, pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	endAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
+
+	if (stagingBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	}
+}
+
+void VirtualTexture::setArea(glm::vec2 origin, glm::vec2 size)
+{
+	// Written into each feedback buffer when its frame is prepared
+	area = glm::vec4(origin, 1.0f / glm::max(size, glm::vec2(0.0001f)));
+}
+
+void VirtualTexture::prepareFrame(uint32_t frameSlot, uint32_t frameNumber)
+{
+	PROFILE_FUNCTION();
+
+	currentSlot = frameSlot;
+	FrameResources& frame = frameResources[frameSlot];
+	graph->setImportedImage(resources.pageTable, pageTableImage, pageTableView, { pagesPerSide, pagesPerSide }, VK_NULL_HANDLE);
+	graph->setImportedImage(resources.atlas, atlasImage, atlasView, atlasExtent, VK_NULL_HANDLE);
+	graph->setImportedBuffer(resources.feedback, frame.feedbackBuffer);
+
+	pageCopies.clear();
+	pageTableStaged = false;
+	if (!loaded)
+	{
+		return;
+	}
+
+	readFeedback(frame, frameNumber);
+	queueLoads(frameNumber);
+	stageLoadedPages(frame, frameNumber);
+
+	// The whole table is rebuilt, a page's residency changes the entries of all its descendants
+	if (pageTableDirty)
+	{
+		writePageTable(frame.staging + MAX_PAGE_UPLOADS_PER_FRAME * PAGE_BYTES);
+		pageTableStaged = true;
+		pageTableDirty = false;
+	}
+}
+
+void VirtualTexture::readFeedback(FrameResources& frame, uint32_t frameNumber)
+{
+	// The GPU finished the frame that wrote it, the graph's final barrier made the writes visible to the host.
+	// A flagged page keeps its ancestors too, they stand in for it whenever it is evicted
+	for (uint32_t i = 0; i < pageCount; i++)
+	{
+		if (frame.requestedPages[i] == 0)
+		{
+			continue;
+		}
+
+		for (uint32_t page = i; page != NO_PAGE && pages[page].lastUsed != frameNumber; page = getParentPage(page))
+		{
+			pages[page].lastUsed = frameNumber;
+			pages[page].used = true;
+		}
+	}
+
+	// Reset for the new frame. The writing pixel visits the 64 of the 8x8 block in a scattered order
+	memset(frame.requestedPages, 0, pageCount * sizeof(uint32_t));
+	frame.feedback->area = area;
+	frame.feedback->feedbackPixel = (frameNumber * 23) % 64;
+}
+
+void VirtualTexture::queueLoads(uint32_t frameNumber)
+{
+	// Pages asked for in the last frames and missing, the coarsest first: each one makes its
+	// descendants look better, and the finer ones may no longer be needed once they are loaded
+	std::vector<uint32_t> wanted;
+	for (uint32_t i = 0; i < pageCount; i++)
+	{
+		const Page& page = pages[i];
+		if (page.used && page.slot == NO_PAGE && !page.pending && frameNumber - page.lastUsed < VIRTUAL_PAGE_KEEP_FRAMES)
+		{
+			wanted.push_back(i);
+		}
+	}
+	std::sort(wanted.begin(), wanted.end(), std::greater<uint32_t>());		// Coarser mips come later in the file
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t page : wanted)
+		{
+			if (pendingLoads >= MAX_PENDING_PAGE_LOADS)
+			{
+				break;
+			}
+			requests.push_back(page);
+			pages[page].pending = true;
+			pendingLoads++;
+		}
+	}
+	wake.notify_one();
+}
+
+void VirtualTexture::stageLoadedPages(FrameResources& frame, uint32_t frameNumber)
+{
+	std::vector<LoadedPage> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t count = std::min(loadedPages.size(), static_cast<size_t>(MAX_PAGE_UPLOADS_PER_FRAME));
+		finished.assign(std::make_move_iterator(loadedPages.begin()), std::make_move_iterator(loadedPages.begin() + count));
+		loadedPages.erase(loadedPages.begin(), loadedPages.begin() + count);
+		pendingLoads -= static_cast<uint32_t>(count);
+	}
+
+	for (LoadedPage& loadedPage : finished)
+	{
+		Page& page = pages[loadedPage.page];
+		page.pending = false;
+
+		// Every slot holds a page the screen needs: the page is dropped, an ancestor keeps standing in
+		uint32_t slot = findSlot(frameNumber);
+		if (loadedPage.pixels.empty() || slot == NO_PAGE)
+		{
+			continue;
+		}
+
+		if (slotPages[slot] != NO_PAGE)
+		{
+			pages[slotPages[slot]].slot = NO_PAGE;
+		}
+		slotPages[slot] = loadedPage.page;
+		page.slot = slot;
+
+		// Ordered before the scene by the graph, the frames in flight sampled the old page before it
+		VkDeviceSize offset = pageCopies.size() * PAGE_BYTES;
+		memcpy(frame.staging + offset, loadedPage.pixels.data(), loadedPage.pixels.size());
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { static_cast<int32_t>((slot % VIRTUAL_ATLAS_PAGES) * PADDED_PAGE_SIZE),
+			static_cast<int32_t>((slot / VIRTUAL_ATLAS_PAGES) * PADDED_PAGE_SIZE), 0 };
+		region.imageExtent = { PADDED_PAGE_SIZE, PADDED_PAGE_SIZE, 1 };
+		pageCopies.push_back(region);
+
+		pageTableDirty = true;
+	}
+}
+
+uint32_t VirtualTexture::findSlot(uint32_t frameNumber)
+{
+	// A free slot, or the one whose page went longest without being asked for. The coarsest page keeps slot 0
+	uint32_t victim = NO_PAGE;
+	uint32_t victimAge = 0;
+	for (uint32_t slot = 1; slot < slotPages.size(); slot++)
+	{
+		if (slotPages[slot] == NO_PAGE)
+		{
+			return slot;
+		}
+
+		const Page& page = pages[slotPages[slot]];
+		uint32_t age = page.used ? frameNumber - page.lastUsed : UINT32_MAX;
+		if (age >= VIRTUAL_PAGE_KEEP_FRAMES && age > victimAge)
+		{
+			victim = slot;
+			victimAge = age;
+		}
+	}
+	return victim;
+}
+
+void VirtualTexture::writePageTable(unsigned char* target) const
+{
+	// Coarsest first, so a page that isn't resident copies the entry its parent already has
+	for (uint32_t mip = mipCount; mip-- > 0;)
+	{
+		uint32_t levelPages = pagesPerSide >> mip;
+		for (uint32_t i = 0; i < levelPages * levelPages; i++)
+		{
+			uint32_t page = mipOffsets[mip] + i;
+			unsigned char* entry = target + page * TEXEL_SIZE;
+			uint32_t slot = pages[page].slot;
+			if (slot != NO_PAGE)
+			{
+				entry[0] = static_cast<unsigned char>(slot % VIRTUAL_ATLAS_PAGES);
+				entry[1] = static_cast<unsigned char>(slot / VIRTUAL_ATLAS_PAGES);
+				entry[2] = static_cast<unsigned char>(mip);
+				entry[3] = 1;
+			}
+			else
+			{
+				memcpy(entry, target + getParentPage(page) * TEXEL_SIZE, TEXEL_SIZE);
+			}
+		}
+	}
+}
+
+uint32_t VirtualTexture::getPageIndex(uint32_t mip, uint32_t x, uint32_t y) const
+{
+	return mipOffsets[mip] + y * (pagesPerSide >> mip) + x;
+}
+
+uint32_t VirtualTexture::getParentPage(uint32_t page) const
+{
+	uint32_t mip = getPageMip(page);
+	if (mip + 1 >= mipCount)
+	{
+		return NO_PAGE;
+	}
+
+	uint32_t levelPages = pagesPerSide >> mip;
+	uint32_t local = page - mipOffsets[mip];
+	return getPageIndex(mip + 1, (local % levelPages) / 2, (local / levelPages) / 2);
+}
+
+uint32_t VirtualTexture::getPageMip(uint32_t page) const
+{
+	uint32_t mip = 0;
+	while (mip + 1 < mipCount && page >= mipOffsets[mip + 1])
+	{
+		mip++;
+	}
+	return mip;
+}
+
+VkDeviceSize VirtualTexture::getPageTableBytes() const
+{
+	return VkDeviceSize(pageCount) * TEXEL_SIZE;
+}
+
+void VirtualTexture::loaderLoop()
+{
+	CpuProfiler::setThreadName("Virtual texture");
+
+	// The file is opened once, each page is a seek and a read
+	std::ifstream file(tileFile, std::ios::binary);
+
+	while (true)
+	{
+		uint32_t page;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !requests.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			page = requests.front();
+			requests.erase(requests.begin());
+		}
+
+		// A failed read hands over no pixels, the main thread just forgets the request
+		LoadedPage result;
+		result.page = page;
+		if (!readPage(file, page, result.pixels))
+		{
+			printf("WARNING: Virtual texture failed to read page %u of %s\n", page, tileFile.c_str());
+			result.pixels.clear();
+			file.clear();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		loadedPages.push_back(std::move(result));
+	}
+}
+
+bool VirtualTexture::readPage(std::ifstream& file, uint32_t page, std::vector<unsigned char>& pixels) const
+{
+	PROFILE_SCOPE("Read virtual texture page");
+
+	pixels.resize(static_cast<size_t>(PAGE_BYTES));
+	file.seekg(static_cast<std::streamoff>(sizeof(TileFileHeader) + page * PAGE_BYTES));
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(pixels.data()), pixels.size()));
+}
+
+void VirtualTexture::record(VkCommandBuffer commandBuffer)
+{
+	FrameResources& frame = frameResources[currentSlot];
+
+	if (!pageCopies.empty())
+	{
+		vkCmdCopyBufferToImage(commandBuffer, frame.stagingBuffer, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(pageCopies.size()), pageCopies.data());
+	}
+
+	if (pageTableStaged)
+	{
+		VkDeviceSize pageTableOffset = MAX_PAGE_UPLOADS_PER_FRAME * PAGE_BYTES;
+		std::vector<VkBufferImageCopy> regions(mipCount);
+		for (uint32_t mip = 0; mip < mipCount; mip++)
+		{
+			regions[mip] = {};
+			regions[mip].bufferOffset = pageTableOffset + mipOffsets[mip] * TEXEL_SIZE;
+			regions[mip].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[mip].imageSubresource.mipLevel = mip;
+			regions[mip].imageSubresource.layerCount = 1;
+			regions[mip].imageExtent = { pagesPerSide >> mip, pagesPerSide >> mip, 1 };
+		}
+		vkCmdCopyBufferToImage(commandBuffer, frame.stagingBuffer, pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()), regions.data());
+	}
+}
+
+bool VirtualTexture::isLoaded() const
+{
+	return loaded;
+}
+
+VkDescriptorSetLayout VirtualTexture::getSetLayout() const
+{
+	return setLayout;
+}
+
+VkDescriptorSet VirtualTexture::getDescriptorSet() const
+{
+	return frameResources[currentSlot].descriptorSet;
+}
+
+void VirtualTexture::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	if (loader.joinable())
+	{
+		loader.join();
+	}
+	requests.clear();
+	loadedPages.clear();
+
+	// The sets go with the pool, the mapped buffers are unmapped with their memory
+	for (FrameResources& frame : frameResources)
+	{
+		vkDestroyBuffer(device, frame.feedbackBuffer, nullptr);
+		vkFreeMemory(device, frame.feedbackMemory, nullptr);
+		vkDestroyBuffer(device, frame.stagingBuffer, nullptr);
+		vkFreeMemory(device, frame.stagingMemory, nullptr);
+	}
+	frameResources.clear();
+
+	vkDestroyImageView(device, atlasView, nullptr);
+	vkDestroyImage(device, atlasImage, nullptr);
+	vkFreeMemory(device, atlasMemory, nullptr);
+	vkDestroyImageView(device, pageTableView, nullptr);
+	vkDestroyImage(device, pageTableImage, nullptr);
+	vkFreeMemory(device, pageTableMemory, nullptr);
+
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroySampler(device, pageTableSampler, nullptr);
+	vkDestroySampler(device, atlasSampler, nullptr);
+
+	device = VK_NULL_HANDLE;
+}
+
+VirtualTexture::~VirtualTexture()
+{
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RenderGraph.h"
+
+const uint32_t VIRTUAL_PAGE_SIZE = 128;					// Texels on a side of a page, without its border
+const uint32_t VIRTUAL_PAGE_BORDER = 4;					// Texels of the neighbouring pages around a page, so the bilinear filter never leaves it
+const uint32_t VIRTUAL_ATLAS_PAGES = 16;				// Pages on a side of the physical atlas, its memory never changes
+const uint32_t MAX_VIRTUAL_TEXTURE_SIZE = 8192;			// Side the source image is resampled to at most when the tiled file is built
+const uint32_t MAX_PAGE_UPLOADS_PER_FRAME = 8;			// Pages copied into the atlas a frame
+const uint32_t MAX_PENDING_PAGE_LOADS = 32;				// Pages queued for or on the loader thread
+const uint32_t VIRTUAL_PAGE_KEEP_FRAMES = 64;			// Frames a page the screen asked for can't be evicted, the feedback sees every pixel in that time
+
+/**
+ * @struct VirtualTextureResources
+ * @brief The virtual texture's resources in the render graph, the passes sampling it declare them.
+ */
+struct VirtualTextureResources
+{
+	RenderGraphResource pageTable = RENDER_GRAPH_INVALID;	///< Read as SAMPLED_FRAGMENT.
+	RenderGraphResource atlas = RENDER_GRAPH_INVALID;		///< Read as SAMPLED_FRAGMENT.
+	RenderGraphResource feedback = RENDER_GRAPH_INVALID;	///< Read and written as STORAGE_WRITE_GRAPHICS.
+};
+
+/**
+ * @class VirtualTexture
+ * @brief A texture far larger than the GPU holds, of which only the pages the screen needs are resident.
+ *
+ * The texture is split into pages of VIRTUAL_PAGE_SIZE texels at every mip, down to the mip that
+ * is a single page. They are stored with their borders in a tiled file next to the source image,
+ * built once and keyed by a checksum of the source, so a page is a single read. The resident pages
+ * live in a fixed grid of slots in the atlas image, the page table image (a texel per page, a mip
+ * per mip of the texture) tells the shaders which slot holds a page. A page that isn't resident
+ * points at its finest resident ancestor, the single page of the coarsest mip always is.
+ *
+ * No sparse binding is needed: the atlas and the page table are ordinary images. The material
+ * shaders write feedback, one pixel of every 8x8 block a frame flags the page it sampled. When a
+ * frame context comes around again its flags are read back, the missing pages (and their missing
+ * ancestors, coarsest first) are queued for the loader thread, and finished loads are copied into
+ * the slots of the pages seen longest ago. The copies and the page table's update are a pass of
+ * the render graph, recorded before the scene samples them.
+ *
+ * The texture covers a rectangle of the XZ plane, a material using it samples it by world position.
+ */
+class VirtualTexture
+{
+public:
+	VirtualTexture();
+
+	/**
+	 * @brief Declares the upload pass and imports the images and the feedback buffer.
+	 *
+	 * @param newGraph Graph the pass is added to, before it is compiled.
+	 * @return The resources the passes sampling the texture declare.
+	 */
+	VirtualTextureResources addPass(RenderGraph& newGraph);
+
+	/**
+	 * @brief Creates the set layout the scene pipelines use, the samplers and the descriptor pool.
+	 *
+	 * @param newPhysicalDevice The GPU.
+	 * @param newDevice The logical device.
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void create(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice);
+
+	/**
+	 * @brief Opens the tiled file of a texture, building it if needed, and starts the loader thread. Called once.
+	 *
+	 * @param sourceFile Image in the Textures folder, empty for none (the images are then 1x1 placeholders).
+	 * @param frameCount Frame contexts, each has its own feedback and staging buffer and descriptor set.
+	 * @param queue Queue the first upload is submitted to.
+	 * @param commandPool Pool of its command buffer.
+	 * @throws std::runtime_error if the image can't be loaded, the tiled file can't be written, or a Vulkan object can't be created.
+	 */
+	void load(const std::string& sourceFile, uint32_t frameCount, VkQueue queue, VkCommandPool commandPool);
+
+	/**
+	 * @brief Sets the rectangle of the XZ plane the texture is stretched over.
+	 *
+	 * @param origin World X and Z of the texture's first texel.
+	 * @param size Extent of the rectangle along X and Z.
+	 */
+	void setArea(glm::vec2 origin, glm::vec2 size);
+
+	/**
+	 * @brief Reads the feedback the frame context's last frame wrote, queues loads and stages the finished ones.
+	 *
+	 * Called once the context's fence is waited on, its feedback buffer is then reset for the new frame.
+	 *
+	 * @param frameSlot Index of the frame context.
+	 * @param frameNumber Number of the frame being recorded.
+	 */
+	void prepareFrame(uint32_t frameSlot, uint32_t frameNumber);
+
+	bool isLoaded() const;
+
+	// Set 3 of the scene pipelines: the page table (binding 0), the atlas (binding 1), the feedback (binding 2)
+	VkDescriptorSetLayout getSetLayout() const;
+	VkDescriptorSet getDescriptorSet() const;		// Of the frame being recorded
+
+	void destroy();
+
+	~VirtualTexture();
+
+private:
+	// Laid out as VirtualTextureFeedback in the shaders (std430), followed by a flag per page
+	struct FeedbackHeader
+	{
+		glm::vec4 area;					// World XZ of the first texel, 1 / extent of the area
+		uint32_t feedbackPixel;			// The pixel of every 8x8 block that writes this frame
+		uint32_t mipCount;
+		uint32_t pagesPerSide;			// At mip 0
+		uint32_t padding;
+	};
+
+	// Per frame context, persistently mapped
+	struct FrameResources
+	{
+		VkBuffer feedbackBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory feedbackMemory = VK_NULL_HANDLE;
+		FeedbackHeader* feedback = nullptr;
+		uint32_t* requestedPages = nullptr;
+
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;	// The pages uploaded this frame, then the page table
+		VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+		unsigned char* staging = nullptr;
+
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+
+	struct Page
+	{
+		uint32_t slot = UINT32_MAX;		// In the atlas, UINT32_MAX if not resident
+		uint32_t lastUsed = 0;			// Frame the feedback last flagged the page or a descendant
+		bool used = false;				// Flagged at least once
+		bool pending = false;			// Queued for or on the loader thread
+	};
+
+	// A page as the loader thread hands it over
+	struct LoadedPage
+	{
+		uint32_t page;
+		std::vector<unsigned char> pixels;
+	};
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	RenderGraph* graph = nullptr;
+	VirtualTextureResources resources;
+
+	VkSampler pageTableSampler = VK_NULL_HANDLE;		// Nearest, the entries are fetched
+	VkSampler atlasSampler = VK_NULL_HANDLE;			// Bilinear, the borders keep it inside a page
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+	// -- IMAGES --
+	VkImage atlasImage = VK_NULL_HANDLE;
+	VkDeviceMemory atlasMemory = VK_NULL_HANDLE;
+	VkImageView atlasView = VK_NULL_HANDLE;
+	VkExtent2D atlasExtent = {};
+	VkImage pageTableImage = VK_NULL_HANDLE;
+	VkDeviceMemory pageTableMemory = VK_NULL_HANDLE;
+	VkImageView pageTableView = VK_NULL_HANDLE;
+
+	// -- LAYOUT --
+	std::string tileFile;
+	uint32_t virtualSize = 0;
+	uint32_t mipCount = 1;
+	uint32_t pagesPerSide = 1;					// At mip 0
+	std::vector<uint32_t> mipOffsets;			// First page of every mip, pages are stored mip after mip, row by row
+	uint32_t pageCount = 1;
+	glm::vec4 area = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	bool loaded = false;
+
+	// -- RESIDENCY (MAIN THREAD) --
+	std::vector<Page> pages;
+	std::vector<uint32_t> slotPages;			// Page held by every atlas slot, UINT32_MAX if free
+	std::vector<FrameResources> frameResources;
+	uint32_t currentSlot = 0;
+	std::vector<VkBufferImageCopy> pageCopies;	// Recorded by the upload pass this frame
+	bool pageTableDirty = false;
+	bool pageTableStaged = false;
+
+	// -- LOADER THREAD --
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<uint32_t> requests;				// Pages to load, the first one first
+	std::vector<LoadedPage> loadedPages;		// Finished loads, waiting for the main thread
+	uint32_t pendingLoads = 0;
+	bool stopping = false;
+
+	// Builds the tiled file from the source image if it is missing or was built from another image
+	void prepareTileFile(const std::string& sourceFile);
+	bool checkTileFile(uint64_t sourceChecksum);
+	void buildTileFile(const std::vector<char>& source, uint64_t sourceChecksum);
+	void computePageLayout(uint32_t size);
+
+	void createImages(uint32_t atlasSize, uint32_t pageTableSize, uint32_t pageTableMips);
+	void createFrameResources(uint32_t frameCount);
+	void uploadFirstPage(VkQueue queue, VkCommandPool commandPool);
+
+	void readFeedback(FrameResources& frame, uint32_t frameNumber);
+	void queueLoads(uint32_t frameNumber);
+	void stageLoadedPages(FrameResources& frame, uint32_t frameNumber);
+	uint32_t findSlot(uint32_t frameNumber);
+	void writePageTable(unsigned char* target) const;
+
+	uint32_t getPageIndex(uint32_t mip, uint32_t x, uint32_t y) const;
+	uint32_t getParentPage(uint32_t page) const;
+	uint32_t getPageMip(uint32_t page) const;
+	VkDeviceSize getPageTableBytes() const;
+
+	void loaderLoop();
+	bool readPage(std::ifstream& file, uint32_t page, std::vector<unsigned char>& pixels) const;
+
+	void record(VkCommandBuffer commandBuffer);
+};
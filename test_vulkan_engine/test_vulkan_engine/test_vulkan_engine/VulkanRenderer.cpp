@@ -27,27 +27,34 @@ int VulkanRenderer::init(GLFWwindow* newWindow, Camera* newCamera)
 		getPhysicalDevice();        ///< Select a suitable GPU.
 		createLogicalDevice();      ///< Create the Vulkan logical device.
 		createSwapChain();          ///< Create the swapchain for frame buffering.
-		createRenderPass();         ///< Define framebuffer attachments and rendering behavior.
+		buildRenderGraph();         ///< Declare the passes, create their render passes and attachments.
+		createTextureSampler();     ///< Create the texture sampler, the material library's sets use it.
 		createDescriptorSetLayout(); ///< Define descriptor layouts for shader resources.
 		createPushConstantRange();  ///< Create push constants for fast shader updates.
+		createPipelineCache();      ///< Load the pipeline cache saved by the previous run.
 		createGraphicsPipeline();   ///< Build the rendering pipeline.
-		createDepthBufferImage();   ///< Set up depth testing for 3D rendering.
-		createFramebuffers();       ///< Create framebuffers for each swapchain image.
-		createCommandPool();        ///< Create the command pool for rendering.
-		createCommandBuffers();     ///< Allocate and record command buffers.
-		createTextureSampler();     ///< Create a texture sampler for image filtering.
+		createShaderHotReload();    ///< Watch the shader sources for changes.
+		createCommandPool();        ///< Create the command pool for transfers.
+		createEnvironmentLighting(); ///< Irradiance and prefiltered reflections of the environment.
+		createTemporalHistory();    ///< Create the TAA history images.
+		createAmbientOcclusion();   ///< SSAO layouts and accumulation images.
+		createSkinning();           ///< Animation workers, skinning layouts and output buffer.
+		createParticles();          ///< Particle pool, layouts and draw pipeline.
+		createPostProcessing();     ///< Bloom, exposure and tonemap pipelines, the adapted luminance image.
+		createFrameContexts();      ///< Command buffers, uniform rings and descriptor pools per frame in flight.
+		createTextureStreaming();   ///< Texture feedback buffers and the texture memory budget.
+		createVirtualTexture();     ///< Tiled file, page table and atlas of the virtual texture.
+		createGpuProfiler();        ///< Create the timestamp and statistics query pools.
 
 		// Shader resource allocation
 		// allocateDynamicBufferTransferSpace(); ///< Uncomment if using dynamic UBOs.
-		createUniformBuffers();      ///< Allocate buffers for transformation matrices.
-		createDescriptorPool();      ///< Create a descriptor pool for resource binding.
-		createDescriptorSets();      ///< Allocate descriptor sets for uniform buffers.
 
 		// Synchronization setup
-		createSynchronisation();     ///< Set up semaphores and fences.
+		createSynchronisation();     ///< Set up the per image semaphores and fences.
 
 		// Load default texture
-		createTexture("plain.png");  ///< Load a default texture for untextured models.
+		createDefaultMaterial();     ///< Load a default texture and material for untextured models.
+		createTerrain();             ///< Heightmap, quadtree and material of the terrain.
 	}
 	catch (const std::runtime_error& e) {
 		printf("ERROR: %s\n", e.what()); ///< Print error message on failure.
@@ -209,42 +216,65 @@ void VulkanRenderer::setupDebugMessenger() {
 }
 
 
+/**
+ * @brief Gives an entity the light parameters of a spotlight source.
+ *
+ * @param entity The entity that can act as a light source.
+ */
+void VulkanRenderer::addLightSource(Entity entity)
+{
+	registry.addComponents(entity, LIGHT_BIT);
+}
+
 /**
  * @brief Configures lighting parameters for the scene.
  *
  * This function sets up ambient lighting and spotlight properties.
- * The spotlight is positioned based on a model's location and direction.
+ * The spotlight goes to the light source nearest to the viewer, positioned at its location
+ * and pointing along its direction.
  *
- * @param source The model ID used as the light source.
+ * @param viewPosition Position of the viewer in world space.
  */
-void VulkanRenderer::setLighting(int source)
+void VulkanRenderer::setLighting(glm::vec3 viewPosition)
 {
-	// Set ambient lighting color and intensity
+	// Environment lighting tint and intensity, the uniform white stand-in is as dim as the old constant ambient
 	uboLighting.ambiantLightColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	uboLighting.ambiantStr = 0.2f;
+	uboLighting.ambiantStr = environmentFile.empty() ? 0.2f : 1.0f;
+
+	// Light assignment through the BVH (the bounds of the last drawn frame), the light source needs a
+	// transform to be placed in the scene. Until the first frame built the tree the old source is kept
+	Entity nearestSource = findNearestEntity(viewPosition, FLT_MAX, INVALID_ENTITY, TRANSFORM_BIT | LIGHT_BIT);
+	if (nearestSource != INVALID_ENTITY)
+	{
+		lightSource = nearestSource;
+	}
+
+	TransformComponent* transform = registry.getComponent<TransformComponent>(lightSource);
+	LightComponent* light = registry.getComponent<LightComponent>(lightSource);
+	if (transform == nullptr || light == nullptr)
+	{
+		return;
+	}
 
-	// Get the model's position and direction for the spotlight
-	glm::vec3 flashlightDirection = getMeshModel(source)->getDirection();
-	float offset = 1.0f;
-	glm::vec3 flashlightFront = getMeshModel(source)->getPosition() + flashlightDirection * offset;
-	glm::vec3 flashlightPosition = getMeshModel(source)->getPosition();
+	// Get the entity's position and direction for the spotlight
+	glm::vec3 flashlightDirection = getTransformDirection(*transform);
+	glm::vec3 flashlightPosition = transform->position;
 
-	// Adjust position to match Vulkan's coordinate system
-	flashlightPosition = glm::vec3(flashlightPosition.z, flashlightPosition.x, flashlightPosition.y);
+	// What the light points at, the beam stops on its surface
+	lightTargetDistance = FLT_MAX;
+	pickEntity(flashlightPosition, flashlightDirection, lightSource, &lightTargetDistance);
 
 	// Set spotlight position and direction
-	uboLighting.spotlight[0].lightPosition = glm::vec4(flashlightPosition, 0.0f);
+	uboLighting.spotlight[0].lightPosition = flashlightPosition;
 	uboLighting.spotlight[0].lightDirection = flashlightDirection;
 
-	// Configure spotlight properties
-	uboLighting.spotlight[0].lightColor = glm::vec3(0.5f, 0.5f, 0.5f);
-	uboLighting.spotlight[0].diffuseStr = 0.8f;
-	uboLighting.spotlight[0].specularStr = 0.8f;
-	uboLighting.spotlight[0].shininess = 12.0f;
+	// Configure spotlight properties, the surface response comes from the materials
+	uboLighting.spotlight[0].lightColor = light->color;
+	uboLighting.spotlight[0].intensity = light->intensity;
 
 	// Spotlight cutoff angles
-	uboLighting.spotlight[0].innerCutOff = glm::cos(glm::radians(15.0f));
-	uboLighting.spotlight[0].outerCutOff = glm::cos(glm::radians(25.0f));
+	uboLighting.spotlight[0].innerCutOff = light->innerCutOff;
+	uboLighting.spotlight[0].outerCutOff = light->outerCutOff;
 }
 
 /**
@@ -252,24 +282,93 @@ void VulkanRenderer::setLighting(int source)
  *
  * This function modifies the transformation of a model by updating its model matrix.
  *
- * @param modelId The ID of the model to update.
+ * @param entity The entity to update.
  * @param newModel The new transformation matrix for the model.
  */
-void VulkanRenderer::updateModel(int modelId, glm::mat4 newModel)
+void VulkanRenderer::updateModel(Entity entity, glm::mat4 newModel)
 {
-	if (modelId >= modelList.size()) return;
+	TransformComponent* transform = registry.getComponent<TransformComponent>(entity);
+	if (transform == nullptr) return;
 
-	modelList[modelId].setModel(newModel);
+	transform->model = newModel;
+}
+
+/**
+ * @brief Runs the per-frame controller system.
+ *
+ * Only the transform and controller arrays of the controllable entities are touched.
+ *
+ * @param keys A boolean array representing the state of keys.
+ * @param deltaTime The time elapsed since the last frame.
+ */
+void VulkanRenderer::updateControllers(bool* keys, float deltaTime)
+{
+	PROFILE_FUNCTION();
+
+	updateControllerSystem(registry, keys, deltaTime);
+}
+
+/**
+ * @brief Advances the animated entities' clips and poses their skeletons for this frame.
+ *
+ * @param deltaTime The time elapsed since the last frame.
+ */
+void VulkanRenderer::updateAnimations(float deltaTime)
+{
+	PROFILE_FUNCTION();
+
+	animationSystem.update(registry, modelList, deltaTime);
+}
+
+/**
+ * @brief Starts a clip of an animated entity's model, crossfading from the current one.
+ *
+ * @param entity The entity.
+ * @param clip Index of the clip in the model.
+ * @param fadeDuration Length of the crossfade in seconds.
+ */
+void VulkanRenderer::playAnimation(Entity entity, uint32_t clip, float fadeDuration)
+{
+	AnimationComponent* animation = registry.getComponent<AnimationComponent>(entity);
+	if (animation == nullptr) return;
+
+	::playAnimation(*animation, clip, fadeDuration);
+}
+
+namespace
+{
+	// Radical inverse of index in the given base, low discrepancy sub-pixel offsets in [0, 1)
+	float halton(uint32_t index, uint32_t base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f / base;
+		while (index > 0)
+		{
+			result += fraction * (index % base);
+			index /= base;
+			fraction /= base;
+		}
+		return result;
+	}
+
+	// Jitter sequence length, long enough to cover the pixel evenly, short enough to converge fast
+	const uint32_t TAA_JITTER_PHASES = 8;
 }
 
 /**
  * @brief Updates the camera's view and projection matrices.
  *
  * This function recalculates the camera's view and projection matrices and updates
- * the uniform buffer for rendering.
+ * the uniform buffer for rendering. It also picks the render scale of the frame from the
+ * latest GPU frame time and jitters the projection by a sub-pixel offset of the rendered
+ * area, so the TAA pass gets a new set of samples of every pixel each frame.
  */
 void VulkanRenderer::updateView()
 {
+	// -- RENDER RESOLUTION --
+	dynamicResolution.update(gpuProfiler.getFrameTimeMs());
+	renderExtent = dynamicResolution.getRenderExtent(swapChainExtent);
+
 	glm::vec3 cameraPosition = this->camera->getPosition();
 	glm::vec3 cameraTarget = this->camera->getPosition() + this->camera->getFront();
 	glm::vec3 upDirection = this->camera->getUp();
@@ -287,6 +386,22 @@ void VulkanRenderer::updateView()
 
 	// Flip Y-axis for Vulkan coordinate system
 	uboViewProjection.projection[1][1] *= -1;
+
+	// -- MOTION VECTORS --
+	// The previous frame is the last one submitted, frames skipped (minimized, out of date) don't count
+	uboViewProjection.previousViewProjection = submittedViewProjection;
+	uboViewProjection.viewProjection = uboViewProjection.projection * uboViewProjection.view;
+
+	// -- JITTER --
+	// Offset in [-0.5, 0.5) pixels of the rendered area, applied in NDC after the projection
+	uint32_t phase = frameNumber % TAA_JITTER_PHASES + 1;
+	jitter = glm::vec2(halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f);
+	glm::vec2 jitterNdc = jitter * 2.0f / glm::vec2(static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height));
+	uboViewProjection.projection = glm::translate(glm::mat4(1.0f), glm::vec3(jitterNdc, 0.0f)) * uboViewProjection.projection;
+
+	// The lighting linearizes the depth for the ambient occlusion's upsample, the jitter doesn't change it
+	uboLighting.depthParams = glm::vec2(uboViewProjection.projection[2][2], uboViewProjection.projection[3][2]);
+	uboLighting.ambientOcclusionStrength = ambientOcclusion.getSettings().strength;
 }
 
 
@@ -299,46 +414,111 @@ void VulkanRenderer::updateView()
  */
 void VulkanRenderer::draw()
 {
-	// -- GET NEXT IMAGE --
-	// Wait for the previous frame to finish rendering before continuing
-	vkWaitForFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
-	// Reset the fence for the next frame
-	vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]);
-
-	// Acquire the next image from the swapchain
-	uint32_t imageIndex;
-	vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(),
-		imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	PROFILE_FUNCTION();
 
-	// Record and update command buffer for this image
-	recordCommands(imageIndex);
-	updateUniformBuffers(imageIndex);
+	// Nothing to render into while minimized
+	if (isMinimized())
+	{
+		return;
+	}
 
-	// -- SUBMIT COMMAND BUFFER TO RENDER --
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	// Resized window or out of date present in the last frame
+	if (swapChainOutOfDate)
+	{
+		recreateSwapChain();
+	}
 
-	// Wait for the swapchain image to be available before rendering
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &imageAvailable[currentFrame];
+	// -- GET NEXT IMAGE --
+	// Note the other contexts that finished already, for the latency estimate
+	for (uint32_t i = 0; i < frames.size(); i++)
+	{
+		if (i != currentFrame)
+		{
+			framePacer.pollFence(mainDevice.logicalDevice, frames[i].inFlightFence, i);
+		}
+	}
 
-	// Wait at the color output stage before rendering
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.pWaitDstStageMask = waitStages;
+	// Wait until the GPU finished the last frame recorded with this context
+	FrameContext& frame = frames[currentFrame];
+	{
+		PROFILE_SCOPE("Wait for frame fence");
+		framePacer.waitForFence(mainDevice.logicalDevice, frame.inFlightFence, currentFrame);
+	}
 
-	// Submit the command buffer for this frame
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+	// Acquire the next image from the swapchain
+	uint32_t imageIndex;
+	VkResult result;
+	{
+		PROFILE_SCOPE("Acquire swapchain image");
+		result = vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(),
+			frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+	}
 
-	// Signal the semaphore when rendering is finished
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &renderFinished[currentFrame];
+	// Out of date: no image was acquired, the fence is still signalled so the frame can simply be retried.
+	// Suboptimal still gives an image, it is drawn and the swapchain is recreated after presenting it
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		recreateSwapChain();
+		return;
+	}
+	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	{
+		throw std::runtime_error("Failed to acquire a Swapchain Image!");
+	}
 
-	// Submit the command buffer to the graphics queue
-	VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, drawFences[currentFrame]);
-	if (result != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit Command Buffer to Queue!");
+	// Images come back in any order, an older frame may still be rendering into this one
+	if (imagesInFlight[imageIndex] != VK_NULL_HANDLE && imagesInFlight[imageIndex] != frame.inFlightFence)
+	{
+		PROFILE_SCOPE("Wait for image fence");
+		vkWaitForFences(mainDevice.logicalDevice, 1, &imagesInFlight[imageIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	}
+	imagesInFlight[imageIndex] = frame.inFlightFence;
+
+	// The context's previous frame is finished, its pools and uniform ring can be reused
+	frame.begin();
+	destroyRetiredModels();
+
+	// The feedback this context's last frame wrote decides which texture mips are streamed in or dropped
+	textureStreamer.update(currentFrame, frameNumber, framesInFlight);
+	virtualTexture.prepareFrame(currentFrame, frameNumber);
+	materialLibrary.releaseRetiredSets(frameNumber);
+
+	// Cull the scene and write the uniforms the passes bind
+	updateSceneVisibility();
+	terrain.prepareFrame(frame, uboViewProjection.projection * uboViewProjection.view, glm::vec3(glm::inverse(uboViewProjection.view)[3]));
+	gpuSkinning.prepareFrame(frame, registry, modelList, visibleEntities, animationSystem.getPalette());
+	updateParticleEmitters();
+	particleSystem.prepareFrame(frame, uboViewProjection.projection * uboViewProjection.view, uboViewProjection.view, renderExtent);
+	ambientOcclusion.prepareFrame(frame, uboViewProjection.projection, uboViewProjection.view,
+		uboViewProjection.previousViewProjection, renderExtent);
+	frameUniformSet = updateUniformBuffers(frame);
+	taaSet = updateTemporalDescriptors(frame);
+	if (renderPath == RENDER_PATH_DEFERRED)
+	{
+		updateDeferredDescriptors(frame);
+	}
+	postProcessing.prepareFrame(frame);
+
+	// -- RECORD AND SUBMIT THE RENDER GRAPH --
+	// The first access of the swapchain image waits for the acquire, the last submission
+	// signals the image's semaphore for the present and the frame's fence
+	renderGraph.setImportedImage(backbufferResource, swapChainImages[imageIndex].image, swapChainImages[imageIndex].imageView,
+		swapChainExtent, frame.imageAvailable);
+	renderGraph.setImportedImage(historyResource, historyImages[historyIndex ^ 1], historyImageViews[historyIndex ^ 1], swapChainExtent, VK_NULL_HANDLE);
+	renderGraph.setImportedImage(historyOutputResource, historyImages[historyIndex], historyImageViews[historyIndex], swapChainExtent, VK_NULL_HANDLE);
+	renderGraph.setImportedBuffer(textureFeedbackResource, textureStreamer.getFeedbackBuffer(currentFrame));
+	{
+		PROFILE_SCOPE("Record and submit");
+		renderGraph.execute(frame, currentFrame, renderFinished[imageIndex], frame.inFlightFence);
 	}
+	framePacer.frameSubmitted(currentFrame);
+
+	// The history written this frame is read by the next one, the transforms drawn become the previous ones
+	historyIndex ^= 1;
+	historyValid = true;
+	frameNumber++;
+	submittedViewProjection = uboViewProjection.viewProjection;
+	storePreviousTransforms(registry);
 
 	// -- PRESENT RENDERED IMAGE TO SCREEN --
 	VkPresentInfoKHR presentInfo = {};
@@ -346,7 +526,7 @@ void VulkanRenderer::draw()
 
 	// Wait for the rendering to be finished before presenting
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &renderFinished[currentFrame];
+	presentInfo.pWaitSemaphores = &renderFinished[imageIndex];
 
 	// Specify the swapchain and image index to present
 	presentInfo.swapchainCount = 1;
@@ -354,13 +534,220 @@ void VulkanRenderer::draw()
 	presentInfo.pImageIndices = &imageIndex;
 
 	// Present the image to the screen
-	result = vkQueuePresentKHR(presentationQueue, &presentInfo);
-	if (result != VK_SUCCESS) {
+	{
+		PROFILE_SCOPE("Queue present");
+		result = vkQueuePresentKHR(presentationQueue, &presentInfo);
+	}
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+		swapChainOutOfDate = true;
+	}
+	else if (result != VK_SUCCESS) {
 		throw std::runtime_error("Failed to present Image!");
 	}
 
-	// Move to the next frame (looping back if necessary)
-	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+	// Move to the next frame context (looping back if necessary)
+	currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void VulkanRenderer::notifyWindowResized()
+{
+	swapChainOutOfDate = true;
+}
+
+void VulkanRenderer::setFramesInFlight(uint32_t count)
+{
+	framesInFlight = std::max(1u, std::min(count, MAX_FRAMES_IN_FLIGHT));
+}
+
+void VulkanRenderer::setMsaaSamples(uint32_t samples)
+{
+	requestedMsaaSamples = std::max(1u, std::min(samples, 8u));
+}
+
+void VulkanRenderer::setRenderPath(RenderPath path)
+{
+	renderPath = path;
+}
+
+int VulkanRenderer::addPointLight(glm::vec3 position, glm::vec3 colour, float intensity, float radius)
+{
+	if (pointLights.size() >= MAX_POINT_LIGHTS)
+	{
+		return -1;
+	}
+
+	PointLight light;
+	light.positionRadius = glm::vec4(position, std::max(radius, 0.001f));
+	light.colourIntensity = glm::vec4(colour, intensity);
+	pointLights.push_back(light);
+	return static_cast<int>(pointLights.size()) - 1;
+}
+
+const char* VulkanRenderer::getRenderPathName(RenderPath path)
+{
+	switch (path)
+	{
+	case RENDER_PATH_FORWARD: return "forward";
+	case RENDER_PATH_DEFERRED: return "deferred";
+	default: return "unknown";
+	}
+}
+
+void VulkanRenderer::setDynamicResolutionTarget(double framesPerSecond)
+{
+	dynamicResolutionTarget = std::max(0.0, framesPerSecond);
+}
+
+void VulkanRenderer::setEnvironmentMap(const std::string& fileName)
+{
+	environmentFile = fileName;
+}
+
+void VulkanRenderer::setVirtualTexture(const std::string& fileName)
+{
+	virtualTextureFile = fileName;
+}
+
+void VulkanRenderer::setTerrain(const std::string& fileName, const TerrainSettings& settings)
+{
+	terrainFile = fileName;
+	terrainSettings = settings;
+}
+
+bool VulkanRenderer::getTerrainHeight(float x, float z, float* outHeight) const
+{
+	return terrain.getHeight(x, z, outHeight);
+}
+
+void VulkanRenderer::setParticleCapacity(uint32_t count)
+{
+	particleCapacity = count;
+}
+
+uint32_t VulkanRenderer::addParticleEmitter(const ParticleEmitterDesc& desc, Entity attachedEntity)
+{
+	uint32_t emitter = particleSystem.addEmitter(desc);
+	if (attachedEntity != INVALID_ENTITY)
+	{
+		particleAttachments.push_back({ emitter, attachedEntity, desc.position, desc.length });
+	}
+	return emitter;
+}
+
+void VulkanRenderer::setTextureBudget(VkDeviceSize bytes)
+{
+	textureBudget = bytes;
+}
+
+void VulkanRenderer::setPresentMode(PresentMode mode)
+{
+	framePacer.setPresentMode(mode);
+
+	// Before init there is no swapchain yet, createSwapChain() picks the mode up
+	if (swapchain != VK_NULL_HANDLE)
+	{
+		swapChainOutOfDate = true;
+	}
+}
+
+bool VulkanRenderer::isMinimized() const
+{
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	return width == 0 || height == 0;
+}
+
+/**
+ * @brief Rebuilds the pipelines whose shaders were recompiled since the last call.
+ *
+ * The device is idled only when something changed, so the old pipelines can be destroyed
+ * right away. Models, textures and every other resource stay as they are.
+ */
+void VulkanRenderer::reloadChangedShaders()
+{
+	PROFILE_FUNCTION();
+
+	std::vector<std::string> changedFiles = shaderHotReloader.poll();
+	if (changedFiles.empty())
+	{
+		return;
+	}
+
+	// Only the pipelines using one of the recompiled files
+	std::vector<size_t> affected;
+	std::vector<GraphicsPipelineDesc> affectedDescs;
+	for (size_t i = 0; i < pipelineDescs.size(); i++)
+	{
+		for (const auto& file : changedFiles)
+		{
+			if (pipelineDescs[i].vertexShader == file || pipelineDescs[i].fragmentShader == file)
+			{
+				affected.push_back(i);
+				affectedDescs.push_back(pipelineDescs[i]);
+				break;
+			}
+		}
+	}
+
+	std::vector<size_t> affectedCompute;
+	std::vector<ComputePipelineDesc> affectedComputeDescs;
+	for (size_t i = 0; i < computePipelineDescs.size(); i++)
+	{
+		if (std::find(changedFiles.begin(), changedFiles.end(), computePipelineDescs[i].computeShader) != changedFiles.end())
+		{
+			affectedCompute.push_back(i);
+			affectedComputeDescs.push_back(computePipelineDescs[i]);
+		}
+	}
+
+	if (affected.empty() && affectedCompute.empty())
+	{
+		return;
+	}
+
+	std::vector<VkPipeline> newPipelines;
+	std::vector<VkPipeline> newComputePipelines;
+	try {
+		if (!affected.empty())
+		{
+			newPipelines = pipelineManager.createGraphicsPipelines(affectedDescs);
+		}
+		if (!affectedCompute.empty())
+		{
+			newComputePipelines = pipelineManager.createComputePipelines(affectedComputeDescs);
+		}
+	}
+	catch (const std::runtime_error& e) {
+		printf("Shader hot reload: %s Keeping the old pipelines\n", e.what());
+		// Whichever batch already succeeded is never swapped in
+		for (auto pipeline : newPipelines)
+		{
+			vkDestroyPipeline(mainDevice.logicalDevice, pipeline, nullptr);
+		}
+		for (auto pipeline : newComputePipelines)
+		{
+			vkDestroyPipeline(mainDevice.logicalDevice, pipeline, nullptr);
+		}
+		return;
+	}
+
+	// The old pipelines may still be used by frames in flight
+	vkDeviceWaitIdle(mainDevice.logicalDevice);
+	for (size_t i = 0; i < affected.size(); i++)
+	{
+		VkPipeline* handle = pipelineHandles[affected[i]];
+		vkDestroyPipeline(mainDevice.logicalDevice, *handle, nullptr);
+		*handle = newPipelines[i];
+	}
+	for (size_t i = 0; i < affectedCompute.size(); i++)
+	{
+		VkPipeline* handle = computePipelineHandles[affectedCompute[i]];
+		vkDestroyPipeline(mainDevice.logicalDevice, *handle, nullptr);
+		*handle = newComputePipelines[i];
+	}
+
+	// Command buffers are recorded every frame, the next one binds the new pipelines
+	printf("Shader hot reload: rebuilt %zu pipeline(s)\n", affected.size() + affectedCompute.size());
 }
 
 /**
@@ -382,61 +769,85 @@ void VulkanRenderer::cleanup()
 	// Free memory for model transfer space (if used)
 	//_aligned_free(modelTransferSpace);
 
-	// Destroy all loaded models
+	// Stop loading the world's cells, the models of the resident ones go with the rest
+	worldStreamer.destroy();
+
+	// Destroy all loaded models and the entities referencing them, retired ones included
 	for (size_t i = 0; i < modelList.size(); i++) {
 		modelList[i].destroyMeshModel();
 	}
+	registry.clear();
+	sceneBVH.clear();
+	sceneCuller.clear();
 
-	// Destroy texture samplers and descriptor layouts
-	vkDestroyDescriptorPool(mainDevice.logicalDevice, samplerDescriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, samplerSetLayout, nullptr);
-	vkDestroySampler(mainDevice.logicalDevice, textureSampler, nullptr);
+	// Destroy the profiler's query pools
+	gpuProfiler.destroy();
 
-	// Destroy texture images and their associated memory
-	for (size_t i = 0; i < textureImages.size(); i++) {
-		vkDestroyImageView(mainDevice.logicalDevice, textureImageViews[i], nullptr);
-		vkDestroyImage(mainDevice.logicalDevice, textureImages[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, textureImageMemory[i], nullptr);
-	}
+	// Destroy the materials and the texture sampler
+	materialLibrary.destroy();
+	environmentLighting.destroy();
+	virtualTexture.destroy();
+	vkDestroySampler(mainDevice.logicalDevice, textureSampler, nullptr);
 
-	// Destroy depth buffer resources
-	vkDestroyImageView(mainDevice.logicalDevice, depthBufferImageView, nullptr);
-	vkDestroyImage(mainDevice.logicalDevice, depthBufferImage, nullptr);
-	vkFreeMemory(mainDevice.logicalDevice, depthBufferImageMemory, nullptr);
+	// Destroy texture images, replaced ones included, and the feedback buffers
+	textureStreamer.destroy();
 
-	// Destroy descriptor pools and layouts
-	vkDestroyDescriptorPool(mainDevice.logicalDevice, descriptorPool, nullptr);
+	// Destroy descriptor layouts
 	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, descriptorSetLayout, nullptr);
 
-	// Destroy uniform buffers and free allocated memory
-	for (size_t i = 0; i < swapChainImages.size(); i++) {
-		vkDestroyBuffer(mainDevice.logicalDevice, vpUniformBuffer[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, vpUniformBufferMemory[i], nullptr);
-		vkDestroyBuffer(mainDevice.logicalDevice, lightingUniformBuffer[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, lightingUniformBufferMemory[i], nullptr);
-		// vkDestroyBuffer(mainDevice.logicalDevice, modelDUniformBuffer[i], nullptr);
-		// vkFreeMemory(mainDevice.logicalDevice, modelDUniformBufferMemory[i], nullptr);
+	// Destroy the frame contexts (command pools, uniform rings, descriptor pools, fences)
+	for (auto& frame : frames) {
+		frame.destroy();
 	}
+	frames.clear();
 
-	// Destroy synchronization objects (semaphores and fences)
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++) {
-		vkDestroySemaphore(mainDevice.logicalDevice, renderFinished[i], nullptr);
-		vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], nullptr);
-		vkDestroyFence(mainDevice.logicalDevice, drawFences[i], nullptr);
-	}
+	// Destroy the per image semaphores
+	destroySynchronisation();
 
 	// Destroy command pool
 	vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, nullptr);
 
-	// Destroy framebuffers
-	for (auto framebuffer : swapChainFramebuffers) {
-		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
-	}
+	shaderHotReloader.destroy();
 
-	// Destroy pipeline and render pass
+	// The terrain owns its pipelines and layouts, its set layout is set 4 of them
+	terrain.destroy();
+
+	// Destroy pipeline, the pipeline cache is saved for the next run
 	vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, taaPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, gbufferPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, deferredLightingPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, lightCullingPipeline, nullptr);
+	vkDestroyPipeline(mainDevice.logicalDevice, depthPrepassPipeline, nullptr);
+	pipelineManager.destroy();
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, nullptr);
-	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, taaPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, deferredPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(mainDevice.logicalDevice, lightCullingPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, deferredSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, lightCullingSetLayout, nullptr);
+
+	// Destroy the TAA history and the full screen passes' sampler and layout
+	destroyTemporalHistory();
+	vkDestroySampler(mainDevice.logicalDevice, postSampler, nullptr);
+	vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, taaSetLayout, nullptr);
+
+	// Destroy the bloom, exposure and tonemap pipelines and the adapted luminance
+	postProcessing.destroy();
+
+	// Destroy the ambient occlusion's pipelines and accumulation images
+	ambientOcclusion.destroy();
+
+	// Destroy the particles' pipelines and pool
+	particleSystem.destroy();
+	particleAttachments.clear();
+
+	// Stop the animation workers, destroy the skinning pipeline and output buffer
+	animationSystem.destroy();
+	gpuSkinning.destroy();
+
+	// Destroy the render passes, framebuffers, attachments and timeline semaphores of the graph
+	renderGraph.destroy();
 
 	// Destroy swapchain images and associated views
 	for (auto image : swapChainImages) {
@@ -480,7 +891,12 @@ void VulkanRenderer::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";              // No custom engine
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;        // Vulkan version
+
+	// 1.2 for timeline semaphores (used to order the async compute queue), if the loader has it
+	instanceApiVersion = VK_API_VERSION_1_0;
+	vkEnumerateInstanceVersion(&instanceApiVersion);
+	instanceApiVersion = std::min(instanceApiVersion, static_cast<uint32_t>(VK_API_VERSION_1_2));
+	appInfo.apiVersion = instanceApiVersion;        // Vulkan version
 
 	// Create instance creation information
 	VkInstanceCreateInfo createInfo = {};
@@ -574,16 +990,46 @@ void VulkanRenderer::createLogicalDevice()
 	// Set of unique queue families required
 	std::set<int> queueFamilyIndices = { indices.graphicsFamily, indices.presentationFamily };
 
+	// Timeline semaphores (core in 1.2) order the async compute queue against the graphics queue
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	if (instanceApiVersion >= VK_API_VERSION_1_2 && deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceFeatures2 features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &features2);
+	}
+	timelineSemaphoresEnabled = timelineFeatures.timelineSemaphore == VK_TRUE;
+
+	// Async compute passes run on a dedicated compute family (its own hardware queue) if there is one,
+	// otherwise on a second queue of the graphics family
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, queueFamilyList.data());
+	bool dedicatedComputeQueue = timelineSemaphoresEnabled && indices.computeFamily >= 0;
+	bool useComputeQueue = dedicatedComputeQueue || (timelineSemaphoresEnabled && queueFamilyList[indices.graphicsFamily].queueCount > 1);
+	asyncComputeFamily = dedicatedComputeQueue ? indices.computeFamily : indices.graphicsFamily;
+
+	if (dedicatedComputeQueue)
+	{
+		queueFamilyIndices.insert(indices.computeFamily);
+	}
+
 	// Queue creation information
+	float priorities[] = { 1.0f, 1.0f };
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	for (int queueFamilyIndex : queueFamilyIndices)
 	{
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamilyIndex;  // Assign queue family index
-		queueCreateInfo.queueCount = 1;  // Create a single queue per family
-		float priority = 1.0f;
-		queueCreateInfo.pQueuePriorities = &priority;  // Assign highest priority to the queue
+		queueCreateInfo.queueCount = (useComputeQueue && !dedicatedComputeQueue && queueFamilyIndex == indices.graphicsFamily) ? 2 : 1;  // Graphics (+ compute), or a single queue
+		queueCreateInfo.pQueuePriorities = priorities;  // Assign highest priority to the queues
 
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
@@ -594,15 +1040,55 @@ void VulkanRenderer::createLogicalDevice()
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+	// Memory budget is optional, the texture streamer keeps within the heap's budget with it.
+	// Its query is core 1.1 (vkGetPhysicalDeviceMemoryProperties2)
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(mainDevice.physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(mainDevice.physicalDevice, nullptr, &extensionCount, extensions.data());
+
+	memoryBudgetEnabled = false;
+	if (instanceApiVersion >= VK_API_VERSION_1_1 && deviceProperties.apiVersion >= VK_API_VERSION_1_1)
+	{
+		for (const auto& extension : extensions)
+		{
+			if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+			{
+				memoryBudgetEnabled = true;
+				break;
+			}
+		}
+	}
+
+	std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	if (memoryBudgetEnabled)
+	{
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
 	// Enable required device extensions (e.g., swapchain support)
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	// Specify physical device features (e.g., anisotropic filtering)
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;  // Enable anisotropic filtering
+	deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;  // The material shaders write the texture streaming feedback
+
+	// Pipeline statistics are optional, only used by the GPU profiler
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mainDevice.physicalDevice, &supportedFeatures);
+	pipelineStatisticsEnabled = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
+	// 1.2 features are chained, the 1.0 ones stay in pEnabledFeatures
+	if (timelineSemaphoresEnabled)
+	{
+		deviceCreateInfo.pNext = &timelineFeatures;
+	}
+
 	// Create the logical device
 	VkResult result = vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice);
 	if (result != VK_SUCCESS)
@@ -613,6 +1099,10 @@ void VulkanRenderer::createLogicalDevice()
 	// Retrieve handles for the graphics and presentation queues
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+	if (useComputeQueue)
+	{
+		vkGetDeviceQueue(mainDevice.logicalDevice, asyncComputeFamily, dedicatedComputeQueue ? 0 : 1, &asyncComputeQueue);
+	}
 }
 
 /**
@@ -700,8 +1190,8 @@ void VulkanRenderer::createSwapChain()
 		swapChainCreateInfo.pQueueFamilyIndices = nullptr;
 	}
 
-	// If replacing an old swapchain, link it for efficiency (not used here)
-	swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
+	// When recreating, the old swapchain is handed over so its resources can be reused
+	swapChainCreateInfo.oldSwapchain = swapchain;
 
 	// Create the swapchain
 	VkResult result = vkCreateSwapchainKHR(mainDevice.logicalDevice, &swapChainCreateInfo, nullptr, &swapchain);
@@ -731,107 +1221,289 @@ void VulkanRenderer::createSwapChain()
 }
 
 /**
- * @brief Creates the Vulkan render pass.
+ * @brief Recreates the swapchain and everything sized by it.
+ *
+ * Called when the window was resized or the presentation engine reported the swapchain
+ * out of date or suboptimal. The device is idled first, nothing else is touched.
+ *
+ * @throws std::runtime_error if the swapchain can't be recreated.
+ */
+void VulkanRenderer::recreateSwapChain()
+{
+	PROFILE_FUNCTION();
+
+	// A minimized window has no extent to create images with, try again once restored
+	if (isMinimized())
+	{
+		swapChainOutOfDate = true;
+		return;
+	}
+
+	vkDeviceWaitIdle(mainDevice.logicalDevice);
+
+	// The new swapchain is created from the old one, which is destroyed afterwards
+	VkSwapchainKHR oldSwapchain = swapchain;
+	std::vector<SwapchainImage> oldImages = swapChainImages;
+	swapChainImages.clear();
+
+	createSwapChain();
+
+	for (auto image : oldImages) {
+		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
+	}
+	vkDestroySwapchainKHR(mainDevice.logicalDevice, oldSwapchain, nullptr);
+
+	// The graph's attachments follow the extent, its framebuffers are recreated on first use.
+	// The image count may change, only the per image semaphores depend on it
+	renderGraph.resize(swapChainExtent);
+	destroySynchronisation();
+	createSynchronisation();
+
+	// The history is at the output resolution, it starts over
+	destroyTemporalHistory();
+	createTemporalHistory();
+	ambientOcclusion.resize(graphicsQueue, graphicsCommandPool);
+	renderExtent = dynamicResolution.getRenderExtent(swapChainExtent);
+
+	swapChainOutOfDate = false;
+	printf("Swapchain recreated: %ux%u\n", swapChainExtent.width, swapChainExtent.height);
+}
+
+namespace
+{
+	// Tiles the light list buffer holds, a 4K render area at LIGHT_TILE_SIZE
+	const uint32_t LIGHT_TILE_CAPACITY = ((3840 + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE) * ((2160 + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE);
+
+	// Smallest power of two multiple of LIGHT_TILE_SIZE whose tiles of the area fit the buffer
+	uint32_t chooseLightTileSize(VkExtent2D extent)
+	{
+		uint32_t tileSize = LIGHT_TILE_SIZE;
+		while (((extent.width + tileSize - 1) / tileSize) * ((extent.height + tileSize - 1) / tileSize) > LIGHT_TILE_CAPACITY)
+		{
+			tileSize *= 2;
+		}
+		return tileSize;
+	}
+}
+
+/**
+ * @brief Declares the passes of the frame and compiles the render graph.
+ *
+ * The swapchain image is imported every frame and exported for the present, the depth
+ * buffer is a transient attachment of the graph. The scene goes into transient colour and
+ * velocity targets, the TAA pass upsamples them into the HDR colour and accumulates into
+ * the history images, which the renderer owns and imports. The post processing blooms,
+ * exposes and tonemaps the HDR colour into the backbuffer. New passes (shadow, post processing,
+ * compute) declare what they read and write here, the graph orders them, inserts the
+ * barriers and layout transitions, and culls the ones nothing consumes.
  *
- * The render pass defines how framebuffers are used during rendering.
- * It includes color and depth attachments and specifies subpass dependencies
- * for layout transitions.
+ * The deferred path replaces the main pass with the light culling and a two subpass pass:
+ * the G-buffer, then the lighting into the same scene colour and velocity targets.
  *
- * @throws std::runtime_error if the render pass creation fails.
+ * Both paths start with a depth prepass, whose depth the ambient occlusion passes read at half
+ * resolution before the scene is shaded.
+ *
+ * @throws std::runtime_error if a render pass or attachment can't be created.
  */
-void VulkanRenderer::createRenderPass()
-{
-	// ATTACHMENTS
-	// Colour attachment of render pass
-	VkAttachmentDescription colourAttachment = {};
-	colourAttachment.format = swapChainImageFormat;						// Format to use for attachment
-	colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;					// Number of samples to write for multisampling
-	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;				// Describes what to do with attachment before rendering
-	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;			// Describes what to do with attachment after rendering
-	colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;	// Describes what to do with stencil before rendering
-	colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;	// Describes what to do with stencil after rendering
-
-	// Framebuffer data will be stored as an image, but images can be given different data layouts
-	// to give optimal use for certain operations
-	colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;			// Image data layout before render pass starts
-	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;		// Image data layout after render pass (to change to)
-
-
-	// Depth attachment of render pass
-	VkAttachmentDescription depthAttachment = {};
-	depthAttachment.format = chooseSupportedFormat(
+void VulkanRenderer::buildRenderGraph()
+{
+	QueueFamilyIndices indices = getQueueFamilies(mainDevice.physicalDevice);
+	renderGraph.create(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, indices.graphicsFamily,
+		asyncComputeQueue, asyncComputeFamily, timelineSemaphoresEnabled);
+	renderGraph.setProfiler(&gpuProfiler);
+
+	// -- RESOURCES --
+	backbufferResource = renderGraph.importImage("Backbuffer", swapChainImageFormat, RENDER_GRAPH_ACCESS_NONE);
+	renderGraph.exportResource(backbufferResource, RENDER_GRAPH_ACCESS_PRESENT);
+
+	// Highest sample count both attachment kinds support, not above the requested one
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
+	VkSampleCountFlags supportedSamples = deviceProperties.limits.framebufferColorSampleCounts & deviceProperties.limits.framebufferDepthSampleCounts;
+	// The deferred path lights every pixel once from the G-buffer, it renders without MSAA
+	uint32_t wantedMsaaSamples = renderPath == RENDER_PATH_DEFERRED ? 1u : requestedMsaaSamples;
+	msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	for (uint32_t samples = wantedMsaaSamples; samples > 1; samples /= 2)
+	{
+		if (supportedSamples & samples)
+		{
+			msaaSamples = static_cast<VkSampleCountFlagBits>(samples);
+			break;
+		}
+	}
+	printf("Render path: %s\n", getRenderPathName(renderPath));
+	printf("MSAA: %ux (requested %ux)\n", static_cast<uint32_t>(msaaSamples), requestedMsaaSamples);
+
+	RenderGraphImageDesc depthDesc;
+	depthDesc.format = chooseSupportedFormat(
 		{ VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
 		VK_IMAGE_TILING_OPTIMAL,
 		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	// REFERENCES
-	// Attachment reference uses an attachment index that refers to index in the attachment list passed to renderPassCreateInfo
-	VkAttachmentReference colourAttachmentReference = {};
-	colourAttachmentReference.attachment = 0;
-	colourAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	// Depth Attachment Reference
-	VkAttachmentReference depthAttachmentReference = {};
-	depthAttachmentReference.attachment = 1;
-	depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-	// Information about a particular subpass the Render Pass is using
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;		// Pipeline type subpass is to be bound to
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colourAttachmentReference;
-	subpass.pDepthStencilAttachment = &depthAttachmentReference;
-
-	// Need to determine when layout transitions occur using subpass dependencies
-	std::array<VkSubpassDependency, 2> subpassDependencies;
-
-	// Conversion from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-	// Transition must happen after...
-	subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;						// Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of renderpass)
-	subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;		// Pipeline stage
-	subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;				// Stage access mask (memory access)
-	// But must happen before...
-	subpassDependencies[0].dstSubpass = 0;
-	subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	subpassDependencies[0].dependencyFlags = 0;
-
-
-	// Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-	// Transition must happen after...
-	subpassDependencies[1].srcSubpass = 0;
-	subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;;
-	// But must happen before...
-	subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	subpassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	subpassDependencies[1].dependencyFlags = 0;
-
-	std::array<VkAttachmentDescription, 2> renderPassAttachments = { colourAttachment, depthAttachment };
-
-	// Create info for Render Pass
-	VkRenderPassCreateInfo renderPassCreateInfo = {};
-	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(renderPassAttachments.size());
-	renderPassCreateInfo.pAttachments = renderPassAttachments.data();
-	renderPassCreateInfo.subpassCount = 1;
-	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-	renderPassCreateInfo.pDependencies = subpassDependencies.data();
-
-	VkResult result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &renderPass);
-	if (result != VK_SUCCESS)
+	depthDesc.samples = msaaSamples;
+	depthResource = renderGraph.createImage("Depth", depthDesc);
+
+	// The scene is rendered into the top left corner of these, as large as the dynamic resolution allows
+	RenderGraphImageDesc sceneColourDesc;
+	sceneColourDesc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	sceneColourResource = renderGraph.createImage("Scene colour", sceneColourDesc);
+
+	RenderGraphImageDesc velocityDesc;
+	velocityDesc.format = VK_FORMAT_R16G16_SFLOAT;
+	velocityResource = renderGraph.createImage("Velocity", velocityDesc);
+
+	// Accumulated at the output resolution, alive across frames
+	historyResource = renderGraph.importImage("TAA history", VK_FORMAT_R16G16B16A16_SFLOAT, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+	historyOutputResource = renderGraph.importImage("TAA history output", VK_FORMAT_R16G16B16A16_SFLOAT, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+	renderGraph.exportResource(historyOutputResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT);
+
+	// Output of the TAA, linear and unbounded until the tonemap
+	RenderGraphImageDesc hdrColourDesc;
+	hdrColourDesc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	hdrColourResource = renderGraph.createImage("HDR colour", hdrColourDesc);
+
+	// Per texture the finest mip a pixel asked for, written by the scene pass and read back by the CPU
+	// when the frame's fence signalled
+	textureFeedbackResource = renderGraph.importBuffer("Texture feedback", RENDER_GRAPH_ACCESS_NONE);
+	renderGraph.exportResource(textureFeedbackResource, RENDER_GRAPH_ACCESS_HOST_READ);
+
+	// -- PASSES --
+	// The animated meshes are posed once, every pass drawing the scene reads the same skinned vertices
+	skinnedVerticesResource = gpuSkinning.addPass(renderGraph);
+
+	// Pages loaded since the last frame are copied into the atlas before the scene samples it
+	virtualTextureResources = virtualTexture.addPass(renderGraph);
+
+	// Depth only, the ambient occlusion needs the depth before the scene is shaded. Without MSAA it is the
+	// scene's depth buffer, which the scene pass then only tests against, with MSAA a single sampled copy
+	depthPrepassShared = msaaSamples == VK_SAMPLE_COUNT_1_BIT;
+	RenderGraphResource prepassDepthResource = depthResource;
+	if (!depthPrepassShared)
+	{
+		RenderGraphImageDesc prepassDepthDesc = depthDesc;
+		prepassDepthDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+		prepassDepthResource = renderGraph.createImage("Prepass depth", prepassDepthDesc);
+	}
+
+	depthPrepass = renderGraph.addPass("Depth prepass", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.writeDepth(prepassDepthResource, true, 1.0f)
+		.read(skinnedVerticesResource, RENDER_GRAPH_ACCESS_VERTEX_BUFFER)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordDepthPrepass(commandBuffer); })
+		.getHandle();
+
+	// Occlusion at half resolution, then accumulated over frames
+	ambientOcclusionResource = ambientOcclusion.addPasses(renderGraph, prepassDepthResource);
+
+	if (renderPath == RENDER_PATH_DEFERRED)
 	{
-		throw std::runtime_error("Failed to create a Render Pass!");
+		// Base colour with the metallic in alpha, the normal packed into 10 bits per axis and the
+		// HDR emission with the roughness in alpha, only alive between the subpasses
+		RenderGraphImageDesc albedoDesc;
+		albedoDesc.format = VK_FORMAT_R8G8B8A8_SRGB;
+		gbufferAlbedoResource = renderGraph.createImage("G-buffer albedo", albedoDesc);
+
+		RenderGraphImageDesc normalDesc;
+		normalDesc.format = VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+		gbufferNormalResource = renderGraph.createImage("G-buffer normal", normalDesc);
+
+		RenderGraphImageDesc emissiveDesc;
+		emissiveDesc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		gbufferEmissiveResource = renderGraph.createImage("G-buffer emissive", emissiveDesc);
+
+		// Per tile a light count and up to MAX_LIGHTS_PER_TILE indices
+		RenderGraphBufferDesc tileLightsDesc;
+		tileLightsDesc.size = static_cast<VkDeviceSize>(LIGHT_TILE_CAPACITY) * (MAX_LIGHTS_PER_TILE + 1) * sizeof(uint32_t);
+		tileLightsResource = renderGraph.createBuffer("Tile light lists", tileLightsDesc);
+
+		// Needs no depth, so it runs on the compute queue beside the depth prepass: each tile's frustum is
+		// tested against the light spheres
+		lightCullingPass = renderGraph.addPass("Light culling", RENDER_GRAPH_QUEUE_ASYNC_COMPUTE)
+			.write(tileLightsResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_COMPUTE)
+			.setExecute([this](VkCommandBuffer commandBuffer) { recordLightCulling(commandBuffer); })
+			.getHandle();
+
+		// Subpass 0 fills the G-buffer, subpass 1 reads it per pixel and shades the lights of the pixel's tile
+		mainPass = renderGraph.addPass("Deferred", RENDER_GRAPH_QUEUE_GRAPHICS)
+			.writeColour(gbufferAlbedoResource, false)
+			.writeColour(gbufferNormalResource, false)
+			.writeColour(gbufferEmissiveResource, false)
+			.writeColour(velocityResource, true)
+			.writeDepth(depthResource, !depthPrepassShared, 1.0f)
+			.nextSubpass()
+			.readInput(gbufferAlbedoResource)
+			.readInput(gbufferNormalResource)
+			.readInput(gbufferEmissiveResource)
+			.readInput(depthResource)
+			.writeColour(sceneColourResource, true, { { 0.5f, 0.5f, 0.5f, 1.0f } })
+			.read(tileLightsResource, RENDER_GRAPH_ACCESS_STORAGE_READ_GRAPHICS)
+			.read(ambientOcclusionResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+			.read(skinnedVerticesResource, RENDER_GRAPH_ACCESS_VERTEX_BUFFER)
+			.readWrite(textureFeedbackResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_GRAPHICS)
+			.read(virtualTextureResources.pageTable, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+			.read(virtualTextureResources.atlas, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+			.readWrite(virtualTextureResources.feedback, RENDER_GRAPH_ACCESS_STORAGE_WRITE_GRAPHICS)
+			.setPipelineStatistics()
+			.setExecute([this](VkCommandBuffer commandBuffer) { recordDeferredPass(commandBuffer); })
+			.getHandle();
 	}
+	else
+	{
+		RenderGraphPassBuilder mainPassBuilder = renderGraph.addPass("Main pass", RENDER_GRAPH_QUEUE_GRAPHICS);
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+		{
+			// Rendered multisampled and resolved into the scene targets at the end of the pass, the samples never leave the tile
+			RenderGraphImageDesc colourDesc = sceneColourDesc;
+			colourDesc.samples = msaaSamples;
+			RenderGraphResource colour = renderGraph.createImage("Colour MSAA", colourDesc);
+
+			RenderGraphImageDesc velocityMsaaDesc = velocityDesc;
+			velocityMsaaDesc.samples = msaaSamples;
+			RenderGraphResource velocity = renderGraph.createImage("Velocity MSAA", velocityMsaaDesc);
+
+			mainPassBuilder
+				.writeColour(colour, true, { { 0.5f, 0.5f, 0.5f, 1.0f } })
+				.writeColour(velocity, true)
+				.resolveColour(colour, sceneColourResource)
+				.resolveColour(velocity, velocityResource);
+		}
+		else
+		{
+			mainPassBuilder
+				.writeColour(sceneColourResource, true, { { 0.5f, 0.5f, 0.5f, 1.0f } })
+				.writeColour(velocityResource, true);
+		}
+		mainPass = mainPassBuilder
+			.writeDepth(depthResource, !depthPrepassShared, 1.0f)
+			.read(ambientOcclusionResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+			.read(skinnedVerticesResource, RENDER_GRAPH_ACCESS_VERTEX_BUFFER)
+			.readWrite(textureFeedbackResource, RENDER_GRAPH_ACCESS_STORAGE_WRITE_GRAPHICS)
+			.read(virtualTextureResources.pageTable, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+			.read(virtualTextureResources.atlas, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+			.readWrite(virtualTextureResources.feedback, RENDER_GRAPH_ACCESS_STORAGE_WRITE_GRAPHICS)
+			.setPipelineStatistics()
+			.setExecute([this](VkCommandBuffer commandBuffer) { recordMainPass(commandBuffer); })
+			.getHandle();
+	}
+
+	// Emitted, simulated and sorted in compute, blended over the scene before the TAA resolves it
+	particleSystem.addPasses(renderGraph, sceneColourResource, prepassDepthResource);
+
+	// Upsamples the scene to the output resolution and accumulates it into the history
+	taaPass = renderGraph.addPass("TAA", RENDER_GRAPH_QUEUE_GRAPHICS)
+		.read(sceneColourResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+		.read(velocityResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+		.read(historyResource, RENDER_GRAPH_ACCESS_SAMPLED_FRAGMENT)
+		.writeColour(hdrColourResource, false)
+		.writeColour(historyOutputResource, true)
+		.setExecute([this](VkCommandBuffer commandBuffer) { recordTemporalPass(commandBuffer); })
+		.getHandle();
+
+	// Bloom and exposure in compute, one pass per step so each is timed on its own, then the tonemap
+	postProcessing.addPasses(renderGraph, hdrColourResource, backbufferResource);
+
+	renderGraph.compile(swapChainExtent);
+	renderPass = renderGraph.getRenderPass(mainPass);
+	depthPrepassRenderPass = renderGraph.getRenderPass(depthPrepass);
+	taaRenderPass = renderGraph.getRenderPass(taaPass);
 }
 
 /**
@@ -850,7 +1522,7 @@ void VulkanRenderer::createDescriptorSetLayout()
 	vpLayoutBinding.binding = 0;  // Matches the binding number in the shader
 	vpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	vpLayoutBinding.descriptorCount = 1;  // Single descriptor per set
-	vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // Used in the vertex shader
+	vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT; // Used in the vertex shader and the light culling
 	vpLayoutBinding.pImmutableSamplers = nullptr;  // Not used for uniform buffers
 
 	// --- LIGHTING UNIFORM BUFFER DESCRIPTOR SET LAYOUT ---
@@ -861,8 +1533,33 @@ void VulkanRenderer::createDescriptorSetLayout()
 	lightBindingInfo.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // Used in the fragment shader
 	lightBindingInfo.pImmutableSamplers = nullptr;
 
+	// --- POINT LIGHT LIST DESCRIPTOR SET LAYOUT ---
+	VkDescriptorSetLayoutBinding pointLightBindingInfo = {};
+	pointLightBindingInfo.binding = 2;
+	pointLightBindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pointLightBindingInfo.descriptorCount = 1;
+	pointLightBindingInfo.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT; // Shaded in the fragment shader, culled in compute
+	pointLightBindingInfo.pImmutableSamplers = nullptr;
+
+	// --- AMBIENT OCCLUSION DESCRIPTOR SET LAYOUT ---
+	VkDescriptorSetLayoutBinding occlusionBindingInfo = {};
+	occlusionBindingInfo.binding = 3;
+	occlusionBindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	occlusionBindingInfo.descriptorCount = 1;
+	occlusionBindingInfo.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // Upsampled in the lighting
+	occlusionBindingInfo.pImmutableSamplers = nullptr;
+
+	// --- TEXTURE FEEDBACK DESCRIPTOR SET LAYOUT ---
+	VkDescriptorSetLayoutBinding feedbackBindingInfo = {};
+	feedbackBindingInfo.binding = 4;
+	feedbackBindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	feedbackBindingInfo.descriptorCount = 1;
+	feedbackBindingInfo.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // The material shaders report the mips they need
+	feedbackBindingInfo.pImmutableSamplers = nullptr;
+
 	// Combine descriptor bindings into a layout
-	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding, lightBindingInfo };
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding, lightBindingInfo, pointLightBindingInfo, occlusionBindingInfo,
+		feedbackBindingInfo };
 
 	// Descriptor Set Layout creation info
 	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
@@ -877,22 +1574,72 @@ void VulkanRenderer::createDescriptorSetLayout()
 		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
 	}
 
-	// --- TEXTURE SAMPLER DESCRIPTOR SET LAYOUT ---
-	VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-	samplerLayoutBinding.binding = 0;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; // Texture sampler
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; // Used in fragment shader
-	samplerLayoutBinding.pImmutableSamplers = nullptr;
+	// --- MATERIAL DESCRIPTOR SET LAYOUT ---
+	// The material library owns the layout of set 1, the texture slots and the parameter block
+	materialLibrary.create(mainDevice.physicalDevice, mainDevice.logicalDevice, textureSampler);
+
+	// --- ENVIRONMENT DESCRIPTOR SET LAYOUT ---
+	// Set 2: the SH irradiance and the prefiltered cubemap, filled once the environment is loaded
+	environmentLighting.create(mainDevice.physicalDevice, mainDevice.logicalDevice);
+	virtualTexture.create(mainDevice.physicalDevice, mainDevice.logicalDevice);
+
+	// --- TAA DESCRIPTOR SET LAYOUT ---
+	// Scene colour, velocity and history, sampled in the fragment shader
+	std::array<VkDescriptorSetLayoutBinding, 3> taaBindings = {};
+	for (uint32_t i = 0; i < taaBindings.size(); i++)
+	{
+		taaBindings[i].binding = i;
+		taaBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		taaBindings[i].descriptorCount = 1;
+		taaBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo taaLayoutCreateInfo = {};
+	taaLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	taaLayoutCreateInfo.bindingCount = static_cast<uint32_t>(taaBindings.size());
+	taaLayoutCreateInfo.pBindings = taaBindings.data();
+
+	result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &taaLayoutCreateInfo, nullptr, &taaSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// --- DEFERRED DESCRIPTOR SET LAYOUTS ---
+	// Lighting: albedo, normal, emissive and depth as input attachments, then the tile light lists
+	std::array<VkDescriptorSetLayoutBinding, 5> deferredBindings = {};
+	for (uint32_t i = 0; i < deferredBindings.size(); i++)
+	{
+		deferredBindings[i].binding = i;
+		deferredBindings[i].descriptorType = i < 4 ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		deferredBindings[i].descriptorCount = 1;
+		deferredBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo deferredLayoutCreateInfo = {};
+	deferredLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	deferredLayoutCreateInfo.bindingCount = static_cast<uint32_t>(deferredBindings.size());
+	deferredLayoutCreateInfo.pBindings = deferredBindings.data();
+
+	result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &deferredLayoutCreateInfo, nullptr, &deferredSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
+	}
+
+	// Light culling: the tile light lists it writes
+	VkDescriptorSetLayoutBinding tileLightsBinding = {};
+	tileLightsBinding.binding = 0;
+	tileLightsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	tileLightsBinding.descriptorCount = 1;
+	tileLightsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	// Descriptor set layout creation info for texture sampling
-	VkDescriptorSetLayoutCreateInfo textureLayoutCreateInfo = {};
-	textureLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	textureLayoutCreateInfo.bindingCount = 1;
-	textureLayoutCreateInfo.pBindings = &samplerLayoutBinding;
+	VkDescriptorSetLayoutCreateInfo cullingLayoutCreateInfo = {};
+	cullingLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	cullingLayoutCreateInfo.bindingCount = 1;
+	cullingLayoutCreateInfo.pBindings = &tileLightsBinding;
 
-	// Create descriptor set layout for textures
-	result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &textureLayoutCreateInfo, nullptr, &samplerSetLayout);
+	result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &cullingLayoutCreateInfo, nullptr, &lightCullingSetLayout);
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create a Descriptor Set Layout!");
@@ -909,159 +1656,22 @@ void VulkanRenderer::createPushConstantRange()
 {
 	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;  // Used in the vertex shader
 	pushConstantRange.offset = 0;  // Start at the beginning of the data block
-	pushConstantRange.size = sizeof(Model);  // Size of the data being passed
+	pushConstantRange.size = sizeof(PushModel);  // Size of the data being passed (this and the previous frame's model matrix)
 }
 
 /**
  * @brief Creates the Vulkan graphics pipeline.
  *
- * This function configures and initializes all stages of the graphics pipeline,
- * including shaders, vertex input, rasterization, depth testing, and blending.
+ * Creates the pipeline layout, then hands the description of every pipeline to the
+ * PipelineManager which compiles them on worker threads through the pipeline cache.
  *
  * @throws std::runtime_error if the graphics pipeline creation fails.
  */
 void VulkanRenderer::createGraphicsPipeline()
 {
-	// --- Load and Create Shader Modules ---
-	auto vertexShaderCode = readFile("Shaders/vert.spv");
-	auto fragmentShaderCode = readFile("Shaders/frag.spv");
-
-	VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-	VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
-
-	// --- Shader Stage Information ---
-	VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-	vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;				// Shader Stage name
-	vertexShaderCreateInfo.module = vertexShaderModule;						// Shader module to be used by stage
-	vertexShaderCreateInfo.pName = "main";									// Entry point in to shader
-
-	// Fragment Stage creation information
-	VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-	fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;				// Shader Stage name
-	fragmentShaderCreateInfo.module = fragmentShaderModule;						// Shader module to be used by stage
-	fragmentShaderCreateInfo.pName = "main";									// Entry point in to shader
-
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
-
-	// How the data for a single vertex (including info such as position, colour, texture coords, normals, etc) is as a whole
-	VkVertexInputBindingDescription bindingDescription = {};
-	bindingDescription.binding = 0;									// Can bind multiple streams of data, this defines which one
-	bindingDescription.stride = sizeof(Vertex);						// Size of a single vertex object
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;		// How to move between data after each vertex.
-	// VK_VERTEX_INPUT_RATE_INDEX		: Move on to the next vertex
-	// VK_VERTEX_INPUT_RATE_INSTANCE	: Move to a vertex for the next instance
-
-// How the data for an attribute is defined within a vertex
-	std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions;
-
-	// Position Attribute
-	attributeDescriptions[0].binding = 0;							// Which binding the data is at (should be same as above)
-	attributeDescriptions[0].location = 0;							// Location in shader where data will be read from
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;	// Format the data will take (also helps define size of data)
-	attributeDescriptions[0].offset = offsetof(Vertex, pos);		// Where this attribute is defined in the data for a single vertex
-
-	// Colour Attribute
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex, col);
-
-	// Texture Attribute
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, tex);
-
-	// Normal Attribute
-	attributeDescriptions[3].binding = 0;
-	attributeDescriptions[3].location = 3;
-	attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[3].offset = offsetof(Vertex, norm);
-
-
-	// -- VERTEX INPUT --
-	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-	vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;											// List of Vertex Binding Descriptions (data spacing/stride information)
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();								// List of Vertex Attribute Descriptions (data format and where to bind to/from)
-
-
-	// --- Input Assembly ---
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;		// Primitive type to assemble vertices as
-	inputAssembly.primitiveRestartEnable = VK_FALSE;					// Allow overriding of "strip" topology to start new primitives
-
-
-	// --- Viewport and Scissor ---
-	VkViewport viewport = {};
-	viewport.x = 0.0f;									// x start coordinate
-	viewport.y = 0.0f;									// y start coordinate
-	viewport.width = (float)swapChainExtent.width;		// width of viewport
-	viewport.height = (float)swapChainExtent.height;	// height of viewport
-	viewport.minDepth = 0.0f;							// min framebuffer depth
-	viewport.maxDepth = 1.0f;							// max framebuffer depth
-
-	// Create a scissor info struct
-	VkRect2D scissor = {};
-	scissor.offset = { 0,0 };							// Offset to use region from
-	scissor.extent = swapChainExtent;					// Extent to describe region to use, starting at offset
-
-	VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-	viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportStateCreateInfo.viewportCount = 1;
-	viewportStateCreateInfo.pViewports = &viewport;
-	viewportStateCreateInfo.scissorCount = 1;
-	viewportStateCreateInfo.pScissors = &scissor;
-
-	// --- Rasterizer ---
-	VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-	rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizerCreateInfo.depthClampEnable = VK_FALSE;					// Change if fragments beyond near/far planes are clipped (default) or clamped to plane
-	rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;			// Whether to discard data and skip rasterizer. Never creates fragments, only suitable for pipeline without framebuffer output
-	rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;			// How to handle filling points between vertices
-	rasterizerCreateInfo.lineWidth = 1.0f;								// How thick lines should be when drawn
-	rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;				// Which face of a tri to cull
-	rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;	// Winding to determine which side is front
-	rasterizerCreateInfo.depthBiasEnable = VK_FALSE;					// Whether to add depth bias to fragments (good for stopping "shadow acne" in shadow mapping)
-
-
-	// --- Multisampling ---
-	VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
-	multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;					// Enable multisample shading or not
-	multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;	// Number of samples to use per fragment
-
-
-	// --- Color Blending ---andled)
-	VkPipelineColorBlendAttachmentState colourState = {};
-	colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT	// Colours to apply blending to
-		| VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colourState.blendEnable = VK_TRUE;													// Enable blending
-
-	// Blending uses equation: (srcColorBlendFactor * new colour) colorBlendOp (dstColorBlendFactor * old colour)
-	colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colourState.colorBlendOp = VK_BLEND_OP_ADD;
-
-	colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colourState.alphaBlendOp = VK_BLEND_OP_ADD;
-	// Summarised: (1 * new alpha) + (0 * old alpha) = new alpha
-
-	VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
-	colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colourBlendingCreateInfo.logicOpEnable = VK_FALSE;				// Alternative to calculations is to use logical operations
-	colourBlendingCreateInfo.attachmentCount = 1;
-	colourBlendingCreateInfo.pAttachments = &colourState;
-
 	// -- PIPELINE LAYOUT --
-	std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = { descriptorSetLayout, samplerSetLayout };
+	std::array<VkDescriptorSetLayout, 4> descriptorSetLayouts = { descriptorSetLayout, materialLibrary.getSetLayout(), environmentLighting.getSetLayout(),
+		virtualTexture.getSetLayout() };
 
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -1077,120 +1687,209 @@ void VulkanRenderer::createGraphicsPipeline()
 		throw std::runtime_error("Failed to create Pipeline Layout!");
 	}
 
-
-	// --- Depth Stencil ---
-	VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
-	depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencilCreateInfo.depthTestEnable = VK_TRUE;				// Enable checking depth to determine fragment write
-	depthStencilCreateInfo.depthWriteEnable = VK_TRUE;				// Enable writing to depth buffer (to replace old values)
-	depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;		// Comparison operation that allows an overwrite (is in front)
-	depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;		// Depth Bounds Test: Does the depth value exist between two bounds
-	depthStencilCreateInfo.stencilTestEnable = VK_FALSE;			// Enable Stencil Test
-
-
-	// --- Create Graphics Pipeline ---
-	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = 2;									// Number of shader stages
-	pipelineCreateInfo.pStages = shaderStages;							// List of shader stages
-	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;		// All the fixed function pipeline states
-	pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-	pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-	pipelineCreateInfo.pDynamicState = nullptr;
-	pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-	pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
-	pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
-	pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
-	pipelineCreateInfo.layout = pipelineLayout;							// Pipeline Layout pipeline should use
-	pipelineCreateInfo.renderPass = renderPass;							// Render pass description the pipeline is compatible with
-	pipelineCreateInfo.subpass = 0;										// Subpass of render pass to use with pipeline
-
-	// Pipeline Derivatives : Can create multiple pipelines that derive from one another for optimisation
-	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;	// Existing pipeline to derive from...
-	pipelineCreateInfo.basePipelineIndex = -1;				// or index of pipeline being created to derive from (in case creating multiple at once)
-
-	// Create Graphics Pipeline
-	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
-	if (result != VK_SUCCESS)
+	// The terrain's layout extends this one, its pipelines share the scene's fragment shaders
+	terrain.create(mainDevice.physicalDevice, mainDevice.logicalDevice, descriptorSetLayouts, pushConstantRange);
+
+	// TAA: its input images and the push constants of the resolve
+	VkPushConstantRange taaPushConstantRange = {};
+	taaPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	taaPushConstantRange.offset = 0;
+	taaPushConstantRange.size = sizeof(PushTaa);
+
+	VkPipelineLayoutCreateInfo taaLayoutCreateInfo = {};
+	taaLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	taaLayoutCreateInfo.setLayoutCount = 1;
+	taaLayoutCreateInfo.pSetLayouts = &taaSetLayout;
+	taaLayoutCreateInfo.pushConstantRangeCount = 1;
+	taaLayoutCreateInfo.pPushConstantRanges = &taaPushConstantRange;
+
+	result = vkCreatePipelineLayout(mainDevice.logicalDevice, &taaLayoutCreateInfo, nullptr, &taaPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+
+	// Deferred lighting: the frame's uniforms and lights, the G-buffer and tile lists, the environment, the unprojection
+	std::array<VkDescriptorSetLayout, 3> deferredSetLayouts = { descriptorSetLayout, deferredSetLayout, environmentLighting.getSetLayout() };
+
+	VkPushConstantRange deferredPushConstantRange = {};
+	deferredPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	deferredPushConstantRange.offset = 0;
+	deferredPushConstantRange.size = sizeof(PushDeferredLighting);
+
+	VkPipelineLayoutCreateInfo deferredLayoutCreateInfo = {};
+	deferredLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	deferredLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(deferredSetLayouts.size());
+	deferredLayoutCreateInfo.pSetLayouts = deferredSetLayouts.data();
+	deferredLayoutCreateInfo.pushConstantRangeCount = 1;
+	deferredLayoutCreateInfo.pPushConstantRanges = &deferredPushConstantRange;
+
+	result = vkCreatePipelineLayout(mainDevice.logicalDevice, &deferredLayoutCreateInfo, nullptr, &deferredPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+
+	// Light culling: the frame's view matrix and lights, the tile lists, the tile grid
+	std::array<VkDescriptorSetLayout, 2> cullingSetLayouts = { descriptorSetLayout, lightCullingSetLayout };
+
+	VkPushConstantRange cullingPushConstantRange = {};
+	cullingPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullingPushConstantRange.offset = 0;
+	cullingPushConstantRange.size = sizeof(PushLightCulling);
+
+	VkPipelineLayoutCreateInfo cullingLayoutCreateInfo = {};
+	cullingLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	cullingLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(cullingSetLayouts.size());
+	cullingLayoutCreateInfo.pSetLayouts = cullingSetLayouts.data();
+	cullingLayoutCreateInfo.pushConstantRangeCount = 1;
+	cullingLayoutCreateInfo.pPushConstantRanges = &cullingPushConstantRange;
+
+	result = vkCreatePipelineLayout(mainDevice.logicalDevice, &cullingLayoutCreateInfo, nullptr, &lightCullingPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Pipeline Layout!");
+	}
+
+	// --- Pipelines ---
+	// Fixed function state lives in the PipelineManager, new pipelines (shadow, depth, post) are added to this list
+	GraphicsPipelineDesc mainPipelineDesc;
+	mainPipelineDesc.name = "Main";
+	mainPipelineDesc.vertexShader = "Shaders/vert.spv";
+	mainPipelineDesc.fragmentShader = "Shaders/frag.spv";
+	mainPipelineDesc.layout = pipelineLayout;
+	mainPipelineDesc.renderPass = renderPass;
+	mainPipelineDesc.subpass = 0;
+	mainPipelineDesc.samples = msaaSamples;
+	mainPipelineDesc.colourAttachmentCount = 2;		// Scene colour and velocity
+	if (depthPrepassShared)
+	{
+		// The prepass wrote the depth of the same vertex shader (invariant position), only the nearest surface is shaded
+		mainPipelineDesc.depthWrite = false;
+		mainPipelineDesc.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	}
+
+	GraphicsPipelineDesc prepassPipelineDesc;
+	prepassPipelineDesc.name = "Depth prepass";
+	prepassPipelineDesc.vertexShader = "Shaders/vert.spv";
+	prepassPipelineDesc.layout = pipelineLayout;
+	prepassPipelineDesc.renderPass = depthPrepassRenderPass;
+	prepassPipelineDesc.subpass = 0;
+	prepassPipelineDesc.alphaBlend = false;
+	prepassPipelineDesc.colourAttachmentCount = 0;
+
+	GraphicsPipelineDesc taaPipelineDesc;
+	taaPipelineDesc.name = "TAA";
+	taaPipelineDesc.vertexShader = "Shaders/fullscreenVert.spv";
+	taaPipelineDesc.fragmentShader = "Shaders/taaFrag.spv";
+	taaPipelineDesc.layout = taaPipelineLayout;
+	taaPipelineDesc.renderPass = taaRenderPass;
+	taaPipelineDesc.subpass = 0;
+	taaPipelineDesc.cullMode = VK_CULL_MODE_NONE;
+	taaPipelineDesc.depthTest = false;
+	taaPipelineDesc.depthWrite = false;
+	taaPipelineDesc.alphaBlend = false;
+	taaPipelineDesc.colourAttachmentCount = 2;		// HDR colour and history
+	taaPipelineDesc.vertexInput = false;
+
+	pipelineDescs = { taaPipelineDesc, prepassPipelineDesc };
+	pipelineHandles = { &taaPipeline, &depthPrepassPipeline };
+
+	if (renderPath == RENDER_PATH_DEFERRED)
+	{
+		// Same vertex shader as the forward path, the fragment shader writes the surface instead of shading it
+		GraphicsPipelineDesc gbufferPipelineDesc = mainPipelineDesc;
+		gbufferPipelineDesc.name = "G-buffer";
+		gbufferPipelineDesc.fragmentShader = "Shaders/gbufferFrag.spv";
+		gbufferPipelineDesc.alphaBlend = false;
+		gbufferPipelineDesc.colourAttachmentCount = 4;		// Albedo, normal, emissive and velocity
+
+		GraphicsPipelineDesc lightingPipelineDesc;
+		lightingPipelineDesc.name = "Deferred lighting";
+		lightingPipelineDesc.vertexShader = "Shaders/fullscreenVert.spv";
+		lightingPipelineDesc.fragmentShader = "Shaders/deferredLightingFrag.spv";
+		lightingPipelineDesc.layout = deferredPipelineLayout;
+		lightingPipelineDesc.renderPass = renderPass;
+		lightingPipelineDesc.subpass = 1;
+		lightingPipelineDesc.cullMode = VK_CULL_MODE_NONE;
+		lightingPipelineDesc.depthTest = false;
+		lightingPipelineDesc.depthWrite = false;
+		lightingPipelineDesc.alphaBlend = false;
+		lightingPipelineDesc.colourAttachmentCount = 1;		// Scene colour
+		lightingPipelineDesc.vertexInput = false;
+
+		pipelineDescs.push_back(gbufferPipelineDesc);
+		pipelineDescs.push_back(lightingPipelineDesc);
+		pipelineHandles.push_back(&gbufferPipeline);
+		pipelineHandles.push_back(&deferredLightingPipeline);
+		terrain.appendPipelineDescs(pipelineDescs, pipelineHandles, prepassPipelineDesc, gbufferPipelineDesc);
+
+		ComputePipelineDesc cullingPipelineDesc;
+		cullingPipelineDesc.name = "Light culling";
+		cullingPipelineDesc.computeShader = "Shaders/lightCullingComp.spv";
+		cullingPipelineDesc.layout = lightCullingPipelineLayout;
+		computePipelineDescs.push_back(cullingPipelineDesc);
+		computePipelineHandles.push_back(&lightCullingPipeline);
+	}
+	else
+	{
+		pipelineDescs.push_back(mainPipelineDesc);
+		pipelineHandles.push_back(&graphicsPipeline);
+		terrain.appendPipelineDescs(pipelineDescs, pipelineHandles, prepassPipelineDesc, mainPipelineDesc);
+	}
+
+	// Compiled in parallel through the pipeline cache, times are printed to the console
+	std::vector<VkPipeline> pipelines = pipelineManager.createGraphicsPipelines(pipelineDescs);
+	for (size_t i = 0; i < pipelines.size(); i++)
 	{
-		throw std::runtime_error("Failed to create a Graphics Pipeline!");
+		*pipelineHandles[i] = pipelines[i];
 	}
-
-	// Destroy Shader Modules, no longer needed after Pipeline created
-	vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, nullptr);
 }
 
 /**
- * @brief Creates the depth buffer image and its corresponding image view.
+ * @brief Creates the pipeline cache, seeded from the file written at the last shutdown.
  *
- * The depth buffer is used for depth testing, ensuring that objects in the scene
- * are correctly rendered based on their distance from the camera.
+ * The file is ignored when it comes from another GPU or driver version.
  */
-void VulkanRenderer::createDepthBufferImage()
+void VulkanRenderer::createPipelineCache()
 {
-	// Select a supported depth format
-	VkFormat depthFormat = chooseSupportedFormat(
-		{ VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-	);
-
-	// Create the depth buffer image
-	depthBufferImage = createImage(
-		swapChainExtent.width, swapChainExtent.height,
-		depthFormat, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&depthBufferImageMemory
-	);
-
-	// Create an image view for the depth buffer
-	depthBufferImageView = createImageView(depthBufferImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+	pipelineManager.create(mainDevice.physicalDevice, mainDevice.logicalDevice, "pipeline_cache.bin");
 }
 
 /**
- * @brief Creates framebuffers for each swap chain image.
- *
- * Framebuffers bind attachments (color, depth) to the render pass for rendering.
- * Each swap chain image has an associated framebuffer.
- *
- * @throws std::runtime_error if framebuffer creation fails.
+ * @brief Starts watching Shaders/, every source is registered with the SPIR-V file it produces.
  */
-void VulkanRenderer::createFramebuffers()
+void VulkanRenderer::createShaderHotReload()
 {
-	// Resize framebuffer list to match swap chain image count
-	swapChainFramebuffers.resize(swapChainImages.size());
-
-	// Create a framebuffer for each swap chain image
-	for (size_t i = 0; i < swapChainFramebuffers.size(); i++)
+	if (!shaderHotReloader.create("Shaders"))
 	{
-		// Attach color and depth images to the framebuffer
-		std::array<VkImageView, 2> attachments = {
-			swapChainImages[i].imageView,  // Color attachment
-			depthBufferImageView           // Depth attachment
-		};
-
-		// Configure framebuffer creation
-		VkFramebufferCreateInfo framebufferCreateInfo = {};
-		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferCreateInfo.renderPass = renderPass;  // Render pass compatibility
-		framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebufferCreateInfo.pAttachments = attachments.data(); // Color & depth attachments
-		framebufferCreateInfo.width = swapChainExtent.width;
-		framebufferCreateInfo.height = swapChainExtent.height;
-		framebufferCreateInfo.layers = 1; // Single-layered framebuffer
-
-		// Create the framebuffer
-		VkResult result = vkCreateFramebuffer(mainDevice.logicalDevice, &framebufferCreateInfo, nullptr, &swapChainFramebuffers[i]);
-		if (result != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create a Framebuffer!");
-		}
-	}
+		return;
+	}
+
+	shaderHotReloader.addShader("shader.vert", "Shaders/vert.spv");
+	shaderHotReloader.addShader("shader.frag", "Shaders/frag.spv");
+	shaderHotReloader.addShader("fullscreen.vert", "Shaders/fullscreenVert.spv");
+	shaderHotReloader.addShader("taa.frag", "Shaders/taaFrag.spv");
+	shaderHotReloader.addShader("tonemap.frag", "Shaders/tonemapFrag.spv");
+	shaderHotReloader.addShader("bloom_down.comp", "Shaders/bloomDownComp.spv");
+	shaderHotReloader.addShader("bloom_up.comp", "Shaders/bloomUpComp.spv");
+	shaderHotReloader.addShader("histogram.comp", "Shaders/histogramComp.spv");
+	shaderHotReloader.addShader("exposure.comp", "Shaders/exposureComp.spv");
+	shaderHotReloader.addShader("gbuffer.frag", "Shaders/gbufferFrag.spv");
+	shaderHotReloader.addShader("deferred_lighting.frag", "Shaders/deferredLightingFrag.spv");
+	shaderHotReloader.addShader("light_culling.comp", "Shaders/lightCullingComp.spv");
+	shaderHotReloader.addShader("ssao.comp", "Shaders/ssaoComp.spv");
+	shaderHotReloader.addShader("ssao_temporal.comp", "Shaders/ssaoTemporalComp.spv");
+	shaderHotReloader.addShader("skinning.comp", "Shaders/skinningComp.spv");
+	shaderHotReloader.addShader("terrain.vert", "Shaders/terrainVert.spv");
+	shaderHotReloader.addShader("particle_args.comp", "Shaders/particleArgsComp.spv");
+	shaderHotReloader.addShader("particle_emit.comp", "Shaders/particleEmitComp.spv");
+	shaderHotReloader.addShader("particle_simulate.comp", "Shaders/particleSimulateComp.spv");
+	shaderHotReloader.addShader("particle_sort.comp", "Shaders/particleSortComp.spv");
+	shaderHotReloader.addShader("particle.vert", "Shaders/particleVert.spv");
+	shaderHotReloader.addShader("particle.frag", "Shaders/particleFrag.spv");
 }
 
-
 void VulkanRenderer::createCommandPool()
 {
 	// Get indices of queue families from device
@@ -1209,52 +1908,70 @@ void VulkanRenderer::createCommandPool()
 	}
 }
 
-void VulkanRenderer::createCommandBuffers()
+void VulkanRenderer::createFrameContexts()
 {
-	// Resize command buffer count to have one for each framebuffer
-	commandBuffers.resize(swapChainFramebuffers.size());
+	QueueFamilyIndices indices = getQueueFamilies(mainDevice.physicalDevice);
+
+	// One context per frame in flight, independent of the swapchain image count
+	frames.resize(framesInFlight);
+	for (auto& frame : frames)
+	{
+		frame.create(mainDevice.physicalDevice, mainDevice.logicalDevice, indices.graphicsFamily, asyncComputeFamily);
+	}
 
-	VkCommandBufferAllocateInfo cbAllocInfo = {};
-	cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cbAllocInfo.commandPool = graphicsCommandPool;
-	cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;	// VK_COMMAND_BUFFER_LEVEL_PRIMARY	: Buffer you submit directly to queue. Cant be called by other buffers.
-	// VK_COMMAND_BUFFER_LEVEL_SECONARY	: Buffer can't be called directly. Can be called from other buffers via "vkCmdExecuteCommands" when recording commands in primary buffer
-	cbAllocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+	// The refresh rate feeds the latency estimate, the window is on the primary monitor
+	const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	double refreshRate = videoMode != nullptr ? static_cast<double>(videoMode->refreshRate) : 60.0;
+	framePacer.create(framesInFlight, refreshRate);
 
-	// Allocate command buffers and place handles in array of buffers
-	VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &cbAllocInfo, commandBuffers.data());
-	if (result != VK_SUCCESS)
+	// GPU times are read back when a context is reused, framesInFlight frames after it was recorded
+	double targetFramesPerSecond = dynamicResolutionTarget < 0.0 ? refreshRate : dynamicResolutionTarget;
+	dynamicResolution.create(targetFramesPerSecond, framesInFlight + 1);
+	renderExtent = dynamicResolution.getRenderExtent(swapChainExtent);
+	if (dynamicResolution.isEnabled())
 	{
-		throw std::runtime_error("Failed to allocate Command Buffers!");
+		printf("Dynamic resolution: holding %.0f fps, scale %.2f - %.2f\n", targetFramesPerSecond,
+			DYNAMIC_RESOLUTION_MIN_SCALE, DYNAMIC_RESOLUTION_MAX_SCALE);
 	}
 }
 
+void VulkanRenderer::createGpuProfiler()
+{
+	QueueFamilyIndices indices = getQueueFamilies(mainDevice.physicalDevice);
+
+	// One query slot per frame context, results are read when the context is recorded again.
+	// The async compute queue gets its own pools, its passes are timed as well.
+	gpuProfiler.create(mainDevice.physicalDevice, mainDevice.logicalDevice, indices.graphicsFamily, asyncComputeFamily,
+		static_cast<uint32_t>(frames.size()), pipelineStatisticsEnabled);
+}
+
 void VulkanRenderer::createSynchronisation()
 {
-	imageAvailable.resize(MAX_FRAME_DRAWS);
-	renderFinished.resize(MAX_FRAME_DRAWS);
-	drawFences.resize(MAX_FRAME_DRAWS);
+	renderFinished.resize(swapChainImages.size());
+	imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
 
 	// Semaphore creation information
 	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	// Fence creation information
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+	for (size_t i = 0; i < renderFinished.size(); i++)
 	{
-		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &imageAvailable[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderFinished[i]) != VK_SUCCESS ||
-			vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &drawFences[i]) != VK_SUCCESS)
+		if (vkCreateSemaphore(mainDevice.logicalDevice, &semaphoreCreateInfo, nullptr, &renderFinished[i]) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create a Semaphore and/or Fence!");
 		}
 	}
 }
 
+void VulkanRenderer::destroySynchronisation()
+{
+	for (auto semaphore : renderFinished) {
+		vkDestroySemaphore(mainDevice.logicalDevice, semaphore, nullptr);
+	}
+	renderFinished.clear();
+	imagesInFlight.clear();
+}
+
 void VulkanRenderer::createTextureSampler()
 {
 	// Sampler Creation Info
@@ -1270,7 +1987,7 @@ void VulkanRenderer::createTextureSampler()
 	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;		// Mipmap interpolation mode
 	samplerCreateInfo.mipLodBias = 0.0f;								// Level of Details bias for mip level
 	samplerCreateInfo.minLod = 0.0f;									// Minimum Level of Detail to pick mip level
-	samplerCreateInfo.maxLod = 0.0f;									// Maximum Level of Detail to pick mip level
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;						// Every mip the texture streamer made resident
 	samplerCreateInfo.anisotropyEnable = VK_TRUE;						// Enable Anisotropy
 	samplerCreateInfo.maxAnisotropy = 16;								// Anisotropy sample level
 
@@ -1279,270 +1996,565 @@ void VulkanRenderer::createTextureSampler()
 	{
 		throw std::runtime_error("Filed to create a Texture Sampler!");
 	}
+
+	// Full screen passes read render targets: bilinear, no mips, nothing beyond the edges
+	VkSamplerCreateInfo postSamplerCreateInfo = {};
+	postSamplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	postSamplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	postSamplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	postSamplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	postSamplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	postSamplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	postSamplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	postSamplerCreateInfo.maxLod = 0.0f;
+
+	result = vkCreateSampler(mainDevice.logicalDevice, &postSamplerCreateInfo, nullptr, &postSampler);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Sampler!");
+	}
 }
-void VulkanRenderer::createUniformBuffers()
+void VulkanRenderer::createDefaultMaterial()
 {
-	// ViewProjection buffer mrete
-	VkDeviceSize vpBufferSize = sizeof(UboViewProjection);
+	// White, so the factors of an empty slot are used as they are
+	int defaultTexture = createTexture("plain.png", VK_FORMAT_R8G8B8A8_UNORM);
+	materialLibrary.setDefaultTexture(textureStreamer.getView(defaultTexture));
+
+	// Material 0: white, rough and without textures
+	materialLibrary.acquire(MaterialDesc(), graphicsQueue, graphicsCommandPool, MaterialLibrary::TextureLoader());
+}
 
-	// Ambiant lighting buffer mrete
-	VkDeviceSize lightingBufferSize = sizeof(UboLighting);
+void VulkanRenderer::createEnvironmentLighting()
+{
+	// The precomputation runs on the graphics queue, it has compute too
+	environmentLighting.load(environmentFile, graphicsQueue, graphicsCommandPool, pipelineManager);
+}
 
-	// Egy uniform buffer minden egyes swap chain kphez (s ezzel egytt command bufferhez)
-	vpUniformBuffer.resize(swapChainImages.size());
-	vpUniformBufferMemory.resize(swapChainImages.size());
+VkDescriptorSet VulkanRenderer::updateUniformBuffers(FrameContext& frame)
+{
+	PROFILE_FUNCTION();
 
-	lightingUniformBuffer.resize(swapChainImages.size());
-	lightingUniformBufferMemory.resize(swapChainImages.size());
+	// Copy this frame's data into the frame's uniform ring, nothing in flight reads it
+	VkDescriptorBufferInfo vpBufferInfo = frame.uniforms.push(&uboViewProjection, sizeof(UboViewProjection));
+	VkDescriptorBufferInfo lightBufferInfo = frame.uniforms.push(&uboLighting, sizeof(UboLighting));
 
-	// Uniform bufferek ltrehozsa
-	for (size_t i = 0; i < swapChainImages.size(); i++)
+	// Point light list: the count in a 16 byte header, then the lights (std430)
+	uint32_t pointLightCount = static_cast<uint32_t>(pointLights.size());
+	std::vector<uint8_t> pointLightData(16 + std::max<size_t>(pointLights.size(), 1) * sizeof(PointLight), 0);
+	memcpy(pointLightData.data(), &pointLightCount, sizeof(uint32_t));
+	if (!pointLights.empty())
 	{
-		// ViewProjection buffer
-		createBuffer(
-			mainDevice.physicalDevice,
-			mainDevice.logicalDevice,
-			vpBufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&vpUniformBuffer[i],
-			&vpUniformBufferMemory[i]
-		);
+		memcpy(pointLightData.data() + 16, pointLights.data(), pointLights.size() * sizeof(PointLight));
+	}
+	VkDescriptorBufferInfo pointLightBufferInfo = frame.uniforms.push(pointLightData.data(), pointLightData.size());
+
+	// Set 0 lives until this context is begun again
+	VkDescriptorSet uniformSet = frame.allocateDescriptorSet(descriptorSetLayout);
+
+	// Data about connection between binding and buffer
+	VkWriteDescriptorSet vpSetWrite = {};
+	vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	vpSetWrite.dstSet = uniformSet;										// Descriptor Set to update
+	vpSetWrite.dstBinding = 0;											// Binding to update (matches with binding on layout/shader)
+	vpSetWrite.dstArrayElement = 0;										// Index in array to update
+	vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;		// Type of descriptor
+	vpSetWrite.descriptorCount = 1;										// Amount to update
+	vpSetWrite.pBufferInfo = &vpBufferInfo;								// Information about buffer data to bind
+
+	VkWriteDescriptorSet lightSetWrite = {};
+	lightSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	lightSetWrite.dstSet = uniformSet;
+	lightSetWrite.dstBinding = 1;
+	lightSetWrite.dstArrayElement = 0;
+	lightSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	lightSetWrite.descriptorCount = 1;
+	lightSetWrite.pBufferInfo = &lightBufferInfo;
+
+	VkWriteDescriptorSet pointLightSetWrite = {};
+	pointLightSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	pointLightSetWrite.dstSet = uniformSet;
+	pointLightSetWrite.dstBinding = 2;
+	pointLightSetWrite.dstArrayElement = 0;
+	pointLightSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pointLightSetWrite.descriptorCount = 1;
+	pointLightSetWrite.pBufferInfo = &pointLightBufferInfo;
+
+	// Written by this frame's ambient occlusion passes, read with texelFetch
+	VkDescriptorImageInfo occlusionImageInfo = {};
+	occlusionImageInfo.sampler = postSampler;
+	occlusionImageInfo.imageView = ambientOcclusion.getOutputView();
+	occlusionImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet occlusionSetWrite = {};
+	occlusionSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	occlusionSetWrite.dstSet = uniformSet;
+	occlusionSetWrite.dstBinding = 3;
+	occlusionSetWrite.dstArrayElement = 0;
+	occlusionSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	occlusionSetWrite.descriptorCount = 1;
+	occlusionSetWrite.pImageInfo = &occlusionImageInfo;
+
+	// This context's feedback buffer, read back when the context comes around again
+	VkDescriptorBufferInfo feedbackBufferInfo = {};
+	feedbackBufferInfo.buffer = textureStreamer.getFeedbackBuffer(currentFrame);
+	feedbackBufferInfo.offset = 0;
+	feedbackBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet feedbackSetWrite = {};
+	feedbackSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	feedbackSetWrite.dstSet = uniformSet;
+	feedbackSetWrite.dstBinding = 4;
+	feedbackSetWrite.dstArrayElement = 0;
+	feedbackSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	feedbackSetWrite.descriptorCount = 1;
+	feedbackSetWrite.pBufferInfo = &feedbackBufferInfo;
+
+	std::array<VkWriteDescriptorSet, 5> setWrites = { vpSetWrite, lightSetWrite, pointLightSetWrite, occlusionSetWrite, feedbackSetWrite };
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+
+	return uniformSet;
+}
 
-		// Ambient lighting buffer
-		createBuffer(
-			mainDevice.physicalDevice,
-			mainDevice.logicalDevice,
-			lightingBufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&lightingUniformBuffer[i],
-			&lightingUniformBufferMemory[i]
-		);
+void VulkanRenderer::recordMainPass(VkCommandBuffer commandBuffer)
+{
+	PROFILE_FUNCTION();
 
-	}
+	// Bind Pipeline to be used in render pass
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+	// Only the dynamic resolution's share of the targets is rendered, the TAA pass upsamples it
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(renderExtent.width);
+	viewport.height = static_cast<float>(renderExtent.height);
+	viewport.maxDepth = 1.0f;
+	VkRect2D scissor = {};
+	scissor.extent = renderExtent;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	drawVisibleEntities(commandBuffer);
+	drawTerrain(commandBuffer, false);
 }
 
-void VulkanRenderer::createDescriptorPool()
+void VulkanRenderer::recordDepthPrepass(VkCommandBuffer commandBuffer)
 {
-	// CREATE UNIFORM DESCRIPTOR POOL
-	// Type of descriptors + how many DESCRIPTORS, not Descriptor Sets (combined makes the pool size)
-	// ViewProjection Pool
-	VkDescriptorPoolSize vpPoolSize = {};
-	vpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	vpPoolSize.descriptorCount = static_cast<uint32_t>(vpUniformBuffer.size());
-
-	// light pool
-	VkDescriptorPoolSize vpPoolSizeLight = {};
-	vpPoolSizeLight.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	vpPoolSizeLight.descriptorCount = static_cast<uint32_t>(lightingUniformBuffer.size());
+	PROFILE_FUNCTION();
 
-	// Model Pool (DYNAMIC)
-	/*VkDescriptorPoolSize modelPoolSize = {};
-	modelPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-	modelPoolSize.descriptorCount = static_cast<uint32_t>(modelDUniformBuffer.size());*/
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
 
-	// List of pool sizes
-	std::vector<VkDescriptorPoolSize> descriptorPoolSizes = { vpPoolSize, vpPoolSizeLight };
+	// Same area as the scene pass
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(renderExtent.width);
+	viewport.height = static_cast<float>(renderExtent.height);
+	viewport.maxDepth = 1.0f;
+	VkRect2D scissor = {};
+	scissor.extent = renderExtent;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	// Data to create Descriptor Pool
-	VkDescriptorPoolCreateInfo poolCreateInfo = {};
-	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolCreateInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());					// Maximum number of Descriptor Sets that can be created from pool
-	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());		// Amount of Pool Sizes being passed
-	poolCreateInfo.pPoolSizes = descriptorPoolSizes.data();									// Pool Sizes to create pool with
+	drawVisibleEntities(commandBuffer);
+	drawTerrain(commandBuffer, true);
+}
 
-	// Create Descriptor Pool
-	VkResult result = vkCreateDescriptorPool(mainDevice.logicalDevice, &poolCreateInfo, nullptr, &descriptorPool);
-	if (result != VK_SUCCESS)
+void VulkanRenderer::drawVisibleEntities(VkCommandBuffer commandBuffer)
+{
+	// A draw per mesh of the entities that passed frustum culling
+	drawList.clear();
+	for (Entity entity : visibleEntities)
 	{
-		throw std::runtime_error("Failed to create a Descriptor Pool!");
+		TransformComponent* transform = registry.getComponent<TransformComponent>(entity);
+		RenderMeshComponent* renderMesh = registry.getComponent<RenderMeshComponent>(entity);
+		if (transform == nullptr || renderMesh == nullptr)
+		{
+			continue;
+		}
+
+		MeshModel& thisModel = modelList[renderMesh->modelIndex];
+		for (size_t k = 0; k < thisModel.getMeshCount(); k++)
+		{
+			drawList.push_back({ thisModel.getMesh(k)->getMaterialId(), entity, static_cast<uint32_t>(k) });
+		}
 	}
 
-	// CREATE SAMPLER DESCRIPTOR POOL
-	// Texture sampler pool
-	VkDescriptorPoolSize samplerPoolSize = {};
-	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerPoolSize.descriptorCount = MAX_OBJECTS;
+	// Grouped by material, then by entity, so both change as rarely as possible
+	std::sort(drawList.begin(), drawList.end(), [](const DrawItem& a, const DrawItem& b)
+		{
+			if (a.materialId != b.materialId)
+			{
+				return a.materialId < b.materialId;
+			}
+			return a.entity != b.entity ? a.entity < b.entity : a.meshIndex < b.meshIndex;
+		});
+
+	// Set 0, the environment (set 2) and the virtual texture (set 3) are the same for every draw
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+		0, 1, &frameUniformSet, 0, nullptr);
+	std::array<VkDescriptorSet, 2> sharedSets = { environmentLighting.getDescriptorSet(), virtualTexture.getDescriptorSet() };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+		2, static_cast<uint32_t>(sharedSets.size()), sharedSets.data(), 0, nullptr);
+
+	uint32_t boundMaterial = UINT32_MAX;
+	Entity pushedEntity = INVALID_ENTITY;
+	for (const DrawItem& item : drawList)
+	{
+		if (item.materialId != boundMaterial)
+		{
+			VkDescriptorSet materialSet = materialLibrary.getDescriptorSet(item.materialId);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+				1, 1, &materialSet, 0, nullptr);
+			boundMaterial = item.materialId;
+		}
+
+		if (item.entity != pushedEntity)
+		{
+			// "Push" constants to given shader stage directly (no buffer)
+			TransformComponent* transform = registry.getComponent<TransformComponent>(item.entity);
+			PushModel pushModel = { transform->model, transform->previousModel };
+			vkCmdPushConstants(
+				commandBuffer,
+				pipelineLayout,
+				VK_SHADER_STAGE_VERTEX_BIT,		// Stage to push constants to
+				0,								// Offset of push constants to update
+				sizeof(PushModel),				// Size of data being pushed
+				&pushModel);					// Actual data being pushed (can be array)
+			pushedEntity = item.entity;
+		}
+
+		Mesh* mesh = modelList[registry.getComponent<RenderMeshComponent>(item.entity)->modelIndex].getMesh(item.meshIndex);
 
-	VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
-	samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
-	samplerPoolCreateInfo.poolSizeCount = 1;
-	samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
+		VkBuffer vertexBuffers[] = { mesh->getVertexBuffer() };								// Buffers to bind
+		VkDeviceSize offsets[] = { 0 };														// Offsets into buffers being bound
+		gpuSkinning.getSkinnedVertices(item.entity, item.meshIndex, &vertexBuffers[0], &offsets[0]);	// Posed this frame, if animated
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);	// Command to bind vertex buffer before drawing with them
 
-	result = vkCreateDescriptorPool(mainDevice.logicalDevice, &samplerPoolCreateInfo, nullptr, &samplerDescriptorPool);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create a Descriptor Pool!");
+		// Bind mesh index buffer, with 0 offset and using the uint32 type
+		vkCmdBindIndexBuffer(commandBuffer, mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+		// Execute pipeline
+		vkCmdDrawIndexed(commandBuffer, mesh->getIndexCount(), 1, 0, 0, 0);
 	}
 }
 
-void VulkanRenderer::createDescriptorSets()
+void VulkanRenderer::drawTerrain(VkCommandBuffer commandBuffer, bool depthOnly)
 {
-	// Resize Descriptor Set list so one for every buffer
-	descriptorSets.resize(swapChainImages.size());
+	// Binds its own pipeline, the passes draw nothing after it
+	std::array<VkDescriptorSet, 4> sceneSets = { frameUniformSet, materialLibrary.getDescriptorSet(terrainMaterial),
+		environmentLighting.getDescriptorSet(), virtualTexture.getDescriptorSet() };
+	terrain.record(commandBuffer, depthOnly, sceneSets);
+}
 
-	std::vector<VkDescriptorSetLayout> setLayouts(swapChainImages.size(), descriptorSetLayout);
+void VulkanRenderer::recordDeferredPass(VkCommandBuffer commandBuffer)
+{
+	PROFILE_FUNCTION();
 
-	// Descriptor Set Allocation Info
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = descriptorPool;									// Pool to allocate Descriptor Set from
-	setAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());// Number of sets to allocate
-	setAllocInfo.pSetLayouts = setLayouts.data();									// Layouts to use to allocate sets (1:1 relationship)
+	// -- G-BUFFER --
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gbufferPipeline);
 
-	// Allocate descriptor sets (multiple)
-	VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, descriptorSets.data());
-	if (result != VK_SUCCESS)
+	// Only the dynamic resolution's share of the targets is rendered, like the forward path
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(renderExtent.width);
+	viewport.height = static_cast<float>(renderExtent.height);
+	viewport.maxDepth = 1.0f;
+	VkRect2D scissor = {};
+	scissor.extent = renderExtent;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	drawVisibleEntities(commandBuffer);
+	drawTerrain(commandBuffer, false);
+
+	// -- LIGHTING --
+	// Viewport and scissor carry over, the lighting covers the same area
+	vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+	PushDeferredLighting pushLighting;
+	pushLighting.inverseViewProjection = glm::inverse(uboViewProjection.projection * uboViewProjection.view);
+	pushLighting.cameraPosition = glm::inverse(uboViewProjection.view)[3];
+	pushLighting.renderSize = glm::vec2(static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height));
+	pushLighting.tileSize = lightTileSize;
+	pushLighting.tileCountX = (renderExtent.width + lightTileSize - 1) / lightTileSize;
+
+	std::array<VkDescriptorSet, 3> descriptorSets = { frameUniformSet, deferredSet, environmentLighting.getDescriptorSet() };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferredLightingPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, deferredPipelineLayout,
+		0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+	vkCmdPushConstants(commandBuffer, deferredPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushDeferredLighting), &pushLighting);
+
+	// Full screen triangle, the vertex shader generates it from the vertex index
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void VulkanRenderer::recordLightCulling(VkCommandBuffer commandBuffer)
+{
+	PROFILE_FUNCTION();
+
+	PushLightCulling pushCulling;
+	pushCulling.inverseProjection = glm::inverse(uboViewProjection.projection);
+	pushCulling.renderSize = glm::uvec2(renderExtent.width, renderExtent.height);
+	pushCulling.tileSize = lightTileSize;
+	pushCulling.tileCountX = (renderExtent.width + lightTileSize - 1) / lightTileSize;
+	uint32_t tileCountY = (renderExtent.height + lightTileSize - 1) / lightTileSize;
+
+	std::array<VkDescriptorSet, 2> descriptorSets = { frameUniformSet, lightCullingSet };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullingPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightCullingPipelineLayout,
+		0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+	vkCmdPushConstants(commandBuffer, lightCullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushLightCulling), &pushCulling);
+
+	// One workgroup per tile, its threads split the light list
+	vkCmdDispatch(commandBuffer, pushCulling.tileCountX, tileCountY, 1);
+}
+
+void VulkanRenderer::updateDeferredDescriptors(FrameContext& frame)
+{
+	// Larger tiles once the render area has more tiles than the buffer holds
+	lightTileSize = chooseLightTileSize(renderExtent);
+
+	// The graph's views change with a resize, the sets are written every frame
+	std::array<VkDescriptorImageInfo, 4> inputInfos = {};
+	inputInfos[0].imageView = renderGraph.getImageView(gbufferAlbedoResource);
+	inputInfos[1].imageView = renderGraph.getImageView(gbufferNormalResource);
+	inputInfos[2].imageView = renderGraph.getImageView(gbufferEmissiveResource);
+	inputInfos[3].imageView = renderGraph.getImageView(depthResource);
+	inputInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	inputInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	inputInfos[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	inputInfos[3].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkDescriptorBufferInfo tileLightsInfo = {};
+	tileLightsInfo.buffer = renderGraph.getBuffer(tileLightsResource);
+	tileLightsInfo.offset = 0;
+	tileLightsInfo.range = VK_WHOLE_SIZE;
+
+	deferredSet = frame.allocateDescriptorSet(deferredSetLayout);
+	lightCullingSet = frame.allocateDescriptorSet(lightCullingSetLayout);
+
+	std::array<VkWriteDescriptorSet, 3> setWrites = {};
+	setWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[0].dstSet = deferredSet;
+	setWrites[0].dstBinding = 0;
+	setWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	setWrites[0].descriptorCount = static_cast<uint32_t>(inputInfos.size());
+	setWrites[0].pImageInfo = inputInfos.data();
+
+	setWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[1].dstSet = deferredSet;
+	setWrites[1].dstBinding = 4;
+	setWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	setWrites[1].descriptorCount = 1;
+	setWrites[1].pBufferInfo = &tileLightsInfo;
+
+	setWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrites[2].dstSet = lightCullingSet;
+	setWrites[2].dstBinding = 0;
+	setWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	setWrites[2].descriptorCount = 1;
+	setWrites[2].pBufferInfo = &tileLightsInfo;
+
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+}
+
+void VulkanRenderer::createTemporalHistory()
+{
+	for (uint32_t i = 0; i < historyImages.size(); i++)
+	{
+		historyImages[i] = createImage(swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &historyMemory[i]);
+		historyImageViews[i] = createImageView(historyImages[i], VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		// Every frame starts with both histories shader readable (the state the graph leaves them in)
+		transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, historyImages[i],
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	historyValid = false;
+}
+
+void VulkanRenderer::destroyTemporalHistory()
+{
+	for (uint32_t i = 0; i < historyImages.size(); i++)
 	{
-		throw std::runtime_error("Failed to allocate Descriptor Sets!");
+		vkDestroyImageView(mainDevice.logicalDevice, historyImageViews[i], nullptr);
+		vkDestroyImage(mainDevice.logicalDevice, historyImages[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, historyMemory[i], nullptr);
+		historyImageViews[i] = VK_NULL_HANDLE;
+		historyImages[i] = VK_NULL_HANDLE;
+		historyMemory[i] = VK_NULL_HANDLE;
 	}
+}
 
-	// Update all of descriptor set buffer bindings
-	for (size_t i = 0; i < swapChainImages.size(); i++)
+VkDescriptorSet VulkanRenderer::updateTemporalDescriptors(FrameContext& frame)
+{
+	// The graph's views change with a resize, the set is written every frame
+	std::array<VkDescriptorImageInfo, 3> imageInfos = {};
+	imageInfos[0].imageView = renderGraph.getImageView(sceneColourResource);
+	imageInfos[1].imageView = renderGraph.getImageView(velocityResource);
+	imageInfos[2].imageView = historyImageViews[historyIndex ^ 1];
+	for (auto& imageInfo : imageInfos)
 	{
-		// VIEW PROJECTION DESCRIPTOR
-		// Buffer info and data offset info
-		VkDescriptorBufferInfo vpBufferInfo = {};
-		vpBufferInfo.buffer = vpUniformBuffer[i];		// Buffer to get data from
-		vpBufferInfo.offset = 0;						// Position of start of data
-		vpBufferInfo.range = sizeof(UboViewProjection);				// Size of data
+		imageInfo.sampler = postSampler;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
 
-		// light description
-		VkDescriptorBufferInfo lightBufferInfo = {};
-		lightBufferInfo.buffer = lightingUniformBuffer[i];
-		lightBufferInfo.offset = 0;
-		lightBufferInfo.range = sizeof(UboLighting);
+	VkDescriptorSet set = frame.allocateDescriptorSet(taaSetLayout);
 
-		// Data about connection between binding and buffer
-		VkWriteDescriptorSet vpSetWrite = {};
-		vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		vpSetWrite.dstSet = descriptorSets[i];								// Descriptor Set to update
-		vpSetWrite.dstBinding = 0;											// Binding to update (matches with binding on layout/shader)
-		vpSetWrite.dstArrayElement = 0;									// Index in array to update
-		vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;		// Type of descriptor
-		vpSetWrite.descriptorCount = 1;									// Amount to update
-		vpSetWrite.pBufferInfo = &vpBufferInfo;							// Information about buffer data to bind
+	VkWriteDescriptorSet setWrite = {};
+	setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	setWrite.dstSet = set;
+	setWrite.dstBinding = 0;
+	setWrite.dstArrayElement = 0;
+	setWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	setWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+	setWrite.pImageInfo = imageInfos.data();
 
-		VkWriteDescriptorSet lightSetWrite = {};
-		lightSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		lightSetWrite.dstSet = descriptorSets[i];
-		lightSetWrite.dstBinding = 1;
-		lightSetWrite.dstArrayElement = 0;
-		lightSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		lightSetWrite.descriptorCount = 1;
-		lightSetWrite.pBufferInfo = &lightBufferInfo;
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &setWrite, 0, nullptr);
 
+	return set;
+}
 
-		// List of Descriptor Set Writes
-		std::vector<VkWriteDescriptorSet> setWrites = { vpSetWrite, lightSetWrite };
+void VulkanRenderer::createAmbientOcclusion()
+{
+	ambientOcclusion.create(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool);
 
-		// Update the descriptor sets with new buffer/binding info
-		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(setWrites.size()), setWrites.data(),
-			0, nullptr);
-	}
+	// Built in createPostProcessing with every other compute pipeline
+	ambientOcclusion.appendPipelineDescs(computePipelineDescs, computePipelineHandles);
 }
 
-void VulkanRenderer::updateUniformBuffers(uint32_t imageIndex)
+void VulkanRenderer::createSkinning()
 {
-	// Frisstjk a ViewProjection adatokat
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex], 0, sizeof(UboViewProjection), 0, &data);
-	memcpy(data, &uboViewProjection, sizeof(UboViewProjection));
-	vkUnmapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex]);
+	animationSystem.create();
+	gpuSkinning.create(mainDevice.physicalDevice, mainDevice.logicalDevice);
 
-	// Frisstjk a Amb Lighting adatokat
-	vkMapMemory(mainDevice.logicalDevice, lightingUniformBufferMemory[imageIndex], 0, sizeof(UboLighting), 0, &data);
-	memcpy(data, &uboLighting, sizeof(UboLighting));
-	vkUnmapMemory(mainDevice.logicalDevice, lightingUniformBufferMemory[imageIndex]);
+	// Built in createPostProcessing with every other compute pipeline
+	gpuSkinning.appendPipelineDescs(computePipelineDescs, computePipelineHandles);
 }
 
-void VulkanRenderer::recordCommands(uint32_t currentImage)
+void VulkanRenderer::createParticles()
 {
-	// Information about how to begin each command buffer
-	VkCommandBufferBeginInfo bufferBeginInfo = {};
-	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	particleSystem.create(mainDevice.physicalDevice, mainDevice.logicalDevice, particleCapacity, graphicsQueue, graphicsCommandPool);
 
-	// Information about how to begin a render pass (only needed for graphical applications)
-	VkRenderPassBeginInfo renderPassBeginInfo = {};
-	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.renderPass = renderPass;							// Render Pass to begin
-	renderPassBeginInfo.renderArea.offset = { 0, 0 };						// Start point of render pass in pixels
-	renderPassBeginInfo.renderArea.extent = swapChainExtent;				// Size of region to run render pass on (starting at offset)
+	// The draw pipeline is rebuilt by the hot reload like the others, the compute ones are built in createPostProcessing
+	std::vector<GraphicsPipelineDesc> graphicsDescs;
+	std::vector<VkPipeline*> graphicsHandles;
+	particleSystem.appendPipelineDescs(graphicsDescs, graphicsHandles, computePipelineDescs, computePipelineHandles);
 
-	std::array<VkClearValue, 2> clearValues = {};
-	clearValues[0].color = { 0.5f, 0.5f, 0.5f, 1.0f };
-	clearValues[1].depthStencil.depth = 1.0f;
+	std::vector<VkPipeline> graphicsPipelines = pipelineManager.createGraphicsPipelines(graphicsDescs);
+	for (size_t i = 0; i < graphicsPipelines.size(); i++)
+	{
+		*graphicsHandles[i] = graphicsPipelines[i];
+	}
+	pipelineDescs.insert(pipelineDescs.end(), graphicsDescs.begin(), graphicsDescs.end());
+	pipelineHandles.insert(pipelineHandles.end(), graphicsHandles.begin(), graphicsHandles.end());
+}
 
-	renderPassBeginInfo.pClearValues = clearValues.data();					// List of clear values
-	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+void VulkanRenderer::createTextureStreaming()
+{
+	textureStreamer.create(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, &materialLibrary,
+		framesInFlight, memoryBudgetEnabled, textureBudget);
+}
 
-	renderPassBeginInfo.framebuffer = swapChainFramebuffers[currentImage];
+void VulkanRenderer::createVirtualTexture()
+{
+	virtualTexture.load(virtualTextureFile, framesInFlight, graphicsQueue, graphicsCommandPool);
+}
 
-	// Start recording commands to command buffer!
-	VkResult result = vkBeginCommandBuffer(commandBuffers[currentImage], &bufferBeginInfo);
-	if (result != VK_SUCCESS)
+void VulkanRenderer::createTerrain()
+{
+	if (terrainFile.empty())
 	{
-		throw std::runtime_error("Failed to start recording a Command Buffer!");
+		return;
 	}
 
-	// Begin Render Pass
-	vkCmdBeginRenderPass(commandBuffers[currentImage], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-	// Bind Pipeline to be used in render pass
-	vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	terrain.load(terrainFile, terrainSettings, graphicsQueue, graphicsCommandPool);
 
-	for (size_t j = 0; j < modelList.size(); j++)
+	// A rough grass green, or the virtual texture stretched over the whole terrain
+	MaterialDesc desc;
+	desc.baseColourFactor = glm::vec4(0.35f, 0.45f, 0.25f, 1.0f);
+	desc.roughness = 0.9f;
+	if (virtualTexture.isLoaded())
 	{
-		MeshModel thisModel = modelList[j];
+		desc.baseColourFactor = glm::vec4(1.0f);
+		desc.virtualTexture = true;
+		virtualTexture.setArea(glm::vec2(terrainSettings.origin.x, terrainSettings.origin.z), glm::vec2(terrainSettings.size));
+	}
+	terrainMaterial = materialLibrary.acquire(desc, graphicsQueue, graphicsCommandPool, makeTextureLoader(nullptr));
+}
 
-		vkCmdPushConstants(
-			commandBuffers[currentImage],
-			pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,		// Stage to push constants to
-			0,								// Offset of push constants to update
-			sizeof(Model),					// Size of data being pushed
-			thisModel.getModelRef());			// Actual data being pushed (can be array)
+void VulkanRenderer::createPostProcessing()
+{
+	postProcessing.create(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, swapChainImageFormat);
 
-		for (size_t k = 0; k < thisModel.getMeshCount(); k++)
-		{
+	// Rebuilt by the hot reload like the others, the post processing keeps owning them
+	std::vector<GraphicsPipelineDesc> graphicsDescs;
+	std::vector<VkPipeline*> graphicsHandles;
+	postProcessing.appendPipelineDescs(graphicsDescs, graphicsHandles, computePipelineDescs, computePipelineHandles);
 
-			VkBuffer vertexBuffers[] = { thisModel.getMesh(k)->getVertexBuffer() };					// Buffers to bind
-			VkDeviceSize offsets[] = { 0 };												// Offsets into buffers being bound
-			vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets);	// Command to bind vertex buffer before drawing with them
+	std::vector<VkPipeline> graphicsPipelines = pipelineManager.createGraphicsPipelines(graphicsDescs);
+	for (size_t i = 0; i < graphicsPipelines.size(); i++)
+	{
+		*graphicsHandles[i] = graphicsPipelines[i];
+	}
+	pipelineDescs.insert(pipelineDescs.end(), graphicsDescs.begin(), graphicsDescs.end());
+	pipelineHandles.insert(pipelineHandles.end(), graphicsHandles.begin(), graphicsHandles.end());
 
-			// Bind mesh index buffer, with 0 offset and using the uint32 type
-			vkCmdBindIndexBuffer(commandBuffers[currentImage], thisModel.getMesh(k)->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	// Every compute pipeline in one batch, the light culling's (deferred path) included
+	std::vector<VkPipeline> computePipelines = pipelineManager.createComputePipelines(computePipelineDescs);
+	for (size_t i = 0; i < computePipelines.size(); i++)
+	{
+		*computePipelineHandles[i] = computePipelines[i];
+	}
+}
 
-			// Dynamic Offset Amount
-			// uint32_t dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * j;
+void VulkanRenderer::recordTemporalPass(VkCommandBuffer commandBuffer)
+{
+	PROFILE_FUNCTION();
 
-			// "Push" constants to given shader stage directly (no buffer)
+	VkExtent2D sceneExtent = renderGraph.getImageExtent(sceneColourResource);
 
+	PushTaa pushTaa;
+	pushTaa.renderScale = glm::vec2(static_cast<float>(renderExtent.width) / sceneExtent.width, static_cast<float>(renderExtent.height) / sceneExtent.height);
+	pushTaa.jitter = jitter / glm::vec2(static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height));
+	pushTaa.sceneTexelSize = glm::vec2(1.0f / sceneExtent.width, 1.0f / sceneExtent.height);
+	pushTaa.blendFactor = 0.1f;
+	pushTaa.historyValid = historyValid ? 1.0f : 0.0f;
 
-			std::array<VkDescriptorSet, 2> descriptorSetGroup = { descriptorSets[currentImage],
-				samplerDescriptorSets[thisModel.getMesh(k)->getTexId()] };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, taaPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, taaPipelineLayout, 0, 1, &taaSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, taaPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushTaa), &pushTaa);
 
-			// Bind Descriptor Sets
-			vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
-				0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+	// Full screen triangle, the vertex shader generates it from the vertex index
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
 
-			// Execute pipeline
-			vkCmdDrawIndexed(commandBuffers[currentImage], thisModel.getMesh(k)->getIndexCount(), 1, 0, 0, 0);
+void VulkanRenderer::updateParticleEmitters()
+{
+	for (const ParticleAttachment& attachment : particleAttachments)
+	{
+		// The entity may have been destroyed, its emitter then stays where it was
+		const TransformComponent* transform = registry.getComponent<TransformComponent>(attachment.entity);
+		if (transform == nullptr)
+		{
+			continue;
+		}
+		particleSystem.setEmitterTransform(attachment.emitter, transform->position + attachment.offset, getTransformDirection(*transform));
+		if (attachment.entity == lightSource)
+		{
+			particleSystem.setEmitterLength(attachment.emitter, std::min(attachment.length, lightTargetDistance));
 		}
 	}
+}
 
-	// End Render Pass
-	vkCmdEndRenderPass(commandBuffers[currentImage]);
+void VulkanRenderer::updateSceneVisibility()
+{
+	PROFILE_FUNCTION();
 
-	// Stop recording to command buffer
-	result = vkEndCommandBuffer(commandBuffers[currentImage]);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to stop recording a Command Buffer!");
-	}
+	// Refit the hierarchy to the current transforms
+	updateSceneBVH(registry, sceneBVH);
 
+	// Collect what the camera can see, a flat SIMD pass beats the tree walk for a full visibility list
+	Frustum frustum = extractFrustum(uboViewProjection.projection * uboViewProjection.view);
+	gatherCullingSpheres(registry, sceneCuller);
+	sceneCuller.cull(frustum, visibleEntities);
 }
 
 void VulkanRenderer::getPhysicalDevice()
@@ -1681,7 +2693,7 @@ bool VulkanRenderer::checkDeviceSuitable(VkPhysicalDevice device)
 		swapChainValid = !swapChainDetails.presentationModes.empty() && !swapChainDetails.formats.empty();
 	}
 
-	return indices.isValid() && extensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy;
+	return indices.isValid() && extensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy && deviceFeatures.fragmentStoresAndAtomics;
 }
 
 QueueFamilyIndices VulkanRenderer::getQueueFamilies(VkPhysicalDevice device)
@@ -1724,6 +2736,17 @@ QueueFamilyIndices VulkanRenderer::getQueueFamilies(VkPhysicalDevice device)
 		i++;
 	}
 
+	// A compute family without graphics maps to the async compute engine, the first one is used
+	for (uint32_t family = 0; family < queueFamilyCount; family++)
+	{
+		if (queueFamilyList[family].queueCount > 0 && (queueFamilyList[family].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+			!(queueFamilyList[family].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			indices.computeFamily = static_cast<int>(family);
+			break;
+		}
+	}
+
 	return indices;
 }
 
@@ -1787,17 +2810,8 @@ VkSurfaceFormatKHR VulkanRenderer::chooseBestSurfaceFormat(const std::vector<VkS
 
 VkPresentModeKHR VulkanRenderer::chooseBestPresentationMode(const std::vector<VkPresentModeKHR> presentationModes)
 {
-	// Look for Mailbox presentation mode
-	for (const auto& presentationMode : presentationModes)
-	{
-		if (presentationMode == VK_PRESENT_MODE_MAILBOX_KHR)
-		{
-			return presentationMode;
-		}
-	}
-
-	// If can't find, use FIFO as Vulkan spec says it must be present
-	return VK_PRESENT_MODE_FIFO_KHR;
+	// Requested mode if supported, otherwise its fallback (FIFO as Vulkan spec says it must be present)
+	return framePacer.choosePresentMode(presentationModes);
 }
 
 VkExtent2D VulkanRenderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities)
@@ -1932,182 +2946,256 @@ VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkIm
 	return imageView;
 }
 
-VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code)
+int VulkanRenderer::createTextureImage(std::string fileName, VkFormat format, const DecodedTexture* decoded)
 {
-	// Shader Module creation information
-	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
-	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderModuleCreateInfo.codeSize = code.size();										// Size of code
-	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());		// Pointer to code (of uint32_t pointer type)
+	// Load image file, unless another thread has decoded it already
+	int width, height;
+	VkDeviceSize imageSize;
+	stbi_uc* imageData = nullptr;
+	const unsigned char* pixels;
+	if (decoded != nullptr)
+	{
+		width = decoded->width;
+		height = decoded->height;
+		pixels = decoded->pixels.data();
+	}
+	else
+	{
+		imageData = loadTextureFile(fileName, &width, &height, &imageSize);
+		pixels = imageData;
+	}
 
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(mainDevice.logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
+	// The streamer keeps the mip chain, only the smallest mips are uploaded until the screen asks for more
+	int textureId = static_cast<int>(textureStreamer.addTexture(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), format));
+
+	// Free original image data
+	if (imageData != nullptr)
 	{
-		throw std::runtime_error("Failed to create a shader module!");
+		stbi_image_free(imageData);
 	}
 
-	return shaderModule;
+	return textureId;
 }
 
-int VulkanRenderer::createTextureImage(std::string fileName)
+int VulkanRenderer::createTexture(std::string fileName, VkFormat format, const DecodedTexture* decoded)
 {
-	// Load image file
-	int width, height;
-	VkDeviceSize imageSize;
-	stbi_uc* imageData = loadTextureFile(fileName, &width, &height, &imageSize);
+	// Already loaded for another material
+	std::string key = fileName + "#" + std::to_string(format);
+	auto cached = textureCache.find(key);
+	if (cached != textureCache.end())
+	{
+		return cached->second;
+	}
 
-	// Create staging buffer to hold loaded data, ready to copy to device
-	VkBuffer imageStagingBuffer;
-	VkDeviceMemory imageStagingBufferMemory;
-	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&imageStagingBuffer, &imageStagingBufferMemory);
+	// Create Texture Image, its view changes as its mips are streamed
+	int textureId = createTextureImage(fileName, format, decoded);
+	textureCache[key] = textureId;
+	return textureId;
+}
 
-	// Copy image data to staging buffer
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, imageStagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, imageData, static_cast<size_t>(imageSize));
-	vkUnmapMemory(mainDevice.logicalDevice, imageStagingBufferMemory);
+Entity VulkanRenderer::createMeshModel(std::string modelFile, bool controlable, glm::vec3 startPos, bool isLookingAt, glm::vec3 lookAt)
+{
+	PROFILE_FUNCTION();
 
-	// Free original image data
-	stbi_image_free(imageData);
+	// Import model "scene"
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(modelFile, MODEL_IMPORT_FLAGS);
+	if (!scene)
+	{
+		throw std::runtime_error("Failed to load model! (" + modelFile + ")");
+	}
 
-	// Create image to hold final texture
-	VkImage texImage;
-	VkDeviceMemory texImageMemory;
-	texImage = createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texImageMemory);
+	return createMeshModelFromScene(scene, controlable, startPos, isLookingAt, lookAt, nullptr);
+}
 
+Entity VulkanRenderer::createMeshModelFromScene(const aiScene* scene, bool controlable, glm::vec3 startPos, bool isLookingAt, glm::vec3 lookAt,
+	const DecodedTextureMap* decodedTextures)
+{
+	// Get vector of all materials with 1:1 ID placement
+	std::vector<MaterialDesc> materials = MeshModel::LoadMaterials(scene);
 
-	// COPY DATA TO IMAGE
-	// Transition image to be DST for copy operation
-	transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool,
-		texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	MaterialLibrary::TextureLoader loadTexture = makeTextureLoader(decodedTextures);
 
-	// Copy image data
-	copyImageBuffer(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, imageStagingBuffer, texImage, width, height);
+	// Conversion from the materials list IDs to the material library's IDs, equal materials share one
+	std::vector<uint32_t> matToMaterial(materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		matToMaterial[i] = materialLibrary.acquire(materials[i], graphicsQueue, graphicsCommandPool, loadTexture);
+	}
 
-	// Transition image to be shader readable for shader usage
-	transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool,
-		texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// The node hierarchy as joints, the clips are resampled against it
+	Skeleton skeleton = MeshModel::LoadSkeleton(scene);
+	std::vector<AnimationClip> clips = MeshModel::LoadAnimations(scene, skeleton);
 
-	// Add texture data to vector for reference
-	textureImages.push_back(texImage);
-	textureImageMemory.push_back(texImageMemory);
+	// Load in all our meshes, the bones of the skinned ones are collected in skinBones
+	std::vector<SkinBone> skinBones;
+	std::vector<Mesh> modelMeshes = MeshModel::LoadNode(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool,
+		scene->mRootNode, scene, matToMaterial, skeleton, skinBones);
 
-	// Destroy staging buffers
-	vkDestroyBuffer(mainDevice.logicalDevice, imageStagingBuffer, nullptr);
-	vkFreeMemory(mainDevice.logicalDevice, imageStagingBufferMemory, nullptr);
+	// Create mesh model and add to list, in the slot of a destroyed one if there is any
+	MeshModel model = skinBones.empty() ? MeshModel(modelMeshes) : MeshModel(modelMeshes, skeleton, skinBones, clips);
+	uint32_t modelIndex;
+	if (!freeModelSlots.empty())
+	{
+		modelIndex = freeModelSlots.back();
+		freeModelSlots.pop_back();
+		modelList[modelIndex] = model;
+	}
+	else
+	{
+		modelIndex = static_cast<uint32_t>(modelList.size());
+		modelList.push_back(model);
+	}
 
-	// Return index of new texture image
-	return textureImages.size() - 1;
-}
+	// Create the entity drawing the model, controllable ones also get a controller, animated ones play their first clip
+	ComponentMask mask = TRANSFORM_BIT | RENDER_MESH_BIT | BOUNDS_BIT;
+	if (controlable)
+	{
+		mask |= CONTROLLER_BIT;
+	}
+	if (modelList[modelIndex].isSkinned() && !modelList[modelIndex].getClips().empty())
+	{
+		mask |= ANIMATION_BIT;
+	}
+	Entity entity = registry.createEntity(mask);
 
-int VulkanRenderer::createTexture(std::string fileName)
-{
-	// Create Texture Image and get its location in array
-	int textureImageLoc = createTextureImage(fileName);
+	registry.getComponent<RenderMeshComponent>(entity)->modelIndex = modelIndex;
+	registry.getComponent<BoundsComponent>(entity)->localBounds = modelList[modelIndex].getBounds();
 
-	// Create Image View and add to list
-	VkImageView imageView = createImageView(textureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-	textureImageViews.push_back(imageView);
+	// Initial placement, facing the look at target
+	glm::vec3 target = isLookingAt ? lookAt : glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 direction = glm::normalize(target - startPos);
 
-	// Create Texture Descriptor
-	int descriptorLoc = createTextureDescriptor(imageView);
+	TransformComponent* transform = registry.getComponent<TransformComponent>(entity);
+	transform->position = startPos;
+	transform->angleX = 0.0f;
+	transform->angleY = glm::degrees(atan2(direction.x, direction.z));
+	transform->model = glm::translate(glm::mat4(1.0f), startPos);
+	transform->previousModel = transform->model;
 
-	// Return location of set with texture
-	return descriptorLoc;
+	return entity;
 }
 
-int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
+MaterialLibrary::TextureLoader VulkanRenderer::makeTextureLoader(const DecodedTextureMap* decodedTextures)
 {
-	VkDescriptorSet descriptorSet;
+	// A texture that can't be loaded leaves its slot empty instead of failing the model
+	return [this, decodedTextures](const std::string& fileName, bool srgb) -> MaterialTexture
+	{
+		try
+		{
+			// Decoded by the world streamer's loader thread, only the upload is left
+			const DecodedTexture* decoded = nullptr;
+			if (decodedTextures != nullptr)
+			{
+				auto found = decodedTextures->find(fileName);
+				decoded = found != decodedTextures->end() ? &found->second : nullptr;
+			}
 
-	// Descriptor Set Allocation Info
-	VkDescriptorSetAllocateInfo setAllocInfo = {};
-	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocInfo.descriptorPool = samplerDescriptorPool;
-	setAllocInfo.descriptorSetCount = 1;
-	setAllocInfo.pSetLayouts = &samplerSetLayout;
+			return textureStreamer.getMaterialTexture(createTexture(fileName, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM, decoded));
+		}
+		catch (const std::runtime_error& e)
+		{
+			printf("WARNING: %s, the material slot stays empty\n", e.what());
+			return MaterialTexture();
+		}
+	};
+}
 
-	// Allocate Descriptor Sets
-	VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, &descriptorSet);
-	if (result != VK_SUCCESS)
+void VulkanRenderer::applyVirtualTexture(Entity entity)
+{
+	RenderMeshComponent* renderMesh = registry.getComponent<RenderMeshComponent>(entity);
+	BoundsComponent* bounds = registry.getComponent<BoundsComponent>(entity);
+	TransformComponent* transform = registry.getComponent<TransformComponent>(entity);
+	if (!virtualTexture.isLoaded() || renderMesh == nullptr || bounds == nullptr || transform == nullptr)
 	{
-		throw std::runtime_error("Failed to allocate Texture Descriptor Sets!");
+		return;
 	}
 
-	// Texture Image Info
-	VkDescriptorImageInfo imageInfo = {};
-	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;	// Image layout when in use
-	imageInfo.imageView = textureImage;									// Image to bind to set
-	imageInfo.sampler = textureSampler;									// Sampler to use for set
-
-	// Descriptor Write Info
-	VkWriteDescriptorSet descriptorWrite = {};
-	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSet;
-	descriptorWrite.dstBinding = 0;
-	descriptorWrite.dstArrayElement = 0;
-	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	descriptorWrite.descriptorCount = 1;
-	descriptorWrite.pImageInfo = &imageInfo;
-
-	// Update new descriptor set
-	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &descriptorWrite, 0, nullptr);
-
-	// Add descriptor set to list
-	samplerDescriptorSets.push_back(descriptorSet);
+	// The same material sampling the virtual texture, its base colour texture isn't needed. The other
+	// slots keep their textures, already in the texture cache
+	MeshModel& model = modelList[renderMesh->modelIndex];
+	MaterialLibrary::TextureLoader loadTexture = makeTextureLoader(nullptr);
+	for (size_t k = 0; k < model.getMeshCount(); k++)
+	{
+		Mesh* mesh = model.getMesh(k);
+		MaterialDesc desc = materialLibrary.getDesc(mesh->getMaterialId());
+		desc.virtualTexture = true;
+		desc.textures[MATERIAL_TEXTURE_BASE_COLOUR].clear();
+		mesh->setMaterialId(materialLibrary.acquire(desc, graphicsQueue, graphicsCommandPool, loadTexture));
+	}
 
-	// Return descriptor set location
-	return samplerDescriptorSets.size() - 1;
+	AABB worldBounds = transformAABB(bounds->localBounds, transform->model);
+	virtualTexture.setArea(glm::vec2(worldBounds.min.x, worldBounds.min.z),
+		glm::vec2(worldBounds.max.x - worldBounds.min.x, worldBounds.max.z - worldBounds.min.z));
 }
 
-int VulkanRenderer::createMeshModel(std::string modelFile, bool controlable, glm::vec3 startPos, bool isLookingAt, glm::vec3 lookAt)
+void VulkanRenderer::destroyMeshModel(Entity entity)
 {
-	// Import model "scene"
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(modelFile, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
-	if (!scene)
-	{
-		throw std::runtime_error("Failed to load model! (" + modelFile + ")");
-	}
-
-	// Get vector of all materials with 1:1 ID placement
-	std::vector<std::string> textureNames = MeshModel::LoadMaterials(scene);
+	RenderMeshComponent* renderMesh = registry.getComponent<RenderMeshComponent>(entity);
+	if (renderMesh == nullptr) return;
 
-	// Conversion from the materials list IDs to our Descriptor Array IDs
-	std::vector<int> matToTex(textureNames.size());
+	// Not drawn from the next frame on, the frames in flight may still read the buffers
+	retiredModels.push_back({ renderMesh->modelIndex, frameNumber + framesInFlight });
+	registry.destroyEntity(entity);
+}
 
-	// Loop over textureNames and create textures for them
-	for (size_t i = 0; i < textureNames.size(); i++)
+void VulkanRenderer::destroyRetiredModels()
+{
+	for (size_t i = 0; i < retiredModels.size();)
 	{
-		// If material had no texture, set '0' to indicate no texture, texture 0 will be reserved for a default texture
-		if (textureNames[i].empty())
+		if (frameNumber < retiredModels[i].releaseFrame)
 		{
-			matToTex[i] = 0;
+			i++;
+			continue;
 		}
-		else
+
+		MeshModel& model = modelList[retiredModels[i].modelIndex];
+		for (size_t k = 0; k < model.getMeshCount(); k++)
 		{
-			// Otherwise, create texture and set value to index of new texture
-			matToTex[i] = createTexture(textureNames[i]);
+			gpuSkinning.forgetMesh(model.getMesh(k));
 		}
+		model.destroyMeshModel();
+		model = MeshModel();
+		freeModelSlots.push_back(retiredModels[i].modelIndex);
+
+		retiredModels[i] = retiredModels.back();
+		retiredModels.pop_back();
 	}
+}
 
-	// Load in all our meshes
-	std::vector<Mesh> modelMeshes = MeshModel::LoadNode(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool,
-		scene->mRootNode, scene, matToTex);
+void VulkanRenderer::loadWorld(const std::string& manifestFile, const StreamingSettings& settings)
+{
+	// Streamed models are placed by the manifest, turned around the up axis
+	WorldStreamer::ModelInstancer instancer = [this](const aiScene* scene, glm::vec3 position, float yaw,
+		const DecodedTextureMap& textures, uint64_t* gpuBytes) -> Entity
+	{
+		Entity entity = createMeshModelFromScene(scene, false, position, false, glm::vec3(1.0f, 0.0f, 0.0f), &textures);
+
+		TransformComponent* transform = registry.getComponent<TransformComponent>(entity);
+		transform->angleY = yaw;
+		transform->model = glm::rotate(glm::translate(glm::mat4(1.0f), position), glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+		transform->previousModel = transform->model;
+
+		*gpuBytes = modelList[registry.getComponent<RenderMeshComponent>(entity)->modelIndex].getMemorySize();
+		return entity;
+	};
+
+	WorldStreamer::ModelReleaser releaser = [this](Entity entity)
+	{
+		destroyMeshModel(entity);
+	};
 
-	// Create mesh model and add to list
-	MeshModel meshModel;
+	WorldStreamer::TextureUploader textureUploader = [this](const std::string& fileName, bool srgb, const DecodedTexture& texture)
+	{
+		createTexture(fileName, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM, &texture);
+	};
 
-	if (isLookingAt) { meshModel = MeshModel(modelMeshes, controlable, startPos, lookAt); }
-	else { meshModel = MeshModel(modelMeshes, controlable, startPos); }
-	
-	modelList.push_back(meshModel);
+	worldStreamer.create(manifestFile, settings, instancer, releaser, textureUploader);
+}
 
-	return modelList.size() - 1;
+void VulkanRenderer::updateStreaming(float deltaTime)
+{
+	worldStreamer.update(camera->getPosition(), deltaTime);
 }
 
 stbi_uc* VulkanRenderer::loadTextureFile(std::string fileName, int* width, int* height, VkDeviceSize* imageSize)
@@ -2130,7 +3218,58 @@ stbi_uc* VulkanRenderer::loadTextureFile(std::string fileName, int* width, int*
 	return image;
 }
 
-MeshModel* VulkanRenderer::getMeshModel(int meshId)
+MeshModel* VulkanRenderer::getMeshModel(Entity entity)
+{
+	// Resolve the model drawn by the entity
+	RenderMeshComponent* renderMesh = registry.getComponent<RenderMeshComponent>(entity);
+	if (renderMesh == nullptr)
+	{
+		return nullptr;
+	}
+
+	return &modelList[renderMesh->modelIndex];
+}
+
+EntityRegistry* VulkanRenderer::getRegistry()
+{
+	return &registry;
+}
+
+GpuProfiler* VulkanRenderer::getGpuProfiler()
+{
+	return &gpuProfiler;
+}
+
+FramePacer* VulkanRenderer::getFramePacer()
 {
-	return &modelList[meshId];
+	return &framePacer;
+}
+
+Entity VulkanRenderer::pickEntity(glm::vec3 origin, glm::vec3 direction, Entity ignoreEntity, float* outDistance)
+{
+	Ray ray = { origin, glm::normalize(direction) };
+
+	BVHRayHit hit;
+	if (!sceneBVH.raycast(ray, FLT_MAX, ignoreEntity, &hit))
+	{
+		return INVALID_ENTITY;
+	}
+
+	if (outDistance != nullptr)
+	{
+		*outDistance = hit.distance;
+	}
+
+	return hit.entity;
+}
+
+Entity VulkanRenderer::findNearestEntity(glm::vec3 point, float maxDistance, Entity ignoreEntity, ComponentMask requiredComponents)
+{
+	if (requiredComponents == 0)
+	{
+		return sceneBVH.findNearest(point, maxDistance, ignoreEntity, nullptr);
+	}
+
+	return sceneBVH.findNearest(point, maxDistance, ignoreEntity, nullptr,
+		[&](Entity entity) { return (registry.getMask(entity) & requiredComponents) == requiredComponents; });
 }
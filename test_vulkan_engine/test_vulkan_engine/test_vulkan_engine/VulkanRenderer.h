@@ -14,7 +14,9 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <cfloat>
 #include <array>
+#include <unordered_map>
 
 #include "stb_image.h"
 
@@ -22,6 +24,27 @@
 #include "MeshModel.h"
 #include "Utilities.h"
 #include "Camera.h"
+#include "EntityRegistry.h"
+#include "SceneSystems.h"
+#include "GpuProfiler.h"
+#include "PipelineManager.h"
+#include "ShaderHotReloader.h"
+#include "FrameContext.h"
+#include "CpuProfiler.h"
+#include "FramePacer.h"
+#include "RenderGraph.h"
+#include "DynamicResolution.h"
+#include "PostProcessing.h"
+#include "MaterialLibrary.h"
+#include "EnvironmentLighting.h"
+#include "AmbientOcclusion.h"
+#include "AnimationSystem.h"
+#include "GpuSkinning.h"
+#include "WorldStreamer.h"
+#include "TextureStreamer.h"
+#include "VirtualTexture.h"
+#include "Terrain.h"
+#include "ParticleSystem.h"
 #include <iostream>
 
 
@@ -31,6 +54,18 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+const uint32_t MAX_POINT_LIGHTS = 1024;				// Point lights uploaded per frame
+const uint32_t LIGHT_TILE_SIZE = 16;				// Pixels per side of a light culling tile (at 4K, larger above)
+const uint32_t MAX_LIGHTS_PER_TILE = 63;			// Must match the shaders, a tile list is a count and this many indices
+
+// Lighting path of the scene, picked at init
+enum RenderPath
+{
+	RENDER_PATH_FORWARD,		///< One pass, every fragment shades every light.
+	RENDER_PATH_DEFERRED,		///< G-buffer subpass, then a lighting subpass reading tiled light lists.
+	RENDER_PATH_COUNT
+};
+
 /**
  * @class VulkanRenderer
  * @brief Handles Vulkan rendering operations, including validation layers, debug messages, and required extensions.
@@ -148,15 +183,22 @@ public:
 
 
 	/**
-	 * @brief Sets the lighting for the scene based on a model's position.
+	 * @brief Makes an entity a light source, it gets a LightComponent with the default spotlight.
+	 *
+	 * @param entity The entity, it needs a transform to be placed in the scene.
+	 */
+	void addLightSource(Entity entity);
+
+	/**
+	 * @brief Sets the lighting for the scene from the light source nearest to the viewer.
 	 *
-	 * This function updates the lighting parameters using the position of a specified
-	 * model as the light source. It configures the light properties such as direction,
-	 * intensity, and cutoff angles.
+	 * The spotlight is assigned with a nearest object query on the scene BVH, filtered to the
+	 * light sources. A ray along the light then finds what it points at, the beam particles
+	 * attached to the light stop there.
 	 *
-	 * @param sourceModelId The ID of the model that acts as the light source.
+	 * @param viewPosition Position of the viewer in world space.
 	 */
-	void setLighting(int sourceModelId);
+	void setLighting(glm::vec3 viewPosition);
 
 
 
@@ -186,20 +228,69 @@ public:
 	 * @param startPos The initial position of the model in world space.
 	 * @param isLookingAt If true, the model is rotated to face a target.
 	 * @param lookAt The position the model should face (default is (1,0,0)).
-	 * @return The ID assigned to the created model.
+	 * @return The entity created for the model.
 	 */
-	int createMeshModel(std::string modelFile, bool controlable, glm::vec3 startPos, bool isLookingAt, glm::vec3 lookAt = glm::vec3(1.0f, 0.0f, 0.0f));
+	Entity createMeshModel(std::string modelFile, bool controlable, glm::vec3 startPos, bool isLookingAt, glm::vec3 lookAt = glm::vec3(1.0f, 0.0f, 0.0f));
+
+	/**
+	 * @brief Removes a model's entity from the scene.
+	 *
+	 * The model's buffers are destroyed once the frames in flight are finished, its slot is then reused.
+	 *
+	 * @param entity The entity of the model.
+	 */
+	void destroyMeshModel(Entity entity);
+
+	/**
+	 * @brief Switches to the streaming world mode, the cells of the manifest are loaded around the camera.
+	 *
+	 * @param manifestFile The world manifest (see WorldStreamer::create).
+	 * @param settings Radii and memory budget of the streaming.
+	 * @throws std::runtime_error if the manifest can't be read.
+	 */
+	void loadWorld(const std::string& manifestFile, const StreamingSettings& settings);
+
+	/**
+	 * @brief Loads and evicts the world's cells for the camera's position, uploads the finished ones.
+	 *
+	 * @param deltaTime The time elapsed since the last frame.
+	 */
+	void updateStreaming(float deltaTime);
 
 	/**
 	 * @brief Updates the transformation matrix of an existing model.
 	 *
-	 * This function modifies the model matrix of a specific mesh, allowing transformations
+	 * This function modifies the model matrix of a specific entity, allowing transformations
 	 * such as translation, rotation, and scaling.
 	 *
-	 * @param modelId The ID of the model to be updated.
+	 * @param entity The entity to be updated.
 	 * @param newModel The new transformation matrix for the model.
 	 */
-	void updateModel(int modelId, glm::mat4 newModel);
+	void updateModel(Entity entity, glm::mat4 newModel);
+
+	/**
+	 * @brief Runs the controller system on every controllable entity.
+	 *
+	 * @param keys A boolean array representing the state of keys.
+	 * @param deltaTime The time elapsed since the last frame.
+	 */
+	void updateControllers(bool* keys, float deltaTime);
+
+	/**
+	 * @brief Advances the animated entities' clips and poses their skeletons for this frame.
+	 *
+	 * @param deltaTime The time elapsed since the last frame.
+	 */
+	void updateAnimations(float deltaTime);
+
+	/**
+	 * @brief Starts a clip of an animated entity's model.
+	 *
+	 * @param entity The entity, created from a model with a skeleton and clips.
+	 * @param clip Index of the clip in the model.
+	 * @param fadeDuration Length of the crossfade from the current clip in seconds.
+	 */
+	void playAnimation(Entity entity, uint32_t clip, float fadeDuration);
 
 	/**
 	 * @brief Updates the view matrix based on the current camera position and orientation.
@@ -217,6 +308,185 @@ public:
 	 */
 	void draw();
 
+	/**
+	 * @brief Requests a swapchain recreation, call when the window's framebuffer was resized.
+	 */
+	void notifyWindowResized();
+
+	/**
+	 * @brief Sets how many frames the CPU may record ahead of the GPU, call before init.
+	 *
+	 * More frames hide CPU spikes, fewer frames lower the input latency.
+	 *
+	 * @param count Frames in flight, clamped to [1, MAX_FRAMES_IN_FLIGHT].
+	 */
+	void setFramesInFlight(uint32_t count);
+
+	/**
+	 * @brief Sets the MSAA sample count of the main pass, call before init.
+	 *
+	 * The highest count the device supports for both colour and depth attachments, not above
+	 * the requested one, is used. The multisampled attachments are resolved inside the render pass.
+	 *
+	 * @param samples 1 (off), 2, 4 or 8.
+	 */
+	void setMsaaSamples(uint32_t samples);
+
+	/**
+	 * @brief Selects the forward or the deferred lighting path, call before init.
+	 *
+	 * Both shade the same lights, so the GPU timings of the two can be compared on one scene.
+	 * The deferred path renders without MSAA and draws no transparency.
+	 *
+	 * @param path The path to render with.
+	 */
+	void setRenderPath(RenderPath path);
+
+	/**
+	 * @brief Adds a point light to the scene, at most MAX_POINT_LIGHTS.
+	 *
+	 * @param position Position in world space.
+	 * @param colour Colour of the light.
+	 * @param intensity Brightness multiplier of the colour.
+	 * @param radius Distance the light fades out at, nothing beyond it is lit.
+	 * @return Index of the light, or -1 if the list is full.
+	 */
+	int addPointLight(glm::vec3 position, glm::vec3 colour, float intensity, float radius);
+
+	/**
+	 * @brief Selects the present mode, the swapchain is recreated with it before the next frame.
+	 *
+	 * Unsupported modes fall back to the closest supported one (FIFO in the end).
+	 *
+	 * @param mode Immediate / mailbox for throughput and latency, FIFO / FIFO relaxed for vsync.
+	 */
+	void setPresentMode(PresentMode mode);
+
+	/**
+	 * @brief Sets the frame rate the dynamic resolution holds, call before init.
+	 *
+	 * The scene is rendered at a scale picked from the GPU frame time and upsampled by the TAA pass.
+	 *
+	 * @param framesPerSecond Frame rate to hold, 0 always renders at the native resolution.
+	 */
+	void setDynamicResolutionTarget(double framesPerSecond);
+
+	/**
+	 * @brief Sets the HDR environment the scene is lit by, call before init.
+	 *
+	 * Its diffuse irradiance and prefiltered reflections replace the constant ambient light. They are
+	 * computed on the first run and read from a cache file next to the environment afterwards.
+	 *
+	 * @param fileName HDR (Radiance) file in the Textures folder, empty for a uniform white environment.
+	 */
+	void setEnvironmentMap(const std::string& fileName);
+
+	/**
+	 * @brief Sets the memory the streamed texture mips may hold, call before init.
+	 *
+	 * With VK_EXT_memory_budget the textures also stay within what the device heap has left.
+	 *
+	 * @param bytes Budget of the texture images, the always resident mip tails may exceed it.
+	 */
+	void setTextureBudget(VkDeviceSize bytes);
+
+	/**
+	 * @brief Sets the image the virtual texture is built from, call before init.
+	 *
+	 * It is tiled into pages once, only the pages the screen needs are resident. Materials switched
+	 * over with applyVirtualTexture() sample it instead of their base colour texture.
+	 *
+	 * @param fileName Image in the Textures folder, empty for none.
+	 */
+	void setVirtualTexture(const std::string& fileName);
+
+	/**
+	 * @brief Stretches the virtual texture over a model's extent on the XZ plane, its materials sample it.
+	 *
+	 * Does nothing if no virtual texture is loaded.
+	 *
+	 * @param entity The entity of the model.
+	 */
+	void applyVirtualTexture(Entity entity);
+
+	/**
+	 * @brief Sets the heightmap of the terrain, call before init.
+	 *
+	 * The terrain is drawn in every pass drawing the scene. With a virtual texture loaded it is
+	 * stretched over the terrain instead of a model.
+	 *
+	 * @param fileName Greyscale image in the Textures folder, empty for no terrain.
+	 * @param settings Extent, height and placement of the terrain.
+	 */
+	void setTerrain(const std::string& fileName, const TerrainSettings& settings);
+
+	/**
+	 * @brief Height of the terrain's surface at a point of the XZ plane, for placing models on it.
+	 *
+	 * @param x World X.
+	 * @param z World Z.
+	 * @param outHeight Receives the world Y of the surface.
+	 * @return False if there is no terrain or the point is outside it.
+	 */
+	bool getTerrainHeight(float x, float z, float* outHeight) const;
+
+	/**
+	 * @brief Sets how many particles can be alive at once, call before init.
+	 *
+	 * @param count Particles, rounded up to a power of two (1024 to MAX_PARTICLE_CAPACITY).
+	 */
+	void setParticleCapacity(uint32_t count);
+
+	/**
+	 * @brief Adds a particle emitter, call after init.
+	 *
+	 * An emitter attached to a model follows it every frame: its position is then an offset from
+	 * the model's and its direction is the model's facing.
+	 *
+	 * @param desc The emitter.
+	 * @param attachedEntity The entity the emitter follows (INVALID_ENTITY for a fixed emitter).
+	 * @return Index of the emitter.
+	 * @throws std::runtime_error if there are MAX_PARTICLE_EMITTERS emitters already.
+	 */
+	uint32_t addParticleEmitter(const ParticleEmitterDesc& desc, Entity attachedEntity = INVALID_ENTITY);
+
+	/**
+	 * @brief True while the window has no drawable area (minimized), draw() renders nothing then.
+	 */
+	bool isMinimized() const;
+
+	/**
+	 * @brief Recompiles the edited shader sources and rebuilds the pipelines using them.
+	 *
+	 * Call between frames. Does nothing (and doesn't wait) unless a watched source changed,
+	 * a shader that fails to compile leaves the running pipelines untouched.
+	 */
+	void reloadChangedShaders();
+
+	/**
+	 * @brief Finds the closest entity hit by a ray (e.g. what the flashlight points at).
+	 *
+	 * Uses the scene BVH, so the bounds are the ones of the last drawn frame.
+	 *
+	 * @param origin Start of the ray in world space.
+	 * @param direction Direction of the ray.
+	 * @param ignoreEntity Entity skipped by the query, usually the one casting the ray (INVALID_ENTITY for none).
+	 * @param outDistance Receives the distance to the hit (can be nullptr).
+	 * @return The hit entity, or INVALID_ENTITY if nothing was hit.
+	 */
+	Entity pickEntity(glm::vec3 origin, glm::vec3 direction, Entity ignoreEntity = INVALID_ENTITY, float* outDistance = nullptr);
+
+	/**
+	 * @brief Finds the entity closest to a point.
+	 *
+	 * @param point The query point in world space.
+	 * @param maxDistance Entities further than this are ignored.
+	 * @param ignoreEntity Entity skipped by the query (INVALID_ENTITY for none).
+	 * @param requiredComponents Only entities owning all of these components are considered.
+	 * @return The closest entity, or INVALID_ENTITY if none is in range.
+	 */
+	Entity findNearestEntity(glm::vec3 point, float maxDistance, Entity ignoreEntity = INVALID_ENTITY, ComponentMask requiredComponents = 0);
+
 	/**
 	 * @brief Cleans up Vulkan resources and deallocates memory.
 	 *
@@ -226,7 +496,11 @@ public:
 	void cleanup();
 
 	// get
-	MeshModel* getMeshModel(int meshId);
+	MeshModel* getMeshModel(Entity entity);
+	EntityRegistry* getRegistry();
+	GpuProfiler* getGpuProfiler();
+	FramePacer* getFramePacer();
+	static const char* getRenderPathName(RenderPath path);
 
 	~VulkanRenderer();
 
@@ -238,21 +512,18 @@ private:
  *
  * This structure contains parameters for a spotlight, including its position,
  * direction, color, and intensity. The cutoff angles control the beam spread.
+ * Every vec3 is followed by a float, so the layout matches std140 without padding.
+ * The surface response (shininess, specular strength) comes from the materials.
  */
 	struct Spotlight {
+		glm::vec3 lightPosition;  ///< The position of the spotlight in world space.
+		float innerCutOff;        ///< Cosine of the inner cutoff angle.
+
 		glm::vec3 lightDirection; ///< The direction in which the spotlight points.
-		float diffuseStr;         ///< Intensity of the diffuse light component.
+		float outerCutOff;        ///< Cosine of the outer cutoff angle.
 
 		glm::vec3 lightColor;     ///< The color of the spotlight.
-		float specularStr;        ///< Intensity of the specular reflection.
-
-		float shininess;          ///< Shininess factor for specular highlights.
-
-		float innerCutOff;        ///< Inner cutoff angle (in radians) for the spotlight.
-		float outerCutOff;        ///< Outer cutoff angle (in radians) for the spotlight.
-
-		glm::vec4 lightPosition;  ///< The position of the spotlight in world space.
-		float padding;            ///< Unused padding to align the structure in memory.
+		float intensity;          ///< Brightness multiplier of the colour.
 	};
 
 
@@ -264,26 +535,30 @@ private:
 	 * It is used to store lighting data in a Vulkan uniform buffer.
 	 */
 	struct UboLighting {
-		glm::vec3 ambiantLightColor;  ///< The color of the ambient light.
-		float ambiantStr;             ///< The intensity of the ambient light.
+		glm::vec3 ambiantLightColor;  ///< Tint of the environment lighting.
+		float ambiantStr;             ///< The intensity of the environment lighting.
 
 		Spotlight spotlight[1];       ///< An array containing spotlight data.
-	} uboLighting;
 
+		glm::vec2 depthParams;        ///< P[2][2] and P[3][2] of the projection, the depth buffer to linear depth.
+		float ambientOcclusionStrength; ///< Share of the environment lighting the ambient occlusion removes.
+		float padding;
+	} uboLighting;
 
 	/**
-	 * @brief Vulkan buffers for storing lighting uniform data.
-	 *
-	 * These buffers hold lighting data that is transferred to the GPU for rendering.
+	 * @struct PointLight
+	 * @brief A point light as the shaders read it from the light list (std430).
 	 */
-	std::vector<VkBuffer> lightingUniformBuffer;
+	struct PointLight {
+		glm::vec4 positionRadius;     ///< World position, and the distance the light fades out at.
+		glm::vec4 colourIntensity;    ///< Colour, and its brightness multiplier.
+	};
 
 	/**
-	 * @brief Vulkan device memory associated with the lighting uniform buffers.
-	 *
-	 * This memory stores the lighting UBO, which is accessed by the shaders.
+	 * @brief Point lights of the scene, uploaded every frame behind a 16 byte header holding the count.
 	 */
-	std::vector<VkDeviceMemory> lightingUniformBufferMemory;
+	std::vector<PointLight> pointLights;
+
 
 
 	/**
@@ -305,19 +580,146 @@ private:
 	/**
 	 * @brief Tracks the current frame index in the rendering loop.
 	 *
-	 * Used for synchronizing resources in Vulkan's multi-buffered rendering system.
+	 * Index of the frame context being recorded, cycles through the frames in flight.
 	 */
-	int currentFrame = 0;
+	uint32_t currentFrame = 0;
 
+	/**
+	 * @brief Number of frames the CPU may record ahead of the GPU.
+	 */
+	uint32_t framesInFlight = MAX_FRAME_DRAWS;
 
 	/**
-	 * @brief List of all 3D models present in the scene.
+	 * @brief MSAA sample count asked for with setMsaaSamples, and the one the device supports.
+	 */
+	uint32_t requestedMsaaSamples = 1;
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	/**
+	 * @brief Forward or deferred lighting, set with setRenderPath.
+	 */
+	RenderPath renderPath = RENDER_PATH_FORWARD;
+
+	/**
+	 * @brief Per frame command pool, command buffer, uniform ring, descriptor pool and fence.
+	 */
+	std::vector<FrameContext> frames;
+
+	/**
+	 * @brief Fence of the frame that last rendered into each swapchain image (VK_NULL_HANDLE if none).
 	 *
-	 * Each model is represented by a MeshModel object, which contains
-	 * its mesh data, transformations, and material properties.
+	 * Images can be acquired in any order, so a new frame waits on it before touching the image.
+	 */
+	std::vector<VkFence> imagesInFlight;
+
+
+	/**
+	 * @brief List of all loaded 3D models.
+	 *
+	 * Each model is represented by a MeshModel object, which owns the GPU buffers
+	 * of its meshes. Entities reference them through their RenderMeshComponent.
 	 */
 	std::vector<MeshModel> modelList;
 
+	/**
+	 * @brief Slots of modelList whose model was destroyed, filled again by the next models created.
+	 */
+	std::vector<uint32_t> freeModelSlots;
+
+	/**
+	 * @brief A destroyed model whose buffers a frame in flight may still read.
+	 */
+	struct RetiredModel
+	{
+		uint32_t modelIndex;
+		uint32_t releaseFrame;		///< frameNumber from which no frame in flight draws it.
+	};
+	std::vector<RetiredModel> retiredModels;
+
+	/**
+	 * @brief Loads the cells of a large world around the camera on a background thread.
+	 */
+	WorldStreamer worldStreamer;
+
+	/**
+	 * @brief Entity storage of the scene.
+	 *
+	 * Holds the per-entity data (transform, render mesh, controller, light) in
+	 * contiguous per-archetype component arrays.
+	 */
+	EntityRegistry registry;
+
+	/**
+	 * @brief Bounding volume hierarchy over the world boxes of the entities.
+	 *
+	 * Refitted every frame from the transforms. Its nearest object query assigns the spotlight, its
+	 * ray pick finds what the light points at. Culling uses the flat SIMD culler below instead.
+	 */
+	BVH sceneBVH;
+
+	/**
+	 * @brief The light source the spotlight was assigned to, and what its ray hit (FLT_MAX if nothing).
+	 */
+	Entity lightSource = INVALID_ENTITY;
+	float lightTargetDistance = FLT_MAX;
+
+	/**
+	 * @brief SoA bounding spheres of the drawable entities, culled with SSE/AVX2 every frame.
+	 */
+	FrustumCuller sceneCuller;
+
+	/**
+	 * @brief Entities inside the view frustum, the draw list of recordMainPass.
+	 */
+	std::vector<Entity> visibleEntities;
+
+	/**
+	 * @brief Timestamp and pipeline statistics queries around the render passes.
+	 *
+	 * Results lag a few frames behind, they are read back without waiting on the GPU.
+	 */
+	GpuProfiler gpuProfiler;
+
+	/**
+	 * @brief Present mode choice, frame limiter, fence waits and frame time / latency statistics.
+	 */
+	FramePacer framePacer;
+
+	/**
+	 * @brief Render scale of the scene, driven by the GPU frame time.
+	 */
+	DynamicResolution dynamicResolution;
+
+	/**
+	 * @brief Frame rate the dynamic resolution holds, negative for the display refresh rate.
+	 */
+	double dynamicResolutionTarget = -1.0;
+
+	/**
+	 * @brief HDR file the environment lighting is computed from, empty for a uniform white environment.
+	 */
+	std::string environmentFile;
+
+	/**
+	 * @brief Area of the scene targets rendered this frame (top left corner).
+	 */
+	VkExtent2D renderExtent = {};
+
+	/**
+	 * @brief Frames rendered, indexes the jitter sequence.
+	 */
+	uint32_t frameNumber = 0;
+
+	/**
+	 * @brief Sub-pixel offset of this frame's projection, in pixels of the rendered area.
+	 */
+	glm::vec2 jitter = glm::vec2(0.0f);
+
+	/**
+	 * @brief True if the device was created with the pipelineStatisticsQuery feature.
+	 */
+	bool pipelineStatisticsEnabled = false;
+
 	/**
 	 * @struct UboViewProjection
 	 * @brief Stores the view and projection matrices for rendering.
@@ -326,10 +728,56 @@ private:
 	 * world coordinates into camera space and apply perspective projection.
 	 */
 	struct UboViewProjection {
-		glm::mat4 projection; ///< Projection matrix (perspective or orthographic).
+		glm::mat4 projection; ///< Projection matrix (perspective or orthographic), jittered for TAA.
 		glm::mat4 view;       ///< View matrix (camera transformation).
+		glm::mat4 viewProjection;			///< Without jitter, for the motion vectors.
+		glm::mat4 previousViewProjection;	///< Same, of the previous frame.
 	} uboViewProjection;
 
+	/**
+	 * @struct PushModel
+	 * @brief Push constants of a draw: the model matrix of this and of the previous frame.
+	 */
+	struct PushModel {
+		glm::mat4 model;
+		glm::mat4 previousModel;
+	};
+
+	/**
+	 * @struct PushTaa
+	 * @brief Push constants of the TAA pass (see Shaders/taa.frag).
+	 */
+	struct PushTaa {
+		glm::vec2 renderScale;		///< Rendered area / scene target size.
+		glm::vec2 jitter;			///< Jitter of the frame, in UV of the rendered area.
+		glm::vec2 sceneTexelSize;	///< 1 / scene target size.
+		float blendFactor;			///< Weight of the current frame.
+		float historyValid;			///< 0 without a usable history.
+	};
+
+	/**
+	 * @struct PushLightCulling
+	 * @brief Push constants of the light culling (see Shaders/light_culling.comp).
+	 */
+	struct PushLightCulling {
+		glm::mat4 inverseProjection;	///< Jittered like the frame, NDC to view space.
+		glm::uvec2 renderSize;			///< Rendered area in pixels.
+		uint32_t tileSize;				///< Pixels per side of a tile.
+		uint32_t tileCountX;			///< Tiles per row.
+	};
+
+	/**
+	 * @struct PushDeferredLighting
+	 * @brief Push constants of the deferred lighting subpass (see Shaders/deferred_lighting.frag).
+	 */
+	struct PushDeferredLighting {
+		glm::mat4 inverseViewProjection;	///< Jittered like the G-buffer, NDC to world space.
+		glm::vec4 cameraPosition;
+		glm::vec2 renderSize;				///< Rendered area in pixels.
+		uint32_t tileSize;
+		uint32_t tileCountX;
+	};
+
 
 	/**
 	 * @brief Vulkan instance handle.
@@ -368,6 +816,34 @@ private:
 	 */
 	VkQueue presentationQueue;
 
+	/**
+	 * @brief Queue of the async compute passes: a dedicated compute family's, or a second queue of the graphics family.
+	 *
+	 * VK_NULL_HANDLE if neither exists or timeline semaphores are missing, the render graph
+	 * then records the compute passes on the graphics queue.
+	 */
+	VkQueue asyncComputeQueue = VK_NULL_HANDLE;
+
+	/**
+	 * @brief Queue family of asyncComputeQueue (the graphics family if there is no dedicated one).
+	 */
+	uint32_t asyncComputeFamily = 0;
+
+	/**
+	 * @brief Vulkan version of the instance (1.2 if the loader supports it).
+	 */
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+
+	/**
+	 * @brief True if the device was created with the timelineSemaphore feature.
+	 */
+	bool timelineSemaphoresEnabled = false;
+
+	/**
+	 * @brief True if the device was created with VK_EXT_memory_budget, the texture budget follows the heap's.
+	 */
+	bool memoryBudgetEnabled = false;
+
 	/**
 	 * @brief Vulkan rendering surface.
 	 *
@@ -380,7 +856,14 @@ private:
 	 *
 	 * The swapchain manages a set of images used for double or triple buffering.
 	 */
-	VkSwapchainKHR swapchain;
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+
+	/**
+	 * @brief Set when the swapchain no longer matches the window (resize, out of date present).
+	 *
+	 * The swapchain is recreated at the start of the next draw.
+	 */
+	bool swapChainOutOfDate = false;
 
 	/**
 	 * @brief List of images in the Vulkan swapchain.
@@ -391,40 +874,158 @@ private:
 	std::vector<SwapchainImage> swapChainImages;
 
 	/**
-	 * @brief List of Vulkan framebuffers for each swapchain image.
+	 * @brief Passes of the frame and the resources they read and write.
 	 *
-	 * Framebuffers store color, depth, and stencil attachments for rendering.
+	 * Owns the render passes, framebuffers and transient attachments (the depth buffer),
+	 * records the barriers between the passes and submits the frame.
 	 */
-	std::vector<VkFramebuffer> swapChainFramebuffers;
+	RenderGraph renderGraph;
 
 	/**
-	 * @brief Command buffers for recording Vulkan draw commands.
-	 *
-	 * These command buffers contain rendering instructions that are submitted to the GPU.
+	 * @brief The swapchain image of the frame, imported into the render graph.
+	 */
+	RenderGraphResource backbufferResource = RENDER_GRAPH_INVALID;
+
+	/**
+	 * @brief The pass drawing the scene.
+	 */
+	RenderGraphPass mainPass = RENDER_GRAPH_INVALID;
+
+	/**
+	 * @brief Scene targets of the main pass, read by the TAA pass.
+	 */
+	RenderGraphResource sceneColourResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource velocityResource = RENDER_GRAPH_INVALID;
+
+	/**
+	 * @brief The antialiased scene in linear HDR at the output resolution, input of the post processing.
+	 */
+	RenderGraphResource hdrColourResource = RENDER_GRAPH_INVALID;
+
+	/**
+	 * @brief Bloom, exposure adaptation and tonemapping of the HDR scene into the backbuffer.
+	 */
+	PostProcessing postProcessing;
+
+	/**
+	 * @brief Half resolution ambient occlusion from the prepass depth, darkens the environment lighting.
+	 */
+	AmbientOcclusion ambientOcclusion;
+	RenderGraphResource ambientOcclusionResource = RENDER_GRAPH_INVALID;
+
+	/**
+	 * @brief Poses the animated entities on worker threads, the compute pass skins their meshes for every scene pass.
+	 */
+	AnimationSystem animationSystem;
+	GpuSkinning gpuSkinning;
+	RenderGraphResource skinnedVerticesResource = RENDER_GRAPH_INVALID;
+
+	/**
+	 * @brief Mips of the textures streamed in from the material shaders' feedback, within textureBudget.
+	 */
+	TextureStreamer textureStreamer;
+	RenderGraphResource textureFeedbackResource = RENDER_GRAPH_INVALID;
+
+	/**
+	 * @brief Paged texture of the terrain, descriptor set 3 of the scene pipelines.
+	 */
+	VirtualTexture virtualTexture;
+	VirtualTextureResources virtualTextureResources;
+	std::string virtualTextureFile;
+	VkDeviceSize textureBudget = DEFAULT_TEXTURE_BUDGET;
+
+	/**
+	 * @brief Heightmap terrain, drawn after the entities in the prepass and the scene pass.
 	 */
-	std::vector<VkCommandBuffer> commandBuffers;
+	Terrain terrain;
+	std::string terrainFile;
+	TerrainSettings terrainSettings;
+	uint32_t terrainMaterial = 0;
 
+	/**
+	 * @brief GPU particles, blended over the scene colour before the TAA.
+	 */
+	struct ParticleAttachment
+	{
+		uint32_t emitter;
+		Entity entity;
+		glm::vec3 offset;		// From the entity's position
+		float length;			// Of the emitter's cone, a light's beam is cut at what it hits
+	};
+
+	ParticleSystem particleSystem;
+	uint32_t particleCapacity = DEFAULT_PARTICLE_CAPACITY;
+	std::vector<ParticleAttachment> particleAttachments;
 
 	/**
-	 * @brief Depth buffer image for handling depth testing.
+	 * @brief Depth only pass before the scene, its depth feeds the ambient occlusion.
 	 *
-	 * The depth buffer is used to determine which objects are in front of others.
+	 * Without MSAA it fills the scene's depth buffer, the main pass (or the G-buffer subpass) then
+	 * only tests against it and shades every pixel once. With MSAA it writes a single sampled
+	 * depth of its own, the multisampled one stays with the main pass.
 	 */
-	VkImage depthBufferImage;
+	RenderGraphPass depthPrepass = RENDER_GRAPH_INVALID;
+	VkRenderPass depthPrepassRenderPass = VK_NULL_HANDLE;
+	VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
+	bool depthPrepassShared = false;	///< The prepass wrote the scene's depth buffer.
 
 	/**
-	 * @brief Memory allocation for the depth buffer image.
+	 * @brief TAA history: read from the previous frame's, written to the other, swapped every frame.
 	 *
-	 * Stores depth values in GPU memory.
+	 * Owned by the renderer (the graph's transient memory doesn't survive the frame), imported
+	 * into the graph and left shader readable at the end of every frame.
+	 */
+	RenderGraphResource historyResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource historyOutputResource = RENDER_GRAPH_INVALID;
+	std::array<VkImage, 2> historyImages = {};
+	std::array<VkDeviceMemory, 2> historyMemory = {};
+	std::array<VkImageView, 2> historyImageViews = {};
+	uint32_t historyIndex = 0;			///< History written this frame.
+	bool historyValid = false;			///< False until a frame was accumulated at the current size.
+	glm::mat4 submittedViewProjection = glm::mat4(1.0f);	///< Unjittered matrix of the last submitted frame, the history was rendered with it.
+
+	/**
+	 * @brief The pass resolving the jittered scene into the HDR colour and the history.
 	 */
-	VkDeviceMemory depthBufferImageMemory;
+	RenderGraphPass taaPass = RENDER_GRAPH_INVALID;
+	VkRenderPass taaRenderPass = VK_NULL_HANDLE;
+	VkDescriptorSetLayout taaSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout taaPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline taaPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet taaSet = VK_NULL_HANDLE;
 
 	/**
-	 * @brief Image view for the depth buffer.
+	 * @brief Deferred path: the G-buffer and lighting subpasses of one render pass, and the light culling before it.
 	 *
-	 * Used to bind the depth buffer as an attachment in the Vulkan pipeline.
+	 * The G-buffer (albedo and metallic, packed normal, emissive and roughness, depth) is only read as input attachments of the
+	 * lighting subpass, so on tiled GPUs it never leaves tile memory.
 	 */
-	VkImageView depthBufferImageView;
+	RenderGraphResource gbufferAlbedoResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource gbufferNormalResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource gbufferEmissiveResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource depthResource = RENDER_GRAPH_INVALID;
+	RenderGraphResource tileLightsResource = RENDER_GRAPH_INVALID;
+	RenderGraphPass lightCullingPass = RENDER_GRAPH_INVALID;
+	uint32_t lightTileSize = LIGHT_TILE_SIZE;
+	VkDescriptorSetLayout deferredSetLayout = VK_NULL_HANDLE;		// G-buffer inputs and the tile light lists
+	VkDescriptorSetLayout lightCullingSetLayout = VK_NULL_HANDLE;	// The tile light lists
+	VkPipelineLayout deferredPipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout lightCullingPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline gbufferPipeline = VK_NULL_HANDLE;
+	VkPipeline deferredLightingPipeline = VK_NULL_HANDLE;
+	VkPipeline lightCullingPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet deferredSet = VK_NULL_HANDLE;
+	VkDescriptorSet lightCullingSet = VK_NULL_HANDLE;
+
+	/**
+	 * @brief Bilinear, clamp to edge sampler of the full screen passes.
+	 */
+	VkSampler postSampler = VK_NULL_HANDLE;
+
+	/**
+	 * @brief Descriptor set 0 of the frame being recorded, bound by the passes.
+	 */
+	VkDescriptorSet frameUniformSet = VK_NULL_HANDLE;
 
 	/**
 	 * @brief Vulkan texture sampler for filtering and mipmapping.
@@ -440,13 +1041,6 @@ private:
 	 */
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	/**
-	 * @brief Descriptor set layout for texture samplers.
-	 *
-	 * Defines how textures and image samplers are bound in shaders.
-	 */
-	VkDescriptorSetLayout samplerSetLayout;
-
 	/**
 	 * @brief Push constant range for passing small amounts of data to shaders.
 	 *
@@ -456,50 +1050,29 @@ private:
 	VkPushConstantRange pushConstantRange;
 
 	/**
-	 * @brief Vulkan descriptor pool for allocating descriptor sets.
-	 *
-	 * This pool is used to allocate descriptor sets for uniform buffers,
-	 * allowing shaders to access transformation matrices and other uniform data.
+	 * @brief Parameter blocks and texture sets of the loaded models' materials, descriptor set 1 of the scene pipelines.
 	 */
-	VkDescriptorPool descriptorPool;
+	MaterialLibrary materialLibrary;
 
 	/**
-	 * @brief Vulkan descriptor pool for texture samplers.
-	 *
-	 * This pool is used for allocating descriptor sets related to image samplers.
-	 * It enables binding and using textures in shaders.
+	 * @brief SH irradiance and prefiltered reflections of the environment, descriptor set 2 of the scene pipelines.
 	 */
-	VkDescriptorPool samplerDescriptorPool;
+	EnvironmentLighting environmentLighting;
 
 	/**
-	 * @brief Descriptor sets for uniform buffers.
-	 *
-	 * Each descriptor set contains information about a uniform buffer,
-	 * allowing shaders to read transformation matrices and other per-frame data.
+	 * @brief A mesh of a visible entity, sorted by material before the draws.
 	 */
-	std::vector<VkDescriptorSet> descriptorSets;
-
-	/**
-	 * @brief Descriptor sets for texture samplers.
-	 *
-	 * These descriptor sets are used to bind texture samplers in shaders.
-	 */
-	std::vector<VkDescriptorSet> samplerDescriptorSets;
-
-	/**
-	 * @brief Uniform buffers for storing view and projection matrices.
-	 *
-	 * These buffers hold the camera's view matrix and projection matrix,
-	 * which are updated every frame and sent to shaders.
-	 */
-	std::vector<VkBuffer> vpUniformBuffer;
+	struct DrawItem
+	{
+		uint32_t materialId;
+		Entity entity;
+		uint32_t meshIndex;
+	};
 
 	/**
-	 * @brief Device memory for view-projection uniform buffers.
-	 *
-	 * This memory stores transformation matrices in GPU-accessible memory.
+	 * @brief The draws of the frame, kept so the list isn't reallocated every frame.
 	 */
-	std::vector<VkDeviceMemory> vpUniformBufferMemory;
+	std::vector<DrawItem> drawList;
 
 	/**
 	 * @brief Uniform buffers for storing per-model transformation data.
@@ -518,25 +1091,9 @@ private:
 
 	// - Assets
 	/**
-	 * @brief Vulkan images used as textures in the scene.
-	 *
-	 * These images store texture data that will be applied to models.
+	 * @brief Texture streamer ID of every loaded file and format, models sharing a texture load it once.
 	 */
-	std::vector<VkImage> textureImages;
-
-	/**
-	 * @brief Device memory associated with texture images.
-	 *
-	 * Each texture image requires dedicated GPU memory to store its pixel data.
-	 */
-	std::vector<VkDeviceMemory> textureImageMemory;
-
-	/**
-	 * @brief Image views for texture images.
-	 *
-	 * Image views describe how textures are accessed in shaders.
-	 */
-	std::vector<VkImageView> textureImageViews;
+	std::unordered_map<std::string, int> textureCache;
 
 
 	/**
@@ -545,7 +1102,7 @@ private:
 	 * Defines the rendering pipeline stages, including shaders, vertex input,
 	 * rasterization, and fragment processing.
 	 */
-	VkPipeline graphicsPipeline;
+	VkPipeline graphicsPipeline = VK_NULL_HANDLE;
 
 	/**
 	 * @brief Layout for the graphics pipeline.
@@ -555,7 +1112,25 @@ private:
 	VkPipelineLayout pipelineLayout;
 
 	/**
-	 * @brief Vulkan render pass.
+	 * @brief Pipeline cache persisted between runs, creates the pipelines on worker threads.
+	 */
+	PipelineManager pipelineManager;
+
+	/**
+	 * @brief Description of every pipeline and the member holding it, used to rebuild them.
+	 */
+	std::vector<GraphicsPipelineDesc> pipelineDescs;
+	std::vector<VkPipeline*> pipelineHandles;
+	std::vector<ComputePipelineDesc> computePipelineDescs;
+	std::vector<VkPipeline*> computePipelineHandles;
+
+	/**
+	 * @brief Watches the GLSL sources in Shaders/ and recompiles them when they are saved.
+	 */
+	ShaderHotReloader shaderHotReloader;
+
+	/**
+	 * @brief Render pass of the main pass, created by the render graph.
 	 *
 	 * Describes the framebuffer attachments and how they are processed during rendering.
 	 */
@@ -586,26 +1161,13 @@ private:
 
 
 	/**
-	 * @brief Semaphores for synchronizing image availability.
-	 *
-	 * These semaphores ensure that the swapchain image is available before rendering begins.
-	 */
-	std::vector<VkSemaphore> imageAvailable;
-
-	/**
-	 * @brief Semaphores for synchronizing render completion.
+	 * @brief Semaphores for synchronizing render completion, one per swapchain image.
 	 *
-	 * These semaphores ensure that rendering is finished before the image is presented to the screen.
+	 * The present of an image waits on its semaphore, so it is only signalled again after
+	 * the same image was acquired again (image availability is per frame context).
 	 */
 	std::vector<VkSemaphore> renderFinished;
 
-	/**
-	 * @brief Fences for synchronizing frame drawing.
-	 *
-	 * Fences are used to ensure that command buffer execution is complete before reusing it.
-	 */
-	std::vector<VkFence> drawFences;
-
 
 	// Vulkan Functions
 	// - Create Functions
@@ -641,12 +1203,20 @@ private:
 	void createSwapChain();
 
 	/**
-	 * @brief Creates the Vulkan render pass.
+	 * @brief Recreates the swapchain with the current window size.
+	 *
+	 * Only the swapchain and the render graph's attachments are rebuilt, pipelines use
+	 * dynamic viewport and scissor so they, and every loaded model and texture, are kept.
+	 */
+	void recreateSwapChain();
+
+	/**
+	 * @brief Declares the passes of the frame and compiles the render graph.
 	 *
-	 * The render pass defines how framebuffers and attachments (color, depth, stencil)
-	 * are used during rendering.
+	 * The graph creates the render passes (with load / store ops from how the attachments
+	 * are used) and the transient attachments, the pipelines are created against them.
 	 */
-	void createRenderPass();
+	void buildRenderGraph();
 
 	/**
 	 * @brief Creates the descriptor set layout.
@@ -673,19 +1243,14 @@ private:
 	void createGraphicsPipeline();
 
 	/**
-	 * @brief Creates the Vulkan depth buffer image.
-	 *
-	 * The depth buffer is used for depth testing to ensure proper rendering order
-	 * based on object distance from the camera.
+	 * @brief Creates the pipeline cache from the file saved by the previous run.
 	 */
-	void createDepthBufferImage();
+	void createPipelineCache();
 
 	/**
-	 * @brief Creates the framebuffers for the swapchain images.
-	 *
-	 * Each framebuffer stores color and depth attachments for rendering.
+	 * @brief Starts watching the sources of the shaders used by the pipelines.
 	 */
-	void createFramebuffers();
+	void createShaderHotReload();
 
 	/**
 	 * @brief Creates the Vulkan command pool.
@@ -696,21 +1261,30 @@ private:
 	void createCommandPool();
 
 	/**
-	 * @brief Creates the Vulkan command buffers.
+	 * @brief Creates one frame context per frame in flight.
 	 *
-	 * Command buffers store rendering commands that are executed by the GPU.
-	 * These include draw calls, pipeline state changes, and memory operations.
+	 * Every context owns the command buffers, uniform ring, descriptor pool and fence
+	 * the CPU uses while recording its frame.
 	 */
-	void createCommandBuffers();
+	void createFrameContexts();
 
 	/**
-	 * @brief Creates synchronization objects for frame rendering.
+	 * @brief Creates the query pools of the GPU profiler (one slot per frame context).
+	 */
+	void createGpuProfiler();
+
+	/**
+	 * @brief Creates the synchronization objects tied to the swapchain images.
 	 *
-	 * Synchronization objects include semaphores and fences that ensure proper
-	 * frame ordering and prevent rendering stalls.
+	 * The render finished semaphores and the image fence tracking, recreated with the swapchain.
 	 */
 	void createSynchronisation();
 
+	/**
+	 * @brief Destroys what createSynchronisation created.
+	 */
+	void destroySynchronisation();
+
 	/**
 	 * @brief Creates a Vulkan texture sampler.
 	 *
@@ -719,47 +1293,193 @@ private:
 	void createTextureSampler();
 
 	/**
-	 * @brief Creates uniform buffers for storing transformation matrices.
+	 * @brief Loads the default texture and creates material 0 from it, used by meshes without a material.
+	 */
+	void createDefaultMaterial();
+
+	/**
+	 * @brief Loads the environment lighting from its cache file, or precomputes and caches it.
+	 */
+	void createEnvironmentLighting();
+
+	/**
+	 * @brief Writes this frame's uniform data into the frame's uniform ring.
 	 *
-	 * These buffers hold view, projection, and model matrices, which are updated
-	 * every frame and sent to shaders.
+	 * The view-projection, lighting and point light data are copied into the ring and a descriptor set
+	 * pointing at them is allocated from the frame's descriptor pool.
+	 *
+	 * @param frame The frame context being recorded.
+	 * @return Descriptor set 0 of the frame.
 	 */
-	void createUniformBuffers();
+	VkDescriptorSet updateUniformBuffers(FrameContext& frame);
 
 	/**
-	 * @brief Creates the Vulkan descriptor pool.
+	 * @brief Records the draws of the main pass.
+	 *
+	 * Called by the render graph inside the pass's render pass. Narrows the viewport to the
+	 * area of the dynamic resolution, binds the pipeline, vertex buffers and descriptor sets
+	 * and draws the visible entities.
 	 *
-	 * The descriptor pool is used to allocate descriptor sets for uniform buffers,
-	 * allowing shaders to access transformation data.
+	 * @param commandBuffer The command buffer of the pass.
 	 */
-	void createDescriptorPool();
+	void recordMainPass(VkCommandBuffer commandBuffer);
 
 	/**
-	 * @brief Creates the Vulkan descriptor sets.
+	 * @brief Records the depth prepass: the visible entities with the depth only pipeline.
 	 *
-	 * Descriptor sets define how uniform buffers and textures are bound to shaders.
+	 * @param commandBuffer The command buffer of the pass.
 	 */
-	void createDescriptorSets();
+	void recordDepthPrepass(VkCommandBuffer commandBuffer);
 
 	/**
-	 * @brief Updates the uniform buffers for a given frame.
+	 * @brief Draws the meshes of every visible entity with the bound pipeline, sorted by material.
 	 *
-	 * This function updates the transformation matrices (view, projection, and model)
-	 * for the specified swapchain image index.
+	 * Set 0 is bound once, a material's set only when it differs from the previous draw's
+	 * and the push constants only when the entity changes.
 	 *
-	 * @param imageIndex The index of the current swapchain image being rendered.
+	 * @param commandBuffer The command buffer of the pass.
 	 */
-	void updateUniformBuffers(uint32_t imageIndex);
+	void drawVisibleEntities(VkCommandBuffer commandBuffer);
 
 	/**
-	 * @brief Records Vulkan command buffers for rendering.
+	 * @brief Draws the terrain's patches selected this frame, after the entities.
 	 *
-	 * This function encodes drawing commands, including pipeline state, vertex buffers,
-	 * and draw calls, into a command buffer for execution.
+	 * @param commandBuffer The command buffer of the pass.
+	 * @param depthOnly True in the depth prepass.
+	 */
+	void drawTerrain(VkCommandBuffer commandBuffer, bool depthOnly);
+
+	/**
+	 * @brief Records the deferred pass: the G-buffer subpass, then the full screen lighting subpass.
 	 *
-	 * @param currentImage The index of the current swapchain image.
+	 * @param commandBuffer The command buffer of the pass.
 	 */
-	void recordCommands(uint32_t currentImage);
+	void recordDeferredPass(VkCommandBuffer commandBuffer);
+
+	/**
+	 * @brief Records the light culling: one workgroup per tile writes the lights touching it.
+	 *
+	 * @param commandBuffer The command buffer of the pass.
+	 */
+	void recordLightCulling(VkCommandBuffer commandBuffer);
+
+	/**
+	 * @brief Points the deferred lighting and the light culling at this frame's G-buffer and tile lists.
+	 *
+	 * @param frame The frame context being recorded.
+	 */
+	void updateDeferredDescriptors(FrameContext& frame);
+
+	/**
+	 * @brief Creates the two TAA history images at the swapchain extent, shader readable.
+	 *
+	 * @throws std::runtime_error if an image can't be created.
+	 */
+	void createTemporalHistory();
+	void destroyTemporalHistory();
+
+	/**
+	 * @brief Creates the post processing's layouts and adapted luminance, and builds its pipelines.
+	 *
+	 * @throws std::runtime_error if a Vulkan object or pipeline can't be created.
+	 */
+	void createPostProcessing();
+
+	/**
+	 * @brief Creates the ambient occlusion's layouts and accumulation images, its pipelines are built with the post processing's.
+	 *
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void createAmbientOcclusion();
+
+	/**
+	 * @brief Starts the animation workers and creates the skinning layouts, its pipeline is built with the post processing's.
+	 *
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void createSkinning();
+
+	/**
+	 * @brief Creates the particle pool and layouts and builds the particles' draw pipeline, before the post processing builds the compute pipelines.
+	 *
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void createParticles();
+
+	/**
+	 * @brief Moves the emitters attached to entities along with them.
+	 */
+	void updateParticleEmitters();
+
+	/**
+	 * @brief Creates the texture streamer's feedback buffers, before the first texture is loaded.
+	 *
+	 * @throws std::runtime_error if a Vulkan object can't be created.
+	 */
+	void createTextureStreaming();
+
+	/**
+	 * @brief Tiles and opens the virtual texture, or binds placeholders if there is none.
+	 *
+	 * @throws std::runtime_error if the image can't be loaded or a Vulkan object can't be created.
+	 */
+	void createVirtualTexture();
+
+	/**
+	 * @brief Loads the heightmap and acquires the terrain's material, after the default material.
+	 *
+	 * @throws std::runtime_error if the heightmap can't be loaded or a Vulkan object can't be created.
+	 */
+	void createTerrain();
+
+	/**
+	 * @brief Creates the model, its materials and its entity from an imported scene.
+	 *
+	 * @param scene The imported model file.
+	 * @param controlable Specifies whether the model can be moved by the user.
+	 * @param startPos The initial position of the model in world space.
+	 * @param isLookingAt If true, the model is rotated to face a target.
+	 * @param lookAt The position the model should face.
+	 * @param decodedTextures Texture files already decoded by the world streamer, nullptr if none.
+	 * @return The entity created for the model.
+	 */
+	Entity createMeshModelFromScene(const aiScene* scene, bool controlable, glm::vec3 startPos, bool isLookingAt, glm::vec3 lookAt,
+		const DecodedTextureMap* decodedTextures);
+
+	/**
+	 * @brief Loads the textures of material slots through the texture streamer.
+	 *
+	 * @param decodedTextures Texture files already decoded by the world streamer, nullptr if none.
+	 */
+	MaterialLibrary::TextureLoader makeTextureLoader(const DecodedTextureMap* decodedTextures);
+
+	/**
+	 * @brief Destroys the buffers of the retired models no frame in flight draws anymore.
+	 */
+	void destroyRetiredModels();
+
+	/**
+	 * @brief Points the TAA pass at this frame's scene targets and history.
+	 *
+	 * @param frame The frame context being recorded.
+	 * @return The descriptor set of the TAA pass.
+	 */
+	VkDescriptorSet updateTemporalDescriptors(FrameContext& frame);
+
+	/**
+	 * @brief Records the TAA pass: one full screen triangle.
+	 *
+	 * @param commandBuffer The command buffer of the pass.
+	 */
+	void recordTemporalPass(VkCommandBuffer commandBuffer);
+
+	/**
+	 * @brief Brings the scene BVH up to date and collects the visible entities.
+	 *
+	 * Refits (or rebuilds) the BVH from the entity transforms, then tests the bounding
+	 * spheres against the frustum of the current view-projection matrix in SIMD batches.
+	 */
+	void updateSceneVisibility();
 
 	/**
 	 * @brief Selects a suitable Vulkan physical device (GPU).
@@ -848,9 +1568,9 @@ private:
 	VkSurfaceFormatKHR chooseBestSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
 
 	/**
-	 * @brief Selects the best presentation mode for the swapchain.
+	 * @brief Selects the presentation mode for the swapchain.
 	 *
-	 * This function determines the optimal presentation mode based on the available options.
+	 * Uses the mode requested through setPresentMode(), or the closest available one.
 	 *
 	 * @param presentationModes A vector of available VkPresentModeKHR modes.
 	 * @return The selected VkPresentModeKHR mode.
@@ -909,46 +1629,31 @@ private:
 	 */
 	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
 
-	/**
-	 * @brief Creates a Vulkan shader module.
-	 *
-	 * This function loads and compiles a SPIR-V shader binary into a Vulkan shader module.
-	 *
-	 * @param code The binary SPIR-V shader code.
-	 * @return The created VkShaderModule.
-	 */
-	VkShaderModule createShaderModule(const std::vector<char>& code);
-
 	/**
 	 * @brief Creates a Vulkan texture image from a file.
 	 *
-	 * This function loads an image from disk, converts it into a Vulkan-compatible texture,
-	 * and uploads it to the GPU.
+	 * This function loads an image from disk and hands it to the texture streamer, which
+	 * builds its mip chain and uploads the smallest mips to the GPU.
 	 *
 	 * @param fileName The path to the texture file.
-	 * @return The ID of the created texture image.
+	 * @param format Format of the image, the sRGB one for colour data.
+	 * @param decoded The file's pixels if they are already decoded, nullptr to load the file.
+	 * @return The ID of the created texture in the texture streamer.
 	 */
-	int createTextureImage(std::string fileName);
+	int createTextureImage(std::string fileName, VkFormat format, const DecodedTexture* decoded = nullptr);
 
 	/**
 	 * @brief Creates a Vulkan texture.
 	 *
-	 * This function initializes a Vulkan texture, including the image, memory, and sampler.
+	 * This function initializes a Vulkan texture, including the image, memory and view.
+	 * A file already loaded in the same format is reused.
 	 *
 	 * @param fileName The path to the texture file.
-	 * @return The ID of the created texture.
-	 */
-	int createTexture(std::string fileName);
-
-	/**
-	 * @brief Creates a descriptor for a texture.
-	 *
-	 * This function generates a descriptor set for a given texture image view.
-	 *
-	 * @param textureImage The image view associated with the texture.
-	 * @return The ID of the created texture descriptor.
+	 * @param format Format of the image, the sRGB one for colour data.
+	 * @param decoded The file's pixels if they are already decoded, nullptr to load the file.
+	 * @return The ID of the texture in the texture streamer.
 	 */
-	int createTextureDescriptor(VkImageView textureImage);
+	int createTexture(std::string fileName, VkFormat format, const DecodedTexture* decoded = nullptr);
 
 
 	/**
@@ -13,6 +13,7 @@ Window::Window()
 
 	this->xChange = 0.0f;
 	this->yChange = 0.0f;
+	this->framebufferResized = false;
 }
 
 Window::Window(int windowWidth, int windowHeight, std::string winName = "Window")
@@ -27,13 +28,14 @@ Window::Window(int windowWidth, int windowHeight, std::string winName = "Window"
 
 	this->xChange = 0.0f;
 	this->yChange = 0.0f;
+	this->framebufferResized = false;
 
 	// Initialise GLFW
 	glfwInit();
 
 	// Set GLFW to NOT work with OpenGL
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	
 	this->mainWindow = glfwCreateWindow(width, height, winName.c_str(), nullptr, nullptr);
 
@@ -101,11 +103,27 @@ void Window::handleMouse(GLFWwindow* window, double xPos, double yPos)
 	theWindow->lastY = yPos;
 }
 
+void Window::handleResize(GLFWwindow* window, int newWidth, int newHeight)
+{
+	Window* theWindow = static_cast<Window*>(glfwGetWindowUserPointer(window));
+
+	theWindow->bufferWidth = newWidth;
+	theWindow->bufferHeight = newHeight;
+	theWindow->framebufferResized = true;
+}
+
+bool Window::wasResized()
+{
+	bool resized = framebufferResized;
+	framebufferResized = false;
+	return resized;
+}
 
 void Window::createCallbacks()
 {
 	glfwSetKeyCallback(mainWindow, handleKeys);
 	glfwSetCursorPosCallback(mainWindow, handleMouse);
+	glfwSetFramebufferSizeCallback(mainWindow, handleResize);
 }
 
 Window::~Window()
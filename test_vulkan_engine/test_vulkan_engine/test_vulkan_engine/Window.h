@@ -19,6 +19,9 @@ public:
 	float getXChange();
 	float getYChange();
 
+	// True once after the framebuffer was resized
+	bool wasResized();
+
 	~Window();
 
 private:
@@ -33,9 +36,11 @@ private:
 	float xChange;
 	float yChange;
 	bool mouseFirstMoved;
+	bool framebufferResized;
 
 	void createCallbacks();
 	static void handleKeys(GLFWwindow* window, int key, int code, int action, int mode);
 	static void handleMouse(GLFWwindow* window, double xPos, double yPos);
+	static void handleResize(GLFWwindow* window, int newWidth, int newHeight);
 };
 
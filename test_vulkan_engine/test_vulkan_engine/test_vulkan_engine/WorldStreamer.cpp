@@ -0,0 +1,469 @@
+#include "WorldStreamer.h"
+
+#include "MeshModel.h"
+#include "CpuProfiler.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+	const float VELOCITY_SMOOTHING = 0.25f;		// Seconds, a single jerky frame doesn't turn the prefetch around
+
+	// Distance of a point to a cell's square on the XZ plane, 0 inside it
+	float distanceToCell(glm::vec3 point, glm::vec2 minCorner, glm::vec2 maxCorner)
+	{
+		glm::vec2 position(point.x, point.z);
+		glm::vec2 outside = glm::max(glm::max(minCorner - position, position - maxCorner), glm::vec2(0.0f));
+		return glm::length(outside);
+	}
+
+	double toMiB(uint64_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+WorldStreamer::WorldStreamer()
+{
+}
+
+void WorldStreamer::create(const std::string& manifestFile, const StreamingSettings& newSettings, const ModelInstancer& newInstancer,
+	const ModelReleaser& newReleaser, const TextureUploader& newTextureUploader)
+{
+	settings = newSettings;
+	instancer = newInstancer;
+	releaser = newReleaser;
+	textureUploader = newTextureUploader;
+
+	readManifest(manifestFile);
+
+	stopping = false;
+	loader = std::thread(&WorldStreamer::loaderLoop, this);
+	active = true;
+
+	printf("World streaming: %zu cells of %.0f units, budget %.0f MiB\n", cells.size(), cellSize, toMiB(settings.memoryBudget));
+}
+
+void WorldStreamer::readManifest(const std::string& manifestFile)
+{
+	std::ifstream file(manifestFile);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open the world manifest! (" + manifestFile + ")");
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream stream(line);
+		std::string statement;
+		if (!(stream >> statement))
+		{
+			continue;
+		}
+
+		bool valid = false;
+		if (statement == "cell_size")
+		{
+			valid = cells.empty() && (stream >> cellSize) && cellSize > 0.0f;
+		}
+		else if (statement == "cell")
+		{
+			Cell cell;
+			valid = static_cast<bool>(stream >> cell.coord.x >> cell.coord.y);
+			if (valid)
+			{
+				cells.push_back(cell);
+			}
+		}
+		else if (statement == "model")
+		{
+			CellModel model;
+			model.yaw = 0.0f;
+			valid = !cells.empty() && (stream >> model.file >> model.position.x >> model.position.y >> model.position.z);
+			if (valid)
+			{
+				stream >> model.yaw;
+				cells.back().models.push_back(model);
+			}
+		}
+		else if (statement == "texture")
+		{
+			CellTexture texture;
+			std::string space;
+			valid = !cells.empty() && (stream >> texture.file >> space) && (space == "srgb" || space == "linear");
+			if (valid)
+			{
+				texture.srgb = space == "srgb";
+				cells.back().textures.push_back(texture);
+			}
+		}
+
+		if (!valid)
+		{
+			throw std::runtime_error("Failed to parse the world manifest! (" + manifestFile + ", line " + std::to_string(lineNumber) + ")");
+		}
+	}
+}
+
+void WorldStreamer::update(glm::vec3 cameraPosition, float deltaTime)
+{
+	if (!active)
+	{
+		return;
+	}
+
+	PROFILE_FUNCTION();
+
+	// -- PRIORITIES --
+	// The velocity only comes from the positions, so the streamer works whatever moves the camera
+	if (hasCameraPosition && deltaTime > 0.0f)
+	{
+		glm::vec3 velocity = (cameraPosition - lastCameraPosition) / deltaTime;
+		cameraVelocity = glm::mix(cameraVelocity, velocity, 1.0f - std::exp(-deltaTime / VELOCITY_SMOOTHING));
+	}
+	lastCameraPosition = cameraPosition;
+	hasCameraPosition = true;
+
+	glm::vec3 predictedPosition = cameraPosition + cameraVelocity * settings.prefetchTime;
+	for (Cell& cell : cells)
+	{
+		cell.priority = computePriority(cell, cameraPosition, predictedPosition);
+	}
+
+	// -- UPLOADS --
+	std::vector<LoadedCell> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t count = std::min<size_t>(loaded.size(), MAX_CELL_UPLOADS_PER_FRAME);
+		std::move(loaded.begin(), loaded.begin() + count, std::back_inserter(finished));
+		loaded.erase(loaded.begin(), loaded.begin() + count);
+	}
+	for (LoadedCell& loadedCell : finished)
+	{
+		Cell& cell = cells[loadedCell.cell];
+		pendingLoads--;
+		pendingBytes -= cell.estimatedBytes;
+
+		// The camera turned away while it was loading
+		if (cell.priority > settings.unloadRadius)
+		{
+			cell.state = CELL_UNLOADED;
+			continue;
+		}
+
+		uploadCell(loadedCell);
+	}
+
+	// -- EVICTION --
+	for (uint32_t i = 0; i < cells.size(); i++)
+	{
+		if (cells[i].state == CELL_RESIDENT && cells[i].priority > settings.unloadRadius)
+		{
+			evictCell(i);
+		}
+	}
+
+	// A cell may turn out larger than estimated, the least important ones make up for it
+	while (residentBytes > settings.memoryBudget && evictLeastImportant(-1.0f))
+	{
+	}
+
+	// -- REQUESTS --
+	std::vector<uint32_t> wanted;
+	for (uint32_t i = 0; i < cells.size(); i++)
+	{
+		if (cells[i].state == CELL_UNLOADED && cells[i].priority <= settings.loadRadius)
+		{
+			wanted.push_back(i);
+		}
+	}
+	std::sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b) { return cells[a].priority < cells[b].priority; });
+
+	{
+		// Queued cells that left the load radius are dropped before the loader gets to them
+		std::lock_guard<std::mutex> lock(mutex);
+		auto dropped = std::remove_if(requests.begin(), requests.end(), [this](uint32_t c) { return cells[c].priority > settings.loadRadius; });
+		for (auto it = dropped; it != requests.end(); ++it)
+		{
+			cells[*it].state = CELL_UNLOADED;
+			pendingLoads--;
+			pendingBytes -= cells[*it].estimatedBytes;
+		}
+		requests.erase(dropped, requests.end());
+	}
+
+	// A cell that doesn't fit may only push out less important ones, otherwise it waits, so two cells never evict each other in turn
+	std::vector<uint32_t> newRequests;
+	for (uint32_t cellIndex : wanted)
+	{
+		Cell& cell = cells[cellIndex];
+		if (pendingLoads >= MAX_PENDING_CELL_LOADS || !makeRoom(cell.estimatedBytes, cell.priority))
+		{
+			break;
+		}
+
+		cell.state = CELL_PENDING;
+		pendingLoads++;
+		pendingBytes += cell.estimatedBytes;
+		newRequests.push_back(cellIndex);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.insert(requests.end(), newRequests.begin(), newRequests.end());
+		std::sort(requests.begin(), requests.end(), [this](uint32_t a, uint32_t b) { return cells[a].priority < cells[b].priority; });
+	}
+	if (!newRequests.empty())
+	{
+		wake.notify_one();
+	}
+}
+
+float WorldStreamer::computePriority(const Cell& cell, glm::vec3 position, glm::vec3 predictedPosition) const
+{
+	glm::vec2 minCorner = glm::vec2(cell.coord) * cellSize;
+	glm::vec2 maxCorner = minCorner + glm::vec2(cellSize);
+	return std::min(distanceToCell(position, minCorner, maxCorner), distanceToCell(predictedPosition, minCorner, maxCorner));
+}
+
+void WorldStreamer::uploadCell(LoadedCell& loadedCell)
+{
+	PROFILE_SCOPE("Upload world cell");
+
+	Cell& cell = cells[loadedCell.cell];
+
+	// Prefetched textures first, the models' materials then find them in the renderer's cache
+	for (const CellTexture& texture : cell.textures)
+	{
+		auto decoded = loadedCell.textures.find(texture.file);
+		if (decoded != loadedCell.textures.end())
+		{
+			textureUploader(texture.file, texture.srgb, decoded->second);
+		}
+	}
+
+	cell.residentBytes = 0;
+	for (size_t i = 0; i < cell.models.size(); i++)
+	{
+		if (loadedCell.importers[i] == nullptr)
+		{
+			continue;
+		}
+
+		const CellModel& model = cell.models[i];
+		uint64_t modelBytes = 0;
+		Entity entity = instancer(loadedCell.importers[i]->GetScene(), model.position, model.yaw, loadedCell.textures, &modelBytes);
+		cell.entities.push_back(entity);
+		cell.residentBytes += modelBytes;
+	}
+
+	cell.estimatedBytes = cell.residentBytes;
+	cell.state = CELL_RESIDENT;
+	residentBytes += cell.residentBytes;
+
+	{
+		// Uploaded now, later cells leave them to the renderer's cache
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& texture : loadedCell.textures)
+		{
+			uploadedTextures.insert(texture.first);
+		}
+	}
+
+	printf("World streaming: cell (%d, %d) loaded, %zu models, %.1f MiB (resident %.1f of %.1f MiB)\n",
+		cell.coord.x, cell.coord.y, cell.entities.size(), toMiB(cell.residentBytes), toMiB(residentBytes), toMiB(settings.memoryBudget));
+}
+
+void WorldStreamer::evictCell(uint32_t cellIndex)
+{
+	Cell& cell = cells[cellIndex];
+	for (Entity entity : cell.entities)
+	{
+		releaser(entity);
+	}
+
+	residentBytes -= cell.residentBytes;
+	cell.entities.clear();
+	cell.residentBytes = 0;
+	cell.state = CELL_UNLOADED;
+
+	printf("World streaming: cell (%d, %d) evicted (resident %.1f MiB)\n", cell.coord.x, cell.coord.y, toMiB(residentBytes));
+}
+
+bool WorldStreamer::evictLeastImportant(float priority)
+{
+	// The resident cell furthest from the camera, if it matters less than the given priority
+	uint32_t victim = static_cast<uint32_t>(cells.size());
+	for (uint32_t i = 0; i < cells.size(); i++)
+	{
+		if (cells[i].state == CELL_RESIDENT && cells[i].priority > priority
+			&& (victim == cells.size() || cells[i].priority > cells[victim].priority))
+		{
+			victim = i;
+		}
+	}
+
+	if (victim == cells.size())
+	{
+		return false;
+	}
+
+	evictCell(victim);
+	return true;
+}
+
+bool WorldStreamer::makeRoom(uint64_t bytes, float priority)
+{
+	// The loads still pending are counted with their estimates
+	while (residentBytes + pendingBytes + bytes > settings.memoryBudget)
+	{
+		if (!evictLeastImportant(priority))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void WorldStreamer::loaderLoop()
+{
+	CpuProfiler::setThreadName("World streaming");
+
+	while (true)
+	{
+		uint32_t cellIndex;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !requests.empty(); });
+			if (stopping)
+			{
+				return;
+			}
+
+			cellIndex = requests.front();
+			requests.erase(requests.begin());
+		}
+
+		LoadedCell result;
+		result.cell = cellIndex;
+		loadCell(cellIndex, result);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded.push_back(std::move(result));
+	}
+}
+
+void WorldStreamer::loadCell(uint32_t cellIndex, LoadedCell& result)
+{
+	PROFILE_SCOPE("Load world cell");
+
+	// Only the manifest part of the cell is read here, it never changes after create()
+	const Cell& cell = cells[cellIndex];
+	for (const CellModel& model : cell.models)
+	{
+		std::unique_ptr<Assimp::Importer> importer(new Assimp::Importer());
+		if (importer->ReadFile("Models/" + model.file, MODEL_IMPORT_FLAGS) == nullptr)
+		{
+			printf("WARNING: World streaming failed to load a model! (%s)\n", model.file.c_str());
+			result.importers.push_back(nullptr);
+			continue;
+		}
+
+		// The textures of its materials are decoded here as well, the main thread only uploads them
+		for (const MaterialDesc& material : MeshModel::LoadMaterials(importer->GetScene()))
+		{
+			for (const std::string& texture : material.textures)
+			{
+				if (!texture.empty())
+				{
+					decodeTexture(texture, result.textures);
+				}
+			}
+		}
+
+		result.importers.push_back(std::move(importer));
+	}
+
+	for (const CellTexture& texture : cell.textures)
+	{
+		decodeTexture(texture.file, result.textures);
+	}
+}
+
+void WorldStreamer::decodeTexture(const std::string& fileName, DecodedTextureMap& textures)
+{
+	if (textures.count(fileName) != 0)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (uploadedTextures.count(fileName) != 0)
+		{
+			return;
+		}
+	}
+
+	// A file that can't be decoded is left to the renderer, which reports it when a material asks for it
+	int width, height, channels;
+	std::string fileLoc = "Textures/" + fileName;
+	stbi_uc* image = stbi_load(fileLoc.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!image)
+	{
+		return;
+	}
+
+	DecodedTexture& texture = textures[fileName];
+	texture.width = width;
+	texture.height = height;
+	texture.pixels.assign(image, image + static_cast<size_t>(width) * height * 4);
+	stbi_image_free(image);
+}
+
+bool WorldStreamer::isActive() const
+{
+	return active;
+}
+
+uint64_t WorldStreamer::getResidentBytes() const
+{
+	return residentBytes;
+}
+
+void WorldStreamer::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	if (loader.joinable())
+	{
+		loader.join();
+	}
+
+	// The renderer frees every model at cleanup, the resident cells are just forgotten
+	requests.clear();
+	loaded.clear();
+	cells.clear();
+	active = false;
+}
+
+WorldStreamer::~WorldStreamer()
+{
+}
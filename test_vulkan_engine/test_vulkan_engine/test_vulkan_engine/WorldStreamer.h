@@ -0,0 +1,205 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include "Components.h"
+
+// Side of a cell when the manifest doesn't set one
+const float DEFAULT_WORLD_CELL_SIZE = 200.0f;
+
+// Loaded cells turned into GPU resources per frame, each upload blocks the frame for a moment
+const uint32_t MAX_CELL_UPLOADS_PER_FRAME = 1;
+
+// Cells queued for or on the loader thread at a time
+const uint32_t MAX_PENDING_CELL_LOADS = 4;
+
+/**
+ * @struct DecodedTexture
+ * @brief A texture file decoded off the main thread, RGBA8.
+ */
+struct DecodedTexture
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels;
+};
+
+typedef std::unordered_map<std::string, DecodedTexture> DecodedTextureMap;
+
+/**
+ * @struct StreamingSettings
+ * @brief When the cells around the camera are loaded and evicted.
+ */
+struct StreamingSettings
+{
+	uint64_t memoryBudget = 256ull * 1024 * 1024;	///< Bytes of geometry the resident cells may hold.
+	float loadRadius = 300.0f;						///< Cells closer than this (on the XZ plane) are loaded.
+	float unloadRadius = 450.0f;					///< Cells further than this are evicted, the gap keeps a cell from flickering at the edge.
+	float prefetchTime = 2.0f;						///< Seconds of the camera's motion looked ahead, cells near that point load early.
+};
+
+/**
+ * @class WorldStreamer
+ * @brief Keeps the cells of a large world near the camera resident, loading them on a background thread.
+ *
+ * The manifest splits the world into a grid of square cells on the XZ plane, each listing the
+ * models placed in it and the textures to prefetch with it. Every frame the cells are ranked by
+ * their distance to the camera or to where the camera's velocity takes it, whichever is nearer.
+ * The nearest missing ones are queued, the loader thread imports their models and decodes their
+ * textures, and the main thread turns at most MAX_CELL_UPLOADS_PER_FRAME finished cells a frame
+ * into entities. Cells leaving the unload radius are evicted, and so are the lowest ranked ones
+ * when a nearer cell doesn't fit the memory budget.
+ *
+ * The streamer only owns the CPU side, the renderer creates and frees the GPU resources through
+ * the callbacks. Textures stay loaded once uploaded (the texture streamer decides which of their mips
+ * are on the GPU), the materials sharing them are never freed.
+ */
+class WorldStreamer
+{
+public:
+	/**
+	 * @brief Creates the entity of a streamed model, returns the entity.
+	 *
+	 * The texture files of the model's materials found in the map are already decoded.
+	 * gpuBytes is set to the memory of the model's buffers.
+	 */
+	typedef std::function<Entity(const aiScene* scene, glm::vec3 position, float yaw, const DecodedTextureMap& textures,
+		uint64_t* gpuBytes)> ModelInstancer;
+
+	// Destroys the entity of a streamed model and, once the GPU is done with it, its buffers
+	typedef std::function<void(Entity entity)> ModelReleaser;
+
+	// Uploads a texture prefetched for a cell, sRGB for colour data
+	typedef std::function<void(const std::string& fileName, bool srgb, const DecodedTexture& texture)> TextureUploader;
+
+	WorldStreamer();
+
+	/**
+	 * @brief Reads the manifest and starts the loader thread.
+	 *
+	 * The manifest is a text file, one statement per line ('#' starts a comment):
+	 *   cell_size <size>                   side of the cells, before the first cell
+	 *   cell <x> <z>                       starts the cell covering [x, x + 1) * size, [z, z + 1) * size
+	 *   model <file> <x> <y> <z> [yaw]     a model of the Models folder at a world position, yaw in degrees
+	 *   texture <file> <srgb|linear>       a texture of the Textures folder loaded with the cell
+	 *
+	 * @param manifestFile Path of the manifest.
+	 * @param newSettings Radii and budget of the streaming.
+	 * @param newInstancer Creates the streamed models.
+	 * @param newReleaser Frees them.
+	 * @param newTextureUploader Uploads the prefetched textures.
+	 * @throws std::runtime_error if the manifest can't be read or is malformed.
+	 */
+	void create(const std::string& manifestFile, const StreamingSettings& newSettings, const ModelInstancer& newInstancer,
+		const ModelReleaser& newReleaser, const TextureUploader& newTextureUploader);
+
+	/**
+	 * @brief Ranks the cells around the camera, uploads finished loads, evicts and queues cells.
+	 *
+	 * @param cameraPosition Where the camera is this frame.
+	 * @param deltaTime The time elapsed since the last frame, the camera's velocity is derived from it.
+	 */
+	void update(glm::vec3 cameraPosition, float deltaTime);
+
+	bool isActive() const;
+	uint64_t getResidentBytes() const;
+
+	void destroy();
+
+	~WorldStreamer();
+
+private:
+	enum CellState
+	{
+		CELL_UNLOADED,
+		CELL_PENDING,		// Queued, or on the loader thread
+		CELL_RESIDENT
+	};
+
+	struct CellModel
+	{
+		std::string file;
+		glm::vec3 position;
+		float yaw;
+	};
+
+	struct CellTexture
+	{
+		std::string file;
+		bool srgb;
+	};
+
+	struct Cell
+	{
+		glm::ivec2 coord;
+		std::vector<CellModel> models;
+		std::vector<CellTexture> textures;
+
+		// -- MAIN THREAD ONLY --
+		CellState state = CELL_UNLOADED;
+		float priority = 0.0f;				// Distance to the camera or its predicted position, lower is more important
+		std::vector<Entity> entities;
+		uint64_t residentBytes = 0;
+		uint64_t estimatedBytes = 0;		// Size at the last load, 0 until the cell was loaded once
+	};
+
+	// A cell as the loader thread hands it over, the importers own the scenes
+	struct LoadedCell
+	{
+		uint32_t cell;
+		std::vector<std::unique_ptr<Assimp::Importer>> importers;	// Per model of the cell, nullptr if the import failed
+		DecodedTextureMap textures;
+	};
+
+	StreamingSettings settings;
+	ModelInstancer instancer;
+	ModelReleaser releaser;
+	TextureUploader textureUploader;
+
+	float cellSize = DEFAULT_WORLD_CELL_SIZE;
+	std::vector<Cell> cells;
+	uint64_t residentBytes = 0;
+	uint64_t pendingBytes = 0;					// Estimated size of the pending cells
+	uint32_t pendingLoads = 0;
+	bool active = false;
+
+	// -- CAMERA --
+	glm::vec3 lastCameraPosition = glm::vec3(0.0f);
+	glm::vec3 cameraVelocity = glm::vec3(0.0f);
+	bool hasCameraPosition = false;
+
+	// -- LOADER THREAD --
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<uint32_t> requests;						// Cells to load, most important first
+	std::vector<LoadedCell> loaded;						// Finished loads, waiting for the main thread
+	std::unordered_set<std::string> uploadedTextures;	// Textures in the renderer's cache, not decoded again
+	bool stopping = false;
+
+	void readManifest(const std::string& manifestFile);
+	float computePriority(const Cell& cell, glm::vec3 position, glm::vec3 predictedPosition) const;
+
+	void uploadCell(LoadedCell& loadedCell);
+	void evictCell(uint32_t cellIndex);
+	bool evictLeastImportant(float priority);
+	bool makeRoom(uint64_t bytes, float priority);
+
+	void loaderLoop();
+	void loadCell(uint32_t cellIndex, LoadedCell& result);
+	void decodeTexture(const std::string& fileName, DecodedTextureMap& textures);
+};
@@ -10,16 +10,215 @@
 #include <stdexcept>
 #include <vector>
 #include <iostream>
+#include <string>
+#include <random>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 
 #include "VulkanRenderer.h"
 #include "Window.h"
 #include "Camera.h"
+#include "Benchmarks.h"
 
 VulkanRenderer vulkanRenderer;
 Camera camera;
 
-int main()
+namespace
 {
+	void printUsage(const char* program)
+	{
+		printf("Usage: %s [options]\n", program);
+		printf("  --bench                         Run the CPU benchmarks and exit\n");
+		printf("  --frames-in-flight N            Frames the CPU may record ahead of the GPU (1 or more)\n");
+		printf("  --present-mode NAME             immediate, mailbox, fifo or fifo-relaxed\n");
+		printf("  --fps-limit FPS                 Frame rate cap, 0 for none\n");
+		printf("  --msaa N                        MSAA samples of the main pass: 1, 2, 4 or 8\n");
+		printf("  --render-path NAME              forward or deferred\n");
+		printf("  --point-lights N                Point lights scattered over the scene\n");
+		printf("  --dynamic-resolution FPS        Frame rate the dynamic resolution holds, 0 for native\n");
+		printf("  --environment FILE              HDR environment in the Textures folder\n");
+		printf("  --virtual-texture FILE          Large ground image in the Textures folder, paged in on demand\n");
+		printf("  --terrain FILE                  Greyscale heightmap in the Textures folder\n");
+		printf("  --terrain-size SIZE HEIGHT      Extent and height of the terrain in world units\n");
+		printf("  --animated-model FILE           Rigged model in the Models folder\n");
+		printf("  --world FILE                    World manifest streamed around the camera\n");
+		printf("  --streaming-budget MIB          Geometry the streamed world keeps resident\n");
+		printf("  --texture-budget MIB            GPU memory of the streamed texture mips\n");
+		printf("  --particles N                   Particles alive at once\n");
+	}
+
+	// The whole argument has to be a number of at least minimum, std::stoi would accept "4x" and throw on "x"
+	int parseIntArgument(const std::string& option, const char* value, long minimum)
+	{
+		char* end = nullptr;
+		errno = 0;
+		long number = std::strtol(value, &end, 10);
+		if (end == value || *end != '\0' || errno == ERANGE || number < minimum || number > INT_MAX)
+		{
+			throw std::invalid_argument(option + " expects a whole number of at least " + std::to_string(minimum) + ", got '" + value + "'");
+		}
+		return static_cast<int>(number);
+	}
+
+	double parseRealArgument(const std::string& option, const char* value, double minimum)
+	{
+		char* end = nullptr;
+		errno = 0;
+		double number = std::strtod(value, &end);
+		if (end == value || *end != '\0' || errno == ERANGE || !(number >= minimum))
+		{
+			char minimumText[32];
+			snprintf(minimumText, sizeof(minimumText), "%g", minimum);
+			throw std::invalid_argument(option + " expects a number of at least " + minimumText + ", got '" + value + "'");
+		}
+		return number;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int pointLightCount = 0;
+	std::string animatedModelFile;
+	std::string worldManifest;
+	StreamingSettings streamingSettings;
+	std::string terrainFile;
+	TerrainSettings terrainSettings;
+
+	// A malformed number ends the program with the usage instead of an uncaught exception
+	try
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			// Run the CPU benchmarks instead of the application
+			if (std::string(argv[i]) == "--bench")
+			{
+				runBenchmarks();
+				return 0;
+			}
+
+			// Frames the CPU may record ahead of the GPU (latency vs. smoothness)
+			if (std::string(argv[i]) == "--frames-in-flight" && i + 1 < argc)
+			{
+				vulkanRenderer.setFramesInFlight(static_cast<uint32_t>(parseIntArgument("--frames-in-flight", argv[++i], 1)));
+			}
+
+			// immediate, mailbox, fifo or fifo-relaxed
+			if (std::string(argv[i]) == "--present-mode" && i + 1 < argc)
+			{
+				std::string modeName = argv[++i];
+				for (int mode = 0; mode < PRESENT_MODE_COUNT; mode++)
+				{
+					if (modeName == FramePacer::getPresentModeName(static_cast<PresentMode>(mode)))
+					{
+						vulkanRenderer.setPresentMode(static_cast<PresentMode>(mode));
+					}
+				}
+			}
+
+			// MSAA samples of the main pass: 1, 2, 4 or 8
+			if (std::string(argv[i]) == "--msaa" && i + 1 < argc)
+			{
+				vulkanRenderer.setMsaaSamples(static_cast<uint32_t>(parseIntArgument("--msaa", argv[++i], 1)));
+			}
+
+			// forward or deferred lighting
+			if (std::string(argv[i]) == "--render-path" && i + 1 < argc)
+			{
+				std::string pathName = argv[++i];
+				for (int path = 0; path < RENDER_PATH_COUNT; path++)
+				{
+					if (pathName == VulkanRenderer::getRenderPathName(static_cast<RenderPath>(path)))
+					{
+						vulkanRenderer.setRenderPath(static_cast<RenderPath>(path));
+					}
+				}
+			}
+
+			// Point lights scattered over the scene, to compare the render paths under load
+			if (std::string(argv[i]) == "--point-lights" && i + 1 < argc)
+			{
+				pointLightCount = parseIntArgument("--point-lights", argv[++i], 0);
+			}
+
+			// Frame rate the dynamic resolution holds, 0 for native resolution (default: the refresh rate)
+			if (std::string(argv[i]) == "--dynamic-resolution" && i + 1 < argc)
+			{
+				vulkanRenderer.setDynamicResolutionTarget(parseRealArgument("--dynamic-resolution", argv[++i], 0.0));
+			}
+
+			// HDR environment in the Textures folder the scene is lit by
+			if (std::string(argv[i]) == "--environment" && i + 1 < argc)
+			{
+				vulkanRenderer.setEnvironmentMap(argv[++i]);
+			}
+
+			// Large image in the Textures folder stretched over the ground, paged in as the camera needs it
+			if (std::string(argv[i]) == "--virtual-texture" && i + 1 < argc)
+			{
+				vulkanRenderer.setVirtualTexture(argv[++i]);
+			}
+
+			// Greyscale heightmap in the Textures folder drawn as the ground instead of the ground model
+			if (std::string(argv[i]) == "--terrain" && i + 1 < argc)
+			{
+				terrainFile = argv[++i];
+			}
+
+			// Extent and height of the terrain in world units, centred under the origin
+			if (std::string(argv[i]) == "--terrain-size" && i + 2 < argc)
+			{
+				terrainSettings.size = static_cast<float>(parseRealArgument("--terrain-size", argv[++i], 1.0));
+				terrainSettings.heightScale = static_cast<float>(parseRealArgument("--terrain-size", argv[++i], 0.0));
+				terrainSettings.origin = glm::vec3(-0.5f * terrainSettings.size, -20.0f, -0.5f * terrainSettings.size);
+			}
+
+			// Rigged model (FBX, glTF, DAE) in the Models folder placed next to the camera, it plays its first clip
+			if (std::string(argv[i]) == "--animated-model" && i + 1 < argc)
+			{
+				animatedModelFile = argv[++i];
+			}
+
+			// World manifest streamed around the camera instead of the fixed scene
+			if (std::string(argv[i]) == "--world" && i + 1 < argc)
+			{
+				worldManifest = argv[++i];
+			}
+
+			// MiB of geometry the streamed world keeps resident
+			if (std::string(argv[i]) == "--streaming-budget" && i + 1 < argc)
+			{
+				streamingSettings.memoryBudget = static_cast<uint64_t>(parseIntArgument("--streaming-budget", argv[++i], 1)) * 1024 * 1024;
+			}
+
+			// MiB the streamed texture mips may hold on the GPU
+			if (std::string(argv[i]) == "--texture-budget" && i + 1 < argc)
+			{
+				vulkanRenderer.setTextureBudget(static_cast<VkDeviceSize>(parseIntArgument("--texture-budget", argv[++i], 1)) * 1024 * 1024);
+			}
+
+			// Particles alive at once, rounded up to a power of two
+			if (std::string(argv[i]) == "--particles" && i + 1 < argc)
+			{
+				vulkanRenderer.setParticleCapacity(static_cast<uint32_t>(parseIntArgument("--particles", argv[++i], 1)));
+			}
+
+			// Frame rate cap, 0 for none
+			if (std::string(argv[i]) == "--fps-limit" && i + 1 < argc)
+			{
+				vulkanRenderer.getFramePacer()->setFrameLimit(parseRealArgument("--fps-limit", argv[++i], 0.0));
+			}
+		}
+	}
+	catch (const std::invalid_argument& e)
+	{
+		printf("ERROR: %s\n", e.what());
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	CpuProfiler::setThreadName("Main");
+
 	// Create Window
 	Window window = Window(1600, 900, "Vulkan");
 	
@@ -27,6 +226,7 @@ int main()
 	camera = Camera(glm::vec3(50.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f, 10.0f, 0.5f);
 
 	// Create Vulkan Renderer instance
+	vulkanRenderer.setTerrain(terrainFile, terrainSettings);
 	if (vulkanRenderer.init(window.mainWindow, &camera) == EXIT_FAILURE)
 	{
 		return EXIT_FAILURE;
@@ -35,23 +235,117 @@ int main()
 	float angle = 0.0f;
 	float deltaTime = 0.0f;
 	float lastTime = 0.0f;
-	std::vector<int> modelIds;
+	bool printKeyHeld = false;
+	bool exportKeyHeld = false;
+	bool presentModeKeyHeld = false;
+	bool pacingKeyHeld = false;
 
 	// Looad modells
-	int seahawk = vulkanRenderer.createMeshModel("Models/Seahawk.obj", false, { {200.0f}, {-20.0f}, {0.0f} }, false, { {0.0f}, {0.0f}, {0.0f} });
-	modelIds.push_back(seahawk);
-	int ground = vulkanRenderer.createMeshModel("Models/ground.obj", false, { {0.0f}, {-20.0f}, {0.0f} }, false, { {0.0f}, {0.0f}, {0.0f} });
-	modelIds.push_back(ground);
-	int flashlight = vulkanRenderer.createMeshModel("Models/flashlight.obj", true, { {0.0f}, {0.0f}, {0.0f} }, true, { {(-1.0f)}, {(0.0f)}, {(0.0f)} });
-	modelIds.push_back(flashlight);
+	// The streamed world brings its own models, the flashlight stays for the lighting
+	if (worldManifest.empty())
+	{
+		// The Seahawk stands on the terrain if there is one
+		float seahawkHeight = -20.0f;
+		vulkanRenderer.getTerrainHeight(200.0f, 0.0f, &seahawkHeight);
+		vulkanRenderer.createMeshModel("Models/Seahawk.obj", false, { {200.0f}, {seahawkHeight}, {0.0f} }, false, { {0.0f}, {0.0f}, {0.0f} });
+
+		// Rotor dust: kicked up off the ground in a ring under the rotor, falls back and settles
+		ParticleEmitterDesc rotorDust;
+		rotorDust.shape = PARTICLE_SHAPE_RING;
+		rotorDust.position = glm::vec3(200.0f, seahawkHeight + 0.2f, 0.0f);
+		rotorDust.angle = 20.0f;
+		rotorDust.radius = 8.0f;
+		rotorDust.rate = 4000.0f;
+		rotorDust.minSpeed = 6.0f;
+		rotorDust.maxSpeed = 14.0f;
+		rotorDust.minLife = 1.5f;
+		rotorDust.maxLife = 3.5f;
+		rotorDust.startSize = 0.6f;
+		rotorDust.endSize = 2.5f;
+		rotorDust.startColour = glm::vec4(0.45f, 0.38f, 0.28f, 0.5f);
+		rotorDust.endColour = glm::vec4(0.55f, 0.5f, 0.42f, 0.0f);
+		rotorDust.gravityScale = 0.4f;
+		rotorDust.drag = 0.8f;
+		vulkanRenderer.addParticleEmitter(rotorDust);
+		if (terrainFile.empty())
+		{
+			Entity ground = vulkanRenderer.createMeshModel("Models/ground.obj", false, { {0.0f}, {-20.0f}, {0.0f} }, false, { {0.0f}, {0.0f}, {0.0f} });
+			vulkanRenderer.applyVirtualTexture(ground);
+		}
+	}
+	else
+	{
+		try
+		{
+			vulkanRenderer.loadWorld(worldManifest, streamingSettings);
+		}
+		catch (const std::runtime_error& e)
+		{
+			printf("ERROR: %s\n", e.what());
+			return EXIT_FAILURE;
+		}
+	}
+	Entity flashlight = vulkanRenderer.createMeshModel("Models/flashlight.obj", true, { {0.0f}, {0.0f}, {0.0f} }, true, { {(-1.0f)}, {(0.0f)}, {(0.0f)} });
+
+	// Dust motes drifting through the flashlight's beam, bright enough to catch the bloom
+	ParticleEmitterDesc beamMotes;
+	beamMotes.shape = PARTICLE_SHAPE_CONE;
+	beamMotes.angle = 12.0f;
+	beamMotes.length = 15.0f;
+	beamMotes.rate = 300.0f;
+	beamMotes.minSpeed = 0.05f;
+	beamMotes.maxSpeed = 0.3f;
+	beamMotes.minLife = 2.0f;
+	beamMotes.maxLife = 5.0f;
+	beamMotes.startSize = 0.04f;
+	beamMotes.endSize = 0.04f;
+	beamMotes.startColour = glm::vec4(2.0f, 1.9f, 1.6f, 0.8f);
+	beamMotes.endColour = glm::vec4(2.0f, 1.9f, 1.6f, 0.0f);
+	beamMotes.gravityScale = 0.01f;
+	beamMotes.drag = 0.5f;
+	beamMotes.bounce = 0.1f;
+	vulkanRenderer.addParticleEmitter(beamMotes, flashlight);
+	vulkanRenderer.addLightSource(flashlight);
+	if (!animatedModelFile.empty())
+	{
+		vulkanRenderer.createMeshModel("Models/" + animatedModelFile, false, { {80.0f}, {-20.0f}, {0.0f} }, true, { {50.0f}, {-20.0f}, {0.0f} });
+	}
+
+	// Fixed seed, every run (and both render paths) gets the same lights
+	std::mt19937 lightRandom(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < pointLightCount; i++)
+	{
+		glm::vec3 position(unit(lightRandom) * 400.0f - 200.0f, -18.0f + unit(lightRandom) * 10.0f, unit(lightRandom) * 400.0f - 200.0f);
+		glm::vec3 colour(0.2f + unit(lightRandom) * 0.8f, 0.2f + unit(lightRandom) * 0.8f, 0.2f + unit(lightRandom) * 0.8f);
+		vulkanRenderer.addPointLight(position, colour, 50.0f, 15.0f + unit(lightRandom) * 15.0f);
+	}
 
 	
 	// Main loop
 	while (!glfwWindowShouldClose(window.mainWindow))
 	{
+		CpuProfiler::markFrame();
+
+		// Frame limiter sleep, then the input of this frame is sampled
+		vulkanRenderer.getFramePacer()->beginFrame();
+
 		// Update events
 		glfwPollEvents();
 
+		// Nothing is rendered while minimized, sleep until the window is restored
+		if (vulkanRenderer.isMinimized())
+		{
+			glfwWaitEvents();
+			lastTime = static_cast<float>(glfwGetTime());
+			continue;
+		}
+
+		if (window.wasResized())
+		{
+			vulkanRenderer.notifyWindowResized();
+		}
+
 		//Add key and mouse controll
 		camera.keyControl(window.getsKeys(), deltaTime);
 		camera.mouseControl(window.getXChange(), window.getYChange());
@@ -62,19 +356,57 @@ int main()
 		lastTime = now;
 
 		// Set lighting related variables
-		vulkanRenderer.setLighting(flashlight);
+		vulkanRenderer.setLighting(camera.getPosition());
 
 		// update camera
 		vulkanRenderer.updateView();
 
-		// update models
-		for (size_t i = 0; i < modelIds.size(); i++)
+		// Load the world's cells the camera moves towards, evict the ones it left
+		vulkanRenderer.updateStreaming(deltaTime);
+
+		// update controllable models
+		vulkanRenderer.updateControllers(window.getsKeys(), deltaTime);
+
+		// Pose the animated models before their meshes are skinned in draw()
+		vulkanRenderer.updateAnimations(deltaTime);
+
+		// Pick up edited shaders before the next frame is recorded
+		vulkanRenderer.reloadChangedShaders();
+
+		vulkanRenderer.draw();
+
+		// Profiler hotkeys: F11 prints the GPU timings, F12 writes the CPU and GPU Chrome traces
+		bool* keys = window.getsKeys();
+		if (keys[GLFW_KEY_F11] && !printKeyHeld)
 		{
-			vulkanRenderer.getMeshModel(modelIds[i])->keyControl(window.getsKeys(), deltaTime, 8.0f, 10.0f);
+			vulkanRenderer.getGpuProfiler()->printResults();
 		}
-		
+		if (keys[GLFW_KEY_F12] && !exportKeyHeld)
+		{
+			if (vulkanRenderer.getGpuProfiler()->exportChromeTrace("gpu_trace.json"))
+			{
+				printf("GPU trace written to gpu_trace.json\n");
+			}
+			if (CpuProfiler::exportChromeTrace("cpu_trace.json"))
+			{
+				printf("CPU trace written to cpu_trace.json\n");
+			}
+		}
+		printKeyHeld = keys[GLFW_KEY_F11];
+		exportKeyHeld = keys[GLFW_KEY_F12];
 
-		vulkanRenderer.draw();
+		// Pacing hotkeys: F9 cycles the present modes, F10 prints the frame time distribution and latency
+		FramePacer* framePacer = vulkanRenderer.getFramePacer();
+		if (keys[GLFW_KEY_F9] && !presentModeKeyHeld)
+		{
+			vulkanRenderer.setPresentMode(static_cast<PresentMode>((framePacer->getPresentMode() + 1) % PRESENT_MODE_COUNT));
+		}
+		if (keys[GLFW_KEY_F10] && !pacingKeyHeld)
+		{
+			framePacer->printStats();
+		}
+		presentModeKeyHeld = keys[GLFW_KEY_F9];
+		pacingKeyHeld = keys[GLFW_KEY_F10];
 	}
 
 	vulkanRenderer.cleanup();